@@ -34,43 +34,48 @@ namespace am
 namespace
 {
 
-const pcg::Vec4f _ps_am_1(1.0f);
-const pcg::Vec4f _ps_am_0p5(0.5f);
-const pcg::Vec4f _ps_am_min_norm_pos(
-    _mm_castsi128_ps(pcg::Vec4i::constant<0x00800000>()));
-const pcg::Vec4f _ps_am_inv_mant_mask(
-    _mm_castsi128_ps(pcg::Vec4i::constant<~0x7f800000>()));
+// The constants are unions initialized at compile time: a constructor would
+// make them dynamic initializers, which in the SIMD variants of the sources
+// run newer instructions as soon as the library is loaded
+#define PCG_AM_VEC4(x) {{x, x, x, x}}
 
-const pcg::Vec4i _epi32_1(pcg::Vec4i::constant<1>());
-const pcg::Vec4i _epi32_0x7f(pcg::Vec4i::constant<0x7f>());
+const pcg::Vec4fUnion _ps_am_1 = PCG_AM_VEC4(1.0f);
+const pcg::Vec4fUnion _ps_am_0p5 = PCG_AM_VEC4(0.5f);
+const pcg::Vec4iUnion _ps_am_min_norm_pos  = PCG_AM_VEC4(0x00800000);
+const pcg::Vec4iUnion _ps_am_inv_mant_mask = PCG_AM_VEC4(~0x7f800000);
+
+const pcg::Vec4iUnion _epi32_1    = PCG_AM_VEC4(1);
+const pcg::Vec4iUnion _epi32_0x7f = PCG_AM_VEC4(0x7f);
 
 /////////////////////////////////////////////////////////////////////////////
 // log functions
 
-const pcg::Vec4f _ps_log_p0( -7.89580278884799154124e-1f);
-const pcg::Vec4f _ps_log_p1(  1.63866645699558079767e1f);
-const pcg::Vec4f _ps_log_p2( -6.41409952958715622951e1f);
+const pcg::Vec4fUnion _ps_log_p0 = PCG_AM_VEC4( -7.89580278884799154124e-1f);
+const pcg::Vec4fUnion _ps_log_p1 = PCG_AM_VEC4(  1.63866645699558079767e1f);
+const pcg::Vec4fUnion _ps_log_p2 = PCG_AM_VEC4( -6.41409952958715622951e1f);
 
-const pcg::Vec4f _ps_log_q0( -3.56722798256324312549e1f);
-const pcg::Vec4f _ps_log_q1(  3.12093766372244180303e2f);
-const pcg::Vec4f _ps_log_q2( -7.69691943550460008604e2f);
+const pcg::Vec4fUnion _ps_log_q0 = PCG_AM_VEC4( -3.56722798256324312549e1f);
+const pcg::Vec4fUnion _ps_log_q1 = PCG_AM_VEC4(  3.12093766372244180303e2f);
+const pcg::Vec4fUnion _ps_log_q2 = PCG_AM_VEC4( -7.69691943550460008604e2f);
 
-const pcg::Vec4f _ps_log_c0(  0.693147180559945f);
+const pcg::Vec4fUnion _ps_log_c0 = PCG_AM_VEC4(  0.693147180559945f);
 
-const pcg::Vec4f _ps_log2_c0( 1.44269504088896340735992f);
+const pcg::Vec4fUnion _ps_log2_c0 = PCG_AM_VEC4( 1.44269504088896340735992f);
 
 /////////////////////////////////////////////////////////////////////////////
 // exp2 functions
 
-const pcg::Vec4f _ps_exp2_hi(  127.4999961853f);
-const pcg::Vec4f _ps_exp2_lo( -127.4999961853f);
+const pcg::Vec4fUnion _ps_exp2_hi = PCG_AM_VEC4(  127.4999961853f);
+const pcg::Vec4fUnion _ps_exp2_lo = PCG_AM_VEC4( -127.4999961853f);
+
+const pcg::Vec4fUnion _ps_exp2_p0 = PCG_AM_VEC4( 2.30933477057345225087e-2f);
+const pcg::Vec4fUnion _ps_exp2_p1 = PCG_AM_VEC4( 2.02020656693165307700e1f);
+const pcg::Vec4fUnion _ps_exp2_p2 = PCG_AM_VEC4( 1.51390680115615096133e3f);
 
-const pcg::Vec4f _ps_exp2_p0( 2.30933477057345225087e-2f);
-const pcg::Vec4f _ps_exp2_p1( 2.02020656693165307700e1f);
-const pcg::Vec4f _ps_exp2_p2( 1.51390680115615096133e3f);
+const pcg::Vec4fUnion _ps_exp2_q0 = PCG_AM_VEC4( 2.33184211722314911771e2f);
+const pcg::Vec4fUnion _ps_exp2_q1 = PCG_AM_VEC4( 4.36821166879210612817e3f);
 
-const pcg::Vec4f _ps_exp2_q0( 2.33184211722314911771e2f);
-const pcg::Vec4f _ps_exp2_q1( 4.36821166879210612817e3f);
+#undef PCG_AM_VEC4
 
 } // namespace
 } // namespace am
@@ -84,20 +89,20 @@ const pcg::Vec4f _ps_exp2_q1( 4.36821166879210612817e3f);
 inline __m128 am::log_eps(__m128 x)
 {
     // Constants
-    const __m128 am_1          = _ps_am_1;
-    const __m128 min_norm_pos  = _ps_am_min_norm_pos;
-    const __m128 inv_mant_mask = _ps_am_inv_mant_mask;
-    const __m128i epi32_0x7f   = _epi32_0x7f;
+    const __m128 am_1          = _ps_am_1.xmm;
+    const __m128 min_norm_pos  = _mm_castsi128_ps(_ps_am_min_norm_pos.xmm);
+    const __m128 inv_mant_mask = _mm_castsi128_ps(_ps_am_inv_mant_mask.xmm);
+    const __m128i epi32_0x7f   = _epi32_0x7f.xmm;
 
-    const __m128 log_p0 = _ps_log_p0;
-    const __m128 log_p1 = _ps_log_p1;
-    const __m128 log_p2 = _ps_log_p2;
+    const __m128 log_p0 = _ps_log_p0.xmm;
+    const __m128 log_p1 = _ps_log_p1.xmm;
+    const __m128 log_p2 = _ps_log_p2.xmm;
 
-    const __m128 log_q0 = _ps_log_q0;
-    const __m128 log_q1 = _ps_log_q1;
-    const __m128 log_q2 = _ps_log_q2;
+    const __m128 log_q0 = _ps_log_q0.xmm;
+    const __m128 log_q1 = _ps_log_q1.xmm;
+    const __m128 log_q2 = _ps_log_q2.xmm;
 
-    const __m128 log_c0 = _ps_log_c0;
+    const __m128 log_c0 = _ps_log_c0.xmm;
 
 
     // Use variables named like the registers to keep the code close
@@ -167,32 +172,32 @@ inline __m128 am::log_eps(__m128 x)
 inline __m128 am::pow_eps(__m128 x, __m128 y)
 {
     // Constants
-    const __m128 am_1          = _ps_am_1;
-    const __m128 am_0p5        = _ps_am_0p5;
-    const __m128 min_norm_pos  = _ps_am_min_norm_pos;
-    const __m128 inv_mant_mask = _ps_am_inv_mant_mask;
-    const __m128i epi32_1      = _epi32_1;
-    const __m128i epi32_0x7f   = _epi32_0x7f;
+    const __m128 am_1          = _ps_am_1.xmm;
+    const __m128 am_0p5        = _ps_am_0p5.xmm;
+    const __m128 min_norm_pos  = _mm_castsi128_ps(_ps_am_min_norm_pos.xmm);
+    const __m128 inv_mant_mask = _mm_castsi128_ps(_ps_am_inv_mant_mask.xmm);
+    const __m128i epi32_1      = _epi32_1.xmm;
+    const __m128i epi32_0x7f   = _epi32_0x7f.xmm;
 
-    const __m128 log_p0 = _ps_log_p0;
-    const __m128 log_p1 = _ps_log_p1;
-    const __m128 log_p2 = _ps_log_p2;
+    const __m128 log_p0 = _ps_log_p0.xmm;
+    const __m128 log_p1 = _ps_log_p1.xmm;
+    const __m128 log_p2 = _ps_log_p2.xmm;
 
-    const __m128 log_q0 = _ps_log_q0;
-    const __m128 log_q1 = _ps_log_q1;
-    const __m128 log_q2 = _ps_log_q2;
+    const __m128 log_q0 = _ps_log_q0.xmm;
+    const __m128 log_q1 = _ps_log_q1.xmm;
+    const __m128 log_q2 = _ps_log_q2.xmm;
 
-    const __m128 log2_c0 = _ps_log2_c0;
+    const __m128 log2_c0 = _ps_log2_c0.xmm;
 
-    const __m128 exp2_hi = _ps_exp2_hi;
-    const __m128 exp2_lo = _ps_exp2_lo;
+    const __m128 exp2_hi = _ps_exp2_hi.xmm;
+    const __m128 exp2_lo = _ps_exp2_lo.xmm;
 
-    const __m128 exp2_p0 = _ps_exp2_p0;
-    const __m128 exp2_p1 = _ps_exp2_p1;
-    const __m128 exp2_p2 = _ps_exp2_p2;
+    const __m128 exp2_p0 = _ps_exp2_p0.xmm;
+    const __m128 exp2_p1 = _ps_exp2_p1.xmm;
+    const __m128 exp2_p2 = _ps_exp2_p2.xmm;
 
-    const __m128 exp2_q0 = _ps_exp2_q0;
-    const __m128 exp2_q1 = _ps_exp2_q1;
+    const __m128 exp2_q0 = _ps_exp2_q0.xmm;
+    const __m128 exp2_q1 = _ps_exp2_q1.xmm;
 
     // Use variables named like the registers to keep the code close
     __m128 xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7, ecx_16;
@@ -329,33 +334,38 @@ typedef pcg::Vec8i v8i;
 typedef pcg::Vec8f v8f;
 
 
-const v8f inv_mantissa_mask(_mm256_castsi256_ps(v8i::constant<~0x7f800000>()));
-const v8f min_normal(_mm256_castsi256_ps(v8i::constant<0x00800000>()));
+// Compile time constants, as in the SSE version
+#define PCG_AM_VEC8(x) {{x, x, x, x, x, x, x, x}}
+
+const pcg::Vec8iUnion inv_mantissa_mask = PCG_AM_VEC8(~0x7f800000);
+const pcg::Vec8iUnion min_normal        = PCG_AM_VEC8(0x00800000);
+
+const pcg::Vec8fUnion const_1 = PCG_AM_VEC8(1.0f);
+const pcg::Vec8fUnion const_127 = PCG_AM_VEC8(127.0f);
+const pcg::Vec8fUnion const_0p5 = PCG_AM_VEC8(0.5f);
 
-const v8f const_1(1.0f);
-const v8f const_127(127.0f);
-const v8f const_0p5(0.5f);
+const pcg::Vec8fUnion log_p0 = PCG_AM_VEC8( -7.89580278884799154124e-1f);
+const pcg::Vec8fUnion log_p1 = PCG_AM_VEC8(  1.63866645699558079767e1f);
+const pcg::Vec8fUnion log_p2 = PCG_AM_VEC8( -6.41409952958715622951e1f);
 
-const v8f log_p0( -7.89580278884799154124e-1f);
-const v8f log_p1(  1.63866645699558079767e1f);
-const v8f log_p2( -6.41409952958715622951e1f);
+const pcg::Vec8fUnion log_q0 = PCG_AM_VEC8( -3.56722798256324312549e1f);
+const pcg::Vec8fUnion log_q1 = PCG_AM_VEC8(  3.12093766372244180303e2f);
+const pcg::Vec8fUnion log_q2 = PCG_AM_VEC8( -7.69691943550460008604e2f);
 
-const v8f log_q0( -3.56722798256324312549e1f);
-const v8f log_q1(  3.12093766372244180303e2f);
-const v8f log_q2( -7.69691943550460008604e2f);
+const pcg::Vec8fUnion log_c0 = PCG_AM_VEC8(  0.693147180559945f);
+const pcg::Vec8fUnion log2_c0 = PCG_AM_VEC8(1.44269504088896340735992f);
 
-const v8f log_c0(  0.693147180559945f);
-const v8f log2_c0(1.44269504088896340735992f);
+const pcg::Vec8fUnion exp2_hi = PCG_AM_VEC8( 127.4999961853f);
+const pcg::Vec8fUnion exp2_lo = PCG_AM_VEC8(-127.4999961853f);
 
-const v8f exp2_hi( 127.4999961853f);
-const v8f exp2_lo(-127.4999961853f);
+const pcg::Vec8fUnion exp2_p0 = PCG_AM_VEC8(2.30933477057345225087e-2f);
+const pcg::Vec8fUnion exp2_p1 = PCG_AM_VEC8(2.02020656693165307700e1f);
+const pcg::Vec8fUnion exp2_p2 = PCG_AM_VEC8(1.51390680115615096133e3f);
 
-const v8f exp2_p0(2.30933477057345225087e-2f);
-const v8f exp2_p1(2.02020656693165307700e1f);
-const v8f exp2_p2(1.51390680115615096133e3f);
+const pcg::Vec8fUnion exp2_q0 = PCG_AM_VEC8(2.33184211722314911771e2f);
+const pcg::Vec8fUnion exp2_q1 = PCG_AM_VEC8(4.36821166879210612817e3f);
 
-const v8f exp2_q0(2.33184211722314911771e2f);
-const v8f exp2_q1(4.36821166879210612817e3f);
+#undef PCG_AM_VEC8
 
 
 
@@ -425,8 +435,9 @@ inline __m256 am::log_avx(__m256 x)
     typedef pcg::Vec8f v8f;
 
     // Constants
-    const v8f min_normal(avx::min_normal);
-    const v8f inv_mantissa_mask(avx::inv_mantissa_mask);
+    const v8f min_normal(_mm256_castsi256_ps(avx::min_normal.ymm));
+    const v8f inv_mantissa_mask(
+        _mm256_castsi256_ps(avx::inv_mantissa_mask.ymm));
     const v8f const_1(avx::const_1);
     const v8f const_127(avx::const_127);
 
@@ -494,8 +505,9 @@ inline __m256 am::pow_avx(__m256 x, __m256 y)
     typedef pcg::Vec8bf v8bf;
 
     // Constants
-    const v8f min_normal(avx::min_normal);
-    const v8f inv_mantissa_mask(avx::inv_mantissa_mask);
+    const v8f min_normal(_mm256_castsi256_ps(avx::min_normal.ymm));
+    const v8f inv_mantissa_mask(
+        _mm256_castsi256_ps(avx::inv_mantissa_mask.ymm));
     const v8f const_1(avx::const_1);
     const v8f const_127(avx::const_127);
 
@@ -530,7 +542,7 @@ inline __m256 am::pow_avx(__m256 x, __m256 y)
     const v8f polyP = ((((avx::log_p0 * vFracSqr) + avx::log_p1) *
                                         vFracSqr) + avx::log_p2) * vFracSqr;
     const v8f polyQ =  (((avx::log_q0 * vFracSqr) + avx::log_q1) *
-                                        vFracSqr) + avx::log_q2;
+                                        vFracSqr) + v8f(avx::log_q2);
     const v8f logApprox = (polyP * simd_rcp(polyQ)) * vFrac;
     const v8f log2Val =
         (logApprox * avx::log2_c0) + ((vFrac * avx::log2_c0) + origExponent);
@@ -542,13 +554,13 @@ inline __m256 am::pow_avx(__m256 x, __m256 y)
     exponent = simd_max(simd_min(exponent, avx::exp2_hi), avx::exp2_lo);
 
     // More floating point tricks: normalize the mantissa to [1.0 - 1.5]
-    const v8f normExponent = exponent + avx::const_0p5;
+    const v8f normExponent = exponent + v8f(avx::const_0p5);
 
     // Build the biased exponent. The original formulation uses integer
     // arithmetic, but since that is not available in AVX use floating point
     // as it can handle all valid exponents: (-127.5 127.5)
     const v8bf expNegExponentMask = cmpnlt(v8f::zero(), normExponent);
-    const v8f expNormalization = v8f(expNegExponentMask) & avx::const_1;
+    const v8f expNormalization = v8f(expNegExponentMask) & v8f(avx::const_1);
     const v8f truncExp = avx::roundTruncate(normExponent);
     const v8f resExp = truncExp - expNormalization;
     v8i biasedExp = avx::toInt(resExp + avx::const_127);
@@ -565,7 +577,7 @@ inline __m256 am::pow_avx(__m256 x, __m256 y)
     const v8f EPolyQ =   ((avx::exp2_q0 * exponentSqr) + avx::exp2_q1) - EPolyP;
     v8f expApprox = EPolyP * simd_rcp(EPolyQ);
     expApprox += expApprox;
-    expApprox += avx::const_1;
+    expApprox += v8f(avx::const_1);
 
     v8f result = expApprox * exponentPart;
     return result;
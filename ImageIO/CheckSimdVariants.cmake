@@ -0,0 +1,58 @@
+# ============================================================================
+#   HDRITools - High Dynamic Range Image Tools
+#   Copyright 2008-2011 Program of Computer Graphics, Cornell University
+#
+#   Distributed under the OSI-approved MIT License (the "License");
+#   see accompanying file LICENSE for details.
+#
+#   This software is distributed WITHOUT ANY WARRANTY; without even the
+#   implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+#   See the License for more information.
+# ============================================================================
+
+# - Checks that the SIMD variant objects have no dynamic initializers nor
+#   weak symbols
+# Run as a script before linking ImageIO:
+#   cmake -DOBJDUMP=<objdump> -DOBJECT_DIR=<dir> -DOBJECT_EXT=<.o>
+#         -P CheckSimdVariants.cmake
+# The variants are compiled for newer instruction sets, so any code which runs
+# when the library is loaded (such as the constructor of a global Vec8f) would
+# crash with an illegal instruction on older processors. Constants in those
+# sources must be constant initialized instead, e.g. with Vec8fUnion.
+# For the same reason the linker must not pick their copy of an inline
+# function or template instance shared with other objects, thus they are
+# compiled with -fno-weak. Only the pointer to the exception personality
+# routine, which is data, may remain weak.
+
+file(GLOB objects "${OBJECT_DIR}/*${OBJECT_EXT}")
+foreach(obj ${objects})
+  execute_process(COMMAND "${OBJDUMP}" -h "${obj}"
+    OUTPUT_VARIABLE sections
+    RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not read the sections of ${obj}")
+  endif()
+  if (sections MATCHES "\\.(init_array|ctors)")
+    get_filename_component(obj_name "${obj}" NAME)
+    message(FATAL_ERROR "${obj_name} has dynamic initializers, which would "
+      "run instructions unsupported by older processors when loading the "
+      "library. Use constant initialized globals in SIMD variant sources.")
+  endif()
+
+  execute_process(COMMAND "${OBJDUMP}" -t "${obj}"
+    OUTPUT_VARIABLE symbols
+    RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not read the symbols of ${obj}")
+  endif()
+  string(REGEX MATCHALL "[^\n]+" symbols "${symbols}")
+  foreach(line ${symbols})
+    if (line MATCHES "^[0-9a-fA-F]+ ([ lg!]w|u)" AND
+        NOT line MATCHES " DW\\.ref\\.[^ ]+$")
+      get_filename_component(obj_name "${obj}" NAME)
+      message(FATAL_ERROR "${obj_name} has a weak symbol, which the linker "
+        "could choose over the copy for older processors:\n${line}\n"
+        "Compile the SIMD variant sources with -fno-weak.")
+    endif()
+  endforeach()
+endforeach()
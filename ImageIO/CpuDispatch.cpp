@@ -0,0 +1,229 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "CpuDispatch.h"
+#include "SimdDispatch.h"
+
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#else
+# include <cpuid.h>
+#endif
+
+using pcg::CpuDispatch;
+using pcg::SimdLevel;
+
+
+namespace
+{
+
+// Registers in the order EAX, EBX, ECX, EDX
+inline void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int r[4])
+{
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        r[i] = static_cast<unsigned int>(regs[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// Register XCR0, with the state components enabled by the operating system.
+// Only valid when CPUID reports OSXSAVE.
+inline unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    // Raw opcode of xgetbv for older assemblers
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0"
+        : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+inline bool hasBits(unsigned long long value, unsigned long long mask) {
+    return (value & mask) == mask;
+}
+
+SimdLevel detect()
+{
+    unsigned int r[4];
+    cpuid(0, 0, r);
+    const unsigned int maxLeaf = r[0];
+    if (maxLeaf < 1) {
+        return pcg::SIMD_SSE2;
+    }
+
+    cpuid(1, 0, r);
+    const unsigned int ecx1 = r[2];
+    const bool osxsave = hasBits(ecx1, 1u << 27);
+    const bool avx     = hasBits(ecx1, 1u << 28);
+    const bool fma     = hasBits(ecx1, 1u << 12);
+    const bool f16c    = hasBits(ecx1, 1u << 29);
+    if (!osxsave || !avx) {
+        return pcg::SIMD_SSE2;
+    }
+
+    // The operating system must save the XMM and YMM registers
+    const unsigned long long xcr0 = xgetbv0();
+    if (!hasBits(xcr0, 0x6)) {
+        return pcg::SIMD_SSE2;
+    }
+    if (maxLeaf < 7) {
+        return pcg::SIMD_AVX;
+    }
+
+    cpuid(7, 0, r);
+    const unsigned int ebx7 = r[1];
+    const bool avx2 = hasBits(ebx7, 1u << 5);
+    if (!avx2 || !fma || !f16c) {
+        return pcg::SIMD_AVX;
+    }
+
+    // F, DQ, BW and VL, plus the opmask and ZMM state
+    const unsigned int avx512Bits =
+        (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);
+    if (!hasBits(ebx7, avx512Bits) || !hasBits(xcr0, 0xE0)) {
+        return pcg::SIMD_AVX2;
+    }
+    return pcg::SIMD_AVX512;
+}
+
+// Best compiled level up to the given one
+SimdLevel bestCompiled(SimdLevel maxLevel)
+{
+    for (int level = maxLevel; level > CpuDispatch::Baseline(); --level) {
+        if (CpuDispatch::IsCompiled(static_cast<SimdLevel>(level))) {
+            return static_cast<SimdLevel>(level);
+        }
+    }
+    return CpuDispatch::Baseline();
+}
+
+SimdLevel initCurrent()
+{
+    SimdLevel level = CpuDispatch::Detected();
+    const char* value = getenv("HDRITOOLS_SIMD");
+    SimdLevel requested;
+    if (value != NULL && CpuDispatch::Parse(value, requested) &&
+        requested < level) {
+        level = requested;
+    }
+    return bestCompiled(level);
+}
+
+const char* const NAMES[] = { "sse2", "avx", "avx2", "avx512" };
+const int NUM_LEVELS = sizeof(NAMES) / sizeof(NAMES[0]);
+
+// Selected level, initialized on first use. The function-local static makes
+// the initialization thread safe and the atomic covers SetCurrent()
+std::atomic<int>& currentLevel()
+{
+    static std::atomic<int> level(initCurrent());
+    return level;
+}
+
+} // namespace
+
+
+
+SimdLevel CpuDispatch::Detected()
+{
+    static const SimdLevel detected = detect();
+    return detected;
+}
+
+
+
+SimdLevel CpuDispatch::Baseline()
+{
+#if PCG_USE_AVX2
+    return SIMD_AVX2;
+#elif PCG_USE_AVX
+    return SIMD_AVX;
+#else
+    return SIMD_SSE2;
+#endif
+}
+
+
+
+bool CpuDispatch::IsCompiled(SimdLevel level)
+{
+    switch (level) {
+    case SIMD_AVX:
+        return PCG_SIMD_HAVE_AVX != 0 || level == Baseline();
+    case SIMD_AVX2:
+        return PCG_SIMD_HAVE_AVX2 != 0 || level == Baseline();
+    case SIMD_AVX512:
+        return PCG_SIMD_HAVE_AVX512 != 0 || level == Baseline();
+    default:
+        return level == Baseline();
+    }
+}
+
+
+
+SimdLevel CpuDispatch::Current()
+{
+    return static_cast<SimdLevel>(currentLevel().load());
+}
+
+
+
+SimdLevel CpuDispatch::SetCurrent(SimdLevel level)
+{
+    const int selected = bestCompiled(level < Detected() ? level : Detected());
+    return static_cast<SimdLevel>(currentLevel().exchange(selected));
+}
+
+
+
+const char* CpuDispatch::Name(SimdLevel level)
+{
+    const int idx = static_cast<int>(level);
+    return (idx >= 0 && idx < NUM_LEVELS) ? NAMES[idx] : "unknown";
+}
+
+
+
+bool CpuDispatch::Parse(const char* name, SimdLevel& level)
+{
+    if (name == NULL) {
+        return false;
+    }
+    for (int idx = 0; idx < NUM_LEVELS; ++idx) {
+        const char* a = name;
+        const char* b = NAMES[idx];
+        while (*a != '\0' && tolower(static_cast<unsigned char>(*a)) == *b) {
+            ++a;
+            ++b;
+        }
+        if (*a == '\0' && *b == '\0') {
+            level = static_cast<SimdLevel>(idx);
+            return true;
+        }
+    }
+    return false;
+}
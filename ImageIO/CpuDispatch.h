@@ -0,0 +1,80 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Runtime selection of the SIMD kernels. When the library is built with
+// USE_SIMD_DISPATCH the hot kernels (tone mapping, luminance reduction,
+// RGBE conversion, AoS <-> SoA copies and image comparison) are compiled
+// once for each instruction set, and the best one supported by the
+// processor is used. The HDRITOOLS_SIMD environment variable, with the
+// values "sse2", "avx", "avx2" or "avx512", lowers that choice, e.g. to
+// test the older code paths on a newer machine.
+
+#pragma once
+#if !defined(PCG_CPUDISPATCH_H)
+#define PCG_CPUDISPATCH_H
+
+#include "ImageIO.h"
+
+namespace pcg
+{
+
+// Instruction sets with their own kernels, in increasing order
+enum SimdLevel
+{
+    SIMD_SSE2,
+    // AVX with 256-bit float vectors
+    SIMD_AVX,
+    // AVX2 with FMA and F16C, as in Haswell
+    SIMD_AVX2,
+    // AVX-512 F, DQ, BW and VL, as in Skylake-SP
+    SIMD_AVX512
+};
+
+
+class IMAGEIO_API CpuDispatch
+{
+public:
+    // Best instruction set supported by both the processor and the
+    // operating system, as reported by CPUID and XGETBV
+    static SimdLevel Detected();
+
+    // Instruction set of the whole library, chosen at build time. There are
+    // no kernels below this one.
+    static SimdLevel Baseline();
+
+    // Returns whether the library contains kernels for the instruction set
+    static bool IsCompiled(SimdLevel level);
+
+    // Instruction set of the kernels in use. The first call picks the best
+    // compiled one up to Detected() and the HDRITOOLS_SIMD variable.
+    static SimdLevel Current();
+
+    // Uses the best compiled instruction set up to the given one and
+    // Detected(), or Baseline() if there is none. Intended for tests and
+    // benchmarks; the kernels already running are not affected. Returns
+    // the previous instruction set.
+    static SimdLevel SetCurrent(SimdLevel level);
+
+    // Lower case name of the instruction set, as used by HDRITOOLS_SIMD
+    static const char* Name(SimdLevel level);
+
+    // Parses a name as returned by Name(), ignoring case. Returns false if
+    // the name is not valid, in which case level is not modified.
+    static bool Parse(const char* name, SimdLevel& level);
+};
+
+} // namespace pcg
+
+#endif /* PCG_CPUDISPATCH_H */
@@ -0,0 +1,128 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "DisplayLUT.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <cmath>
+
+using pcg::DisplayLUT;
+
+
+namespace
+{
+
+// The first octave of the table is the highest one whose transform is below
+// 2^-18, less than half of the 16-bit quantization step
+const double MIN_TRANSFORM_EXP = -18.0;
+
+// Smallest exponent of the normalized floats
+const int MIN_NORMAL_EXP = -126;
+
+inline double sRGB(double x)
+{
+    return x <= 0.0031308 ? 12.92 * x : 1.055 * pow(x, 1.0/2.4) - 0.055;
+}
+
+} // namespace
+
+
+
+DisplayLUT::DisplayLUT(const DisplayLUT& other) :
+m_table(NULL), m_size(other.m_size), m_precision(other.m_precision),
+m_base(other.m_base), m_isSRGB(other.m_isSRGB), m_gamma(other.m_gamma)
+{
+    if (!other.IsEmpty()) {
+        m_table = new float[m_size];
+        std::copy(other.m_table, other.m_table + m_size, m_table);
+    }
+}
+
+
+
+DisplayLUT& DisplayLUT::operator= (const DisplayLUT& other)
+{
+    if (this != &other) {
+        DisplayLUT tmp(other);
+        std::swap(m_table, tmp.m_table);
+        m_size      = other.m_size;
+        m_precision = other.m_precision;
+        m_base      = other.m_base;
+        m_isSRGB    = other.m_isSRGB;
+        m_gamma     = other.m_gamma;
+    }
+    return *this;
+}
+
+
+
+DisplayLUT::~DisplayLUT()
+{
+    delete [] m_table;
+}
+
+
+
+void DisplayLUT::SetSRGB(int precision)
+{
+    build(true, 0.0f, precision);
+}
+
+
+
+void DisplayLUT::SetGamma(float gamma, int precision)
+{
+    if (!(gamma > 0.0f)) {
+        throw IllegalArgumentException("The gamma must be greater than zero");
+    }
+    build(false, gamma, precision);
+}
+
+
+
+void DisplayLUT::build(bool isSRGB, float gamma, int precision)
+{
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION) {
+        throw IllegalArgumentException("Unsupported LUT precision");
+    }
+
+    // Below the linear segment sRGB is 12.92x, a gamma curve is x^(1/gamma)
+    const double minExpD = isSRGB ?
+        floor(MIN_TRANSFORM_EXP - log(12.92) / log(2.0)) :
+        floor(MIN_TRANSFORM_EXP * gamma);
+    const int minExp = static_cast<int>(std::max(minExpD,
+        static_cast<double>(MIN_NORMAL_EXP)));
+
+    // One entry per step within each octave in [2^minExp, 1], plus the
+    // end point and the entry after it, required by the interpolation of 1
+    const int steps = 1 << precision;
+    const int size  = -minExp * steps + 2;
+    float* table = new float[size];
+    const double invGamma = isSRGB ? 0.0 : 1.0 / gamma;
+    for (int i = 0; i < size; ++i) {
+        const double mantissa = 1.0 + static_cast<double>(i % steps) / steps;
+        const double x = ldexp(mantissa, minExp + i / steps);
+        table[i] = static_cast<float>(isSRGB ? sRGB(x) : pow(x, invGamma));
+    }
+
+    delete [] m_table;
+    m_table     = table;
+    m_size      = size;
+    m_precision = precision;
+    m_base      = (127 + minExp) << 23;
+    m_isSRGB    = isSRGB;
+    m_gamma     = isSRGB ? 0.0f : gamma;
+}
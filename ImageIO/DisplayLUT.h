@@ -0,0 +1,148 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Lookup table for the display transform (sRGB or a gamma curve) of linear
+// HDR values. It is indexed by the top bits of the IEEE 754 single
+// precision values: the exponent and the first Precision() bits of the
+// mantissa, thus each octave has the same number of entries and the relative
+// error is about the same across the whole range. The remaining bits of the
+// mantissa interpolate linearly between consecutive entries. The display
+// transform saturates at 1, hence the entries stop there: the index of any
+// larger value, infinity and positive NaNs included, is clamped to the entry
+// of 1, while negative values and negative NaNs use the first entry.
+//
+// Unlike the LUT of the old ToneMapper, the table does not depend on the
+// exposure, which is applied to the values beforehand. Changing it never
+// requires rebuilding the table.
+
+#pragma once
+#if !defined(PCG_DISPLAYLUT_H)
+#define PCG_DISPLAYLUT_H
+
+#include "ImageIO.h"
+#include "StdAfx.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace pcg
+{
+
+class IMAGEIO_API DisplayLUT
+{
+public:
+
+    // Supported number of mantissa bits in the index. With the default the
+    // maximum relative error is below 1e-5 for sRGB and gammas of at least 1.
+    enum {
+        MIN_PRECISION = 2,
+        MAX_PRECISION = 12,
+        DEFAULT_PRECISION = 6
+    };
+
+    // Creates an empty table. It has to be set up before its evaluation.
+    DisplayLUT() :
+    m_table(NULL), m_size(0), m_precision(0), m_base(0),
+    m_isSRGB(false), m_gamma(0.0f)
+    {}
+
+    DisplayLUT(const DisplayLUT& other);
+
+    DisplayLUT& operator= (const DisplayLUT& other);
+
+    ~DisplayLUT();
+
+    // Rebuilds the table for the sRGB curve. Throws an
+    // IllegalArgumentException if the precision is not supported.
+    void SetSRGB(int precision = DEFAULT_PRECISION);
+
+    // Rebuilds the table for the curve x^(1/gamma). Throws an
+    // IllegalArgumentException if the gamma is not greater than zero or if
+    // the precision is not supported.
+    void SetGamma(float gamma, int precision = DEFAULT_PRECISION);
+
+    // Bit pattern of 1.0f, the last value with its own entry
+    enum { ONE_BITS = 0x3F800000 };
+
+    // Evaluates the display transform of any value, clamped to [0,1]. The
+    // clamp is done on the bit pattern, as signed integers the negative
+    // values are below Base() and the NaNs are either below or above 1.
+    inline float operator() (float x) const {
+        assert(!IsEmpty());
+        int32_t bits;
+        memcpy(&bits, &x, sizeof(float));
+        bits = bits > m_base ? std::min(bits, static_cast<int32_t>(ONE_BITS)) :
+            m_base;
+        const int32_t offset = bits - m_base;
+
+        const int shift = 23 - m_precision;
+        const float* entry = m_table + (offset >> shift);
+        const float t = static_cast<float>(offset & ((1 << shift) - 1)) *
+            (1.0f / static_cast<float>(1 << shift));
+        return entry[0] + t * (entry[1] - entry[0]);
+    }
+
+    inline bool IsEmpty() const {
+        return m_table == NULL;
+    }
+
+    // Whether the table is for the sRGB curve or for a gamma one
+    inline bool IsSRGB() const {
+        return m_isSRGB;
+    }
+
+    // Gamma of the curve, zero for sRGB
+    inline float Gamma() const {
+        return m_gamma;
+    }
+
+    // Number of mantissa bits in the index
+    inline int Precision() const {
+        return m_precision;
+    }
+
+    // Raw entries, for the SIMD kernels. The entry of a value x is
+    // (clamp(bits(x), Base(), ONE_BITS) - Base()) >> (23 - Precision());
+    // the next entry is always valid, even for x = 1.
+    inline const float* Table() const {
+        return m_table;
+    }
+
+    inline int Size() const {
+        return m_size;
+    }
+
+    // Bit pattern of the smallest value with its own entry, a power of two
+    // whose transform is below half of the 16-bit quantization step. All
+    // the values below it, zero included, use the first entry.
+    inline int32_t Base() const {
+        return m_base;
+    }
+
+private:
+    void build(bool isSRGB, float gamma, int precision);
+
+    float* m_table;
+    int m_size;
+    int m_precision;
+    int32_t m_base;
+    bool m_isSRGB;
+    float m_gamma;
+};
+
+} // namespace pcg
+
+#endif /* PCG_DISPLAYLUT_H */
@@ -0,0 +1,332 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "HdrScanlineIO.h"
+#include "HdrScanlineIOPrivate.h"
+#include "LoadHDR.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+
+using namespace pcg;
+using namespace pcg::scanlineio_internal;
+
+
+namespace
+{
+
+// Guess the format of the file from its magic number
+HdrFormat guessFormat(const char* filename)
+{
+    std::ifstream is(filename, std::ios::binary);
+    if (!is) {
+        std::string msg("Could not open the file \"");
+        msg += filename;
+        msg += "\".";
+        throw IOException(msg);
+    }
+
+    union {
+        int32_t magic;
+        char magic_buffer[4];
+    } u = {0};
+    is.read(u.magic_buffer, sizeof(u.magic_buffer));
+    if (!is.good()) {
+        throw IOException("Could not read the magic number.");
+    }
+
+    if (u.magic == 20000630) {
+        return HDR_OPENEXR;
+    } else if (u.magic_buffer[0] == '#' && u.magic_buffer[1] == '?') {
+        return HDR_RGBE;
+    } else if (u.magic_buffer[0] == 'P' &&
+              (u.magic_buffer[1] == 'F' || u.magic_buffer[1] == 'f')) {
+        return HDR_PFM;
+    }
+
+    std::stringstream ss;
+    ss << "Unknown magic number [" << std::showbase << std::hex
+       << static_cast<int>(u.magic_buffer[0]) << ", "
+       << static_cast<int>(u.magic_buffer[1]) << "]";
+    throw UnkownFileType(ss.str());
+}
+
+} // namespace
+
+
+
+void ScanlineReaderImpl::read(RGBAImageSoA& band)
+{
+    if (m_tmp.Width() != band.Width() || m_tmp.Height() != band.Height()) {
+        m_tmp.Alloc(band.Width(), band.Height());
+    }
+    read(m_tmp);
+
+    float* PCG_RESTRICT r = band.GetDataPointer<RGBAImageSoA::R>();
+    float* PCG_RESTRICT g = band.GetDataPointer<RGBAImageSoA::G>();
+    float* PCG_RESTRICT b = band.GetDataPointer<RGBAImageSoA::B>();
+    float* PCG_RESTRICT a = band.GetDataPointer<RGBAImageSoA::A>();
+    const Rgba32F* PCG_RESTRICT pixels = m_tmp.GetDataPointer();
+    for (int i = 0; i < m_tmp.Size(); ++i) {
+        r[i] = pixels[i].r();
+        g[i] = pixels[i].g();
+        b[i] = pixels[i].b();
+        a[i] = pixels[i].a();
+    }
+}
+
+
+
+void ScanlineReaderImpl::read(Image<Rgbe, TopDown>& band)
+{
+    if (m_tmp.Width() != band.Width() || m_tmp.Height() != band.Height()) {
+        m_tmp.Alloc(band.Width(), band.Height());
+    }
+    read(m_tmp);
+
+    const Rgba32F* PCG_RESTRICT pixels = m_tmp.GetDataPointer();
+    Rgbe* PCG_RESTRICT dest = band.GetDataPointer();
+    for (int i = 0; i < m_tmp.Size(); ++i) {
+        dest[i] = Rgbe(pixels[i]);
+    }
+}
+
+
+
+void ScanlineWriterImpl::write(const RGBAImageSoA& band)
+{
+    if (m_tmp.Width() != band.Width() || m_tmp.Height() != band.Height()) {
+        m_tmp.Alloc(band.Width(), band.Height());
+    }
+
+    const float* PCG_RESTRICT r = band.GetDataPointer<RGBAImageSoA::R>();
+    const float* PCG_RESTRICT g = band.GetDataPointer<RGBAImageSoA::G>();
+    const float* PCG_RESTRICT b = band.GetDataPointer<RGBAImageSoA::B>();
+    const float* PCG_RESTRICT a = band.GetDataPointer<RGBAImageSoA::A>();
+    Rgba32F* PCG_RESTRICT pixels = m_tmp.GetDataPointer();
+    for (int i = 0; i < m_tmp.Size(); ++i) {
+        pixels[i].set(r[i], g[i], b[i], a[i]);
+    }
+    write(m_tmp);
+}
+
+
+
+HdrScanlineReader::HdrScanlineReader(const char* filename) :
+m_impl(NULL), m_format(HDR_RGBE), m_next(0)
+{
+    open(filename);
+}
+
+HdrScanlineReader::HdrScanlineReader(const std::string& filename) :
+m_impl(NULL), m_format(HDR_RGBE), m_next(0)
+{
+    open(filename.c_str());
+}
+
+HdrScanlineReader::~HdrScanlineReader()
+{
+    delete m_impl;
+}
+
+void HdrScanlineReader::open(const char* filename)
+{
+    if (filename == NULL) {
+        throw IllegalArgumentException("The filename cannot be null.");
+    }
+
+    m_format = guessFormat(filename);
+    switch (m_format) {
+    case HDR_RGBE:
+        m_impl = newRgbeScanlineReader(filename);
+        break;
+    case HDR_PFM:
+        m_impl = newPfmScanlineReader(filename);
+        break;
+    case HDR_OPENEXR:
+        m_impl = newOpenEXRScanlineReader(filename);
+        break;
+    }
+    assert(m_impl != NULL);
+}
+
+int HdrScanlineReader::Width() const
+{
+    return m_impl->width();
+}
+
+int HdrScanlineReader::Height() const
+{
+    return m_impl->height();
+}
+
+int HdrScanlineReader::nextBandSize(int maxScanlines) const
+{
+    if (maxScanlines <= 0) {
+        throw IllegalArgumentException("The band must have at least "
+            "one scanline.");
+    }
+    return std::min(maxScanlines, Height() - m_next);
+}
+
+int HdrScanlineReader::Read(Image<Rgba32F, TopDown>& band, int maxScanlines)
+{
+    const int count = nextBandSize(maxScanlines);
+    if (count == 0) {
+        return 0;
+    }
+    if (band.Width() != Width() || band.Height() != count) {
+        band.Alloc(Width(), count);
+    }
+    m_impl->read(band);
+    m_next += count;
+    return count;
+}
+
+int HdrScanlineReader::Read(RGBAImageSoA& band, int maxScanlines)
+{
+    const int count = nextBandSize(maxScanlines);
+    if (count == 0) {
+        return 0;
+    }
+    if (band.Width() != Width() || band.Height() != count) {
+        band.Alloc(Width(), count);
+    }
+    m_impl->read(band);
+    m_next += count;
+    return count;
+}
+
+int HdrScanlineReader::Read(Image<Rgbe, TopDown>& band, int maxScanlines)
+{
+    const int count = nextBandSize(maxScanlines);
+    if (count == 0) {
+        return 0;
+    }
+    if (band.Width() != Width() || band.Height() != count) {
+        band.Alloc(Width(), count);
+    }
+    m_impl->read(band);
+    m_next += count;
+    return count;
+}
+
+
+
+HdrScanlineWriter::HdrScanlineWriter(const char* filename,
+    int width, int height, HdrFormat format) :
+m_impl(NULL), m_width(width), m_height(height), m_next(0)
+{
+    open(filename, format);
+}
+
+HdrScanlineWriter::HdrScanlineWriter(const std::string& filename,
+    int width, int height, HdrFormat format) :
+m_impl(NULL), m_width(width), m_height(height), m_next(0)
+{
+    open(filename.c_str(), format);
+}
+
+HdrScanlineWriter::~HdrScanlineWriter()
+{
+    if (m_impl != NULL) {
+        try {
+            m_impl->close();
+        }
+        catch (...) {}
+        delete m_impl;
+    }
+}
+
+void HdrScanlineWriter::open(const char* filename, HdrFormat format)
+{
+    if (filename == NULL) {
+        throw IllegalArgumentException("The filename cannot be null.");
+    }
+    if (m_width <= 0 || m_height <= 0) {
+        throw IllegalArgumentException("Invalid image dimensions.");
+    }
+
+    switch (format) {
+    case HDR_RGBE:
+        m_impl = newRgbeScanlineWriter(filename, m_width, m_height);
+        break;
+    case HDR_PFM:
+        m_impl = newPfmScanlineWriter(filename, m_width, m_height);
+        break;
+    case HDR_OPENEXR:
+        m_impl = newOpenEXRScanlineWriter(filename, m_width, m_height);
+        break;
+    default:
+        throw IllegalArgumentException("Unknown format.");
+    }
+    assert(m_impl != NULL);
+}
+
+void HdrScanlineWriter::checkBand(int bandWidth, int bandHeight) const
+{
+    if (m_impl == NULL) {
+        throw IOException("The writer has already been closed.");
+    }
+    if (bandWidth != m_width) {
+        throw IllegalArgumentException("The width of the band does not "
+            "match the width of the file.");
+    }
+    if (bandHeight > m_height - m_next) {
+        throw IllegalArgumentException("The band goes beyond the last "
+            "scanline of the file.");
+    }
+}
+
+void HdrScanlineWriter::Write(const Image<Rgba32F, TopDown>& band)
+{
+    checkBand(band.Width(), band.Height());
+    if (band.Height() != 0) {
+        m_impl->write(band);
+        m_next += band.Height();
+    }
+}
+
+void HdrScanlineWriter::Write(const RGBAImageSoA& band)
+{
+    checkBand(band.Width(), band.Height());
+    if (band.Height() != 0) {
+        m_impl->write(band);
+        m_next += band.Height();
+    }
+}
+
+void HdrScanlineWriter::Close()
+{
+    if (m_impl == NULL) {
+        return;
+    }
+    ScanlineWriterImpl* impl = m_impl;
+    m_impl = NULL;
+    const bool complete = m_next == m_height;
+    try {
+        impl->close();
+    }
+    catch (...) {
+        delete impl;
+        throw;
+    }
+    delete impl;
+    if (!complete) {
+        throw IOException("Not all the scanlines were written.");
+    }
+}
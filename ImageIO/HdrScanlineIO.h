@@ -0,0 +1,153 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Incremental access to RGBE, PFM and OpenEXR files in bands of scanlines,
+// so that arbitrarily large images may be processed with bounded memory.
+// The scanlines are always read and written in top-down order.
+
+#pragma once
+#if !defined(PCG_HDRSCANLINEIO_H)
+#define PCG_HDRSCANLINEIO_H
+
+#include "ImageIO.h"
+#include "Image.h"
+#include "ImageSoA.h"
+#include "Rgba32F.h"
+#include "rgbe.h"
+#include "Exception.h"
+
+#include <string>
+
+namespace pcg
+{
+
+namespace scanlineio_internal
+{
+class ScanlineReaderImpl;
+class ScanlineWriterImpl;
+}
+
+// Supported file formats
+enum HdrFormat
+{
+    HDR_RGBE,
+    HDR_PFM,
+    HDR_OPENEXR
+};
+
+
+class IMAGEIO_API HdrScanlineReader
+{
+public:
+    // Opens the file, guessing its format from the magic number. Throws an
+    // IOException if the file cannot be read or if the format is unknown.
+    explicit HdrScanlineReader(const char* filename);
+    explicit HdrScanlineReader(const std::string& filename);
+    ~HdrScanlineReader();
+
+    int Width() const;
+    int Height() const;
+
+    inline HdrFormat Format() const {
+        return m_format;
+    }
+
+    // Index of the next scanline to be read
+    inline int NextScanline() const {
+        return m_next;
+    }
+
+    // Whether all the scanlines have been read
+    inline bool IsDone() const {
+        return m_next >= Height();
+    }
+
+    // Reads up to maxScanlines into the band, which is reallocated only if
+    // its size changes. Returns the number of scanlines read, which is zero
+    // once the end of the image is reached.
+    int Read(Image<Rgba32F, TopDown>& band, int maxScanlines);
+    int Read(RGBAImageSoA& band, int maxScanlines);
+
+    // RGBE files are read without decoding their pixels, e.g. to tone map
+    // them directly with ToneMapperSoA. Other formats are encoded as RGBE,
+    // losing precision.
+    int Read(Image<Rgbe, TopDown>& band, int maxScanlines);
+
+private:
+    // Non-copyable
+    HdrScanlineReader(const HdrScanlineReader&);
+    HdrScanlineReader& operator= (const HdrScanlineReader&);
+
+    void open(const char* filename);
+    int nextBandSize(int maxScanlines) const;
+
+    scanlineio_internal::ScanlineReaderImpl* m_impl;
+    HdrFormat m_format;
+    int m_next;
+};
+
+
+class IMAGEIO_API HdrScanlineWriter
+{
+public:
+    // Creates a new file with the given format and dimensions. The PFM
+    // format is stored bottom-up, thus the file must be seekable.
+    HdrScanlineWriter(const char* filename, int width, int height,
+        HdrFormat format);
+    HdrScanlineWriter(const std::string& filename, int width, int height,
+        HdrFormat format);
+
+    // Closes the file if it is still open, ignoring any error
+    ~HdrScanlineWriter();
+
+    inline int Width() const {
+        return m_width;
+    }
+
+    inline int Height() const {
+        return m_height;
+    }
+
+    // Index of the next scanline to be written
+    inline int NextScanline() const {
+        return m_next;
+    }
+
+    // Writes the band as the next scanlines. The band must have the same
+    // width as the file and must not go past its last scanline.
+    void Write(const Image<Rgba32F, TopDown>& band);
+    void Write(const RGBAImageSoA& band);
+
+    // Finishes the file. Throws an IOException if not all the scanlines
+    // were written.
+    void Close();
+
+private:
+    // Non-copyable
+    HdrScanlineWriter(const HdrScanlineWriter&);
+    HdrScanlineWriter& operator= (const HdrScanlineWriter&);
+
+    void open(const char* filename, HdrFormat format);
+    void checkBand(int bandWidth, int bandHeight) const;
+
+    scanlineio_internal::ScanlineWriterImpl* m_impl;
+    int m_width;
+    int m_height;
+    int m_next;
+};
+
+} // namespace pcg
+
+#endif /* PCG_HDRSCANLINEIO_H */
@@ -0,0 +1,100 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal interface between the streaming scanline reader/writer and the
+// format specific implementations, which live next to each codec.
+
+#if !defined(PCG_HDRSCANLINEIOPRIVATE_H)
+#define PCG_HDRSCANLINEIOPRIVATE_H
+
+#include "Image.h"
+#include "ImageSoA.h"
+#include "Rgba32F.h"
+#include "rgbe.h"
+
+namespace pcg
+{
+namespace scanlineio_internal
+{
+
+// Sequential reader of the scanlines of a file, in top-down order
+class ScanlineReaderImpl
+{
+public:
+    ScanlineReaderImpl() : m_width(0), m_height(0) {}
+    virtual ~ScanlineReaderImpl() {}
+
+    inline int width()  const { return m_width;  }
+    inline int height() const { return m_height; }
+
+    // Reads the next band.Height() scanlines into the band, which has
+    // already been allocated with the width of the image. Throws an
+    // IOException upon failure.
+    virtual void read(Image<Rgba32F, TopDown>& band) = 0;
+
+    // Same as above for SoA bands. The default implementation converts
+    // from an intermediate Rgba32F band.
+    virtual void read(RGBAImageSoA& band);
+
+    // Same as above for RGBE bands. The default implementation encodes
+    // an intermediate Rgba32F band.
+    virtual void read(Image<Rgbe, TopDown>& band);
+
+protected:
+    int m_width;
+    int m_height;
+
+private:
+    Image<Rgba32F, TopDown> m_tmp;
+};
+
+
+// Sequential writer of the scanlines of a file, in top-down order
+class ScanlineWriterImpl
+{
+public:
+    virtual ~ScanlineWriterImpl() {}
+
+    // Writes the band as the next band.Height() scanlines of the file
+    virtual void write(const Image<Rgba32F, TopDown>& band) = 0;
+
+    // Same as above for SoA bands. The default implementation converts
+    // into an intermediate Rgba32F band.
+    virtual void write(const RGBAImageSoA& band);
+
+    // Flushes any pending data once all the scanlines have been written
+    virtual void close() = 0;
+
+private:
+    Image<Rgba32F, TopDown> m_tmp;
+};
+
+
+// Factories for each format. They throw an IOException upon failure.
+ScanlineReaderImpl* newRgbeScanlineReader(const char* filename);
+ScanlineReaderImpl* newPfmScanlineReader(const char* filename);
+ScanlineReaderImpl* newOpenEXRScanlineReader(const char* filename);
+
+ScanlineWriterImpl* newRgbeScanlineWriter(const char* filename,
+    int width, int height);
+ScanlineWriterImpl* newPfmScanlineWriter(const char* filename,
+    int width, int height);
+ScanlineWriterImpl* newOpenEXRScanlineWriter(const char* filename,
+    int width, int height);
+
+} // namespace scanlineio_internal
+} // namespace pcg
+
+#endif /* PCG_HDRSCANLINEIOPRIVATE_H */
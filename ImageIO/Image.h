@@ -32,9 +32,11 @@
 #endif
 
 #include "ImageIO.h"
+#include "ImageAllocator.h"
 #include "Exception.h"
 
 #include <cstdlib>
+#include <cstddef>
 #include <cassert>
 
 
@@ -130,14 +132,21 @@ namespace pcg {
 
 #endif /* PCG_IMAGE_CRAZY_TEMPLATES */
 
-		// Helper function to allocate the memory. It allocates excess data so
-		// that the total memory is a multiple of 64. The memory is aligned to
-		// 64-bytes as well.
+		// Number of bytes of the buffer: the pixels are padded to a
+		// multiple of 64 so that whole vectors may be read past the end
+		inline size_t bufferBytes() const {
+			const size_t numPixels = ((static_cast<size_t>(w)*h) + 63) & ~size_t(0x3F);
+			assert (numPixels >= (static_cast<size_t>(w)*h));
+			assert (numPixels % 64 == 0);
+			return sizeof(T) * numPixels;
+		}
+
+		// Helper function to allocate the memory through the current
+		// ImageAllocator. It allocates excess data so that the total memory
+		// is a multiple of 64. The memory is aligned to 64-bytes as well.
 		inline void alloc() {
-			const size_t totalBytes = ((static_cast<size_t>(w)*h) + 63) & ~0x3F;
-			assert (totalBytes >= (static_cast<size_t>(w)*h));
-			assert (totalBytes % 64 == 0);
-			this->d = alloc_align<T>(64, totalBytes);
+			this->allocator = ImageAllocator::Current();
+			this->d = static_cast<T*>(allocator->Allocate(bufferBytes()));
             if (this->d == NULL) {
                 throw RuntimeException("Couldn't allocate the memory "
                     "for the image");
@@ -149,13 +158,12 @@ namespace pcg {
 
 		// Default constructor: creates an empty image. To do anything
 		// useful afterwards you need to use the Alloc(int,int) method.
-		Image() : d(NULL), w(0), h(0), mode(S) {
+		Image() : d(NULL), w(0), h(0), allocator(NULL), mode(S) {
 		}
 
 		// Creates a new image allocating the required space
-		Image(int w, int h) : d(NULL), mode(S) {
+		Image(int w, int h) : d(NULL), allocator(NULL), mode(S) {
 			assert(w > 0 && h > 0);
-            assert(((long long)w)*h <= 0x7fffffff);
 			this->w = w;
 			this->h = h;
 			alloc();
@@ -178,8 +186,9 @@ namespace pcg {
 		// Deallocates the memory and resets the image dimensions to 0
 		void Clear() {
 			if(d != NULL) {
-				free_align(d);
+				allocator->Release(d, bufferBytes());
 				d = NULL;
+				allocator = NULL;
 			}
 			w = h = 0;
 		}
@@ -187,37 +196,40 @@ namespace pcg {
 		// Returns a reference to the i-th pixel in the j-th scanline (indices are zero-based)
 		// according to the scanline order of the image.
 		T& ElementAt(int i, int j, ScanLineMode mode = S) const {
-			assert(w*j+i >=0 && w*j+i < w*h && j >= 0 && j < h && i >=0 && i < w);
+			assert(j >= 0 && j < h && i >=0 && i < w);
 #if PCG_IMAGE_CRAZY_TEMPLATES
 			return ScanLineGetter<S>::ElementAt(i, j, mode, this);
 #else
-            return (mode == S) ? d[w*j + i] : d[(h-j-1)*w + i];
+            return (mode == S) ? d[static_cast<ptrdiff_t>(w)*j + i] :
+                                 d[static_cast<ptrdiff_t>(h-j-1)*w + i];
 #endif
 		}
 
 		// Returns a reference to the idx-th pixel of the image, which are in scanline order
 		// according to the specified mode.
-		T& ElementAt(int idx) const {
-			assert(idx >=0 && idx < w*h);
+		T& ElementAt(ptrdiff_t idx) const {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
 		// Writes in the i,j parameters the coordinates necessary to access the idx-pixel in the
 		// image using ElementAt(int,int), according to the scanline order of the image.
-		void GetIndices(int idx, int &i, int &j) const { 
-			i = idx % w; 
-			j = idx / w; 
+		void GetIndices(ptrdiff_t idx, int &i, int &j) const { 
+			i = static_cast<int>(idx % w); 
+			j = static_cast<int>(idx / w); 
 		}
 		
 		// Returns the index (zero based) of the i-th pixel at the j-th scanline using the
 		// scanline order of the image.
-		int GetIndex(int i, int j) const { return w*j+i; }
+		ptrdiff_t GetIndex(int i, int j) const {
+			return static_cast<ptrdiff_t>(w)*j + i;
+		}
 
 		// Returns the index (zero based) of the i-th pixel at the j-th scanline
 		// using the given scanline order.
-		int GetIndex(int i, int j, ScanLineMode mode) const {
-			return w*j+i;
-			return (mode == S) ? (w*j + i) : (((h-j-1)*w) + i);
+		ptrdiff_t GetIndex(int i, int j, ScanLineMode mode) const {
+			return (mode == S) ? (static_cast<ptrdiff_t>(w)*j + i) :
+			                     (static_cast<ptrdiff_t>(h-j-1)*w + i);
 		}
 
 		// Width of the image
@@ -226,21 +238,21 @@ namespace pcg {
 		// Height of the image
 		int Height() const { return h; }
 
-		// Number of pixels in the image (Width*Height)
-		int Size()   const { return w*h; }
+		// Number of pixels in the image (Width*Height). It may exceed 2^31
+		ptrdiff_t Size() const { return static_cast<ptrdiff_t>(w)*h; }
 
 		// Raw pointer to the pixels
 		T* GetDataPointer() const { return d; }
 
 		// Returns a reference to the idx-th pixel, as in ElementAt(int)
-		T& operator[](int idx) {
-			assert(idx >=0 && idx < w*h);
+		T& operator[](ptrdiff_t idx) {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
 		// Returns a const reference to the idx-th pixel, as in ElementAt(int)
-		const T& operator[](int idx) const {
-			assert(idx >=0 && idx < w*h);
+		const T& operator[](ptrdiff_t idx) const {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
@@ -258,7 +270,8 @@ namespace pcg {
 			return ScanLineGetter<S>::GetScanline(j, mode, this);
 #else
 			// We only have two modes, so this works nicely
-            return (mode == S) ? &(d[j * w]) : &(d[(h - j - 1) * w]);
+            return (mode == S) ? &(d[static_cast<ptrdiff_t>(j) * w]) :
+                                 &(d[static_cast<ptrdiff_t>(h - j - 1) * w]);
 #endif
 		}
 
@@ -273,6 +286,9 @@ namespace pcg {
 		// Height of the image
 		int h;
 
+		// Allocator which provided the pixels
+		ImageAllocator* allocator;
+
 		// The scanline mode of this image
 		const ScanLineMode mode;
 	};
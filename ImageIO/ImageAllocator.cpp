@@ -0,0 +1,559 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "ImageAllocator.h"
+
+#include <tbb/spin_mutex.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_scheduler_init.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cassert>
+
+#if defined(_WIN32)
+# ifdef NOMINMAX
+#  undef NOMINMAX
+# endif
+# define NOMINMAX
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+# include <WinIoCtl.h>
+#else
+# include <sys/types.h>
+# include <sys/mman.h>
+# include <unistd.h>
+# include <cstdlib>
+# include <limits>
+#endif
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+# define PCG_USE_THP 1
+#endif
+#if !defined(PCG_USE_THP)
+# define PCG_USE_THP 0
+#endif
+
+using namespace pcg;
+
+
+namespace
+{
+
+// Size of the transparent huge pages on x86-64
+const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// Requests up to this size are rounded to whole 4 KB pages
+const size_t SMALL_LIMIT       = size_t(64) << 10;
+const size_t SMALL_GRANULARITY = size_t(4) << 10;
+
+inline size_t roundUp(size_t value, size_t multiple)
+{
+    assert(multiple != 0 && (multiple & (multiple - 1)) == 0);
+    return (value + (multiple - 1)) & ~(multiple - 1);
+}
+
+// Largest power of two less or equal than the (non zero) value
+inline size_t floorPow2(size_t value)
+{
+    assert(value != 0);
+    size_t p = 1;
+    while ((value >>= 1) != 0) {
+        p <<= 1;
+    }
+    return p;
+}
+
+inline void* allocateBlock(size_t bytes, bool useHugePages)
+{
+    if (useHugePages && bytes >= HUGE_PAGE_SIZE) {
+        void* ptr = alloc_align<char>(HUGE_PAGE_SIZE, bytes);
+#if PCG_USE_THP
+        // Only a hint, the kernel might not have huge pages available
+        if (ptr != NULL) {
+            madvise(ptr, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        return ptr;
+    }
+    return alloc_align<char>(ImageAllocator::ALIGNMENT, bytes);
+}
+
+inline void freeBlock(void* ptr)
+{
+    free_align(static_cast<char*>(ptr));
+}
+
+
+
+// Writes the first byte of each page so that it gets mapped on the NUMA
+// node of the thread which processes that part of the block. Each task
+// handles whole chunks, in all the planes; a page belongs to the chunk
+// where it starts, except the first one of the block.
+struct FirstTouchFunctor
+{
+    FirstTouchFunctor(char* ptr, size_t planeBytes, size_t numPlanes,
+        int numChunks) : m_ptr(ptr), m_planeBytes(planeBytes),
+        m_numPlanes(numPlanes), m_numChunks(numChunks) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        const size_t PAGE_BYTES = FirstTouchAllocator::PAGE_BYTES;
+        if (range.begin() == 0) {
+            m_ptr[0] = 0;
+        }
+        for (int k = range.begin(); k != range.end(); ++k) {
+            const size_t begin = FirstTouchAllocator::ChunkBegin(
+                m_planeBytes, k, m_numChunks);
+            const size_t end = FirstTouchAllocator::ChunkBegin(
+                m_planeBytes, k + 1, m_numChunks);
+            for (size_t p = 0; p != m_numPlanes; ++p) {
+                char* plane = m_ptr + p * m_planeBytes;
+                const uintptr_t first = roundUp(
+                    reinterpret_cast<uintptr_t>(plane + begin), PAGE_BYTES);
+                const uintptr_t last = reinterpret_cast<uintptr_t>(plane + end);
+                for (uintptr_t page = first; page < last; page += PAGE_BYTES) {
+                    *reinterpret_cast<char*>(page) = 0;
+                }
+            }
+        }
+    }
+
+private:
+    char* const m_ptr;
+    const size_t m_planeBytes;
+    const size_t m_numPlanes;
+    const int m_numChunks;
+};
+
+
+
+// Maps a new sparse temporary file of the given size, which goes away when
+// the mapping is released. Returns NULL on error.
+#if defined(_WIN32)
+
+void* mapTemporaryFile(const std::string& directory, size_t bytes)
+{
+    char dir[MAX_PATH + 1];
+    if (!directory.empty()) {
+        strncpy_s(dir, directory.c_str(), _TRUNCATE);
+    } else if (::GetTempPathA(sizeof(dir), dir) == 0) {
+        return NULL;
+    }
+    char filename[MAX_PATH + 1];
+    if (::GetTempFileNameA(dir, "hdr", 0, filename) == 0) {
+        return NULL;
+    }
+
+    HANDLE hFile = ::CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0,
+        NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    // The view keeps the file alive once its handles are closed
+    void* ptr = NULL;
+    DWORD unused;
+    ::DeviceIoControl(hFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &unused, NULL);
+    const unsigned long long size = bytes;
+    HANDLE hMapping = ::CreateFileMappingA(hFile, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+    if (hMapping != NULL) {
+        ptr = ::MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        ::CloseHandle(hMapping);
+    }
+    ::CloseHandle(hFile);
+    return ptr;
+}
+
+inline void unmapTemporaryFile(void* ptr, size_t)
+{
+    ::UnmapViewOfFile(ptr);
+}
+
+#else
+
+void* mapTemporaryFile(const std::string& directory, size_t bytes)
+{
+    if (bytes > static_cast<unsigned long long>(
+        std::numeric_limits<off_t>::max())) {
+        return NULL;
+    }
+
+    std::string path(directory);
+    if (path.empty()) {
+        const char* tmpdir = getenv("TMPDIR");
+        path = tmpdir != NULL && tmpdir[0] != '\0' ? tmpdir : "/tmp";
+    }
+    path += "/hdritools-XXXXXX";
+    std::vector<char> filename(path.begin(), path.end());
+    filename.push_back('\0');
+    const int fd = ::mkstemp(&filename[0]);
+    if (fd == -1) {
+        return NULL;
+    }
+    ::unlink(&filename[0]);
+
+    // Extending the file without writing it keeps it sparse
+    void* ptr = NULL;
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) == 0) {
+        void* addr = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+        if (addr != MAP_FAILED) {
+            // The kernels stream through the planes
+#if defined(MADV_SEQUENTIAL)
+            ::madvise(addr, bytes, MADV_SEQUENTIAL);
+#endif
+            ptr = addr;
+        }
+    }
+    ::close(fd);
+    return ptr;
+}
+
+inline void unmapTemporaryFile(void* ptr, size_t bytes)
+{
+    ::munmap(ptr, bytes);
+}
+
+#endif
+
+
+
+// Plain aligned allocations, as the images used to do
+class DefaultAllocator : public ImageAllocator
+{
+public:
+    virtual void* Allocate(size_t bytes) {
+        return allocateBlock(bytes, false);
+    }
+
+    virtual void Release(void* ptr, size_t) {
+        freeBlock(ptr);
+    }
+};
+
+DefaultAllocator defaultAllocator;
+
+// Allocator currently used by the images
+ImageAllocator* currentAllocator = &defaultAllocator;
+tbb::spin_mutex currentMutex;
+
+} // namespace
+
+
+
+void* ImageAllocator::AllocatePlanes(size_t planeBytes, size_t numPlanes)
+{
+    return Allocate(planeBytes * numPlanes);
+}
+
+
+ImageAllocator* ImageAllocator::Current()
+{
+    tbb::spin_mutex::scoped_lock lock(currentMutex);
+    return currentAllocator;
+}
+
+
+ImageAllocator* ImageAllocator::SetCurrent(ImageAllocator* allocator)
+{
+    tbb::spin_mutex::scoped_lock lock(currentMutex);
+    ImageAllocator* previous = currentAllocator;
+    currentAllocator = allocator != NULL ? allocator : &defaultAllocator;
+    return previous;
+}
+
+
+ImageAllocator* ImageAllocator::Default()
+{
+    return &defaultAllocator;
+}
+
+
+
+struct PooledAllocator::Pool
+{
+    // Released blocks of each size class, the most recent one at the back
+    typedef std::map<size_t, std::vector<void*> > FreeLists;
+
+    Pool(size_t maxCached, bool hugePages) : cachedBytes(0),
+        maxCachedBytes(maxCached), hits(0), misses(0),
+        useHugePages(hugePages) {}
+
+    FreeLists freeLists;
+    size_t cachedBytes;
+    const size_t maxCachedBytes;
+    size_t hits;
+    size_t misses;
+    const bool useHugePages;
+    mutable tbb::spin_mutex mutex;
+};
+
+
+PooledAllocator::PooledAllocator(size_t maxCachedBytes, bool useHugePages) :
+m_pool(new Pool(maxCachedBytes, useHugePages))
+{}
+
+
+PooledAllocator::~PooledAllocator()
+{
+    Trim();
+    delete m_pool;
+}
+
+
+size_t PooledAllocator::SizeClass(size_t bytes) const
+{
+    size_t size;
+    if (bytes <= SMALL_LIMIT) {
+        size = roundUp(bytes != 0 ? bytes : 1, SMALL_GRANULARITY);
+    } else {
+        // Four classes between consecutive powers of two
+        size = roundUp(bytes, floorPow2(bytes) >> 2);
+    }
+    if (m_pool->useHugePages && size >= HUGE_PAGE_SIZE) {
+        size = roundUp(size, HUGE_PAGE_SIZE);
+    }
+    // On overflow just let the actual allocation fail
+    return size >= bytes ? size : bytes;
+}
+
+
+void* PooledAllocator::Allocate(size_t bytes)
+{
+    const size_t size = SizeClass(bytes);
+    {
+        tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+        Pool::FreeLists::iterator it = m_pool->freeLists.find(size);
+        if (it != m_pool->freeLists.end() && !it->second.empty()) {
+            void* ptr = it->second.back();
+            it->second.pop_back();
+            m_pool->cachedBytes -= size;
+            ++m_pool->hits;
+            return ptr;
+        }
+        ++m_pool->misses;
+    }
+    return allocateBlock(size, m_pool->useHugePages);
+}
+
+
+void PooledAllocator::Release(void* ptr, size_t bytes)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    const size_t size = SizeClass(bytes);
+    {
+        tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+        if (m_pool->cachedBytes + size <= m_pool->maxCachedBytes) {
+            m_pool->freeLists[size].push_back(ptr);
+            m_pool->cachedBytes += size;
+            return;
+        }
+    }
+    freeBlock(ptr);
+}
+
+
+void PooledAllocator::Trim()
+{
+    Pool::FreeLists blocks;
+    {
+        tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+        blocks.swap(m_pool->freeLists);
+        m_pool->cachedBytes = 0;
+    }
+    for (Pool::FreeLists::iterator it = blocks.begin();
+         it != blocks.end(); ++it) {
+        for (size_t i = 0; i != it->second.size(); ++i) {
+            freeBlock(it->second[i]);
+        }
+    }
+}
+
+
+size_t PooledAllocator::CachedBytes() const
+{
+    tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+    return m_pool->cachedBytes;
+}
+
+
+size_t PooledAllocator::Hits() const
+{
+    tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+    return m_pool->hits;
+}
+
+
+size_t PooledAllocator::Misses() const
+{
+    tbb::spin_mutex::scoped_lock lock(m_pool->mutex);
+    return m_pool->misses;
+}
+
+
+
+FirstTouchAllocator::FirstTouchAllocator(ImageAllocator* base,
+    int numChunks) :
+m_base(base != NULL ? base : ImageAllocator::Default()),
+m_numChunks(numChunks > 0 ? numChunks :
+    tbb::task_scheduler_init::default_num_threads())
+{}
+
+
+void* FirstTouchAllocator::Allocate(size_t bytes)
+{
+    return AllocatePlanes(bytes, 1);
+}
+
+
+void* FirstTouchAllocator::AllocatePlanes(size_t planeBytes, size_t numPlanes)
+{
+    char* ptr = static_cast<char*>(m_base->Allocate(planeBytes * numPlanes));
+    if (ptr != NULL && planeBytes * numPlanes != 0) {
+        // One task per chunk, always on the same thread for each chunk
+        const FirstTouchFunctor touch(ptr, planeBytes, numPlanes, m_numChunks);
+        const tbb::blocked_range<int> chunks(0, m_numChunks, 1);
+#if TBB_INTERFACE_VERSION >= 9100
+        tbb::parallel_for(chunks, touch, tbb::static_partitioner());
+#else
+        tbb::parallel_for(chunks, touch, tbb::simple_partitioner());
+#endif
+    }
+    return ptr;
+}
+
+
+size_t FirstTouchAllocator::ChunkBegin(size_t planeBytes, int k,
+    int numChunks)
+{
+    assert(0 <= k && k <= numChunks && numChunks > 0);
+    if (k == numChunks) {
+        return planeBytes;
+    }
+    const size_t n = static_cast<size_t>(numChunks);
+    const size_t offset = (planeBytes / n) * k + (planeBytes % n) * k / n;
+    return offset & ~(ALIGNMENT - 1);
+}
+
+
+void FirstTouchAllocator::Release(void* ptr, size_t bytes)
+{
+    m_base->Release(ptr, bytes);
+}
+
+
+
+struct MappedFileAllocator::Store
+{
+    Store(size_t limit, const char* dir) : memoryLimit(limit),
+        directory(dir != NULL ? dir : ""), inMemoryBytes(0), mappedBytes(0) {}
+
+    const size_t memoryLimit;
+    const std::string directory;
+    size_t inMemoryBytes;
+    size_t mappedBytes;
+
+    // Blocks currently mapped to temporary files
+    std::set<void*> mapped;
+    mutable tbb::spin_mutex mutex;
+};
+
+
+MappedFileAllocator::MappedFileAllocator(size_t memoryLimit,
+    const char* directory) : m_store(new Store(memoryLimit, directory))
+{}
+
+
+MappedFileAllocator::~MappedFileAllocator()
+{
+    delete m_store;
+}
+
+
+void* MappedFileAllocator::Allocate(size_t bytes)
+{
+    bool inMemory;
+    {
+        tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+        inMemory = bytes <= m_store->memoryLimit &&
+            m_store->inMemoryBytes <= m_store->memoryLimit - bytes;
+        if (inMemory) {
+            m_store->inMemoryBytes += bytes;
+        }
+    }
+
+    if (inMemory) {
+        void* ptr = ImageAllocator::Default()->Allocate(bytes);
+        if (ptr == NULL) {
+            tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+            m_store->inMemoryBytes -= bytes;
+        }
+        return ptr;
+    }
+
+    void* ptr = mapTemporaryFile(m_store->directory, bytes);
+    if (ptr != NULL) {
+        tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+        m_store->mapped.insert(ptr);
+        m_store->mappedBytes += bytes;
+    }
+    return ptr;
+}
+
+
+void MappedFileAllocator::Release(void* ptr, size_t bytes)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    bool isMapped;
+    {
+        tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+        isMapped = m_store->mapped.erase(ptr) != 0;
+        if (isMapped) {
+            m_store->mappedBytes -= bytes;
+        } else {
+            m_store->inMemoryBytes -= bytes;
+        }
+    }
+
+    if (isMapped) {
+        unmapTemporaryFile(ptr, bytes);
+    } else {
+        ImageAllocator::Default()->Release(ptr, bytes);
+    }
+}
+
+
+size_t MappedFileAllocator::InMemoryBytes() const
+{
+    tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+    return m_store->inMemoryBytes;
+}
+
+
+size_t MappedFileAllocator::MappedBytes() const
+{
+    tbb::spin_mutex::scoped_lock lock(m_store->mutex);
+    return m_store->mappedBytes;
+}
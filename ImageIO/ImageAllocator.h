@@ -0,0 +1,231 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Allocators for the pixels of Image and ImageSoA. By default each image
+// gets its memory straight from alloc_align; a batch process which creates
+// and destroys many large images of similar sizes may install a
+// PooledAllocator instead, so that the buffers are recycled rather than
+// returned to the operating system each time.
+
+#pragma once
+#if !defined(PCG_IMAGEALLOCATOR_H)
+#define PCG_IMAGEALLOCATOR_H
+
+#include "ImageIO.h"
+
+#include <cstddef>
+
+namespace pcg
+{
+
+class IMAGEIO_API ImageAllocator
+{
+public:
+    // Alignment in bytes of all the blocks
+    static const size_t ALIGNMENT = 64;
+
+    virtual ~ImageAllocator() {}
+
+    // Returns a block of at least the given number of bytes aligned to
+    // ALIGNMENT bytes, or NULL if there is not enough memory.
+    virtual void* Allocate(size_t bytes) = 0;
+
+    // Returns a block made of numPlanes consecutive planes of planeBytes
+    // each, such as the channels of an ImageSoA. The kernels split the pixels
+    // of every plane alike, thus allocators which place the memory treat the
+    // planes the same way. By default it is Allocate(planeBytes*numPlanes).
+    virtual void* AllocatePlanes(size_t planeBytes, size_t numPlanes);
+
+    // Reclaims a block previously returned by Allocate(bytes), or by
+    // AllocatePlanes with a total of bytes
+    virtual void Release(void* ptr, size_t bytes) = 0;
+
+    // Number of chunks in which AllocatePlanes splits each plane to place its
+    // pages (see FirstTouchAllocator), or 0 if the allocator does not place
+    // them. The kernels then process each chunk on the thread which placed it.
+    virtual int NumChunks() const { return 0; }
+
+    // Allocator used by the images when they allocate their pixels. It is
+    // never NULL.
+    static ImageAllocator* Current();
+
+    // Sets the allocator to be used by the images allocated from now on,
+    // NULL restores the default one. Each image releases its pixels through
+    // the allocator which provided them, thus the allocator must outlive
+    // all those images. Returns the previous allocator.
+    static ImageAllocator* SetCurrent(ImageAllocator* allocator);
+
+    // The default allocator, a thin wrapper over alloc_align
+    static ImageAllocator* Default();
+};
+
+
+
+// Keeps the released blocks in size classes and hands them back to later
+// requests of the same class, up to a maximum amount of cached memory.
+// Each size class spans at most 25% of its size, so images with slightly
+// different dimensions still share buffers. This class is thread safe.
+class IMAGEIO_API PooledAllocator : public ImageAllocator
+{
+public:
+    // Default limit for the cached memory: 1 GB
+    static const size_t DEFAULT_MAX_CACHED = size_t(1) << 30;
+
+    // Creates a pool which keeps up to maxCachedBytes in released blocks.
+    // With useHugePages the blocks of 2 MB or more are aligned to 2 MB and
+    // backed by transparent huge pages where supported (Linux), which
+    // reduces the page faults and TLB misses when touching large frames.
+    explicit PooledAllocator(size_t maxCachedBytes = DEFAULT_MAX_CACHED,
+        bool useHugePages = false);
+
+    // Frees all the cached blocks. The blocks still in use are not tracked,
+    // the pool must outlive them.
+    virtual ~PooledAllocator();
+
+    virtual void* Allocate(size_t bytes);
+
+    virtual void Release(void* ptr, size_t bytes);
+
+    // Frees all the cached blocks
+    void Trim();
+
+    // Number of bytes currently kept in released blocks
+    size_t CachedBytes() const;
+
+    // Number of requests satisfied by a cached block
+    size_t Hits() const;
+
+    // Number of requests which allocated a new block
+    size_t Misses() const;
+
+    // Actual size of the blocks which satisfy a request of the given size
+    size_t SizeClass(size_t bytes) const;
+
+private:
+    // Non-copyable
+    PooledAllocator(const PooledAllocator&);
+    PooledAllocator& operator= (const PooledAllocator&);
+
+    struct Pool;
+    Pool* m_pool;
+};
+
+
+
+// Allocator for machines with several NUMA nodes. Operating systems place
+// each page on the node of the thread which touches it first, so a buffer
+// filled by a single thread ends up entirely on that thread's node and the
+// TBB workers running on the other sockets pay remote memory latency. This
+// allocator gets the blocks from another one and then touches their pages
+// as the kernels split the pixels: each plane is divided in one contiguous
+// range of pixels per chunk, and a single task, assigned to its thread by
+// tbb::static_partitioner, touches the range of its chunk in every plane.
+// The SoA kernels split the pixels of those images in the same chunks, run
+// with the same partitioner, so that each thread reads its local pages.
+// Blocks recycled by a PooledAllocator keep the placement of their first use.
+class IMAGEIO_API FirstTouchAllocator : public ImageAllocator
+{
+public:
+    // Decorates the given allocator, by default ImageAllocator::Default().
+    // The planes are split in the given number of chunks, by default one
+    // per TBB thread.
+    explicit FirstTouchAllocator(ImageAllocator* base = NULL,
+        int numChunks = 0);
+
+    virtual void* Allocate(size_t bytes);
+
+    virtual void* AllocatePlanes(size_t planeBytes, size_t numPlanes);
+
+    virtual void Release(void* ptr, size_t bytes);
+
+    // Number of chunks of each plane
+    virtual int NumChunks() const { return m_numChunks; }
+
+    // Offset of the first byte of the k-th chunk of a plane, for k from 0 to
+    // numChunks. The chunks hold the same share of the pixels of any plane
+    // and their boundaries fall on whole vectors (ALIGNMENT bytes).
+    static size_t ChunkBegin(size_t planeBytes, int k, int numChunks);
+
+    // Page size used to touch the blocks, the smallest of the platforms
+    static const size_t PAGE_BYTES = 4096;
+
+private:
+    ImageAllocator* const m_base;
+    const int m_numChunks;
+};
+
+
+
+// Backing store for images larger than the physical memory. While the
+// blocks in regular memory stay within the given limit new blocks come from
+// the default allocator, the rest are mapped to sparse temporary files which
+// are deleted when the blocks are released. The kernels access the mapped
+// blocks as any other memory and the operating system pages them in and out
+// as needed; the mappings are advised for sequential access, so that pages
+// are read ahead and evicted after they were used. This class is thread safe.
+class IMAGEIO_API MappedFileAllocator : public ImageAllocator
+{
+public:
+    // Creates the store. The temporary files go into the given directory,
+    // by default the system temporary directory.
+    explicit MappedFileAllocator(size_t memoryLimit,
+        const char* directory = NULL);
+
+    // The blocks still in use are not tracked, the store must outlive them
+    virtual ~MappedFileAllocator();
+
+    virtual void* Allocate(size_t bytes);
+
+    virtual void Release(void* ptr, size_t bytes);
+
+    // Number of bytes of the blocks in regular memory
+    size_t InMemoryBytes() const;
+
+    // Number of bytes of the blocks mapped to temporary files
+    size_t MappedBytes() const;
+
+private:
+    // Non-copyable
+    MappedFileAllocator(const MappedFileAllocator&);
+    MappedFileAllocator& operator= (const MappedFileAllocator&);
+
+    struct Store;
+    Store* m_store;
+};
+
+
+
+// Installs an allocator for the lifetime of this object, restoring the
+// previous one when it goes out of scope
+class AllocatorScope
+{
+public:
+    explicit AllocatorScope(ImageAllocator* allocator) :
+    m_previous(ImageAllocator::SetCurrent(allocator)) {}
+
+    ~AllocatorScope() {
+        ImageAllocator::SetCurrent(m_previous);
+    }
+
+private:
+    AllocatorScope(const AllocatorScope&);
+    AllocatorScope& operator= (const AllocatorScope&);
+
+    ImageAllocator* m_previous;
+};
+
+} // namespace pcg
+
+#endif /* PCG_IMAGEALLOCATOR_H */
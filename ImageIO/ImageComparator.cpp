@@ -16,6 +16,7 @@
 #include "ImageComparator.h"
 #include "Exception.h"
 #include "ImageIterators.h"
+#include "SimdDispatch.h"
 #if !PCG_USE_AVX
 # include "Vec4f.h"
 # include "Vec4i.h"
@@ -29,6 +30,8 @@
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 
+#include <algorithm>
+
 using namespace pcg;
 using namespace tbb;
 
@@ -47,41 +50,56 @@ using namespace tbb;
 
 
 
+// Entry points of the kernels for each instruction set. The images already
+// have the same size.
+PCG_SIMD_DECLARE(void, ImageComparator_AoS, (ImageComparator::Type type,
+    Rgba32F* dest, const Rgba32F* src1, const Rgba32F* src2, ptrdiff_t count))
+PCG_SIMD_DECLARE(void, ImageComparator_SoA, (ImageComparator::Type type,
+    RGBAImageSoA& dest, const RGBAImageSoA& src1, const RGBAImageSoA& src2))
+PCG_SIMD_DECLARE(void, ImageComparator_AoSView, (ImageComparator::Type type,
+    const ImageView<Rgba32F>& dest,
+    const ImageView<Rgba32F>& src1, const ImageView<Rgba32F>& src2))
+PCG_SIMD_DECLARE(void, ImageComparator_SoAView, (ImageComparator::Type type,
+    const RGBAImageSoAView& dest,
+    const RGBAImageSoAView& src1, const RGBAImageSoAView& src2))
+
+
+
 namespace
 {
 
-// A class that we will use for the TBB implementation
-template <ScanLineMode S>
+// A class that we will use for the TBB implementation. It works on raw
+// pointers, so that it handles both images and single scanlines of views.
 class Comparator {
             
 private:
-    const Image<Rgba32F, S> &src1;
-    const Image<Rgba32F, S> &src2;
-    Image<Rgba32F, S> &dest;
+    const Rgba32F * const src1;
+    const Rgba32F * const src2;
+    Rgba32F * const dest;
 
     const ImageComparator::Type type;
 
     // The different kernels, one for each comparison type
 
     // Takes the absolute value of the difference of the pixels
-    inline void kernel_absoluteDiff(const int &i) const {
+    inline void kernel_absoluteDiff(const ptrdiff_t &i) const {
 
         dest[i] = Rgba32F::abs(src1[i] - src2[i]);
     }
 
     // Not actually a comparision but a combination: just adds both pixels
-    inline void kernel_addition(const int &i) const {
+    inline void kernel_addition(const ptrdiff_t &i) const {
         dest[i] = src1[i] + src2[i];
     }
 
     // Divides the first source by the second one
-    inline void kernel_division(const int &i) const {
+    inline void kernel_division(const ptrdiff_t &i) const {
         // TODO what if both are zero? what if src2[i] is almost zero?
         dest[i] = src1[i] / src2[i];
     }
 
     // Error relative to the adition of both images
-    inline void kernel_relError(const int &i) const {
+    inline void kernel_relError(const ptrdiff_t &i) const {
         dest[i] = Rgba32F(2.0f) * Rgba32F::abs(src1[i] - src2[i]) / (src1[i] + src2[i]);
     }
 
@@ -94,7 +112,7 @@ private:
 
 
     // Helper function for the 2-norm comparisons
-    FORCEINLINE_BEG void kernel_2norm(const Rgba32F &val, const int &i, 
+    FORCEINLINE_BEG void kernel_2norm(const Rgba32F &val, const ptrdiff_t &i, 
         const Rgba32F &alphaKillMask) const FORCEINLINE_END
     {	
         const Rgba32F v = val & alphaKillMask;
@@ -127,62 +145,62 @@ private:
     }
 
     // 2-norm of the rgb diference
-    inline void kernel_posNeg(const int &i, const Rgba32F &alphaKillMask) const {
+    inline void kernel_posNeg(const ptrdiff_t &i, const Rgba32F &alphaKillMask) const {
 
         const Rgba32F delta = (src1[i] - src2[i]);
         kernel_2norm(delta, i, alphaKillMask);
     }
 
-    inline void kernel_posNegRel(const int &i, const Rgba32F &alphaKillMask) const {
+    inline void kernel_posNegRel(const ptrdiff_t &i, const Rgba32F &alphaKillMask) const {
 
         const Rgba32F diff = Rgba32F(2.0f) * (src1[i] - src2[i]) / (src1[i] + src2[i]);
         kernel_2norm(diff, i, alphaKillMask);
     }
 
 public:
-    Comparator(ImageComparator::Type type, Image<Rgba32F, S> &dest, 
-        const Image<Rgba32F, S> &src1, const Image<Rgba32F, S> &src2) :
+    Comparator(ImageComparator::Type type, Rgba32F *dest, 
+        const Rgba32F *src1, const Rgba32F *src2) :
         src1(src1), src2(src2), dest(dest), type(type) {}
 
     // Linear-style operator (one pixel after the other)
-    void operator()(const blocked_range<int>& r) const {
+    void operator()(const blocked_range<ptrdiff_t>& r) const {
         const __m128i alphaKillInt = _mm_set_epi32(0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x0);
         const Rgba32F alphaKill = _mm_castsi128_ps(alphaKillInt);
 
         // TODO Use templates to remove the conditional at compile-time
         switch (type) {
             case ImageComparator::AbsoluteDifference:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_absoluteDiff(i);
                 }
                 break;
 
             case ImageComparator::Addition:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_addition(i);
                 }
                 break;
 
             case ImageComparator::Division:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_division(i);
                 }
                 break;
 
             case ImageComparator::RelativeError:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_relError(i);
                 }
                 break;
 
             case ImageComparator::PositiveNegative:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_posNeg(i, alphaKill);
                 }
                 break;
 
             case ImageComparator::PositiveNegativeRelativeError:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_posNegRel(i, alphaKill);
                 }
                 break;
@@ -408,12 +426,20 @@ class ComparatorSoA
 
 
 public:
+    // Number of pixels in each vector
+    static const int VEC_LEN = sizeof(vf) / sizeof(float);
+
     ComparatorSoA(ImageComparator::Type cmpType, RGBAImageSoA& dest, 
         const RGBAImageSoA& src1, const RGBAImageSoA& src2) :
     type(cmpType), destBegin(IteratorSoA::begin(dest)),
     src1Begin(IteratorSoA::begin(src1)), src2Begin(IteratorSoA::begin(src2))
     {}
 
+    ComparatorSoA(ImageComparator::Type cmpType, const IteratorSoA& dest,
+        const IteratorSoA& src1, const IteratorSoA& src2) :
+    type(cmpType), destBegin(dest), src1Begin(src1), src2Begin(src2)
+    {}
+
     // Linear-style operator (one pixel after the other)
     void operator()(const blocked_range<diff_t>& r) const {
 
@@ -445,10 +471,224 @@ public:
 
 };
 
+
+
+// Number of pixels per staging buffer when comparing views
+const int VIEW_CHUNK = 64;
+
+// Aligned copy of a few pixels of a SoA view, padded with zeros to whole
+// vectors, so that the vector kernels never touch memory outside the views
+struct StagingSoA
+{
+    static const int N = ComparatorSoA::VEC_LEN;
+    typedef RGBA32FVec_traits<N>::value_type vec_t;
+    typedef RGBA32FVecImageSoAIterator<N> IteratorSoA;
+
+    vec_t r[VIEW_CHUNK/N];
+    vec_t g[VIEW_CHUNK/N];
+    vec_t b[VIEW_CHUNK/N];
+    vec_t a[VIEW_CHUNK/N];
+
+    inline IteratorSoA begin() {
+        return IteratorSoA::begin(plane(r), plane(g), plane(b), plane(a));
+    }
+
+    // Whether the view may be read in place starting at pixel (x,j)
+    static bool isAligned(const RGBAImageSoAView& view, int j, ptrdiff_t x) {
+        const uintptr_t bits = address<RGBAImageSoAView::R>(view, j, x) |
+                               address<RGBAImageSoAView::G>(view, j, x) |
+                               address<RGBAImageSoAView::B>(view, j, x) |
+                               address<RGBAImageSoAView::A>(view, j, x);
+        return bits % sizeof(vec_t) == 0;
+    }
+
+    // Iterator over the view starting at pixel (x,j)
+    static IteratorSoA at(const RGBAImageSoAView& view, int j, ptrdiff_t x) {
+        return IteratorSoA::begin(
+            view.GetScanlinePointer<RGBAImageSoAView::R>(j) + x,
+            view.GetScanlinePointer<RGBAImageSoAView::G>(j) + x,
+            view.GetScanlinePointer<RGBAImageSoAView::B>(j) + x,
+            view.GetScanlinePointer<RGBAImageSoAView::A>(j) + x);
+    }
+
+    void load(const RGBAImageSoAView& view, int j, ptrdiff_t x, int count) {
+        load(plane(r), view.GetScanlinePointer<RGBAImageSoAView::R>(j)+x, count);
+        load(plane(g), view.GetScanlinePointer<RGBAImageSoAView::G>(j)+x, count);
+        load(plane(b), view.GetScanlinePointer<RGBAImageSoAView::B>(j)+x, count);
+        load(plane(a), view.GetScanlinePointer<RGBAImageSoAView::A>(j)+x, count);
+    }
+
+    void store(const RGBAImageSoAView& view, int j, ptrdiff_t x, int count) {
+        std::copy(plane(r), plane(r) + count,
+            view.GetScanlinePointer<RGBAImageSoAView::R>(j) + x);
+        std::copy(plane(g), plane(g) + count,
+            view.GetScanlinePointer<RGBAImageSoAView::G>(j) + x);
+        std::copy(plane(b), plane(b) + count,
+            view.GetScanlinePointer<RGBAImageSoAView::B>(j) + x);
+        std::copy(plane(a), plane(a) + count,
+            view.GetScanlinePointer<RGBAImageSoAView::A>(j) + x);
+    }
+
+private:
+    template <class ChannelSpec>
+    static inline uintptr_t address(const RGBAImageSoAView& view,
+        int j, ptrdiff_t x) {
+        return reinterpret_cast<uintptr_t>(
+            view.GetScanlinePointer<ChannelSpec>(j) + x);
+    }
+
+    static inline float* plane(vec_t* v) {
+        return reinterpret_cast<float*>(v);
+    }
+
+    static inline void load(float* dest, const float* src, int count) {
+        std::copy(src, src + count, dest);
+        std::fill(dest + count, dest + ((count + N-1) & ~(N-1)), 0.0f);
+    }
+};
+
+
+
+// Compares AoS or SoA views, either as a single long scanline when all of
+// them are contiguous, or scanline by scanline
+template <class ViewType>
+class ComparatorViews
+{
+public:
+    ComparatorViews(ImageComparator::Type cmpType, const ViewType& dest,
+        const ViewType& src1, const ViewType& src2) :
+    type(cmpType), m_dest(dest), m_src1(src1), m_src2(src2),
+    m_isLinear(dest.IsContiguous() && src1.IsContiguous() &&
+               src2.IsContiguous())
+    {}
+
+    void run() const {
+        if (m_isLinear) {
+            parallel_for(blocked_range<ptrdiff_t>(0, m_dest.Size(),
+                VIEW_CHUNK), *this);
+        } else {
+            parallel_for(blocked_range<ptrdiff_t>(0, m_dest.Height()), *this);
+        }
+    }
+
+    // The range is either pixels of the single scanline of contiguous views,
+    // or full scanlines
+    void operator()(const blocked_range<ptrdiff_t>& r) const {
+        if (m_isLinear) {
+            processSegment(0, r.begin(), r.end());
+        } else {
+            for (ptrdiff_t j = r.begin(); j != r.end(); ++j) {
+                processSegment(static_cast<int>(j), 0, m_dest.Width());
+            }
+        }
+    }
+
+private:
+    void processSegment(int j, ptrdiff_t begin, ptrdiff_t end) const;
+
+    const ImageComparator::Type type;
+    const ViewType& m_dest;
+    const ViewType& m_src1;
+    const ViewType& m_src2;
+    const bool m_isLinear;
+};
+
+// AoS pixels are always aligned, thus they are used in place
+template <>
+void ComparatorViews<ImageView<Rgba32F> >::processSegment(int j,
+    ptrdiff_t begin, ptrdiff_t end) const
+{
+    const Comparator cmp(type, m_dest.GetScanlinePointer(j) + begin,
+        m_src1.GetScanlinePointer(j) + begin,
+        m_src2.GetScanlinePointer(j) + begin);
+    cmp(blocked_range<ptrdiff_t>(0, end - begin));
+}
+
+// Whole vectors are compared in place when all the planes are aligned, the
+// rest goes through the staging buffers
+template <>
+void ComparatorViews<RGBAImageSoAView>::processSegment(int j,
+    ptrdiff_t begin, ptrdiff_t end) const
+{
+    typedef StagingSoA::IteratorSoA IteratorSoA;
+    typedef IteratorSoA::difference_type diff_t;
+    const int N = StagingSoA::N;
+    const ptrdiff_t count = end - begin;
+    ptrdiff_t done = 0;
+
+    if (count >= N && StagingSoA::isAligned(m_dest, j, begin) &&
+        StagingSoA::isAligned(m_src1, j, begin) &&
+        StagingSoA::isAligned(m_src2, j, begin)) {
+        done = count - (count % N);
+        const ComparatorSoA cmp(type, StagingSoA::at(m_dest, j, begin),
+            StagingSoA::at(m_src1, j, begin), StagingSoA::at(m_src2, j, begin));
+        cmp(blocked_range<diff_t>(0, done / N));
+    }
+
+    while (done < count) {
+        const int n = static_cast<int>(
+            std::min(count - done, static_cast<ptrdiff_t>(VIEW_CHUNK)));
+        StagingSoA bufDest, buf1, buf2;
+        buf1.load(m_src1, j, begin + done, n);
+        buf2.load(m_src2, j, begin + done, n);
+        const ComparatorSoA cmp(type, bufDest.begin(),
+            buf1.begin(), buf2.begin());
+        cmp(blocked_range<diff_t>(0, (n + N-1) / N));
+        bufDest.store(m_dest, j, begin + done, n);
+        done += n;
+    }
+}
+
 } // namespace
 
 
 
+void pcg::PCG_SIMD_NS::ImageComparator_AoS(ImageComparator::Type type,
+    Rgba32F* dest, const Rgba32F* src1, const Rgba32F* src2, ptrdiff_t count)
+{
+    parallel_for(blocked_range<ptrdiff_t>(0, count, 4),
+        Comparator(type, dest, src1, src2));
+}
+
+
+
+void pcg::PCG_SIMD_NS::ImageComparator_SoA(ImageComparator::Type type,
+    RGBAImageSoA& dest, const RGBAImageSoA& src1, const RGBAImageSoA& src2)
+{
+#if !PCG_USE_AVX
+    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
+#else
+    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
+#endif
+
+    typedef IteratorSoA::difference_type diff_t;
+    const diff_t count = IteratorSoA::end(src1) - IteratorSoA::begin(src1);
+    const blocked_range<diff_t> range(0, count, 4);
+    parallel_for(range, ComparatorSoA(type, dest, src1, src2));
+}
+
+
+
+void pcg::PCG_SIMD_NS::ImageComparator_AoSView(ImageComparator::Type type,
+    const ImageView<Rgba32F>& dest,
+    const ImageView<Rgba32F>& src1, const ImageView<Rgba32F>& src2)
+{
+    ComparatorViews<ImageView<Rgba32F> >(type, dest, src1, src2).run();
+}
+
+
+
+void pcg::PCG_SIMD_NS::ImageComparator_SoAView(ImageComparator::Type type,
+    const RGBAImageSoAView& dest,
+    const RGBAImageSoAView& src1, const RGBAImageSoAView& src2)
+{
+    ComparatorViews<RGBAImageSoAView>(type, dest, src1, src2).run();
+}
+
+
+
+#if !PCG_SIMD_IS_VARIANT
+
 template <ScanLineMode S>
 void ImageComparator::CompareHelper(Type type, Image<Rgba32F, S> &dest, 
             const Image<Rgba32F, S> &src1, const Image<Rgba32F, S> &src2)
@@ -462,9 +702,8 @@ void ImageComparator::CompareHelper(Type type, Image<Rgba32F, S> &dest,
     }
 
     // And launch the parallel for
-    const int numPixels = dest.Size();
-    parallel_for(blocked_range<int>(0, numPixels, 4),
-        Comparator<S>(type, dest, src1, src2));
+    PCG_SIMD_DISPATCH(ImageComparator_AoS)(type, dest.GetDataPointer(),
+        src1.GetDataPointer(), src2.GetDataPointer(), dest.Size());
 }
 
 // The real instances of the template
@@ -488,15 +727,32 @@ void ImageComparator::Compare(Type type, RGBAImageSoA &dest,
     {
         throw IllegalArgumentException("Incompatible images size");
     }
+    PCG_SIMD_DISPATCH(ImageComparator_SoA)(type, dest, src1, src2);
+}
 
-#if !PCG_USE_AVX
-    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
-#else
-    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
-#endif
 
-    typedef IteratorSoA::difference_type diff_t;
-    const diff_t count = IteratorSoA::end(src1) - IteratorSoA::begin(src1);
-    const blocked_range<diff_t> range(0, count, 4);
-    parallel_for(range, ComparatorSoA(type, dest, src1, src2));
+
+void ImageComparator::Compare(Type type, const ImageView<Rgba32F> &dest,
+            const ImageView<Rgba32F> &src1, const ImageView<Rgba32F> &src2)
+{
+    if (dest.Width() != src1.Width() || dest.Height() != src1.Height() ||
+        src1.Width() != src2.Width() || src1.Height() != src2.Height() )
+    {
+        throw IllegalArgumentException("Incompatible images size");
+    }
+    PCG_SIMD_DISPATCH(ImageComparator_AoSView)(type, dest, src1, src2);
+}
+
+
+void ImageComparator::Compare(Type type, const RGBAImageSoAView &dest,
+            const RGBAImageSoAView &src1, const RGBAImageSoAView &src2)
+{
+    if (dest.Width() != src1.Width() || dest.Height() != src1.Height() ||
+        src1.Width() != src2.Width() || src1.Height() != src2.Height() )
+    {
+        throw IllegalArgumentException("Incompatible images size");
+    }
+    PCG_SIMD_DISPATCH(ImageComparator_SoAView)(type, dest, src1, src2);
 }
+
+#endif // !PCG_SIMD_IS_VARIANT
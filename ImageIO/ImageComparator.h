@@ -22,6 +22,7 @@
 #include "ImageIO.h"
 #include "Image.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "Rgba32F.h"
 
 namespace pcg {
@@ -47,6 +48,13 @@ namespace pcg {
 
 		static IMAGEIO_API void Compare(Type type, RGBAImageSoA &dest,
 			const RGBAImageSoA &src1, const RGBAImageSoA &src2);
+
+		// Views over external memory, only their pixels are read and written
+		static IMAGEIO_API void Compare(Type type, const ImageView<Rgba32F> &dest,
+			const ImageView<Rgba32F> &src1, const ImageView<Rgba32F> &src2);
+
+		static IMAGEIO_API void Compare(Type type, const RGBAImageSoAView &dest,
+			const RGBAImageSoAView &src1, const RGBAImageSoAView &src2);
 		
 	private:
 		// Just for the sake of knowing what we have
@@ -22,6 +22,7 @@
 #include "Image.h"
 #include "ImageSoA.h"
 #include "Rgba32F.h"
+#include "Rgba16F.h"
 #include "LDRPixels.h"
 
 #include <iterator>
@@ -32,6 +33,9 @@
 namespace pcg
 {
 
+// Forward declaration
+struct Rgbe;
+
 
 // Helper struct which represent 4 RGBA values, in SoA fashion
 struct RGBA32FVec4
@@ -177,120 +181,121 @@ typedef RGBAVecConstRef<__m128> RGBA32FVec4ConstRef;
 
 
 
-// RGBA SoA Pixel Iterator concept for standard RGBA32F images. It iterates
-// the image in groups of 4 pixels, returning a fresh RGBA32FVec4 with the
-// next 4 R,G,B,A values in SoA form. Thus this is only a "read-only" iterator.
-// The current implementation only iterates in the original scanlie order of
-// an image.
-class RGBA32FVec4ImageIterator :
+// RGBA SoA Pixel Iterator concept for standard RGBA32F and RGBA16F images. It
+// iterates the image in groups of 4 pixels, returning a fresh RGBA32FVec4 with
+// the next 4 R,G,B,A values in SoA form, widened to single precision. Thus
+// this is only a "read-only" iterator. The current implementation only
+// iterates in the original scanlie order of an image.
+template <typename PixelType>
+class RGBAVec4ImageIterator :
 public std::iterator<std::random_access_iterator_tag, RGBA32FVec4>
 {
 public:
 
     // Default constructor, which creates an invalid iterator
-    RGBA32FVec4ImageIterator() : m_ptr(NULL)
+    RGBAVec4ImageIterator() : m_ptr(NULL)
     {}
 
     // Copy constructor
-    RGBA32FVec4ImageIterator(const RGBA32FVec4ImageIterator& other)
+    RGBAVec4ImageIterator(const RGBAVec4ImageIterator& other)
     {
         m_ptr = other.m_ptr;
     }
 
     // Just wrap a pointer, be careful!
-    RGBA32FVec4ImageIterator(const pcg::Rgba32F *ptr) : m_ptr(ptr)
+    RGBAVec4ImageIterator(const PixelType *ptr) : m_ptr(ptr)
     {
         assert(reinterpret_cast<intptr_t>(ptr) % 16 == 0);
     }
 
     // Equality/inequality comparisons
 
-    inline bool operator== (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator== (const RGBAVec4ImageIterator& other) const {
         return m_ptr == other.m_ptr;
     }
-    inline bool operator!= (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator!= (const RGBAVec4ImageIterator& other) const {
         return m_ptr != other.m_ptr;
     }
 
     // Inequality comparisons between iterators
 
-    inline bool operator< (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator< (const RGBAVec4ImageIterator& other) const {
         return m_ptr < other.m_ptr;
     }
-    inline bool operator> (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator> (const RGBAVec4ImageIterator& other) const {
         return m_ptr > other.m_ptr;
     }
-    inline bool operator<= (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator<= (const RGBAVec4ImageIterator& other) const {
         return m_ptr <= other.m_ptr;
     }
-    inline bool operator>= (const RGBA32FVec4ImageIterator& other) const {
+    inline bool operator>= (const RGBAVec4ImageIterator& other) const {
         return m_ptr >= other.m_ptr;
     }
 
     // Increments
 
-    inline RGBA32FVec4ImageIterator& operator++() {
+    inline RGBAVec4ImageIterator& operator++() {
         m_ptr += 4;
         return *this;
     }
-    inline RGBA32FVec4ImageIterator& operator++(int) {
+    inline RGBAVec4ImageIterator& operator++(int) {
         m_ptr += 4;
         return *this;
     }
 
     // Decrements
 
-    inline RGBA32FVec4ImageIterator& operator--() {
+    inline RGBAVec4ImageIterator& operator--() {
         m_ptr -= 4;
         return *this;
     }
 
-    inline RGBA32FVec4ImageIterator& operator--(int) {
+    inline RGBAVec4ImageIterator& operator--(int) {
         m_ptr -= 4;
         return *this;
     }
 
     // Binary arithmetic operators
 
-    inline friend RGBA32FVec4ImageIterator operator + (
-        const RGBA32FVec4ImageIterator& a, difference_type offset)
+    inline friend RGBAVec4ImageIterator operator + (
+        const RGBAVec4ImageIterator& a, difference_type offset)
     {
-        RGBA32FVec4ImageIterator it(a);
+        RGBAVec4ImageIterator it(a);
         it.m_ptr += 4 * offset;
         return it;
     }
 
-    inline friend RGBA32FVec4ImageIterator operator + (
-        difference_type offset, const RGBA32FVec4ImageIterator& a)
+    inline friend RGBAVec4ImageIterator operator + (
+        difference_type offset, const RGBAVec4ImageIterator& a)
     {
-        RGBA32FVec4ImageIterator it(a);
+        RGBAVec4ImageIterator it(a);
         it.m_ptr += 4 * offset;
         return it;
     }
 
-    inline friend RGBA32FVec4ImageIterator operator - (
-        const RGBA32FVec4ImageIterator& a, difference_type offset)
+    inline friend RGBAVec4ImageIterator operator - (
+        const RGBAVec4ImageIterator& a, difference_type offset)
     {
-        RGBA32FVec4ImageIterator it(a);
+        RGBAVec4ImageIterator it(a);
         it.m_ptr -= 4 * offset;
         return it;
     }
 
-    inline friend difference_type operator- (const RGBA32FVec4ImageIterator& a,
-        const RGBA32FVec4ImageIterator& b)
+    inline friend difference_type operator- (const RGBAVec4ImageIterator& a,
+        const RGBAVec4ImageIterator& b)
     {
-        RGBA32FVec4ImageIterator::difference_type rawDelta = a.m_ptr - b.m_ptr;
+        typename RGBAVec4ImageIterator::difference_type rawDelta = a.m_ptr - b.m_ptr;
         return rawDelta >> 2;
     }
 
     // Compound assignment
 
-    inline RGBA32FVec4ImageIterator& operator+=(difference_type offset) {
+    inline RGBAVec4ImageIterator& operator+=(difference_type offset) {
         m_ptr += 4 * offset;
         return *this;
     }
 
-    inline RGBA32FVec4ImageIterator& operator-=(difference_type offset) {
+    inline RGBAVec4ImageIterator& operator-=(difference_type offset) {
         m_ptr -= 4 * offset;
         return *this;
     }
@@ -300,34 +305,21 @@ public:
     // Be aware that this returns a temporary element!
     inline RGBA32FVec4 operator[] (size_t idx) const
     {
-        const pcg::Rgba32F* base = m_ptr + (4 * idx);
-        RGBA32FVec4 p;
-        p.data[0] = base[0];
-        p.data[1] = base[1];
-        p.data[2] = base[2];
-        p.data[3] = base[3];
-        PCG_MM_TRANSPOSE4_PS (p.data[0], p.data[1], p.data[2], p.data[3]);
-        return p;
+        return load(m_ptr + (4 * idx));
     }
 
     // Builds a RGBA32FVec4 from the current values pointed by the iterator
     inline RGBA32FVec4 operator*() const
     {
-        RGBA32FVec4 p;
-        p.data[0] = m_ptr[0];
-        p.data[1] = m_ptr[1];
-        p.data[2] = m_ptr[2];
-        p.data[3] = m_ptr[3];
-        PCG_MM_TRANSPOSE4_PS (p.data[0], p.data[1], p.data[2], p.data[3]);
-        return p;
+        return load(m_ptr);
     }
 
     // Create an iterator at the beginning of the image, moving in the same
     // direction as the established scanline order
     template <pcg::ScanLineMode S>
-    static RGBA32FVec4ImageIterator begin(const pcg::Image<pcg::Rgba32F,S> &src)
+    static RGBAVec4ImageIterator begin(const pcg::Image<PixelType,S> &src)
     {
-        RGBA32FVec4ImageIterator it;
+        RGBAVec4ImageIterator it;
         it.m_ptr = src.GetDataPointer();
         return it;
     }
@@ -336,9 +328,9 @@ public:
     // the image must have a multiple of 4 number of pixels or have allocated
     // additional elements to avoid segfaults.
     template <pcg::ScanLineMode S>
-    static RGBA32FVec4ImageIterator end(const pcg::Image<pcg::Rgba32F,S> &src)
+    static RGBAVec4ImageIterator end(const pcg::Image<PixelType,S> &src)
     {
-        RGBA32FVec4ImageIterator it;
+        RGBAVec4ImageIterator it;
         it.m_ptr = src.GetDataPointer();
         size_t offset = (src.Size() + 3) & ~0x3;
         assert (offset % 4 == 0);
@@ -347,10 +339,50 @@ public:
     }
 
 private:
+    // Transposes 4 consecutive pixels
+    static inline RGBA32FVec4 load(const pcg::Rgba32F *ptr)
+    {
+        RGBA32FVec4 p;
+        p.data[0] = ptr[0];
+        p.data[1] = ptr[1];
+        p.data[2] = ptr[2];
+        p.data[3] = ptr[3];
+        PCG_MM_TRANSPOSE4_PS (p.data[0], p.data[1], p.data[2], p.data[3]);
+        return p;
+    }
+
+    // Widens 4 consecutive pixels, whose components are in [r g b a] order,
+    // and transposes them
+    static inline RGBA32FVec4 load(const pcg::Rgba16F *ptr)
+    {
+        const __m128i* in = reinterpret_cast<const __m128i*>(ptr);
+        const __m128i p01 = _mm_load_si128(in);
+        const __m128i p23 = _mm_load_si128(in + 1);
+        __m128 p0 = halfToFloat4(p01);
+        __m128 p1 = halfToFloat4(_mm_unpackhi_epi64(p01, p01));
+        __m128 p2 = halfToFloat4(p23);
+        __m128 p3 = halfToFloat4(_mm_unpackhi_epi64(p23, p23));
+        PCG_MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+        RGBA32FVec4 p;
+        p.r() = p0;
+        p.g() = p1;
+        p.b() = p2;
+        p.a() = p3;
+        return p;
+    }
+
     // Pointer to AoS data
-    const pcg::Rgba32F *m_ptr;
+    const PixelType *m_ptr;
 };
 
+// Iterators over full and half precision AoS pixels
+typedef RGBAVec4ImageIterator<Rgba32F> RGBA32FVec4ImageIterator;
+typedef RGBAVec4ImageIterator<Rgba16F> RGBA16FVec4ImageIterator;
+
+
+
+
+
 
 
 // Helper struct which represent 4 packed RGBA values, in AoS fashion
@@ -583,13 +615,25 @@ public:
     // Create an iterator at the beginning of the image, moving in the same
     // direction as the established scanline order
     static RGBA32FVecImageSoAIterator begin(const RGBAImageSoA &src)
+    {
+        return begin(src.GetDataPointer<RGBAImageSoA::R>(),
+                     src.GetDataPointer<RGBAImageSoA::G>(),
+                     src.GetDataPointer<RGBAImageSoA::B>(),
+                     src.GetDataPointer<RGBAImageSoA::A>());
+    }
+
+    // Create an iterator over raw planes, aligned to the size of N floats
+    static RGBA32FVecImageSoAIterator begin(float *r, float *g,
+                                            float *b, float *a)
     {
         typedef typename RGBA32FVec_traits<N>::pointer_type vptr_t;
+        assert(reinterpret_cast<intptr_t>(r) %
+            sizeof(typename RGBA32FVec_traits<N>::value_type) == 0);
         RGBA32FVecImageSoAIterator it;
-        it.m_r=reinterpret_cast<vptr_t>(src.GetDataPointer<RGBAImageSoA::R>());
-        it.m_g=reinterpret_cast<vptr_t>(src.GetDataPointer<RGBAImageSoA::G>());
-        it.m_b=reinterpret_cast<vptr_t>(src.GetDataPointer<RGBAImageSoA::B>());
-        it.m_a=reinterpret_cast<vptr_t>(src.GetDataPointer<RGBAImageSoA::A>());
+        it.m_r = reinterpret_cast<vptr_t>(r);
+        it.m_g = reinterpret_cast<vptr_t>(g);
+        it.m_b = reinterpret_cast<vptr_t>(b);
+        it.m_a = reinterpret_cast<vptr_t>(a);
         it.m_offset = 0;
         return it;
     }
@@ -698,8 +742,846 @@ struct RGBA32FVec_traits<8>
 // an image.
 typedef RGBA32FVecImageSoAIterator<8> RGBA32FVec8ImageSoAIterator;
 
+// Helper struct which represent 8 RGBA values, in SoA fashion
+struct RGBA32FVec8
+{
+    __m256 data[4];
+
+    inline __m256& r() {
+        return data[3];
+    }
+
+    inline const __m256& r() const {
+        return data[3];
+    }
+
+    inline __m256& g() {
+        return data[2];
+    }
+
+    inline const __m256& g() const {
+        return data[2];
+    }
+
+    inline __m256& b() {
+        return data[1];
+    }
+
+    inline const __m256& b() const {
+        return data[1];
+    }
+
+    inline __m256& a() {
+        return data[0];
+    }
+
+    inline const __m256& a() const {
+        return data[0];
+    }
+};
+
+#endif // PCG_USE_AVX
+
+
+
+#if PCG_USE_AVX512
+
+// Helper struct which represent 16 RGBA values
+typedef RGBAVecRef<__m512> RGBA32FVec16Ref;
+
+// Helper struct to represent 16 const RGBA values
+typedef RGBAVecConstRef<__m512> RGBA32FVec16ConstRef;
+
+// Helper struct which represent 16 packed RGBA values, in AoS fashion
+struct PixelBGRA8Vec16
+{
+    union {
+        __m512i zmm;
+        __m256i ymm[2];
+        PixelBGRA8 pixels[16];
+    };
+
+    // Create an iterator at the beginning of the image, moving in the same
+    // direction as the established scanline order
+    template <ScanLineMode S>
+    static PixelBGRA8Vec16* begin(Image<Bgra8, S> &img)
+    {
+        Bgra8* ptr = img.GetDataPointer();
+        assert(reinterpret_cast<intptr_t>(ptr) % 64 == 0);
+        return reinterpret_cast<PixelBGRA8Vec16*>(ptr);
+    }
+
+    // Create an iterator at the end of the image, moving in the same
+    // direction as the established scanline order. Note that for this to work
+    // the image must have a multiple of 16 number of pixels or have allocated
+    // additional elements to avoid segfaults (alll with the proper alignment).
+    template <ScanLineMode S>
+    inline PixelBGRA8Vec16* end(Image<Bgra8, S> &img)
+    {
+        Bgra8* ptr = img.GetDataPointer();
+        assert(reinterpret_cast<intptr_t>(ptr) % 64 == 0);
+        size_t offset = (img.Size() + 15) & ~0xF;
+        assert (offset % 16 == 0);
+        ptr += offset;
+        return reinterpret_cast<PixelBGRA8Vec16*>(ptr);
+    }
+};
+
+template <>
+struct RGBA32FVec_traits<16>
+{
+    typedef RGBA32FVec16Ref VecRef;
+    typedef RGBA32FVec16ConstRef VecConstRef;
+    typedef __m512  value_type;
+    typedef __m512* pointer_type;
+};
+
+// RGBA SoA Pixel Iterator concept for SoA images, in groups of 16 pixels
+typedef RGBA32FVecImageSoAIterator<16> RGBA32FVec16ImageSoAIterator;
+
+// Helper struct which represent 16 RGBA values, in SoA fashion
+struct RGBA32FVec16
+{
+    __m512 data[4];
+
+    inline __m512& r() {
+        return data[3];
+    }
+
+    inline const __m512& r() const {
+        return data[3];
+    }
+
+    inline __m512& g() {
+        return data[2];
+    }
+
+    inline const __m512& g() const {
+        return data[2];
+    }
+
+    inline __m512& b() {
+        return data[1];
+    }
+
+    inline const __m512& b() const {
+        return data[1];
+    }
+
+    inline __m512& a() {
+        return data[0];
+    }
+
+    inline const __m512& a() const {
+        return data[0];
+    }
+};
+
+#endif // PCG_USE_AVX512
+
+
+
+// Helper traits to widen N half precision values from SoA planes
+template <int N>
+struct RGBA16FVec_traits;
+
+template <>
+struct RGBA16FVec_traits<4>
+{
+    typedef RGBA32FVec4 value_type;
+
+    static inline __m128 load(const uint16_t *ptr) {
+        return halfToFloat4(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr)));
+    }
+};
+
+#if PCG_USE_AVX
+template <>
+struct RGBA16FVec_traits<8>
+{
+    typedef RGBA32FVec8 value_type;
+
+    static inline __m256 load(const uint16_t *ptr) {
+        return halfToFloat8(
+            _mm_load_si128(reinterpret_cast<const __m128i*>(ptr)));
+    }
+};
+#endif // PCG_USE_AVX
+
+#if PCG_USE_AVX512
+template <>
+struct RGBA16FVec_traits<16>
+{
+    typedef RGBA32FVec16 value_type;
+
+    static inline __m512 load(const uint16_t *ptr) {
+        return halfToFloat16(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(ptr)));
+    }
+};
+#endif // PCG_USE_AVX512
+
+
+
+// RGBA SoA Pixel Iterator concept template for half precision SoA images. It
+// iterates the image in groups of N pixels, returning a fresh value with the
+// next N R,G,B,A values widened to single precision. Thus this is only a
+// "read-only" iterator. The current implementation only iterates in the
+// original scanlie order of an image.
+template <int N>
+class RGBA16FVecImageSoAIterator :
+public std::iterator<std::random_access_iterator_tag,
+                     typename RGBA16FVec_traits<N>::value_type>
+{
+public:
+    typedef typename RGBA16FVec_traits<N>::value_type value_type;
+    typedef ptrdiff_t difference_type;
+
+    // Default constructor, which creates an invalid iterator
+    RGBA16FVecImageSoAIterator() :
+    m_r(NULL), m_g(NULL), m_b(NULL), m_a(NULL), m_offset(0)
+    {}
+
+    // Equality/inequality comparisons using only the offsets
+
+    inline bool operator== (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset == other.m_offset;
+    }
+    inline bool operator!= (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset != other.m_offset;
+    }
+
+    // Inequality comparisons between iterators
+
+    inline bool operator< (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset < other.m_offset;
+    }
+    inline bool operator> (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset > other.m_offset;
+    }
+    inline bool operator<= (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset <= other.m_offset;
+    }
+    inline bool operator>= (const RGBA16FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset >= other.m_offset;
+    }
+
+    // Increments and decrements
+
+    inline RGBA16FVecImageSoAIterator& operator++() {
+        ++m_offset;
+        return *this;
+    }
+
+    inline RGBA16FVecImageSoAIterator& operator--() {
+        --m_offset;
+        return *this;
+    }
+
+    // Binary arithmetic operators
+
+    inline friend RGBA16FVecImageSoAIterator operator + (
+        const RGBA16FVecImageSoAIterator& a, difference_type offset)
+    {
+        RGBA16FVecImageSoAIterator it(a);
+        it.m_offset += offset;
+        return it;
+    }
+
+    inline friend RGBA16FVecImageSoAIterator operator + (
+        difference_type offset, const RGBA16FVecImageSoAIterator& a)
+    {
+        RGBA16FVecImageSoAIterator it(a);
+        it.m_offset += offset;
+        return it;
+    }
+
+    inline friend RGBA16FVecImageSoAIterator operator- (
+        const RGBA16FVecImageSoAIterator& a, difference_type offset)
+    {
+        RGBA16FVecImageSoAIterator it(a);
+        it.m_offset -= offset;
+        return it;
+    }
+
+    inline friend difference_type operator- (
+        const RGBA16FVecImageSoAIterator& a,
+        const RGBA16FVecImageSoAIterator& b)
+    {
+        assert(a.haveSameBase(b));
+        return a.m_offset - b.m_offset;
+    }
+
+    // Compound assignment
+
+    inline RGBA16FVecImageSoAIterator& operator+=(difference_type offset) {
+        m_offset += offset;
+        return *this;
+    }
+
+    inline RGBA16FVecImageSoAIterator& operator-=(difference_type offset) {
+        m_offset -= offset;
+        return *this;
+    }
+
+    // Builds a value from the current pixels. Be aware that this returns a
+    // temporary element!
+    inline value_type operator*() const
+    {
+        typedef RGBA16FVec_traits<N> traits;
+        const ptrdiff_t idx = N * m_offset;
+        value_type p;
+        p.r() = traits::load(m_r + idx);
+        p.g() = traits::load(m_g + idx);
+        p.b() = traits::load(m_b + idx);
+        p.a() = traits::load(m_a + idx);
+        return p;
+    }
+
+    inline value_type operator[] (difference_type idx) const
+    {
+        return *(*this + idx);
+    }
+
+
+    // Create an iterator at the beginning of the image, moving in the same
+    // direction as the established scanline order
+    static RGBA16FVecImageSoAIterator begin(const RGBA16FImageSoA &src)
+    {
+        RGBA16FVecImageSoAIterator it;
+        it.m_r = src.GetDataPointer<RGBA16FImageSoA::R>();
+        it.m_g = src.GetDataPointer<RGBA16FImageSoA::G>();
+        it.m_b = src.GetDataPointer<RGBA16FImageSoA::B>();
+        it.m_a = src.GetDataPointer<RGBA16FImageSoA::A>();
+        it.m_offset = 0;
+        return it;
+    }
+
+    // Create an iterator at the end of the image. The channels are padded,
+    // so the last group may be read safely even if it is incomplete.
+    static RGBA16FVecImageSoAIterator end(const RGBA16FImageSoA &src)
+    {
+        RGBA16FVecImageSoAIterator it = begin(src);
+        it.m_offset = (src.Size() + (N-1)) / N;
+        return it;
+    }
+
+private:
+#ifndef NDEBUG
+    inline bool haveSameBase(const RGBA16FVecImageSoAIterator& other) const {
+        return m_r == other.m_r && m_g == other.m_g &&
+               m_b == other.m_b && m_a == other.m_a;
+    }
+#endif
+
+    // Pointers to the *base* data
+    const uint16_t *m_r;
+    const uint16_t *m_g;
+    const uint16_t *m_b;
+    const uint16_t *m_a;
+
+    // Offset, in groups of N pixels
+    ptrdiff_t m_offset;
+};
+
+// Half precision RGBA SoA Pixel Iterator concept, in groups of 4 pixels
+typedef RGBA16FVecImageSoAIterator<4> RGBA16FVec4ImageSoAIterator;
+
+#if PCG_USE_AVX
+// Half precision RGBA SoA Pixel Iterator concept, in groups of 8 pixels
+typedef RGBA16FVecImageSoAIterator<8> RGBA16FVec8ImageSoAIterator;
+#endif
+
+#if PCG_USE_AVX512
+// Half precision RGBA SoA Pixel Iterator concept, in groups of 16 pixels
+typedef RGBA16FVecImageSoAIterator<16> RGBA16FVec16ImageSoAIterator;
+#endif
+
+
+
+// Helper traits to load N single precision values from the SoA planes
+template <int N>
+struct RGB32FVec_traits;
+
+template <>
+struct RGB32FVec_traits<4>
+{
+    typedef RGBA32FVec4 value_type;
+
+    static inline __m128 load(const float *ptr) {
+        return _mm_load_ps(ptr);
+    }
+
+    static inline __m128 one() {
+        return _mm_set1_ps(1.0f);
+    }
+};
+
+#if PCG_USE_AVX
+template <>
+struct RGB32FVec_traits<8>
+{
+    typedef RGBA32FVec8 value_type;
+
+    static inline __m256 load(const float *ptr) {
+        return _mm256_load_ps(ptr);
+    }
+
+    static inline __m256 one() {
+        return _mm256_set1_ps(1.0f);
+    }
+};
 #endif // PCG_USE_AVX
 
+#if PCG_USE_AVX512
+template <>
+struct RGB32FVec_traits<16>
+{
+    typedef RGBA32FVec16 value_type;
+
+    static inline __m512 load(const float *ptr) {
+        return _mm512_load_ps(ptr);
+    }
+
+    static inline __m512 one() {
+        return _mm512_set1_ps(1.0f);
+    }
+};
+#endif // PCG_USE_AVX512
+
+
+
+// RGBA SoA Pixel Iterator concept template for SoA images without alpha. It
+// iterates the image in groups of N pixels, returning a fresh value with the
+// next N R,G,B values and an alpha of 1. Thus this is only a "read-only"
+// iterator. The current implementation only iterates in the original
+// scanline order of an image.
+template <int N>
+class RGB32FVecImageSoAIterator :
+public std::iterator<std::random_access_iterator_tag,
+                     typename RGB32FVec_traits<N>::value_type>
+{
+public:
+    typedef typename RGB32FVec_traits<N>::value_type value_type;
+    typedef ptrdiff_t difference_type;
+
+    // Default constructor, which creates an invalid iterator
+    RGB32FVecImageSoAIterator() :
+    m_r(NULL), m_g(NULL), m_b(NULL), m_offset(0)
+    {}
+
+    // Equality/inequality comparisons using only the offsets
+
+    inline bool operator== (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset == other.m_offset;
+    }
+    inline bool operator!= (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset != other.m_offset;
+    }
+
+    // Inequality comparisons between iterators
+
+    inline bool operator< (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset < other.m_offset;
+    }
+    inline bool operator> (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset > other.m_offset;
+    }
+    inline bool operator<= (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset <= other.m_offset;
+    }
+    inline bool operator>= (const RGB32FVecImageSoAIterator& other) const {
+        assert(haveSameBase(other));
+        return m_offset >= other.m_offset;
+    }
+
+    // Increments and decrements
+
+    inline RGB32FVecImageSoAIterator& operator++() {
+        ++m_offset;
+        return *this;
+    }
+
+    inline RGB32FVecImageSoAIterator& operator--() {
+        --m_offset;
+        return *this;
+    }
+
+    // Binary arithmetic operators
+
+    inline friend RGB32FVecImageSoAIterator operator + (
+        const RGB32FVecImageSoAIterator& a, difference_type offset)
+    {
+        RGB32FVecImageSoAIterator it(a);
+        it.m_offset += offset;
+        return it;
+    }
+
+    inline friend RGB32FVecImageSoAIterator operator + (
+        difference_type offset, const RGB32FVecImageSoAIterator& a)
+    {
+        RGB32FVecImageSoAIterator it(a);
+        it.m_offset += offset;
+        return it;
+    }
+
+    inline friend RGB32FVecImageSoAIterator operator- (
+        const RGB32FVecImageSoAIterator& a, difference_type offset)
+    {
+        RGB32FVecImageSoAIterator it(a);
+        it.m_offset -= offset;
+        return it;
+    }
+
+    inline friend difference_type operator- (
+        const RGB32FVecImageSoAIterator& a,
+        const RGB32FVecImageSoAIterator& b)
+    {
+        assert(a.haveSameBase(b));
+        return a.m_offset - b.m_offset;
+    }
+
+    // Compound assignment
+
+    inline RGB32FVecImageSoAIterator& operator+=(difference_type offset) {
+        m_offset += offset;
+        return *this;
+    }
+
+    inline RGB32FVecImageSoAIterator& operator-=(difference_type offset) {
+        m_offset -= offset;
+        return *this;
+    }
+
+    // Builds a value from the current pixels. Be aware that this returns a
+    // temporary element!
+    inline value_type operator*() const
+    {
+        typedef RGB32FVec_traits<N> traits;
+        const ptrdiff_t idx = N * m_offset;
+        value_type p;
+        p.r() = traits::load(m_r + idx);
+        p.g() = traits::load(m_g + idx);
+        p.b() = traits::load(m_b + idx);
+        p.a() = traits::one();
+        return p;
+    }
+
+    inline value_type operator[] (difference_type idx) const
+    {
+        return *(*this + idx);
+    }
+
+
+    // Create an iterator at the beginning of the image, moving in the same
+    // direction as the established scanline order
+    static RGB32FVecImageSoAIterator begin(const RGBImageSoA &src)
+    {
+        RGB32FVecImageSoAIterator it;
+        it.m_r = src.GetDataPointer<RGBImageSoA::R>();
+        it.m_g = src.GetDataPointer<RGBImageSoA::G>();
+        it.m_b = src.GetDataPointer<RGBImageSoA::B>();
+        it.m_offset = 0;
+        return it;
+    }
+
+    // Create an iterator at the end of the image. The channels are padded,
+    // so the last group may be read safely even if it is incomplete.
+    static RGB32FVecImageSoAIterator end(const RGBImageSoA &src)
+    {
+        RGB32FVecImageSoAIterator it = begin(src);
+        it.m_offset = (src.Size() + (N-1)) / N;
+        return it;
+    }
+
+private:
+#ifndef NDEBUG
+    inline bool haveSameBase(const RGB32FVecImageSoAIterator& other) const {
+        return m_r == other.m_r && m_g == other.m_g && m_b == other.m_b;
+    }
+#endif
+
+    // Pointers to the *base* data
+    const float *m_r;
+    const float *m_g;
+    const float *m_b;
+
+    // Offset, in groups of N pixels
+    ptrdiff_t m_offset;
+};
+
+// RGB SoA Pixel Iterator concept, in groups of 4 pixels
+typedef RGB32FVecImageSoAIterator<4> RGB32FVec4ImageSoAIterator;
+
+#if PCG_USE_AVX
+// RGB SoA Pixel Iterator concept, in groups of 8 pixels
+typedef RGB32FVecImageSoAIterator<8> RGB32FVec8ImageSoAIterator;
+#endif
+
+#if PCG_USE_AVX512
+// RGB SoA Pixel Iterator concept, in groups of 16 pixels
+typedef RGB32FVecImageSoAIterator<16> RGB32FVec16ImageSoAIterator;
+#endif
+
+
+
+// Helper traits to decode N consecutive RGBE pixels into SoA single precision
+// values with the RTGI2 method, as the RGBE SoA codec: each component is
+// scaled by 2^(e-136), built straight into the exponent bits of the float.
+// The exponents 1 to 9 would require denormal multipliers, thus they are
+// truncated to zero.
+template <int N>
+struct RgbeVec_traits;
+
+template <>
+struct RgbeVec_traits<4>
+{
+    typedef RGBA32FVec4 value_type;
+
+    static inline value_type load(const Rgbe *ptr) {
+        return decode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+    }
+
+    // Each 32-bit integer holds the bytes of a pixel as [e b g r]
+    static inline value_type decode(const __m128i p) {
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128i const_9  = _mm_set1_epi32(9);
+        const __m128i e = _mm_srli_epi32(p, 24);
+        const __m128 scale = _mm_castsi128_ps(_mm_and_si128(
+            _mm_slli_epi32(_mm_sub_epi32(e, const_9), 23),
+            _mm_cmpgt_epi32(e, const_9)));
+
+        value_type v;
+        v.r() = _mm_mul_ps(scale,
+            _mm_cvtepi32_ps(_mm_and_si128(p, byteMask)));
+        v.g() = _mm_mul_ps(scale,
+            _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), byteMask)));
+        v.b() = _mm_mul_ps(scale,
+            _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), byteMask)));
+        v.a() = _mm_set1_ps(1.0f);
+        return v;
+    }
+};
+
+#if PCG_USE_AVX
+template <>
+struct RgbeVec_traits<8>
+{
+    typedef RGBA32FVec8 value_type;
+
+#if PCG_USE_AVX2
+    static inline value_type load(const Rgbe *ptr) {
+        const __m256i p =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i const_9  = _mm256_set1_epi32(9);
+        const __m256i e = _mm256_srli_epi32(p, 24);
+        const __m256 scale = _mm256_castsi256_ps(_mm256_and_si256(
+            _mm256_slli_epi32(_mm256_sub_epi32(e, const_9), 23),
+            _mm256_cmpgt_epi32(e, const_9)));
+
+        value_type v;
+        v.r() = _mm256_mul_ps(scale, _mm256_cvtepi32_ps(
+            _mm256_and_si256(p, byteMask)));
+        v.g() = _mm256_mul_ps(scale, _mm256_cvtepi32_ps(
+            _mm256_and_si256(_mm256_srli_epi32(p, 8), byteMask)));
+        v.b() = _mm256_mul_ps(scale, _mm256_cvtepi32_ps(
+            _mm256_and_si256(_mm256_srli_epi32(p, 16), byteMask)));
+        v.a() = _mm256_set1_ps(1.0f);
+        return v;
+    }
+#else
+    // Without AVX2 the integer operations are done in SSE halves
+    static inline value_type load(const Rgbe *ptr) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(ptr);
+        const RGBA32FVec4 lo = RgbeVec_traits<4>::decode(_mm_loadu_si128(in));
+        const RGBA32FVec4 hi =
+            RgbeVec_traits<4>::decode(_mm_loadu_si128(in + 1));
+        value_type v;
+        for (int i = 0; i < 4; ++i) {
+            v.data[i] = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(lo.data[i]), hi.data[i], 1);
+        }
+        return v;
+    }
+#endif // PCG_USE_AVX2
+};
+#endif // PCG_USE_AVX
+
+#if PCG_USE_AVX512
+template <>
+struct RgbeVec_traits<16>
+{
+    typedef RGBA32FVec16 value_type;
+
+    static inline value_type load(const Rgbe *ptr) {
+        const __m512i p = _mm512_loadu_si512(ptr);
+        const __m512i byteMask = _mm512_set1_epi32(0xFF);
+        const __m512i const_9  = _mm512_set1_epi32(9);
+        const __m512i e = _mm512_srli_epi32(p, 24);
+        const __m512 scale = _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+            _mm512_cmpgt_epi32_mask(e, const_9),
+            _mm512_sub_epi32(e, const_9), 23));
+
+        value_type v;
+        v.r() = _mm512_mul_ps(scale, _mm512_cvtepi32_ps(
+            _mm512_and_si512(p, byteMask)));
+        v.g() = _mm512_mul_ps(scale, _mm512_cvtepi32_ps(
+            _mm512_and_si512(_mm512_srli_epi32(p, 8), byteMask)));
+        v.b() = _mm512_mul_ps(scale, _mm512_cvtepi32_ps(
+            _mm512_and_si512(_mm512_srli_epi32(p, 16), byteMask)));
+        v.a() = _mm512_set1_ps(1.0f);
+        return v;
+    }
+};
+#endif // PCG_USE_AVX512
+
+
+
+// RGBA SoA Pixel Iterator concept template for RGBE pixels. It iterates the
+// pixels in groups of N, returning a fresh value with the next N R,G,B values
+// decoded to single precision and an alpha of 1, so that the float pixels
+// only ever exist in registers. Thus this is only a "read-only" iterator.
+// The pixels need not be aligned.
+template <int N>
+class RgbeVecImageIterator :
+public std::iterator<std::random_access_iterator_tag,
+                     typename RgbeVec_traits<N>::value_type>
+{
+public:
+    typedef typename RgbeVec_traits<N>::value_type value_type;
+    typedef ptrdiff_t difference_type;
+
+    // Default constructor, which creates an invalid iterator
+    RgbeVecImageIterator() : m_ptr(NULL)
+    {}
+
+    // Just wrap a pointer, be careful!
+    explicit RgbeVecImageIterator(const Rgbe *ptr) :
+    m_ptr(reinterpret_cast<const int32_t*>(ptr))
+    {}
+
+    // Equality/inequality comparisons
+
+    inline bool operator== (const RgbeVecImageIterator& other) const {
+        return m_ptr == other.m_ptr;
+    }
+    inline bool operator!= (const RgbeVecImageIterator& other) const {
+        return m_ptr != other.m_ptr;
+    }
+
+    // Inequality comparisons between iterators
+
+    inline bool operator< (const RgbeVecImageIterator& other) const {
+        return m_ptr < other.m_ptr;
+    }
+    inline bool operator> (const RgbeVecImageIterator& other) const {
+        return m_ptr > other.m_ptr;
+    }
+    inline bool operator<= (const RgbeVecImageIterator& other) const {
+        return m_ptr <= other.m_ptr;
+    }
+    inline bool operator>= (const RgbeVecImageIterator& other) const {
+        return m_ptr >= other.m_ptr;
+    }
+
+    // Increments and decrements
+
+    inline RgbeVecImageIterator& operator++() {
+        m_ptr += N;
+        return *this;
+    }
+
+    inline RgbeVecImageIterator& operator--() {
+        m_ptr -= N;
+        return *this;
+    }
+
+    // Binary arithmetic operators
+
+    inline friend RgbeVecImageIterator operator + (
+        const RgbeVecImageIterator& a, difference_type offset)
+    {
+        return RgbeVecImageIterator(a.m_ptr + N * offset);
+    }
+
+    inline friend RgbeVecImageIterator operator + (
+        difference_type offset, const RgbeVecImageIterator& a)
+    {
+        return RgbeVecImageIterator(a.m_ptr + N * offset);
+    }
+
+    inline friend RgbeVecImageIterator operator- (
+        const RgbeVecImageIterator& a, difference_type offset)
+    {
+        return RgbeVecImageIterator(a.m_ptr - N * offset);
+    }
+
+    inline friend difference_type operator- (
+        const RgbeVecImageIterator& a, const RgbeVecImageIterator& b)
+    {
+        return (a.m_ptr - b.m_ptr) / N;
+    }
+
+    // Compound assignment
+
+    inline RgbeVecImageIterator& operator+=(difference_type offset) {
+        m_ptr += N * offset;
+        return *this;
+    }
+
+    inline RgbeVecImageIterator& operator-=(difference_type offset) {
+        m_ptr -= N * offset;
+        return *this;
+    }
+
+    // Decodes the current pixels. Be aware that this returns a temporary
+    // element!
+    inline value_type operator*() const
+    {
+        return RgbeVec_traits<N>::load(reinterpret_cast<const Rgbe*>(m_ptr));
+    }
+
+    inline value_type operator[] (difference_type idx) const
+    {
+        return RgbeVec_traits<N>::load(
+            reinterpret_cast<const Rgbe*>(m_ptr + N * idx));
+    }
+
+private:
+    explicit RgbeVecImageIterator(const int32_t *ptr) : m_ptr(ptr)
+    {}
+
+    // Pointer to the AoS pixels, each one handled as a 32-bit integer so
+    // that only the SIMD code depends on the layout of Rgbe
+    const int32_t *m_ptr;
+};
+
+// RGBE Pixel Iterator concept, in groups of 4 pixels
+typedef RgbeVecImageIterator<4> RgbeVec4ImageIterator;
+
+#if PCG_USE_AVX
+// RGBE Pixel Iterator concept, in groups of 8 pixels
+typedef RgbeVecImageIterator<8> RgbeVec8ImageIterator;
+#endif
+
+#if PCG_USE_AVX512
+// RGBE Pixel Iterator concept, in groups of 16 pixels
+typedef RgbeVecImageIterator<16> RgbeVec16ImageIterator;
+#endif
+
 }
 
 #endif /* PCG_IMAGEITERATORS_H */
@@ -16,107 +16,718 @@
 #include "ImageSoA.h"
 #include "StdAfx.h"
 #include "Rgba32F.h"
+#include "Rgb32F.h"
+#include "rgbe.h"
+#include "RgbeIOPrivate.h"
+#include "SimdDispatch.h"
+
+#include <algorithm>
 
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 
 
+// Entry points of the kernels for each instruction set. They copy between
+// the pixels of the AoS image and the planes, both of the same size.
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgba32F_TopDown,
+    (const Image<Rgba32F, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgba32F_BottomUp,
+    (const Image<Rgba32F, BottomUp> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgb32F_TopDown,
+    (const Image<Rgb32F, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgb32F_BottomUp,
+    (const Image<Rgb32F, BottomUp> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgbe_TopDown,
+    (const Image<Rgbe, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_FromRgbe_BottomUp,
+    (const Image<Rgbe, BottomUp> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgba32F_TopDown,
+    (const Image<Rgba32F, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgba32F_BottomUp,
+    (const Image<Rgba32F, BottomUp> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgb32F_TopDown,
+    (const Image<Rgb32F, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgb32F_BottomUp,
+    (const Image<Rgb32F, BottomUp> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgbe_TopDown,
+    (const Image<Rgbe, TopDown> &img, const RGBAImageSoA &soa))
+PCG_SIMD_DECLARE(void, ImageSoA_ToRgbe_BottomUp,
+    (const Image<Rgbe, BottomUp> &img, const RGBAImageSoA &soa))
+
+
 namespace
 {
-struct CopyFunctor
+
+// Minimum number of pixels converted by each task
+const ptrdiff_t GRAIN_SIZE = 1024;
+
+
+#if PCG_USE_AVX
+// Transposes the 4x4 blocks within each 128-bit lane
+inline void transpose4x2(__m256 &row0, __m256 &row1, __m256 &row2, __m256 &row3)
 {
-    typedef tbb::blocked_range<int> Range;
+    const __m256 tmp0 = _mm256_unpacklo_ps(row0, row1);
+    const __m256 tmp2 = _mm256_unpacklo_ps(row2, row3);
+    const __m256 tmp1 = _mm256_unpackhi_ps(row0, row1);
+    const __m256 tmp3 = _mm256_unpackhi_ps(row2, row3);
 
-    struct Args
-    {
-        const pcg::Image<pcg::Rgba32F, pcg::TopDown> &src;
-        pcg::RGBAImageSoA &dest;
+    row0 = _mm256_shuffle_ps(tmp0, tmp2, _MM_SHUFFLE(1,0,1,0));
+    row1 = _mm256_shuffle_ps(tmp0, tmp2, _MM_SHUFFLE(3,2,3,2));
+    row2 = _mm256_shuffle_ps(tmp1, tmp3, _MM_SHUFFLE(1,0,1,0));
+    row3 = _mm256_shuffle_ps(tmp1, tmp3, _MM_SHUFFLE(3,2,3,2));
+}
+
+// Unaligned load of two 128-bit halves
+inline __m256 loadHalves(const float* lo, const float* hi)
+{
+    return _mm256_insertf128_ps(
+        _mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+#endif
+
+
+
+// Each kernel converts a run of n consecutive pixels in a single scanline
+// between the AoS pixels and the planes. The planes share their alignment,
+// since they all start at multiples of 64 bytes, so the kernels copy single
+// pixels until the planes are aligned and then switch to vectors.
 
-        Args(const pcg::Image<pcg::Rgba32F, pcg::TopDown> &source,
-            pcg::RGBAImageSoA &target) : src(source), dest(target)
-        {}
-    };
+#if PCG_USE_AVX
+const size_t VEC_MASK = 0x1F;
+#else
+const size_t VEC_MASK = 0xF;
+#endif
 
+inline ptrdiff_t headCount(const float* plane, ptrdiff_t n)
+{
+    const size_t misalign = reinterpret_cast<size_t>(plane) & VEC_MASK;
+    const ptrdiff_t head = misalign != 0 ?
+        static_cast<ptrdiff_t>((VEC_MASK + 1 - misalign) / sizeof(float)) : 0;
+    return std::min(head, n);
+}
+
+
+
+struct Rgba32FToSoA
+{
+    typedef pcg::Rgba32F pixel_t;
+
+    static void apply(pixel_t* src, float* r, float* g, float* b, float* a,
+        ptrdiff_t n)
+    {
+        const ptrdiff_t head = headCount(r, n);
+        ptrdiff_t i = 0;
+        for (; i < head; ++i) {
+            copy1(r[i], g[i], b[i], a[i], src[i]);
+        }
+#if PCG_USE_AVX
+        for (; i + 8 <= n; i += 8) {
+            __m256 p0 = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(src[i]),     src[i + 4], 1);
+            __m256 p1 = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(src[i + 1]), src[i + 5], 1);
+            __m256 p2 = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(src[i + 2]), src[i + 6], 1);
+            __m256 p3 = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(src[i + 3]), src[i + 7], 1);
+            transpose4x2(p0, p1, p2, p3);
 
-    CopyFunctor(const Args &args) : m_args(args) {}
-    CopyFunctor(const CopyFunctor &other) : m_args(other.m_args) {}
+            _mm256_stream_ps(r + i, p3);
+            _mm256_stream_ps(g + i, p2);
+            _mm256_stream_ps(b + i, p1);
+            _mm256_stream_ps(a + i, p0);
+        }
+#endif
+        for (; i + 4 <= n; i += 4) {
+            __m128 p0 = src[i];
+            __m128 p1 = src[i + 1];
+            __m128 p2 = src[i + 2];
+            __m128 p3 = src[i + 3];
+            PCG_MM_TRANSPOSE4_PS (p0, p1, p2, p3);
 
+            // Stream the results
+            _mm_stream_ps(r + i, p3);
+            _mm_stream_ps(g + i, p2);
+            _mm_stream_ps(b + i, p1);
+            _mm_stream_ps(a + i, p0);
+        }
+        for (; i < n; ++i) {
+            copy1(r[i], g[i], b[i], a[i], src[i]);
+        }
+    }
 
-    inline void
-    copy1(float& r, float& g, float& b, float& a, const pcg::Rgba32F& src) const
+    static inline void
+    copy1(float& r, float& g, float& b, float& a, const pcg::Rgba32F& src)
     {
         r = src.r();
         g = src.g();
         b = src.b();
         a = src.a();
     }
+};
+
+
 
-    inline void
-    copy4(float* r, float* g, float *b, float* a, const pcg::Rgba32F* src,
-          int off) const
+struct Rgba32FFromSoA
+{
+    typedef pcg::Rgba32F pixel_t;
+
+    static void apply(pixel_t* dest, const float* r, const float* g,
+        const float* b, const float* a, ptrdiff_t n)
     {
-        __m128 p0 = src[off];
-        __m128 p1 = src[off + 1];
-        __m128 p2 = src[off + 2];
-        __m128 p3 = src[off + 3];
-        PCG_MM_TRANSPOSE4_PS (p0, p1, p2, p3);
-
-        // Stream the results
-        _mm_stream_ps(r + off, p3);
-        _mm_stream_ps(g + off, p2);
-        _mm_stream_ps(b + off, p1);
-        _mm_stream_ps(a + off, p0);
+        const ptrdiff_t head = headCount(r, n);
+        ptrdiff_t i = 0;
+        for (; i < head; ++i) {
+            dest[i].set(r[i], g[i], b[i], a[i]);
+        }
+        float* out = reinterpret_cast<float*>(dest);
+#if PCG_USE_AVX
+        for (; i + 8 <= n; i += 8) {
+            __m256 p0 = _mm256_load_ps(a + i);
+            __m256 p1 = _mm256_load_ps(b + i);
+            __m256 p2 = _mm256_load_ps(g + i);
+            __m256 p3 = _mm256_load_ps(r + i);
+            transpose4x2(p0, p1, p2, p3);
+
+            // Each lane now holds a pixel in [a b g r] order
+            float* o = out + 4*i;
+            _mm_stream_ps(o,      _mm256_castps256_ps128(p0));
+            _mm_stream_ps(o + 4,  _mm256_castps256_ps128(p1));
+            _mm_stream_ps(o + 8,  _mm256_castps256_ps128(p2));
+            _mm_stream_ps(o + 12, _mm256_castps256_ps128(p3));
+            _mm_stream_ps(o + 16, _mm256_extractf128_ps(p0, 1));
+            _mm_stream_ps(o + 20, _mm256_extractf128_ps(p1, 1));
+            _mm_stream_ps(o + 24, _mm256_extractf128_ps(p2, 1));
+            _mm_stream_ps(o + 28, _mm256_extractf128_ps(p3, 1));
+        }
+#endif
+        for (; i + 4 <= n; i += 4) {
+            __m128 p0 = _mm_load_ps(a + i);
+            __m128 p1 = _mm_load_ps(b + i);
+            __m128 p2 = _mm_load_ps(g + i);
+            __m128 p3 = _mm_load_ps(r + i);
+            PCG_MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+
+            float* o = out + 4*i;
+            _mm_stream_ps(o,      p0);
+            _mm_stream_ps(o + 4,  p1);
+            _mm_stream_ps(o + 8,  p2);
+            _mm_stream_ps(o + 12, p3);
+        }
+        for (; i < n; ++i) {
+            dest[i].set(r[i], g[i], b[i], a[i]);
+        }
     }
+};
 
-    void operator() (Range& range) const
-    {
-        assert(range.begin() >= 0);
-        assert(range.end() <= m_args.src.Size());
-        assert(range.begin() <= range.end());
 
-        // The range might not be in appropriate multiples of four
-        const int beginSSE = (range.begin() + 3) & ~0x3;
-        const int endSSE   = range.end() & ~0x3;
-        assert((endSSE - beginSSE) % 4 == 0);
-        assert((beginSSE-range.begin())+(endSSE-beginSSE)+(range.end()-endSSE)\
-            == static_cast<int>(range.size()));
-
-        float * r = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::R>();
-        float * g = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::G>();
-        float * b = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::B>();
-        float * a = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::A>();
-        const pcg::Rgba32F* src = m_args.src.GetDataPointer();
-
-        // Copy individual items until the first multiple of 4, so that they
-        // are aligned to 16 bytes (1 to 3 elements)
-        for (int i = range.begin(); i < beginSSE; ++i) {
+
+// The alpha of the Rgb32F pixels is 1
+struct Rgb32FToSoA
+{
+    typedef pcg::Rgb32F pixel_t;
+
+    static void apply(pixel_t* src, float* r, float* g, float* b, float* a,
+        ptrdiff_t n)
+    {
+        const ptrdiff_t head = headCount(r, n);
+        ptrdiff_t i = 0;
+        for (; i < head; ++i) {
             copy1(r[i], g[i], b[i], a[i], src[i]);
         }
+        const float* in = reinterpret_cast<const float*>(src);
+#if PCG_USE_AVX
+        // Same shuffles as below, each lane holds a block of 4 pixels
+        const __m256 one8 = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= n; i += 8) {
+            const float* p = in + 3*i;
+            const __m256 x0 = loadHalves(p,     p + 12);
+            const __m256 x1 = loadHalves(p + 4, p + 16);
+            const __m256 x2 = loadHalves(p + 8, p + 20);
+
+            const __m256 rr = _mm256_shuffle_ps(x1, x2, _MM_SHUFFLE(1,1,2,2));
+            const __m256 r8 = _mm256_shuffle_ps(x0, rr, _MM_SHUFFLE(2,0,3,0));
 
-        // Copy all the blocks of 4 pixels. This is the heaviest loop
-        for (int offset = beginSSE; offset < endSSE; offset += 4)
-        {
-            copy4(r, g, b, a, src, offset);
+            const __m256 g01 = _mm256_shuffle_ps(x0, x1, _MM_SHUFFLE(0,0,1,1));
+            const __m256 g23 = _mm256_shuffle_ps(x1, x2, _MM_SHUFFLE(2,2,3,3));
+            const __m256 g8 = _mm256_shuffle_ps(g01, g23, _MM_SHUFFLE(2,0,2,0));
+
+            const __m256 b01 = _mm256_shuffle_ps(x0, x1, _MM_SHUFFLE(1,1,2,2));
+            const __m256 b23 = _mm256_shuffle_ps(x2, x2, _MM_SHUFFLE(3,3,0,0));
+            const __m256 b8 = _mm256_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0));
+
+            _mm256_stream_ps(r + i, r8);
+            _mm256_stream_ps(g + i, g8);
+            _mm256_stream_ps(b + i, b8);
+            _mm256_stream_ps(a + i, one8);
         }
+#endif
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= n; i += 4) {
+            // x0 = [r0 g0 b0 r1], x1 = [g1 b1 r2 g2], x2 = [b2 r3 g3 b3]
+            const __m128 x0 = _mm_loadu_ps(in + 3*i);
+            const __m128 x1 = _mm_loadu_ps(in + 3*i + 4);
+            const __m128 x2 = _mm_loadu_ps(in + 3*i + 8);
+
+            const __m128 rr = _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(1,1,2,2));
+            const __m128 r4 = _mm_shuffle_ps(x0, rr, _MM_SHUFFLE(2,0,3,0));
+
+            const __m128 g01 = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(0,0,1,1));
+            const __m128 g23 = _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(2,2,3,3));
+            const __m128 g4 = _mm_shuffle_ps(g01, g23, _MM_SHUFFLE(2,0,2,0));
 
-        // Copy any remaining elements (1 to 3)
-        for (int i = endSSE; i < range.end(); ++i) {
+            const __m128 b01 = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(1,1,2,2));
+            const __m128 b23 = _mm_shuffle_ps(x2, x2, _MM_SHUFFLE(3,3,0,0));
+            const __m128 b4 = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0));
+
+            _mm_stream_ps(r + i, r4);
+            _mm_stream_ps(g + i, g4);
+            _mm_stream_ps(b + i, b4);
+            _mm_stream_ps(a + i, one);
+        }
+        for (; i < n; ++i) {
             copy1(r[i], g[i], b[i], a[i], src[i]);
         }
     }
 
+    static inline void
+    copy1(float& r, float& g, float& b, float& a, const pcg::Rgb32F& src)
+    {
+        r = src.r;
+        g = src.g;
+        b = src.b;
+        a = 1.0f;
+    }
+};
+
+
+
+// Same as the conversion from Rgba32F to Rgb32F: the color is multiplied by
+// alpha, and pixels with zero alpha become black
+struct Rgb32FFromSoA
+{
+    typedef pcg::Rgb32F pixel_t;
+
+    static void apply(pixel_t* dest, const float* r, const float* g,
+        const float* b, const float* a, ptrdiff_t n)
+    {
+        const ptrdiff_t head = headCount(r, n);
+        ptrdiff_t i = 0;
+        for (; i < head; ++i) {
+            copy1(dest[i], r[i], g[i], b[i], a[i]);
+        }
+        float* out = reinterpret_cast<float*>(dest);
+#if PCG_USE_AVX
+        // Same shuffles as below within each lane, then the halves of the
+        // three results are regrouped into consecutive pixels
+        const __m256 zero8 = _mm256_setzero_ps();
+        for (; i + 8 <= n; i += 8) {
+            const __m256 a8 = _mm256_load_ps(a + i);
+            const __m256 mask = _mm256_cmp_ps(a8, zero8, _CMP_NEQ_UQ);
+            const __m256 r8 = _mm256_and_ps(_mm256_mul_ps(_mm256_load_ps(r + i), a8), mask);
+            const __m256 g8 = _mm256_and_ps(_mm256_mul_ps(_mm256_load_ps(g + i), a8), mask);
+            const __m256 b8 = _mm256_and_ps(_mm256_mul_ps(_mm256_load_ps(b + i), a8), mask);
+
+            const __m256 rg01 = _mm256_unpacklo_ps(r8, g8);
+            const __m256 br01 = _mm256_shuffle_ps(b8, r8, _MM_SHUFFLE(1,1,0,0));
+            const __m256 x0 = _mm256_shuffle_ps(rg01, br01, _MM_SHUFFLE(2,0,1,0));
+
+            const __m256 gb1 = _mm256_shuffle_ps(g8, b8, _MM_SHUFFLE(1,1,1,1));
+            const __m256 rg2 = _mm256_shuffle_ps(r8, g8, _MM_SHUFFLE(2,2,2,2));
+            const __m256 x1 = _mm256_shuffle_ps(gb1, rg2, _MM_SHUFFLE(2,0,2,0));
+
+            const __m256 br23 = _mm256_shuffle_ps(b8, r8, _MM_SHUFFLE(3,3,2,2));
+            const __m256 gb3 = _mm256_shuffle_ps(g8, b8, _MM_SHUFFLE(3,3,3,3));
+            const __m256 x2 = _mm256_shuffle_ps(br23, gb3, _MM_SHUFFLE(2,0,2,0));
+
+            float* o = out + 3*i;
+            _mm256_storeu_ps(o,      _mm256_permute2f128_ps(x0, x1, 0x20));
+            _mm256_storeu_ps(o + 8,  _mm256_permute2f128_ps(x2, x0, 0x30));
+            _mm256_storeu_ps(o + 16, _mm256_permute2f128_ps(x1, x2, 0x31));
+        }
+#endif
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4) {
+            const __m128 a4 = _mm_load_ps(a + i);
+            const __m128 mask = _mm_cmpneq_ps(a4, zero);
+            const __m128 r4 = _mm_and_ps(_mm_mul_ps(_mm_load_ps(r + i), a4), mask);
+            const __m128 g4 = _mm_and_ps(_mm_mul_ps(_mm_load_ps(g + i), a4), mask);
+            const __m128 b4 = _mm_and_ps(_mm_mul_ps(_mm_load_ps(b + i), a4), mask);
+
+            // x0 = [r0 g0 b0 r1]
+            const __m128 rg01 = _mm_unpacklo_ps(r4, g4);
+            const __m128 br01 = _mm_shuffle_ps(b4, r4, _MM_SHUFFLE(1,1,0,0));
+            const __m128 x0 = _mm_shuffle_ps(rg01, br01, _MM_SHUFFLE(2,0,1,0));
+
+            // x1 = [g1 b1 r2 g2]
+            const __m128 gb1 = _mm_shuffle_ps(g4, b4, _MM_SHUFFLE(1,1,1,1));
+            const __m128 rg2 = _mm_shuffle_ps(r4, g4, _MM_SHUFFLE(2,2,2,2));
+            const __m128 x1 = _mm_shuffle_ps(gb1, rg2, _MM_SHUFFLE(2,0,2,0));
+
+            // x2 = [b2 r3 g3 b3]
+            const __m128 br23 = _mm_shuffle_ps(b4, r4, _MM_SHUFFLE(3,3,2,2));
+            const __m128 gb3 = _mm_shuffle_ps(g4, b4, _MM_SHUFFLE(3,3,3,3));
+            const __m128 x2 = _mm_shuffle_ps(br23, gb3, _MM_SHUFFLE(2,0,2,0));
+
+            _mm_storeu_ps(out + 3*i,     x0);
+            _mm_storeu_ps(out + 3*i + 4, x1);
+            _mm_storeu_ps(out + 3*i + 8, x2);
+        }
+        for (; i < n; ++i) {
+            copy1(dest[i], r[i], g[i], b[i], a[i]);
+        }
+    }
+
+    static inline void copy1(pcg::Rgb32F& dest,
+        float r, float g, float b, float a)
+    {
+        if (a != 0.0f) {
+            dest.set(r * a, g * a, b * a);
+        } else {
+            dest.set(0.0f, 0.0f, 0.0f);
+        }
+    }
+};
+
+
+
+// Number of RGBE pixels staged at once by the conversions below
+const ptrdiff_t RGBE_BLOCK = 256;
+
+// The RGBE pixels are transposed into the channel runs of an RLE scanline
+// and decoded by RgbeIO_DecodeSoA, the kernel used when reading the files.
+// It matches the conversion to Rgba32F, except that the exponents from 1 to
+// 9 yield zero instead of denormals; as with Rgba32F, the alpha of the
+// pixels with a zero exponent is zero.
+struct RgbeToSoA
+{
+    typedef pcg::Rgbe pixel_t;
+
+    static void apply(pixel_t* src, float* r, float* g, float* b, float* a,
+        ptrdiff_t n)
+    {
+        ALIGN16_BEG unsigned char runs[4 * RGBE_BLOCK] ALIGN16_END;
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+        for (ptrdiff_t i = 0; i < n; i += RGBE_BLOCK) {
+            const ptrdiff_t count = std::min(RGBE_BLOCK, n - i);
+            stage(runs, in + 4*i, count);
+            const unsigned char* e = runs + 3*count;
+            for (ptrdiff_t k = 0; k < count; ++k) {
+                a[i + k] = e[k] != 0 ? 1.0f : 0.0f;
+            }
+            pcg::PCG_SIMD_NS::RgbeIO_DecodeSoA(runs, static_cast<int>(count),
+                r + i, g + i, b + i, NULL);
+        }
+    }
+
+    // Splits the pixels into the runs of each channel, 16 at a time
+    static void stage(unsigned char* runs, const unsigned char* in,
+        ptrdiff_t count)
+    {
+        unsigned char* PCG_RESTRICT rRun = runs;
+        unsigned char* PCG_RESTRICT gRun = runs + count;
+        unsigned char* PCG_RESTRICT bRun = runs + 2*count;
+        unsigned char* PCG_RESTRICT eRun = runs + 3*count;
+        ptrdiff_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m128i* p = reinterpret_cast<const __m128i*>(in + 4*i);
+            __m128i x0 = _mm_loadu_si128(p);
+            __m128i x1 = _mm_loadu_si128(p + 1);
+            __m128i x2 = _mm_loadu_si128(p + 2);
+            __m128i x3 = _mm_loadu_si128(p + 3);
+            for (int k = 0; k != 3; ++k) {
+                const __m128i y0 = _mm_unpacklo_epi8(x0, x1);
+                const __m128i y1 = _mm_unpackhi_epi8(x0, x1);
+                const __m128i y2 = _mm_unpacklo_epi8(x2, x3);
+                const __m128i y3 = _mm_unpackhi_epi8(x2, x3);
+                x0 = y0; x1 = y1; x2 = y2; x3 = y3;
+            }
+            // x0 = [r0..r7 g0..g7], x1 = [b0..b7 e0..e7], x2 and x3 have
+            // the same for the pixels 8 to 15
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rRun + i),
+                _mm_unpacklo_epi64(x0, x2));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(gRun + i),
+                _mm_unpackhi_epi64(x0, x2));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bRun + i),
+                _mm_unpacklo_epi64(x1, x3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(eRun + i),
+                _mm_unpackhi_epi64(x1, x3));
+        }
+        for (; i < count; ++i) {
+            rRun[i] = in[4*i];
+            gRun[i] = in[4*i + 1];
+            bRun[i] = in[4*i + 2];
+            eRun[i] = in[4*i + 3];
+        }
+    }
+};
+
+
+
+// RGBE has no alpha, the values are assumed to be premultiplied already.
+// Once the planes are aligned, the blocks of 4 pixels are encoded by
+// RgbeIO_EncodeSoA, the kernel used when writing the files, either in place
+// or through an aligned buffer if the destination is not aligned.
+struct RgbeFromSoA
+{
+    typedef pcg::Rgbe pixel_t;
+
+    static void apply(pixel_t* dest, const float* r, const float* g,
+        const float* b, const float*, ptrdiff_t n)
+    {
+        const ptrdiff_t head = headCount(r, n);
+        ptrdiff_t i = 0;
+        for (; i < head; ++i) {
+            dest[i].set(r[i], g[i], b[i]);
+        }
+
+        const ptrdiff_t bulkEnd = i + ((n - i) & ~ptrdiff_t(3));
+        if (reinterpret_cast<uintptr_t>(dest + i) % 16 == 0) {
+            pcg::PCG_SIMD_NS::RgbeIO_EncodeSoA(dest + i,
+                r + i, g + i, b + i, bulkEnd - i);
+        } else {
+            ALIGN16_BEG pcg::Rgbe buffer[RGBE_BLOCK] ALIGN16_END;
+            for (ptrdiff_t k = i; k < bulkEnd; k += RGBE_BLOCK) {
+                const ptrdiff_t count = std::min(RGBE_BLOCK, bulkEnd - k);
+                pcg::PCG_SIMD_NS::RgbeIO_EncodeSoA(buffer,
+                    r + k, g + k, b + k, count);
+                std::copy(buffer, buffer + count, dest + k);
+            }
+        }
+
+        for (i = bulkEnd; i < n; ++i) {
+            dest[i].set(r[i], g[i], b[i]);
+        }
+    }
+};
+
+
+
+// Runs a kernel over a linear range of the planes. The planes are always in
+// top-down order, so the range is split into scanlines when the AoS image is
+// bottom-up; otherwise the whole range is contiguous in both layouts.
+template <class Kernel, pcg::ScanLineMode S>
+struct ConvertFunctor
+{
+    typedef tbb::blocked_range<ptrdiff_t> Range;
+    typedef typename Kernel::pixel_t pixel_t;
+
+    ConvertFunctor(const pcg::Image<pixel_t, S> &img,
+        const pcg::RGBAImageSoA &soa) : m_img(img), m_soa(soa) {}
+
+    void operator() (const Range& range) const
+    {
+        assert(range.begin() >= 0);
+        assert(range.end() <= m_img.Size());
+        assert(range.begin() <= range.end());
+
+        float * r = m_soa.GetDataPointer<pcg::RGBAImageSoA::R>();
+        float * g = m_soa.GetDataPointer<pcg::RGBAImageSoA::G>();
+        float * b = m_soa.GetDataPointer<pcg::RGBAImageSoA::B>();
+        float * a = m_soa.GetDataPointer<pcg::RGBAImageSoA::A>();
+        const ptrdiff_t w = m_img.Width();
+
+        for (ptrdiff_t idx = range.begin(); idx < range.end(); ) {
+            const int j = static_cast<int>(idx / w);
+            const ptrdiff_t i = idx - j * w;
+            const ptrdiff_t n = S == pcg::TopDown ? range.end() - idx :
+                std::min(range.end(), (j + 1) * w) - idx;
+            pixel_t * pixels =
+                m_img.GetScanlinePointer(j, pcg::TopDown) + i;
+            Kernel::apply(pixels, r + idx, g + idx, b + idx, a + idx, n);
+            idx += n;
+        }
+
+        // Make the streaming stores visible to the other threads
+        _mm_sfence();
+    }
+
 private:
-    Args m_args;
+    const pcg::Image<pixel_t, S> &m_img;
+    const pcg::RGBAImageSoA &m_soa;
 };
 
+
+
+template <class Kernel, pcg::ScanLineMode S>
+void convert(const pcg::Image<typename Kernel::pixel_t, S> &img,
+             const pcg::RGBAImageSoA &soa)
+{
+    assert(img.Width() == soa.Width() && img.Height() == soa.Height());
+    tbb::blocked_range<ptrdiff_t> range(0, img.Size(), GRAIN_SIZE);
+    tbb::parallel_for(range, ConvertFunctor<Kernel, S>(img, soa));
+}
+
+
+
+template <typename T, pcg::ScanLineMode S>
+void prepare(pcg::Image<T, S> &img, const pcg::RGBAImageSoA &soa)
+{
+    if (img.Width() != soa.Width() || img.Height() != soa.Height()) {
+        img.Alloc(soa.Width(), soa.Height());
+    }
+}
+
 } // Namespace
 
 
 
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgba32F_TopDown(
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgba32FToSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgba32F_BottomUp(
+    const pcg::Image<pcg::Rgba32F, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgba32FToSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgb32F_TopDown(
+    const pcg::Image<pcg::Rgb32F, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgb32FToSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgb32F_BottomUp(
+    const pcg::Image<pcg::Rgb32F, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgb32FToSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgbe_TopDown(
+    const pcg::Image<pcg::Rgbe, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<RgbeToSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_FromRgbe_BottomUp(
+    const pcg::Image<pcg::Rgbe, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<RgbeToSoA>(img, soa);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgba32F_TopDown(
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgba32FFromSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgba32F_BottomUp(
+    const pcg::Image<pcg::Rgba32F, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgba32FFromSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgb32F_TopDown(
+    const pcg::Image<pcg::Rgb32F, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgb32FFromSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgb32F_BottomUp(
+    const pcg::Image<pcg::Rgb32F, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<Rgb32FFromSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgbe_TopDown(
+    const pcg::Image<pcg::Rgbe, pcg::TopDown> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<RgbeFromSoA>(img, soa);
+}
+
+void pcg::PCG_SIMD_NS::ImageSoA_ToRgbe_BottomUp(
+    const pcg::Image<pcg::Rgbe, pcg::BottomUp> &img, const pcg::RGBAImageSoA &soa)
+{
+    convert<RgbeFromSoA>(img, soa);
+}
+
+
+
+#if !PCG_SIMD_IS_VARIANT
+
 void
 pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgba32F, pcg::TopDown> &img)
 {
-    CopyFunctor::Range range(0, img.Size(), 4);
-    CopyFunctor functor(CopyFunctor::Args(img, *this));
-    tbb::parallel_for(range, functor);
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgba32F_TopDown)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgba32F, pcg::BottomUp> &img)
+{
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgba32F_BottomUp)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgb32F, pcg::TopDown> &img)
+{
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgb32F_TopDown)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgb32F, pcg::BottomUp> &img)
+{
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgb32F_BottomUp)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgbe, pcg::TopDown> &img)
+{
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgbe_TopDown)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgbe, pcg::BottomUp> &img)
+{
+    PCG_SIMD_DISPATCH(ImageSoA_FromRgbe_BottomUp)(img, *this);
+}
+
+
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgba32F, pcg::TopDown> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgba32F_TopDown)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgba32F, pcg::BottomUp> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgba32F_BottomUp)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgb32F, pcg::TopDown> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgb32F_TopDown)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgb32F, pcg::BottomUp> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgb32F_BottomUp)(img, *this);
+}
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgbe, pcg::TopDown> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgbe_TopDown)(img, *this);
 }
+
+void
+pcg::RGBAImageSoA::CopyTo(pcg::Image<pcg::Rgbe, pcg::BottomUp> &img) const
+{
+    prepare(img, *this);
+    PCG_SIMD_DISPATCH(ImageSoA_ToRgbe_BottomUp)(img, *this);
+}
+
+#endif // !PCG_SIMD_IS_VARIANT
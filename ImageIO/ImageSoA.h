@@ -19,11 +19,15 @@
 
 #include "ImageIO.h"
 #include "Image.h"
+#include "ImageAllocator.h"
 #include "Exception.h"
 #include "Rgba32F.h"
+#include "Rgba16F.h"
 
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <cstddef>
 #include <cassert>
 
 #if !defined(_MSC_VER) || _MSC_VER >= 1600
@@ -33,6 +37,10 @@
 namespace pcg
 {
 
+// Other AoS pixels with parallel conversions to RGBAImageSoA
+struct Rgb32F;
+struct Rgbe;
+
 /** Tag-structure to query each channel in a type-safe way */
 template <typename T, int channelIdx>
 struct ChannelSpecTag
@@ -51,7 +59,8 @@ class ImageSoABase
 {
 protected:
     // Default constructor, clears the member variables
-    ImageSoABase() : m_width(0), m_height(0), m_data(0)
+    ImageSoABase() : m_width(0), m_height(0), m_data(0),
+        m_totalBytes(0), m_allocator(NULL), m_backingStore(NULL)
     {
     }
 
@@ -59,8 +68,13 @@ protected:
     // Allocates new space for the image data, deleting the previous one
     template <size_t N>
     void Alloc(int w, int h, const size_t (&sizes)[N]) {
-        assert(w > 0 && h > 0);
-        assert(((long long)w)*h <= 0x7fffffff);
+        assert(m_offsets.size() == N);
+        Alloc(w, h, sizes, N);
+    }
+
+    // Allocates space for n channels whose elements have the given sizes
+    void Alloc(int w, int h, const size_t *sizes, size_t n) {
+        assert(w > 0 && h > 0 && n > 0);
         Clear();
         m_width  = w;
         m_height = h;
@@ -69,21 +83,36 @@ protected:
         const size_t numel = static_cast<size_t>(w) * static_cast<size_t>(h);
 
         size_t offset = 0;
-        assert(m_offsets.size() == N);
-        m_offsets[0] = offset;
-        for (size_t i = 0; i != N; ++i) {
+        bool isPlanar = true;
+        m_offsets.resize(n);
+        for (size_t i = 0; i != n; ++i) {
             m_offsets[i] = offset;
-            offset += ((numel * sizes[i]) + 63) & ~0x3F;
+            offset += ((numel * sizes[i]) + 63) & ~size_t(0x3F);
             assert(offset % 64 == 0);
+            isPlanar = isPlanar && sizes[i] == sizes[0];
         }
 
-        // At this point offset contains the total requested memory
-        const size_t totalBytes = offset;
-        m_data = alloc_align<int8_t>(64, totalBytes);
+        // At this point offset contains the total requested memory. Channels
+        // of the same size are planes which the kernels split alike.
+        m_totalBytes = offset;
+        m_allocator  = m_backingStore != NULL ? m_backingStore :
+                                                ImageAllocator::Current();
+        m_data = static_cast<int8_t*>(isPlanar ?
+            m_allocator->AllocatePlanes(m_totalBytes / n, n) :
+            m_allocator->Allocate(m_totalBytes));
         assert(reinterpret_cast<intptr_t>(m_data) % 64 == 0);
         if (m_data == NULL) {
             throw RuntimeException("Couldn't allocate memory for the image.");
         }
+
+        // Pixels of each chunk of the planes placed by the allocator
+        const int numChunks = isPlanar ? m_allocator->NumChunks() : 0;
+        m_chunkBegin.resize(numChunks > 0 ? numChunks + 1 : 0);
+        for (int k = 0; k != static_cast<int>(m_chunkBegin.size()); ++k) {
+            const size_t begin = FirstTouchAllocator::ChunkBegin(
+                m_totalBytes / n, k, numChunks) / sizes[0];
+            m_chunkBegin[k] = std::min(static_cast<ptrdiff_t>(begin), Size());
+        }
     }
 
 public:
@@ -100,12 +129,29 @@ public:
         Clear();
     }
 
+    // Selects where the following calls to Alloc get the memory from, for
+    // example a MappedFileAllocator for images larger than the physical
+    // memory. NULL, the default, uses ImageAllocator::Current(). The
+    // allocator must outlive the pixels which it provides.
+    void SetBackingStore(ImageAllocator* allocator) {
+        m_backingStore = allocator;
+    }
+
+    // Allocator used by the following calls to Alloc, NULL if it is the
+    // current one at the time of the call
+    ImageAllocator* GetBackingStore() const {
+        return m_backingStore;
+    }
+
     // Deallocates the memory and resets the image dimensions to 0
     void Clear() {
         if (m_data != 0) {
-            free_align(m_data);
+            m_allocator->Release(m_data, m_totalBytes);
             m_data = 0;
+            m_totalBytes = 0;
+            m_allocator  = NULL;
             std::fill(m_offsets.begin(), m_offsets.end(), -1);
+            m_chunkBegin.clear();
         }
 
         m_width = m_height = 0;
@@ -117,8 +163,22 @@ public:
     // Height of the image
     int Height() const { return m_height; }
 
-    // Number of pixels in the image (Width*Height)
-    int Size()   const { return m_width*m_height; }
+    // Number of pixels in the image (Width*Height). It may exceed 2^31
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(m_width)*m_height; }
+
+    // Number of chunks in which the allocator placed the pages of every
+    // channel, 0 if it did not place them (see ImageAllocator::NumChunks)
+    int NumChunks() const {
+        return m_chunkBegin.empty() ? 0 :
+            static_cast<int>(m_chunkBegin.size()) - 1;
+    }
+
+    // Index of the first pixel of the k-th chunk, for k from 0 to NumChunks().
+    // The boundaries fall on whole vectors of up to 16 elements.
+    ptrdiff_t ChunkBegin(int k) const {
+        assert(0 <= k && k < static_cast<int>(m_chunkBegin.size()));
+        return m_chunkBegin[k];
+    }
 
     // Provides access to the scanline mode of the image
     ScanLineMode GetMode() const { return TopDown; }
@@ -129,22 +189,20 @@ public:
     inline typename ChannelSpec::data_t & ElementAt(int i, int j,
         ScanLineMode mode = TopDown) const
     {
-        assert(m_width*j+i >=0 && m_width*j+i < m_width*m_height && 
-            j >= 0 && j < m_height && i >=0 && i < m_width);
+        assert(j >= 0 && j < m_height && i >=0 && i < m_width);
 
         typedef typename ChannelSpec::data_t data_t;
         data_t * d = reinterpret_cast<data_t*>(
             m_data + m_offsets[ChannelSpec::IDX]);
-        return (mode == TopDown) ? d[m_width*j + i] :
-                                   d[(m_height-j-1)*m_width + i];
+        return d[GetIndex(i, j, mode)];
     }
 
     // Returns a reference to the idx-th pixel of the image, which are in
     // scanline order according to the specified mode.
     template <class ChannelSpec>
-    inline typename ChannelSpec::data_t & ElementAt(int idx) const
+    inline typename ChannelSpec::data_t & ElementAt(ptrdiff_t idx) const
     {
-        assert(idx >=0 && idx < m_width*m_height);
+        assert(idx >=0 && idx < Size());
         typedef typename ChannelSpec::data_t data_t;
         data_t * d = reinterpret_cast<data_t*>(
             m_data + m_offsets[ChannelSpec::IDX]);
@@ -164,26 +222,27 @@ public:
     // Writes in the i,j parameters the coordinates necessary to access the
     // idx-pixel in the image using ElementAt(int,int), according to the
     // scanline order of the image.
-    inline void GetIndices(int idx, int &i, int &j) const { 
-        assert(0 <= idx && idx < m_width*m_height);
-        i = idx % m_width; 
-        j = idx / m_width; 
+    inline void GetIndices(ptrdiff_t idx, int &i, int &j) const { 
+        assert(0 <= idx && idx < Size());
+        i = static_cast<int>(idx % m_width); 
+        j = static_cast<int>(idx / m_width); 
     }
 
     // Returns the index (zero based) of the i-th pixel at the j-th scanline
     // using the scanline order of the image.
-    inline int GetIndex(int i, int j) const {
+    inline ptrdiff_t GetIndex(int i, int j) const {
         assert(0 <= i && i < m_width);
         assert(0 <= j && j < m_height);
-        return m_width*j+i;
+        return static_cast<ptrdiff_t>(m_width)*j + i;
     }
 
     // Returns the index (zero based) of the i-th pixel at the j-th scanline
     // using the given scanline order.
-	inline int GetIndex(int i, int j, ScanLineMode mode) const {
+	inline ptrdiff_t GetIndex(int i, int j, ScanLineMode mode) const {
         assert(0 <= i && i < m_width);
         assert(0 <= j && j < m_height);
-        return mode == TopDown ? (m_width*j + i) : ((m_height-j-1)*m_width + i);
+        return mode == TopDown ? (static_cast<ptrdiff_t>(m_width)*j + i) :
+                                 (static_cast<ptrdiff_t>(m_height-j-1)*m_width + i);
     }
 
     // Gets a pointer to the beginning of the j-th scanline in the specified
@@ -201,8 +260,7 @@ public:
             m_data + m_offsets[ChannelSpec::IDX]);
 
         // There are only have two modes, so this works nicely
-        return (mode == TopDown) ? &(d[j * m_width]) :
-                                   &(d[(m_height - j - 1) * m_width]);
+        return &(d[GetIndex(0, j, mode)]);
     }
 
 
@@ -215,6 +273,17 @@ protected:
 
     // Offsets for each channel
     std::vector<size_t> m_offsets;
+
+    // Size of the buffer and the allocator which provided it
+    size_t m_totalBytes;
+    ImageAllocator* m_allocator;
+
+    // First pixel of each chunk placed by the allocator and Size() at the end,
+    // empty if the allocator did not place the pages
+    std::vector<ptrdiff_t> m_chunkBegin;
+
+    // Allocator selected for this image, if any
+    ImageAllocator* m_backingStore;
 };
 
 
@@ -302,6 +371,145 @@ public:
 
 
 
+// SoA image whose channels are only known at runtime, such as the arbitrary
+// outputs (depth, normals, albedo...) of a renderer. Each channel has a name
+// and its own 64-byte aligned, padded plane of elements of its type.
+class MultiChannelImageSoA : public ImageSoABase
+{
+public:
+
+    // Types of the elements of each plane, in the same order as the
+    // Imf::PixelType enumeration. HALF planes hold the raw binary16 bits.
+    enum PixelType {
+        UINT,   // uint32_t
+        HALF,   // uint16_t
+        FLOAT   // float
+    };
+
+    // Description of each channel
+    struct Channel {
+        std::string name;
+        PixelType type;
+
+        Channel() : type(FLOAT) {}
+        Channel(const std::string &n, PixelType t = FLOAT) : name(n), type(t) {}
+    };
+
+    typedef std::vector<Channel> ChannelList;
+
+    // Size in bytes of the elements of the given type
+    static size_t PixelSize(PixelType type) {
+        switch (type) {
+        case UINT:  return sizeof(uint32_t);
+        case HALF:  return sizeof(uint16_t);
+        case FLOAT: return sizeof(float);
+        default:
+            assert(0);
+            return 0;
+        }
+    }
+
+
+    // Default constructor: creates an empty image. To do anything
+    // useful afterwards you need to use the Alloc method.
+    MultiChannelImageSoA() {}
+
+    // Creates a new image allocating the required space
+    MultiChannelImageSoA(int w, int h, const ChannelList &channels)
+    {
+        Alloc(w, h, channels);
+    }
+
+    // Allocates new space for the image data, deleting the previous one.
+    // The names of the channels must be unique.
+    void Alloc(int w, int h, const ChannelList &channels) {
+        if (channels.empty()) {
+            throw IllegalArgumentException("The image needs some channels");
+        }
+        std::vector<size_t> sizes(channels.size());
+        for (size_t i = 0; i != channels.size(); ++i) {
+            for (size_t k = 0; k != i; ++k) {
+                if (channels[k].name == channels[i].name) {
+                    throw IllegalArgumentException("Duplicate channel: " +
+                        channels[i].name);
+                }
+            }
+            sizes[i] = PixelSize(channels[i].type);
+        }
+        m_channels.clear();
+        ImageSoABase::Alloc(w, h, &sizes[0], sizes.size());
+        m_channels = channels;
+    }
+
+    // Deallocates the memory and removes all the channels
+    void Clear() {
+        ImageSoABase::Clear();
+        m_channels.clear();
+    }
+
+    // Number of channels of the image
+    int NumChannels() const { return static_cast<int>(m_channels.size()); }
+
+    // Channels of the image, in the order of their planes
+    const ChannelList& Channels() const { return m_channels; }
+
+    // Index of the channel with the given name, or -1 if there is none
+    int FindChannel(const std::string &name) const {
+        for (size_t i = 0; i != m_channels.size(); ++i) {
+            if (m_channels[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // Index of the channel with the given name. Throws an
+    // IllegalArgumentException if there is no such channel.
+    int ChannelIndex(const std::string &name) const {
+        const int idx = FindChannel(name);
+        if (idx < 0) {
+            throw IllegalArgumentException("Unknown channel: " + name);
+        }
+        return idx;
+    }
+
+    // Raw pointer to the plane of the given channel. The size of T must
+    // match the type of the channel.
+    template <typename T>
+    inline T* GetPlane(int channelIdx) const {
+        assert(0 <= channelIdx && channelIdx < NumChannels());
+        assert(sizeof(T) == PixelSize(m_channels[channelIdx].type));
+        return reinterpret_cast<T*>(m_data + m_offsets[channelIdx]);
+    }
+
+    template <typename T>
+    inline T* GetPlane(const std::string &name) const {
+        return GetPlane<T>(ChannelIndex(name));
+    }
+
+    // Gets a pointer to the beginning of the j-th scanline of a plane
+    template <typename T>
+    inline T* GetScanlinePointer(int channelIdx, int j,
+        ScanLineMode mode = TopDown) const
+    {
+        assert(j >= 0 && j < m_height);
+        return GetPlane<T>(channelIdx) + GetIndex(0, j, mode);
+    }
+
+    // Returns a reference to the i-th pixel in the j-th scanline of a plane
+    template <typename T>
+    inline T& ElementAt(int channelIdx, int i, int j,
+        ScanLineMode mode = TopDown) const
+    {
+        return GetPlane<T>(channelIdx)[GetIndex(i, j, mode)];
+    }
+
+private:
+    ChannelList m_channels;
+};
+
+
+
 // Helper typedef for an SoA image with RGBA channels, for bulk operations
 class RGBAImageSoA : public ImageSoA4<float, float, float, float>
 {
@@ -315,6 +523,9 @@ public:
 
     RGBAImageSoA(int w, int h) : ImageSoA4<float,float,float,float>(w, h) {}
 
+    // Copies the pixels of an AoS image. The conversions from Rgba32F,
+    // Rgb32F and Rgbe images, in either scanline order, are specialized to
+    // run in parallel with SIMD transposes.
     template <typename PixelRGB>
     RGBAImageSoA(const Image<PixelRGB, pcg::TopDown> &img) :
     ImageSoA4<float,float,float,float>(img.Width(), img.Height())
@@ -326,7 +537,7 @@ public:
 
         const PixelRGB * pixels = img.GetDataPointer();
 
-        for (int i = 0; i < img.Size(); ++i) {
+        for (ptrdiff_t i = 0; i < img.Size(); ++i) {
             const PixelRGB &p = pixels[i];
             r[i] = p.r();
             g[i] = p.g();
@@ -357,8 +568,19 @@ public:
         }
     }
 
+    // Copies the pixels into an AoS image, which is reallocated if its size
+    // is different. As with the Rgba32F to Rgb32F conversion, the Rgb32F
+    // pixels get the color multiplied by alpha; the alpha is dropped when
+    // encoding Rgbe pixels.
+    void IMAGEIO_API CopyTo(Image<pcg::Rgba32F, pcg::TopDown>  &img) const;
+    void IMAGEIO_API CopyTo(Image<pcg::Rgba32F, pcg::BottomUp> &img) const;
+    void IMAGEIO_API CopyTo(Image<pcg::Rgb32F,  pcg::TopDown>  &img) const;
+    void IMAGEIO_API CopyTo(Image<pcg::Rgb32F,  pcg::BottomUp> &img) const;
+    void IMAGEIO_API CopyTo(Image<pcg::Rgbe,    pcg::TopDown>  &img) const;
+    void IMAGEIO_API CopyTo(Image<pcg::Rgbe,    pcg::BottomUp> &img) const;
+
     // Utility which generates a RGBA32F pixel on the fly
-    Rgba32F operator[] (int idx) const
+    Rgba32F operator[] (ptrdiff_t idx) const
     {
         const float& r = ElementAt<R>(idx);
         const float& g = ElementAt<G>(idx);
@@ -368,10 +590,15 @@ public:
     }
 
 protected:
-    void IMAGEIO_API copyImage(const Image<pcg::Rgba32F, pcg::TopDown> &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgba32F, pcg::TopDown>  &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgba32F, pcg::BottomUp> &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgb32F,  pcg::TopDown>  &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgb32F,  pcg::BottomUp> &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgbe,    pcg::TopDown>  &img);
+    void IMAGEIO_API copyImage(const Image<pcg::Rgbe,    pcg::BottomUp> &img);
 };
 
-// Constructor specialization
+// Constructor specializations
 template <>
 inline RGBAImageSoA::RGBAImageSoA(const Image<Rgba32F, pcg::TopDown> &img) :
 ImageSoA4<float,float,float,float>(img.Width(), img.Height())
@@ -379,6 +606,93 @@ ImageSoA4<float,float,float,float>(img.Width(), img.Height())
     copyImage(img);
 }
 
+template <>
+inline RGBAImageSoA::RGBAImageSoA(const Image<Rgba32F, pcg::BottomUp> &img) :
+ImageSoA4<float,float,float,float>(img.Width(), img.Height())
+{
+    copyImage(img);
+}
+
+template <>
+inline RGBAImageSoA::RGBAImageSoA(const Image<Rgb32F, pcg::TopDown> &img) :
+ImageSoA4<float,float,float,float>(img.Width(), img.Height())
+{
+    copyImage(img);
+}
+
+template <>
+inline RGBAImageSoA::RGBAImageSoA(const Image<Rgb32F, pcg::BottomUp> &img) :
+ImageSoA4<float,float,float,float>(img.Width(), img.Height())
+{
+    copyImage(img);
+}
+
+template <>
+inline RGBAImageSoA::RGBAImageSoA(const Image<Rgbe, pcg::TopDown> &img) :
+ImageSoA4<float,float,float,float>(img.Width(), img.Height())
+{
+    copyImage(img);
+}
+
+template <>
+inline RGBAImageSoA::RGBAImageSoA(const Image<Rgbe, pcg::BottomUp> &img) :
+ImageSoA4<float,float,float,float>(img.Width(), img.Height())
+{
+    copyImage(img);
+}
+
+
+
+// SoA image with only RGB channels, for opaque images such as those from RGBE
+// and PFM files. It saves the memory and bandwidth of a constant alpha plane;
+// wherever an alpha is required it is 1.
+class RGBImageSoA : public ImageSoA3<float, float, float>
+{
+public:
+    typedef Channel_1 R;
+    typedef Channel_2 G;
+    typedef Channel_3 B;
+
+    RGBImageSoA() : ImageSoA3<float,float,float>() {}
+
+    RGBImageSoA(int w, int h) : ImageSoA3<float,float,float>(w, h) {}
+
+    // Utility which generates an opaque RGBA32F pixel on the fly
+    Rgba32F operator[] (ptrdiff_t idx) const
+    {
+        const float& r = ElementAt<R>(idx);
+        const float& g = ElementAt<G>(idx);
+        const float& b = ElementAt<B>(idx);
+        return Rgba32F(r, g, b);
+    }
+};
+
+
+
+// SoA image with half precision RGBA channels, holding the raw binary16 bits
+class RGBA16FImageSoA : public ImageSoA4<uint16_t, uint16_t, uint16_t, uint16_t>
+{
+public:
+    typedef Channel_1 R;
+    typedef Channel_2 G;
+    typedef Channel_3 B;
+    typedef Channel_4 A;
+
+    RGBA16FImageSoA() : ImageSoA4<uint16_t,uint16_t,uint16_t,uint16_t>() {}
+
+    RGBA16FImageSoA(int w, int h) :
+    ImageSoA4<uint16_t,uint16_t,uint16_t,uint16_t>(w, h) {}
+
+    // Utility which generates a RGBA32F pixel on the fly
+    Rgba32F operator[] (ptrdiff_t idx) const
+    {
+        return Rgba32F(halfToFloat(ElementAt<R>(idx)),
+                       halfToFloat(ElementAt<G>(idx)),
+                       halfToFloat(ElementAt<B>(idx)),
+                       halfToFloat(ElementAt<A>(idx)));
+    }
+};
+
 } // namespace pcg
 
 #endif /* PCG_IMAGESOA_H */
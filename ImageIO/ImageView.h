@@ -0,0 +1,206 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Non-owning views over pixels which live somewhere else: a QImage, a Java
+// direct buffer, a Matlab array... The views never allocate nor release the
+// memory, they only describe where each scanline is. Unlike the images, the
+// memory after the last pixel of a view is not padded, thus the algorithms
+// taking views never read or write beyond it.
+
+#pragma once
+#if !defined(PCG_IMAGEVIEW_H)
+#define PCG_IMAGEVIEW_H
+
+#include "ImageIO.h"
+#include "Image.h"
+#include "ImageSoA.h"
+
+#include <cstddef>
+#include <cassert>
+
+namespace pcg
+{
+
+template <typename T, ScanLineMode S = TopDown>
+class ImageView
+{
+public:
+
+    // Default constructor: creates an empty view
+    ImageView() : d(NULL), w(0), h(0), stride(0) {}
+
+    // Wraps pixels whose consecutive scanlines (in the scanline order of
+    // the view) are separated by the given number of pixels, by default they
+    // are tightly packed. A negative stride walks the memory backwards, as
+    // with a bottom-up bitmap.
+    ImageView(T* data, int width, int height, ptrdiff_t rowStride = 0) :
+    d(data), w(width), h(height), stride(rowStride != 0 ? rowStride : width)
+    {
+        assert(data != NULL && width > 0 && height > 0);
+        assert(stride >= width || stride <= -width);
+    }
+
+    // View of all the pixels of an image
+    ImageView(const Image<T, S> &img) :
+    d(img.GetDataPointer()), w(img.Width()), h(img.Height()),
+    stride(img.Width())
+    {}
+
+    // Width of the view
+    int Width()  const { return w; }
+
+    // Height of the view
+    int Height() const { return h; }
+
+    // Number of pixels in the view (Width*Height)
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(w)*h; }
+
+    // Distance in pixels between consecutive scanlines
+    ptrdiff_t Stride() const { return stride; }
+
+    // Whether the pixels are in a single block, one scanline after the other
+    bool IsContiguous() const { return stride == w; }
+
+    // Pointer to the first pixel, which is the first pixel of the first
+    // scanline according to the scanline order of the view
+    T* GetDataPointer() const { return d; }
+
+    // Provides access to the scanline mode of the view
+    ScanLineMode GetMode() const { return S; }
+
+    // Gets a pointer to the beginning of the j-th scanline in the specified
+    // mode. By default the mode is the same of the view.
+    T* GetScanlinePointer(int j, ScanLineMode mode = S) const {
+        assert(j >= 0 && j < h);
+        return d + stride * (mode == S ? j : h - j - 1);
+    }
+
+    // Returns a reference to the i-th pixel in the j-th scanline
+    T& ElementAt(int i, int j, ScanLineMode mode = S) const {
+        assert(i >= 0 && i < w);
+        return GetScanlinePointer(j, mode)[i];
+    }
+
+private:
+    T* d;
+    int w;
+    int h;
+    ptrdiff_t stride;
+};
+
+
+
+// View over four single precision planes with the RGBA channels. All the
+// planes share the same stride, and are always in top-down order.
+class RGBAImageSoAView
+{
+public:
+    typedef RGBAImageSoA::R R;
+    typedef RGBAImageSoA::G G;
+    typedef RGBAImageSoA::B B;
+    typedef RGBAImageSoA::A A;
+
+    // Default constructor: creates an empty view
+    RGBAImageSoAView() : m_width(0), m_height(0), m_stride(0)
+    {
+        m_planes[0] = m_planes[1] = m_planes[2] = m_planes[3] = NULL;
+    }
+
+    // Wraps the given planes. The stride is the distance in elements between
+    // consecutive scanlines, by default the planes are tightly packed.
+    RGBAImageSoAView(float* r, float* g, float* b, float* a,
+        int width, int height, ptrdiff_t rowStride = 0) :
+    m_width(width), m_height(height),
+    m_stride(rowStride != 0 ? rowStride : width)
+    {
+        assert(r != NULL && g != NULL && b != NULL && a != NULL);
+        assert(width > 0 && height > 0);
+        assert(m_stride >= width || m_stride <= -width);
+        m_planes[0] = r;
+        m_planes[1] = g;
+        m_planes[2] = b;
+        m_planes[3] = a;
+    }
+
+    // View of all the pixels of a SoA image
+    RGBAImageSoAView(const RGBAImageSoA &img) :
+    m_width(img.Width()), m_height(img.Height()), m_stride(img.Width())
+    {
+        m_planes[0] = img.GetDataPointer<R>();
+        m_planes[1] = img.GetDataPointer<G>();
+        m_planes[2] = img.GetDataPointer<B>();
+        m_planes[3] = img.GetDataPointer<A>();
+    }
+
+    // Width of the view
+    int Width()  const { return m_width; }
+
+    // Height of the view
+    int Height() const { return m_height; }
+
+    // Number of pixels in the view (Width*Height)
+    ptrdiff_t Size() const {
+        return static_cast<ptrdiff_t>(m_width)*m_height;
+    }
+
+    // Distance in elements between consecutive scanlines
+    ptrdiff_t Stride() const { return m_stride; }
+
+    // Whether each plane is a single block, one scanline after the other
+    bool IsContiguous() const { return m_stride == m_width; }
+
+    // Provides access to the scanline mode of the view
+    ScanLineMode GetMode() const { return TopDown; }
+
+    // Pointer to the first element of a plane
+    template <class ChannelSpec>
+    inline float* GetDataPointer() const {
+        return m_planes[ChannelSpec::IDX];
+    }
+
+    // Gets a pointer to the beginning of the j-th scanline of a plane
+    template <class ChannelSpec>
+    inline float* GetScanlinePointer(int j, ScanLineMode mode = TopDown) const
+    {
+        assert(j >= 0 && j < m_height);
+        return m_planes[ChannelSpec::IDX] +
+            m_stride * (mode == TopDown ? j : m_height - j - 1);
+    }
+
+    // Returns a reference to the i-th pixel in the j-th scanline of a plane
+    template <class ChannelSpec>
+    inline float& ElementAt(int i, int j, ScanLineMode mode = TopDown) const
+    {
+        assert(i >= 0 && i < m_width);
+        return GetScanlinePointer<ChannelSpec>(j, mode)[i];
+    }
+
+    // Utility which generates a RGBA32F pixel on the fly
+    Rgba32F operator() (int i, int j) const
+    {
+        return Rgba32F(ElementAt<R>(i, j), ElementAt<G>(i, j),
+                       ElementAt<B>(i, j), ElementAt<A>(i, j));
+    }
+
+private:
+    float* m_planes[4];
+    int m_width;
+    int m_height;
+    ptrdiff_t m_stride;
+};
+
+} // namespace pcg
+
+#endif /* PCG_IMAGEVIEW_H */
@@ -19,6 +19,7 @@
 #include "OpenEXRIO.h"
 #include "RgbeIO.h"
 #include "PfmIO.h"
+#include "MappedFile.h"
 
 #include <fstream>
 #include <sstream>
@@ -151,6 +152,16 @@ void LoadHDRImpl(ImageCls &img, const CharT *filename)
         throw IllegalArgumentException("The filename cannot be null.");
     }
 
+    // Regular files are read straight from the page cache, so that the
+    // codecs may use the bytes in place
+    MappedFile mapped;
+    if (mapped.open(filename)) {
+        MemoryStreamBuf buf(mapped.data(), mapped.size());
+        std::istream is(&buf);
+        LoadHDRImpl(img, is);
+        return;
+    }
+
     std::ifstream is(filename, std::ios::binary);
 
     if(!is) {
@@ -0,0 +1,205 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "MappedFile.h"
+
+#include <limits>
+
+#if defined(_WIN32)
+# ifdef NOMINMAX
+#  undef NOMINMAX
+# endif
+# define NOMINMAX
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+using namespace pcg;
+
+
+namespace
+{
+
+#if defined(_WIN32)
+
+// Maps the whole file through an already open handle, which is closed
+const char* mapHandle(HANDLE hFile, size_t& size)
+{
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    const char* data = NULL;
+    LARGE_INTEGER fileSize;
+    if (::GetFileType(hFile) == FILE_TYPE_DISK &&
+        ::GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0 &&
+        static_cast<unsigned long long>(fileSize.QuadPart) <=
+        std::numeric_limits<size_t>::max())
+    {
+        // The view keeps the mapping alive once its handle is closed
+        HANDLE hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY,
+            0, 0, NULL);
+        if (hMapping != NULL) {
+            data = static_cast<const char*>(
+                ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+            size = static_cast<size_t>(fileSize.QuadPart);
+            ::CloseHandle(hMapping);
+        }
+    }
+    ::CloseHandle(hFile);
+    return data;
+}
+
+#else
+
+const char* mapFile(const char* filename, size_t& size)
+{
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    const char* data = NULL;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        static_cast<unsigned long long>(st.st_size) <=
+        std::numeric_limits<size_t>::max())
+    {
+        size = static_cast<size_t>(st.st_size);
+        void* addr = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            // The codecs touch every page, so start reading them right away
+#if defined(MADV_WILLNEED)
+            ::madvise(addr, size, MADV_WILLNEED);
+#endif
+            data = static_cast<const char*>(addr);
+        }
+    }
+    ::close(fd);
+    return data;
+}
+
+#endif
+
+} // namespace
+
+
+
+MappedFile::MappedFile() : m_data(NULL), m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const char* filename)
+{
+    close();
+    m_data = mapHandle(::CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL), m_size);
+    return m_data != NULL;
+}
+
+bool MappedFile::open(const wchar_t* filename)
+{
+    close();
+    m_data = mapHandle(::CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL), m_size);
+    return m_data != NULL;
+}
+
+void MappedFile::close()
+{
+    if (m_data != NULL) {
+        ::UnmapViewOfFile(m_data);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+#else
+
+bool MappedFile::open(const char* filename)
+{
+    close();
+    m_data = mapFile(filename, m_size);
+    return m_data != NULL;
+}
+
+void MappedFile::close()
+{
+    if (m_data != NULL) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+#endif
+
+
+
+MemoryStreamBuf::MemoryStreamBuf(const char* data, size_t size)
+{
+    // The get area is never written to
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(off_type off,
+    std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if ((which & std::ios_base::in) == 0) {
+        return pos_type(off_type(-1));
+    }
+
+    off_type base;
+    if (dir == std::ios_base::beg) {
+        base = 0;
+    } else if (dir == std::ios_base::cur) {
+        base = static_cast<off_type>(gptr() - eback());
+    } else {
+        base = static_cast<off_type>(egptr() - eback());
+    }
+
+    const off_type pos = base + off;
+    if (pos < 0 || pos > static_cast<off_type>(egptr() - eback())) {
+        return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(pos_type pos,
+    std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+std::streamsize MemoryStreamBuf::showmanyc()
+{
+    // Reached only once the get area is exhausted
+    return -1;
+}
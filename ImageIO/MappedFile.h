@@ -0,0 +1,108 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal helpers to read whole files through memory mappings. A mapped file
+// is exposed to the codecs as a regular std::istream backed by a
+// MemoryStreamBuf; codecs which recognize the buffer may then access the
+// bytes in place instead of copying them through the stream.
+
+#if !defined(PCG_MAPPEDFILE_H)
+#define PCG_MAPPEDFILE_H
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+namespace pcg
+{
+
+// Read-only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Maps the file. Returns false if it is not a non-empty regular file or
+    // if it cannot be mapped, in which case the caller should fall back to
+    // regular streams.
+    bool open(const char* filename);
+#if defined(_WIN32)
+    bool open(const wchar_t* filename);
+#endif
+
+    void close();
+
+    inline bool isOpen() const {
+        return m_data != NULL;
+    }
+
+    inline const char* data() const {
+        return m_data;
+    }
+
+    inline size_t size() const {
+        return m_size;
+    }
+
+private:
+    // Non-copyable
+    MappedFile(const MappedFile&);
+    MappedFile& operator= (const MappedFile&);
+
+    const char* m_data;
+    size_t m_size;
+};
+
+
+
+// Seekable, read-only stream buffer over a block of memory
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const char* data, size_t size);
+
+    // Returns the memory buffer of the stream, or NULL if the stream is not
+    // backed by a MemoryStreamBuf
+    static inline MemoryStreamBuf* fromStream(std::istream& is) {
+        return dynamic_cast<MemoryStreamBuf*>(is.rdbuf());
+    }
+
+    // Pointer to the next byte to be read
+    inline const char* current() const {
+        return gptr();
+    }
+
+    // Number of bytes left in the buffer
+    inline size_t available() const {
+        return static_cast<size_t>(egptr() - gptr());
+    }
+
+    // Marks n bytes as read, n <= available()
+    inline void consume(size_t n) {
+        setg(eback(), gptr() + n, egptr());
+    }
+
+protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in);
+    virtual pos_type seekpos(pos_type pos,
+        std::ios_base::openmode which = std::ios_base::in);
+    virtual std::streamsize showmanyc();
+};
+
+} // namespace pcg
+
+#endif /* PCG_MAPPEDFILE_H */
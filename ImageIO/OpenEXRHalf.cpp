@@ -0,0 +1,81 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Float to half conversions for saving OpenEXR files, compiled once per
+// instruction set (see SimdDispatch.h). With F16C, enabled in the AVX2
+// variant, the hardware instruction is used, otherwise the scalar
+// floatToHalf. Both round to nearest even.
+
+#include "StdAfx.h"
+#include "OpenEXRIOPrivate.h"
+
+using namespace pcg;
+
+
+namespace
+{
+
+#if PCG_USE_F16C
+inline __m128i toHalf4(__m128 v) {
+    return _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+}
+#endif
+
+} // namespace
+
+
+
+// Rgba32F stores the components as [a b g r]
+void pcg::PCG_SIMD_NS::OpenEXRIO_ToHalf(const Rgba32F* PCG_RESTRICT src,
+    Rgba16F* PCG_RESTRICT dest, int count)
+{
+    int i = 0;
+#if PCG_USE_F16C
+    const __m128* PCG_RESTRICT in = reinterpret_cast<const __m128*>(src);
+    __m128i* out = reinterpret_cast<__m128i*>(dest);
+    for (; i + 2 <= count; i += 2) {
+        const __m128 p0 = _mm_shuffle_ps(in[i],   in[i],   _MM_SHUFFLE(0,1,2,3));
+        const __m128 p1 = _mm_shuffle_ps(in[i+1], in[i+1], _MM_SHUFFLE(0,1,2,3));
+        _mm_storeu_si128(out + i/2,
+            _mm_unpacklo_epi64(toHalf4(p0), toHalf4(p1)));
+    }
+#endif
+    for (; i < count; ++i) {
+        dest[i] = Rgba16F(src[i]);
+    }
+}
+
+
+
+void pcg::PCG_SIMD_NS::OpenEXRIO_ToHalfSoA(const float* PCG_RESTRICT r,
+    const float* PCG_RESTRICT g, const float* PCG_RESTRICT b,
+    const float* PCG_RESTRICT a, Rgba16F* PCG_RESTRICT dest, int count)
+{
+    int i = 0;
+#if PCG_USE_F16C
+    __m128i* out = reinterpret_cast<__m128i*>(dest);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i rg = _mm_unpacklo_epi16(
+            toHalf4(_mm_loadu_ps(r + i)), toHalf4(_mm_loadu_ps(g + i)));
+        const __m128i ba = _mm_unpacklo_epi16(
+            toHalf4(_mm_loadu_ps(b + i)), toHalf4(_mm_loadu_ps(a + i)));
+        _mm_storeu_si128(out + i/2,     _mm_unpacklo_epi32(rg, ba));
+        _mm_storeu_si128(out + i/2 + 1, _mm_unpackhi_epi32(rg, ba));
+    }
+#endif
+    for (; i < count; ++i) {
+        dest[i].set(r[i], g[i], b[i], a[i]);
+    }
+}
@@ -16,8 +16,10 @@
 // Implementation file for loading the OpenEXR Images
 
 #include "OpenEXRIO.h"
+#include "OpenEXRIOPrivate.h"
 #include "Exception.h"
-#include "ImageIterators.h"
+#include "HdrScanlineIOPrivate.h"
+#include "MappedFile.h"
 
 // OpenEXR includes
 #include <half.h>
@@ -31,8 +33,13 @@
 #include <IlmThreadPool.h>
 
 #include <tbb/task_scheduler_init.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 #include <cerrno>
+#include <cstring>
+#include <vector>
+#include <algorithm>
 
 namespace {
 
@@ -106,6 +113,57 @@ private:
 };
 
 
+// Input stream over a MemoryStreamBuf, which lets the library read the pixel
+// data in place. The stream's position is updated as the file is read.
+class MemoryIStream : public Imf::IStream
+{
+public:
+    MemoryIStream (pcg::MemoryStreamBuf &buf, const char fileName[] = "internalBuffer.exr") :
+        IStream(fileName),
+        _buf(buf),
+        _start(buf.pubseekoff(0, std::ios_base::cur, std::ios_base::in))
+    {
+        // empty
+    }
+
+    virtual ~MemoryIStream () {}
+
+    virtual bool isMemoryMapped () const {
+        return true;
+    }
+
+    virtual bool read (char c[/*n*/], int n) {
+        memcpy (c, readMemoryMapped (n), n);
+        return true;
+    }
+
+    virtual char * readMemoryMapped (int n) {
+        if (n < 0 || static_cast<size_t>(n) > _buf.available())
+            throw Iex::InputExc ("Unexpected end of file.");
+
+        char *data = const_cast<char*>(_buf.current());
+        _buf.consume (n);
+        return data;
+    }
+
+    virtual Imath::Int64 tellg () {
+        return std::streamoff (_buf.pubseekoff(0, std::ios_base::cur,
+            std::ios_base::in) - _start);
+    }
+
+    virtual void seekg (Imath::Int64 pos) {
+        const std::streampos target = _start +
+            static_cast<std::streamoff>(pos);
+        if (_buf.pubseekpos(target, std::ios_base::in) != target)
+            throw Iex::InputExc ("Invalid seek position.");
+    }
+
+private:
+    pcg::MemoryStreamBuf & _buf;
+    const std::streampos   _start;
+};
+
+
 // Almost a copy of Imf::StdIFStream, but this one works with any kind of
 // istreams, it won't close them when it's done
 class StdOFStream : public Imf::OStream
@@ -146,13 +204,16 @@ private:
 
 
 // Helper to generate Slices for a framebuffer. The offsets are specified as
-// multiples of the given type, *NOT* bytes!
+// multiples of the given type, *NOT* bytes! A negative yStride flips the
+// image vertically: the library computes the addresses with unsigned
+// arithmetic, which wraps around to the right place.
 template <typename T>
-inline Imf::Slice newSlice(T* base, size_t xStride, size_t yStride,
+inline Imf::Slice newSlice(T* base, size_t xStride, ptrdiff_t yStride,
     double fillValue = 0.0, Imf::PixelType type = Imf::FLOAT)
 {
     Imf::Slice slice(type, reinterpret_cast<char*>(base),
-        sizeof(T) * xStride, sizeof(T) * yStride,
+        sizeof(T) * xStride,
+        static_cast<size_t>(static_cast<ptrdiff_t>(sizeof(T)) * yStride),
         1, 1, fillValue);
     return slice;
 }
@@ -162,7 +223,8 @@ inline Imf::Slice newSlice(T* base, size_t xStride, size_t yStride,
 using namespace pcg;
 
 // Small function to actually copy the pixels from the already open file into the image
-void ReadImage(Image<Rgba32F, TopDown> &img, Imf::RgbaInputFile &file)
+template <ScanLineMode S>
+void ReadImage(Image<Rgba32F, S> &img, Imf::RgbaInputFile &file)
 {
     Imath::Box2i dw = file.dataWindow();
     const int width  = dw.max.x - dw.min.x + 1;
@@ -181,10 +243,12 @@ void ReadImage(Image<Rgba32F, TopDown> &img, Imf::RgbaInputFile &file)
 
     // Convert everything to full floating point, storing in the top-down order
     const Imf::Rgba *halfPixel = &halfPixels[0][0];
-    Rgba32F *pixel = img.GetDataPointer();
-    for(int i = 0; i < width*height; ++i) {
-        Rgba32F temp(halfPixel[i].r, halfPixel[i].g, halfPixel[i].b, halfPixel[i].a);
-        pixel[i] = temp;
+    for (int j = 0; j < height; ++j, halfPixel += width) {
+        Rgba32F *pixel = img.GetScanlinePointer(j, TopDown);
+        for (int i = 0; i < width; ++i) {
+            pixel[i].set(halfPixel[i].r, halfPixel[i].g,
+                         halfPixel[i].b, halfPixel[i].a);
+        }
     }
 }
 
@@ -225,8 +289,10 @@ void ReadImage(RGBAImageSoA &img, Imf::RgbaInputFile &file)
 
 
 
-// Version using the general purpose interface, assumes RGBA channels
-void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
+// Version using the general purpose interface, assumes RGBA channels. The
+// pixels are decoded straight into the image, whatever its scanline order.
+template <ScanLineMode S>
+void ReadImage(Image<Rgba32F, S> &img, Imf::InputFile &file)
 {
     Imath::Box2i dw = file.header().dataWindow();
     const int width  = dw.max.x - dw.min.x + 1;
@@ -237,7 +303,8 @@ void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
     // Build a framebuffer
     Imf::FrameBuffer framebuffer;
     img.Alloc(width, height);
-    float *pixels = reinterpret_cast<float *>(img.GetDataPointer());
+    float *pixels = reinterpret_cast<float *>(img.GetScanlinePointer(0, TopDown));
+    const ptrdiff_t yStride = S == TopDown ? 4*width : -4*width;
 
     // The code assumes that sizeof(Rgba32F) == 4 * sizeof(float), and that the
     // pixels inside Rgba32F are at certain fixed offsets. If
@@ -248,13 +315,13 @@ void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
     //   ptr[1] == pixel.b()
     //   ptr[2] == pixel.g()
     //   ptr[3] == pixel.r()
-    const off_t baseOffset = - 4 * (dw.min.x + dw.min.y*width);
+    const ptrdiff_t baseOffset = - (4*dw.min.x + dw.min.y*yStride);
     pixels += baseOffset;
 
-    framebuffer.insert("R", newSlice(pixels+3, 4, 4*width));
-    framebuffer.insert("G", newSlice(pixels+2, 4, 4*width));
-    framebuffer.insert("B", newSlice(pixels+1, 4, 4*width));
-    framebuffer.insert("A", newSlice(pixels,   4, 4*width, 1.0));
+    framebuffer.insert("R", newSlice(pixels+3, 4, yStride));
+    framebuffer.insert("G", newSlice(pixels+2, 4, yStride));
+    framebuffer.insert("B", newSlice(pixels+1, 4, yStride));
+    framebuffer.insert("A", newSlice(pixels,   4, yStride, 1.0));
 
     // Read all the pixels from the image
     file.setFrameBuffer (framebuffer);
@@ -298,12 +365,335 @@ void ReadImage(RGBAImageSoA &img, Imf::InputFile &file)
 
 
 
+// Rgba16F has exactly the same layout as Imf::Rgba
+typedef char Rgba16FLayoutCheck[sizeof(Rgba16F) == sizeof(Imf::Rgba) &&
+    sizeof(Imf::Rgba) == 4 * sizeof(uint16_t) ? 1 : -1];
+
+// Half precision pixels are decoded straight into the image
+template <ScanLineMode S>
+void ReadImage(Image<Rgba16F, S> &img, Imf::RgbaInputFile &file)
+{
+    Imath::Box2i dw = file.dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+
+    img.Alloc(width, height);
+    Imf::Rgba *pixels =
+        reinterpret_cast<Imf::Rgba*>(img.GetScanlinePointer(0, TopDown));
+    const ptrdiff_t yStride = S == TopDown ? width : -width;
+    pixels -= dw.min.x + dw.min.y*yStride;
+
+    file.setFrameBuffer (pixels, 1, static_cast<size_t>(yStride));
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+
+
+// The SoA half precision image is filled in bands, to keep the temporary
+// interleaved pixels small
+void ReadImage(RGBA16FImageSoA &img, Imf::RgbaInputFile &file)
+{
+    Imath::Box2i dw = file.dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+
+    img.Alloc(width, height);
+    const int bandHeight = std::min(height, std::max(1, (1 << 16) / width));
+    std::vector<Imf::Rgba> halfPixels(static_cast<size_t>(width) * bandHeight);
+
+    for (int y = 0; y < height; y += bandHeight) {
+        const int count = std::min(bandHeight, height - y);
+        file.setFrameBuffer (&halfPixels[0] - dw.min.x -
+            static_cast<ptrdiff_t>(dw.min.y + y) * width, 1, width);
+        file.readPixels (dw.min.y + y, dw.min.y + y + count - 1);
+
+        const Imf::Rgba *halfPixel = &halfPixels[0];
+        uint16_t* r = img.GetScanlinePointer<RGBA16FImageSoA::R>(y);
+        uint16_t* g = img.GetScanlinePointer<RGBA16FImageSoA::G>(y);
+        uint16_t* b = img.GetScanlinePointer<RGBA16FImageSoA::B>(y);
+        uint16_t* a = img.GetScanlinePointer<RGBA16FImageSoA::A>(y);
+        for (int i = 0; i < width*count; ++i) {
+            r[i] = halfPixel[i].r.bits();
+            g[i] = halfPixel[i].g.bits();
+            b[i] = halfPixel[i].b.bits();
+            a[i] = halfPixel[i].a.bits();
+        }
+    }
+}
+
+
+
+// Version using the general purpose interface, assumes RGBA channels. The
+// half values are decoded straight into the image, whatever its scanline order
+template <ScanLineMode S>
+void ReadImage(Image<Rgba16F, S> &img, Imf::InputFile &file)
+{
+    Imath::Box2i dw = file.header().dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+
+    Imf::FrameBuffer framebuffer;
+    img.Alloc(width, height);
+    uint16_t *pixels =
+        reinterpret_cast<uint16_t*>(img.GetScanlinePointer(0, TopDown));
+    const ptrdiff_t yStride = S == TopDown ? 4*width : -4*width;
+    pixels -= 4*dw.min.x + dw.min.y*yStride;
+
+    // The components are in [r g b a] order
+    framebuffer.insert("R", newSlice(pixels,   4, yStride, 0.0, Imf::HALF));
+    framebuffer.insert("G", newSlice(pixels+1, 4, yStride, 0.0, Imf::HALF));
+    framebuffer.insert("B", newSlice(pixels+2, 4, yStride, 0.0, Imf::HALF));
+    framebuffer.insert("A", newSlice(pixels+3, 4, yStride, 1.0, Imf::HALF));
+
+    file.setFrameBuffer (framebuffer);
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+
+
+// Version using the general purpose interface, assumes RGBA channels (SoA)
+void ReadImage(RGBA16FImageSoA &img, Imf::InputFile &file)
+{
+    Imath::Box2i dw = file.header().dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+
+    Imf::FrameBuffer framebuffer;
+    img.Alloc(width, height);
+    const ptrdiff_t baseOffset = - (dw.min.x + dw.min.y*width);
+    uint16_t* r = img.GetDataPointer<RGBA16FImageSoA::R>() + baseOffset;
+    uint16_t* g = img.GetDataPointer<RGBA16FImageSoA::G>() + baseOffset;
+    uint16_t* b = img.GetDataPointer<RGBA16FImageSoA::B>() + baseOffset;
+    uint16_t* a = img.GetDataPointer<RGBA16FImageSoA::A>() + baseOffset;
+
+    framebuffer.insert("R", newSlice(r, 1, width, 0.0, Imf::HALF));
+    framebuffer.insert("G", newSlice(g, 1, width, 0.0, Imf::HALF));
+    framebuffer.insert("B", newSlice(b, 1, width, 0.0, Imf::HALF));
+    framebuffer.insert("A", newSlice(a, 1, width, 1.0, Imf::HALF));
+
+    file.setFrameBuffer (framebuffer);
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+
+
+// Views are filled in place, thus the file must have the same size
+inline void checkViewSize(const Imath::Box2i& dw, int width, int height)
+{
+    if (dw.max.x - dw.min.x + 1 != width ||
+        dw.max.y - dw.min.y + 1 != height) {
+        throw IOException("The size of the image does not match the view");
+    }
+}
+
+// Version using the general purpose interface for AoS views
+void ReadImage(const ImageView<Rgba32F, TopDown> &view, Imf::InputFile &file)
+{
+    Imath::Box2i dw = file.header().dataWindow();
+    checkViewSize(dw, view.Width(), view.Height());
+
+    // Same layout as in the Rgba32F images, with the stride of the view
+    float *pixels = reinterpret_cast<float *>(view.GetDataPointer());
+    const ptrdiff_t yStride = 4 * view.Stride();
+    pixels -= 4*dw.min.x + dw.min.y*yStride;
+
+    Imf::FrameBuffer framebuffer;
+    framebuffer.insert("R", newSlice(pixels+3, 4, yStride));
+    framebuffer.insert("G", newSlice(pixels+2, 4, yStride));
+    framebuffer.insert("B", newSlice(pixels+1, 4, yStride));
+    framebuffer.insert("A", newSlice(pixels,   4, yStride, 1.0));
+
+    file.setFrameBuffer (framebuffer);
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+// Version using the general purpose interface for SoA views
+void ReadImage(const RGBAImageSoAView &view, Imf::InputFile &file)
+{
+    Imath::Box2i dw = file.header().dataWindow();
+    checkViewSize(dw, view.Width(), view.Height());
+
+    const ptrdiff_t yStride = view.Stride();
+    const ptrdiff_t baseOffset = - (dw.min.x + dw.min.y*yStride);
+    float* r = view.GetDataPointer<RGBAImageSoAView::R>() + baseOffset;
+    float* g = view.GetDataPointer<RGBAImageSoAView::G>() + baseOffset;
+    float* b = view.GetDataPointer<RGBAImageSoAView::B>() + baseOffset;
+    float* a = view.GetDataPointer<RGBAImageSoAView::A>() + baseOffset;
+
+    Imf::FrameBuffer framebuffer;
+    framebuffer.insert("R", newSlice(r, 1, yStride));
+    framebuffer.insert("G", newSlice(g, 1, yStride));
+    framebuffer.insert("B", newSlice(b, 1, yStride));
+    framebuffer.insert("A", newSlice(a, 1, yStride, 1.0));
+
+    file.setFrameBuffer (framebuffer);
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+// Luminance/chroma files are decoded in bands, then widened into the views
+inline void fromHalf(const Imf::Rgba *src, Rgba32F *dest, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dest[i].set(src[i].r, src[i].g, src[i].b, src[i].a);
+    }
+}
+
+inline void fromHalf(const Imf::Rgba *src, const RGBAImageSoAView &view,
+    int row, int count)
+{
+    float* r = view.GetScanlinePointer<RGBAImageSoAView::R>(row);
+    float* g = view.GetScanlinePointer<RGBAImageSoAView::G>(row);
+    float* b = view.GetScanlinePointer<RGBAImageSoAView::B>(row);
+    float* a = view.GetScanlinePointer<RGBAImageSoAView::A>(row);
+    for (int i = 0; i < count; ++i) {
+        r[i] = src[i].r;
+        g[i] = src[i].g;
+        b[i] = src[i].b;
+        a[i] = src[i].a;
+    }
+}
+
+inline void fromHalf(const Imf::Rgba *src,
+    const ImageView<Rgba32F, TopDown> &view, int row, int count)
+{
+    fromHalf(src, view.GetScanlinePointer(row), count);
+}
+
+template <class ViewType>
+void ReadView(const ViewType &view, Imf::RgbaInputFile &file)
+{
+    Imath::Box2i dw = file.dataWindow();
+    checkViewSize(dw, view.Width(), view.Height());
+    const int width  = view.Width();
+    const int height = view.Height();
+
+    const int bandHeight = std::min(height, std::max(1, (1 << 16) / width));
+    std::vector<Imf::Rgba> halfPixels(static_cast<size_t>(width) * bandHeight);
+
+    for (int y = 0; y < height; y += bandHeight) {
+        const int count = std::min(bandHeight, height - y);
+        file.setFrameBuffer (&halfPixels[0] - dw.min.x -
+            static_cast<ptrdiff_t>(dw.min.y + y) * width, 1, width);
+        file.readPixels (dw.min.y + y, dw.min.y + y + count - 1);
+        for (int j = 0; j < count; ++j) {
+            fromHalf(&halfPixels[static_cast<size_t>(j) * width], view,
+                y + j, width);
+        }
+    }
+}
+
+inline void ReadImage(const ImageView<Rgba32F, TopDown> &view,
+    Imf::RgbaInputFile &file)
+{
+    ReadView(view, file);
+}
+
+inline void ReadImage(const RGBAImageSoAView &view, Imf::RgbaInputFile &file)
+{
+    ReadView(view, file);
+}
+
+
+
+inline MultiChannelImageSoA::PixelType toPixelType(Imf::PixelType type)
+{
+    switch (type) {
+    case Imf::UINT:  return MultiChannelImageSoA::UINT;
+    case Imf::HALF:  return MultiChannelImageSoA::HALF;
+    case Imf::FLOAT: return MultiChannelImageSoA::FLOAT;
+    default:
+        throw IOException("Unsupported pixel type");
+    }
+}
+
+inline MultiChannelImageSoA::Channel toChannel(const char *name,
+    const Imf::Channel &channel)
+{
+    if (channel.xSampling != 1 || channel.ySampling != 1) {
+        throw IOException(std::string("Subsampled channels are not "
+            "supported: ") + name);
+    }
+    return MultiChannelImageSoA::Channel(name, toPixelType(channel.type));
+}
+
+// Reads only the requested channels of the file, each one straight into
+// its own plane. Nothing else is decoded.
+void ReadChannels(MultiChannelImageSoA &img, Imf::InputFile &file,
+    const std::vector<std::string> &names)
+{
+    const Imf::ChannelList &fileChannels = file.header().channels();
+    MultiChannelImageSoA::ChannelList channels;
+    if (names.empty()) {
+        for (Imf::ChannelList::ConstIterator it = fileChannels.begin();
+             it != fileChannels.end(); ++it) {
+            channels.push_back(toChannel(it.name(), it.channel()));
+        }
+    } else {
+        for (size_t i = 0; i != names.size(); ++i) {
+            const Imf::Channel *c = fileChannels.findChannel(names[i].c_str());
+            if (c == NULL) {
+                throw IOException("The file does not have the channel " +
+                    names[i]);
+            }
+            channels.push_back(toChannel(names[i].c_str(), *c));
+        }
+    }
+    if (channels.empty()) {
+        throw IOException("The file does not have any channel");
+    }
+
+    Imath::Box2i dw = file.header().dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+    img.Alloc(width, height, channels);
+
+    Imf::FrameBuffer framebuffer;
+    const ptrdiff_t baseOffset =
+        -(dw.min.x + static_cast<ptrdiff_t>(dw.min.y) * width);
+    for (int i = 0; i != img.NumChannels(); ++i) {
+        const char *name = channels[i].name.c_str();
+        switch (channels[i].type) {
+        case MultiChannelImageSoA::UINT:
+            framebuffer.insert(name, newSlice(img.GetPlane<uint32_t>(i) +
+                baseOffset, 1, width, 0.0, Imf::UINT));
+            break;
+        case MultiChannelImageSoA::HALF:
+            framebuffer.insert(name, newSlice(img.GetPlane<uint16_t>(i) +
+                baseOffset, 1, width, 0.0, Imf::HALF));
+            break;
+        case MultiChannelImageSoA::FLOAT:
+            framebuffer.insert(name, newSlice(img.GetPlane<float>(i) +
+                baseOffset, 1, width, 0.0, Imf::FLOAT));
+            break;
+        }
+    }
+
+    file.setFrameBuffer (framebuffer);
+    file.readPixels (dw.min.y, dw.max.y);
+}
+
+// The source is either a file name or an Imf::IStream
+template <class Source>
+void LoadChannelsImpl(MultiChannelImageSoA &img, Source &source,
+    const std::vector<std::string> &names, int nThreads)
+{
+    try {
+        IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
+        Imf::InputFile file(source);
+        ReadChannels(img, file, names);
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+
+
 template <class ImageCls>
-void LoadImpl(ImageCls& img, std::istream &is, int nThreads = 0)
+void LoadImpl(ImageCls& img, Imf::IStream &stdis, int nThreads)
 {
     try {
         IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
-        StdIStream stdis(is);
         Imf::InputFile file(stdis);
         const Imf::ChannelList & channels = file.header().channels();
         const bool isYC = channels.findChannel("Y")  != NULL || 
@@ -322,6 +712,20 @@ void LoadImpl(ImageCls& img, std::istream &is, int nThreads = 0)
     }
 }
 
+template <class ImageCls>
+void LoadImpl(ImageCls& img, std::istream &is, int nThreads = 0)
+{
+    // Memory backed streams are read in place
+    pcg::MemoryStreamBuf *buf = pcg::MemoryStreamBuf::fromStream(is);
+    if (buf != NULL) {
+        MemoryIStream memis(*buf);
+        LoadImpl(img, memis, nThreads);
+    } else {
+        StdIStream stdis(is);
+        LoadImpl(img, stdis, nThreads);
+    }
+}
+
 template <class ImageCls>
 void LoadImpl(ImageCls& img,  const char *filename, int nThreads = 0)
 {
@@ -412,27 +816,121 @@ inline Imf::RgbaChannels getImfRgbaChannels(OpenEXRIO::RgbaChannels channels)
 
 
 
-// OStreamArgT should be either const char* or a subclass of Imf::Ostream
-template <typename ImgIterator, class OStreamArgT>
-void SaveImpl(const ImgIterator begin, OStreamArgT &ostreamArg,
-    int width, int height, pcg::ScanLineMode scanlineMode,
+// Number of scanlines compressed together by each method
+inline int linesPerBlock(Imf::Compression c)
+{
+    switch (c) {
+    case Imf::ZIP_COMPRESSION:
+    case Imf::PXR24_COMPRESSION:
+        return 16;
+    case Imf::PIZ_COMPRESSION:
+    case Imf::B44_COMPRESSION:
+    case Imf::B44A_COMPRESSION:
+    case Imf::DWAA_COMPRESSION:
+        return 32;
+    case Imf::DWAB_COMPRESSION:
+        return 256;
+    default:
+        return 1;
+    }
+}
+
+// Approximate number of pixels converted and written at once
+const int SAVE_BAND_PIXELS = 1 << 18;
+
+
+
+// Float to half conversions, with F16C when the processor supports it (see
+// OpenEXRIOPrivate.h). Rgba16F has the same layout as Imf::Rgba.
+inline void toHalf(const Rgba32F* src, Imf::Rgba* dest, int count)
+{
+    PCG_SIMD_DISPATCH(OpenEXRIO_ToHalf)(src,
+        reinterpret_cast<Rgba16F*>(dest), count);
+}
+
+// Converts and interleaves the planes of SoA pixels
+inline void toHalf(const float* r, const float* g, const float* b,
+                   const float* a, Imf::Rgba* dest, int count)
+{
+    PCG_SIMD_DISPATCH(OpenEXRIO_ToHalfSoA)(r, g, b, a,
+        reinterpret_cast<Rgba16F*>(dest), count);
+}
+
+// Converts the given rows of the image, in memory order
+template <ScanLineMode S>
+inline void toHalf(const Image<Rgba32F, S> &img, int row, int count,
+                   Imf::Rgba* dest)
+{
+    toHalf(img.GetDataPointer() + static_cast<size_t>(row) * img.Width(),
+        dest, count * img.Width());
+}
+
+inline void toHalf(const RGBAImageSoA &img, int row, int count,
+                   Imf::Rgba* dest)
+{
+    const size_t offset = static_cast<size_t>(row) * img.Width();
+    toHalf(img.GetDataPointer<RGBAImageSoA::R>() + offset,
+           img.GetDataPointer<RGBAImageSoA::G>() + offset,
+           img.GetDataPointer<RGBAImageSoA::B>() + offset,
+           img.GetDataPointer<RGBAImageSoA::A>() + offset,
+           dest, count * img.Width());
+}
+
+// Views convert scanline by scanline, as they may have any stride
+inline void toHalf(const ImageView<Rgba32F, TopDown> &view, int row, int count,
+                   Imf::Rgba* dest)
+{
+    for (int j = 0; j < count; ++j, dest += view.Width()) {
+        toHalf(view.GetScanlinePointer(row + j), dest, view.Width());
+    }
+}
+
+inline void toHalf(const RGBAImageSoAView &view, int row, int count,
+                   Imf::Rgba* dest)
+{
+    for (int j = 0; j < count; ++j, dest += view.Width()) {
+        toHalf(view.GetScanlinePointer<RGBAImageSoAView::R>(row + j),
+               view.GetScanlinePointer<RGBAImageSoAView::G>(row + j),
+               view.GetScanlinePointer<RGBAImageSoAView::B>(row + j),
+               view.GetScanlinePointer<RGBAImageSoAView::A>(row + j),
+               dest, view.Width());
+    }
+}
+
+// TBB functor to convert a band of rows into half
+template <class ImageType>
+class ToHalfFunctor
+{
+public:
+    ToHalfFunctor(const ImageType &img, int firstRow, Imf::Rgba* dest) :
+    m_img(img), m_firstRow(firstRow), m_dest(dest) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        toHalf(m_img, m_firstRow + range.begin(), range.end()-range.begin(),
+            m_dest + static_cast<size_t>(range.begin()) * m_img.Width());
+    }
+
+private:
+    const ImageType &m_img;
+    const int m_firstRow;
+    Imf::Rgba* m_dest;
+};
+
+
+
+// OStreamArgT should be either const char* or a subclass of Imf::Ostream.
+// The pixels are converted and written in bands of whole compression
+// blocks, so that the staging buffer does not grow with the image.
+template <class ImageType, class OStreamArgT>
+void SaveImpl(const ImageType &img, OStreamArgT &ostreamArg,
+    pcg::ScanLineMode scanlineMode,
     OpenEXRIO::Compression compression, OpenEXRIO::RgbaChannels rgbaChannels,
     int nThreads)
 {
     try {
         IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
-
-        // Temporal buffer to convert from our floating point pixels into half
-        Imf::Array2D<Imf::Rgba> halfPixels(width, height);
-        
-        Imf::Rgba *halfPixel = &halfPixels[0][0];
-        ImgIterator pixel = begin;
-        for(int i = 0; i < width*height; ++i, ++pixel, ++halfPixel) {
-            halfPixel->r = pixel->r();
-            halfPixel->g = pixel->g();
-            halfPixel->b = pixel->b();
-            halfPixel->a = pixel->a();
-        }
+        const int width  = img.Width();
+        const int height = img.Height();
 
         // Retrieve the compression type and the scanline order to use
         const Imf::Compression c   = getImfCompression(compression);
@@ -445,8 +943,29 @@ void SaveImpl(const ImgIterator begin, OStreamArgT &ostreamArg,
         // screen window center, screen window width, line order, compression
         Imf::Header hd (width, height, 1.0f, Imath::V2f(0.0f,0.0f), 1.0f, order, c);
         Imf::RgbaOutputFile file(ostreamArg, hd, cn);
-        file.setFrameBuffer(&halfPixels[0][0], 1, width);
-        file.writePixels(height);
+
+        const int blockLines = linesPerBlock(c);
+        const int numBlocks = std::max(1,
+            SAVE_BAND_PIXELS / (width * blockLines));
+        const int bandHeight = std::min(height, numBlocks * blockLines);
+        std::vector<Imf::Rgba> halfPixels(
+            static_cast<size_t>(width) * bandHeight);
+        const int grainSize = std::max(1, 16384 / width);
+
+        // The frame buffer row y is the memory row y, thus a decreasing
+        // line order writes the bands starting from the end of the image
+        for (int k = 0; k < height; k += bandHeight) {
+            const int count = std::min(bandHeight, height - k);
+            const int y0 = order == Imf::INCREASING_Y ? k : height - k - count;
+
+            ToHalfFunctor<ImageType> func(img, y0, &halfPixels[0]);
+            tbb::parallel_for(tbb::blocked_range<int>(0, count, grainSize),
+                func);
+
+            file.setFrameBuffer(&halfPixels[0] -
+                static_cast<ptrdiff_t>(y0) * width, 1, width);
+            file.writePixels(count);
+        }
     }
     catch (const Iex::BaseExc &e) {
         throw IOException(static_cast<const std::exception&>(e));
@@ -479,6 +998,10 @@ void OpenEXRIO::LoadHelper(Image<Rgba32F, TopDown> &img,  std::istream &is) {
     LoadImpl(img, is, numThreads);
 }
 
+void OpenEXRIO::LoadHelper(Image<Rgba32F, BottomUp> &img, const char *filename){
+    LoadImpl(img, filename, numThreads);
+}
+
 void OpenEXRIO::Load(RGBAImageSoA& img, const char* filename) {
     LoadImpl(img, filename, numThreads);
 }
@@ -487,12 +1010,66 @@ void OpenEXRIO::Load(RGBAImageSoA& img, std::istream& is) {
     LoadImpl(img, is, numThreads);
 }
 
+void OpenEXRIO::Load(Image<Rgba16F, TopDown> &img, const char *filename) {
+    LoadImpl(img, filename, numThreads);
+}
+
+void OpenEXRIO::Load(Image<Rgba16F, TopDown> &img, std::istream &is) {
+    LoadImpl(img, is, numThreads);
+}
+
+void OpenEXRIO::Load(Image<Rgba16F, BottomUp> &img, const char *filename) {
+    LoadImpl(img, filename, numThreads);
+}
+
+void OpenEXRIO::Load(RGBA16FImageSoA& img, const char* filename) {
+    LoadImpl(img, filename, numThreads);
+}
+
+void OpenEXRIO::Load(RGBA16FImageSoA& img, std::istream& is) {
+    LoadImpl(img, is, numThreads);
+}
+
+void OpenEXRIO::Load(const ImageView<Rgba32F, TopDown> &view,
+    const char *filename) {
+    LoadImpl(view, filename, numThreads);
+}
+
+void OpenEXRIO::Load(const ImageView<Rgba32F, TopDown> &view,
+    std::istream &is) {
+    LoadImpl(view, is, numThreads);
+}
+
+void OpenEXRIO::Load(const RGBAImageSoAView &view, const char *filename) {
+    LoadImpl(view, filename, numThreads);
+}
+
+void OpenEXRIO::Load(const RGBAImageSoAView &view, std::istream &is) {
+    LoadImpl(view, is, numThreads);
+}
+
+void OpenEXRIO::Load(MultiChannelImageSoA& img, const char* filename,
+    const std::vector<std::string>& channels) {
+    LoadChannelsImpl(img, filename, channels, numThreads);
+}
+
+void OpenEXRIO::Load(MultiChannelImageSoA& img, std::istream& is,
+    const std::vector<std::string>& channels) {
+    pcg::MemoryStreamBuf *buf = pcg::MemoryStreamBuf::fromStream(is);
+    if (buf != NULL) {
+        MemoryIStream memis(*buf);
+        LoadChannelsImpl(img, memis, channels, numThreads);
+    } else {
+        StdIStream stdis(is);
+        LoadChannelsImpl(img, stdis, channels, numThreads);
+    }
+}
+
 
 template<ScanLineMode S, class OStreamArgT>
 void OpenEXRIO::SaveHelper(const Image<Rgba32F, S> &img,  OStreamArgT &ostreamArg,
     Compression compression, RgbaChannels rgbaChannels) {
-    SaveImpl(img.GetDataPointer(), ostreamArg, img.Width(), img.Height(),
-        S, compression, rgbaChannels, numThreads);
+    SaveImpl(img, ostreamArg, S, compression, rgbaChannels, numThreads);
 }
 
 
@@ -538,13 +1115,223 @@ void OpenEXRIO::Save(const Image<Rgba32F, BottomUp> &img, const char *filename,
 void OpenEXRIO::Save(const RGBAImageSoA& img, std::ofstream &os,
     RgbaChannels rgbaChannels, Compression compression) {
     StdOFStream stdos(os);
-    RGBA32FScalarImageSoAIterator it=RGBA32FScalarImageSoAIterator::begin(img);
-    SaveImpl(it, stdos, img.Width(), img.Height(), img.GetMode(),
-        compression, rgbaChannels, numThreads);
+    SaveImpl(img, stdos, img.GetMode(), compression, rgbaChannels, numThreads);
 }
 void OpenEXRIO::Save(const RGBAImageSoA& img, const char* filename,
     RgbaChannels rgbaChannels, Compression compression) {
-    RGBA32FScalarImageSoAIterator it=RGBA32FScalarImageSoAIterator::begin(img);
-    SaveImpl(it, filename, img.Width(), img.Height(), img.GetMode(),
-        compression, rgbaChannels, numThreads);
+    SaveImpl(img, filename, img.GetMode(), compression, rgbaChannels,
+        numThreads);
+}
+
+void OpenEXRIO::Save(const ImageView<Rgba32F, TopDown> &view,
+    std::ofstream &os, RgbaChannels rgbaChannels, Compression compression) {
+    StdOFStream stdos(os);
+    SaveImpl(view, stdos, view.GetMode(), compression, rgbaChannels,
+        numThreads);
+}
+void OpenEXRIO::Save(const ImageView<Rgba32F, TopDown> &view,
+    const char* filename, RgbaChannels rgbaChannels, Compression compression) {
+    SaveImpl(view, filename, view.GetMode(), compression, rgbaChannels,
+        numThreads);
 }
+void OpenEXRIO::Save(const RGBAImageSoAView &view, std::ofstream &os,
+    RgbaChannels rgbaChannels, Compression compression) {
+    StdOFStream stdos(os);
+    SaveImpl(view, stdos, view.GetMode(), compression, rgbaChannels,
+        numThreads);
+}
+void OpenEXRIO::Save(const RGBAImageSoAView &view, const char* filename,
+    RgbaChannels rgbaChannels, Compression compression) {
+    SaveImpl(view, filename, view.GetMode(), compression, rgbaChannels,
+        numThreads);
+}
+
+
+
+// Streaming scanline access through the RGBA interface, which also takes
+// care of luminance/chroma files
+namespace pcg
+{
+namespace scanlineio_internal
+{
+
+class OpenEXRScanlineReader : public ScanlineReaderImpl
+{
+public:
+    OpenEXRScanlineReader(const char* filename) : m_file(NULL), m_next(0)
+    {
+        try {
+            IlmThread::ThreadPool::globalThreadPool().setNumThreads(
+                OpenEXRIO::numThreads);
+            m_file = new Imf::RgbaInputFile(filename);
+        }
+        catch (const Iex::BaseExc &e) {
+            throw IOException(static_cast<const std::exception&>(e));
+        }
+        m_dw = m_file->dataWindow();
+        m_width  = m_dw.max.x - m_dw.min.x + 1;
+        m_height = m_dw.max.y - m_dw.min.y + 1;
+    }
+
+    virtual ~OpenEXRScanlineReader() {
+        delete m_file;
+    }
+
+    virtual void read(Image<Rgba32F, TopDown>& band)
+    {
+        const Imf::Rgba *halfPixel = readHalf(band.Height());
+        Rgba32F *pixel = band.GetDataPointer();
+        for (int i = 0; i < band.Size(); ++i) {
+            pixel[i].set(halfPixel[i].r, halfPixel[i].g,
+                         halfPixel[i].b, halfPixel[i].a);
+        }
+    }
+
+    virtual void read(RGBAImageSoA& band)
+    {
+        const Imf::Rgba *halfPixel = readHalf(band.Height());
+        float* r = band.GetDataPointer<RGBAImageSoA::R>();
+        float* g = band.GetDataPointer<RGBAImageSoA::G>();
+        float* b = band.GetDataPointer<RGBAImageSoA::B>();
+        float* a = band.GetDataPointer<RGBAImageSoA::A>();
+        for (int i = 0; i < band.Size(); ++i) {
+            r[i] = halfPixel[i].r;
+            g[i] = halfPixel[i].g;
+            b[i] = halfPixel[i].b;
+            a[i] = halfPixel[i].a;
+        }
+    }
+
+private:
+    // Reads the next count scanlines into the half buffer
+    const Imf::Rgba* readHalf(int count)
+    {
+        m_halfPixels.resize(static_cast<size_t>(m_width) * count);
+        const int y0 = m_dw.min.y + m_next;
+        try {
+            // The frame buffer maps the first scanline of the band to y0
+            Imf::Rgba *base = &m_halfPixels[0] -
+                (m_dw.min.x + static_cast<ptrdiff_t>(y0) * m_width);
+            m_file->setFrameBuffer(base, 1, m_width);
+            m_file->readPixels(y0, y0 + count - 1);
+        }
+        catch (const Iex::BaseExc &e) {
+            throw IOException(static_cast<const std::exception&>(e));
+        }
+        m_next += count;
+        return &m_halfPixels[0];
+    }
+
+    Imf::RgbaInputFile* m_file;
+    Imath::Box2i m_dw;
+    int m_next;
+    std::vector<Imf::Rgba> m_halfPixels;
+};
+
+
+
+class OpenEXRScanlineWriter : public ScanlineWriterImpl
+{
+public:
+    OpenEXRScanlineWriter(const char* filename, int width, int height) :
+    m_file(NULL), m_width(width), m_next(0)
+    {
+        try {
+            IlmThread::ThreadPool::globalThreadPool().setNumThreads(
+                OpenEXRIO::numThreads);
+            Imf::Header hd (width, height, 1.0f, Imath::V2f(0.0f,0.0f), 1.0f,
+                Imf::INCREASING_Y, Imf::ZIP_COMPRESSION);
+            m_file = new Imf::RgbaOutputFile(filename, hd, Imf::WRITE_RGBA);
+        }
+        catch (const Iex::BaseExc &e) {
+            throw IOException(static_cast<const std::exception&>(e));
+        }
+    }
+
+    virtual ~OpenEXRScanlineWriter() {
+        delete m_file;
+    }
+
+    virtual void write(const Image<Rgba32F, TopDown>& band)
+    {
+        Imf::Rgba *halfPixel = halfBuffer(band.Height());
+        const Rgba32F *pixel = band.GetDataPointer();
+        for (int i = 0; i < band.Size(); ++i) {
+            halfPixel[i].r = pixel[i].r();
+            halfPixel[i].g = pixel[i].g();
+            halfPixel[i].b = pixel[i].b();
+            halfPixel[i].a = pixel[i].a();
+        }
+        writeHalf(band.Height());
+    }
+
+    virtual void write(const RGBAImageSoA& band)
+    {
+        Imf::Rgba *halfPixel = halfBuffer(band.Height());
+        const float* r = band.GetDataPointer<RGBAImageSoA::R>();
+        const float* g = band.GetDataPointer<RGBAImageSoA::G>();
+        const float* b = band.GetDataPointer<RGBAImageSoA::B>();
+        const float* a = band.GetDataPointer<RGBAImageSoA::A>();
+        for (int i = 0; i < band.Size(); ++i) {
+            halfPixel[i].r = r[i];
+            halfPixel[i].g = g[i];
+            halfPixel[i].b = b[i];
+            halfPixel[i].a = a[i];
+        }
+        writeHalf(band.Height());
+    }
+
+    virtual void close()
+    {
+        // The file is completed when the output file is destroyed
+        Imf::RgbaOutputFile* file = m_file;
+        m_file = NULL;
+        try {
+            delete file;
+        }
+        catch (const Iex::BaseExc &e) {
+            throw IOException(static_cast<const std::exception&>(e));
+        }
+    }
+
+private:
+    inline Imf::Rgba* halfBuffer(int count) {
+        m_halfPixels.resize(static_cast<size_t>(m_width) * count);
+        return &m_halfPixels[0];
+    }
+
+    void writeHalf(int count)
+    {
+        try {
+            Imf::Rgba *base = &m_halfPixels[0] -
+                static_cast<ptrdiff_t>(m_next) * m_width;
+            m_file->setFrameBuffer(base, 1, m_width);
+            m_file->writePixels(count);
+        }
+        catch (const Iex::BaseExc &e) {
+            throw IOException(static_cast<const std::exception&>(e));
+        }
+        m_next += count;
+    }
+
+    Imf::RgbaOutputFile* m_file;
+    const int m_width;
+    int m_next;
+    std::vector<Imf::Rgba> m_halfPixels;
+};
+
+
+
+ScanlineReaderImpl* newOpenEXRScanlineReader(const char* filename)
+{
+    return new OpenEXRScanlineReader(filename);
+}
+
+ScanlineWriterImpl* newOpenEXRScanlineWriter(const char* filename,
+    int width, int height)
+{
+    return new OpenEXRScanlineWriter(filename, width, height);
+}
+
+} // namespace scanlineio_internal
+} // namespace pcg
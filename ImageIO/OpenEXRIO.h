@@ -23,15 +23,28 @@
 #include "ImageIO.h"
 #include "Image.h"
 #include "Rgba32F.h"
+#include "Rgba16F.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 
 #include <istream>
+#include <string>
+#include <vector>
 
 namespace pcg {
 
+    namespace scanlineio_internal {
+        class OpenEXRScanlineReader;
+        class OpenEXRScanlineWriter;
+    }
+
     // The base class has only static methods
     class OpenEXRIO {
 
+        // The streaming scanline classes share the threading setup
+        friend class scanlineio_internal::OpenEXRScanlineReader;
+        friend class scanlineio_internal::OpenEXRScanlineWriter;
+
     public:
 
         // An enum for the different types of compression available when saving the file
@@ -70,27 +83,44 @@ namespace pcg {
         }
 
         static void Load(Image<Rgba32F, BottomUp> &img, const char *filename) {
-            // TODO Fix this lazy, lame method
-            Image<Rgba32F, TopDown> tmp;
-            LoadHelper(tmp, filename);
-            img.Alloc(tmp.Width(), tmp.Height());
-            
-            // Stupid copy!
-            for (int i = 0; i < img.Height(); ++i) {
-
-                const Rgba32F *src = tmp.GetScanlinePointer(i, BottomUp);
-                Rgba32F *dest = img.GetScanlinePointer(i, BottomUp);
-
-                for (int j = 0; j < img.Width(); ++j) {
-                    _mm_stream_ps((float*)dest[j], src[j]);
-                }
-            }
+            LoadHelper(img, filename);
         }
 
         static void IMAGEIO_API Load(RGBAImageSoA& img, std::istream& is);
 
         static void IMAGEIO_API Load(RGBAImageSoA& img, const char* filename);
 
+        // Half precision images keep the values exactly as stored in the file
+        static void IMAGEIO_API Load(Image<Rgba16F, TopDown> &img, const char *filename);
+
+        static void IMAGEIO_API Load(Image<Rgba16F, TopDown> &img, std::istream &is);
+
+        static void IMAGEIO_API Load(Image<Rgba16F, BottomUp> &img, const char *filename);
+
+        static void IMAGEIO_API Load(RGBA16FImageSoA& img, std::istream& is);
+
+        static void IMAGEIO_API Load(RGBA16FImageSoA& img, const char* filename);
+
+        // Views over external memory are filled in place. The file must have
+        // the same dimensions as the view, otherwise an IOException is thrown
+        static void IMAGEIO_API Load(const ImageView<Rgba32F, TopDown> &view, const char *filename);
+
+        static void IMAGEIO_API Load(const ImageView<Rgba32F, TopDown> &view, std::istream &is);
+
+        static void IMAGEIO_API Load(const RGBAImageSoAView &view, const char *filename);
+
+        static void IMAGEIO_API Load(const RGBAImageSoAView &view, std::istream &is);
+
+        // Loads only the named channels, each one into its own plane with
+        // the pixel type stored in the file. An empty list loads all the
+        // channels. Throws an IOException if a channel is not in the file or
+        // if it is subsampled, as the chroma channels of YC files.
+        static void IMAGEIO_API Load(MultiChannelImageSoA& img, const char* filename,
+            const std::vector<std::string>& channels = std::vector<std::string>());
+
+        static void IMAGEIO_API Load(MultiChannelImageSoA& img, std::istream& is,
+            const std::vector<std::string>& channels = std::vector<std::string>());
+
         // To save the images with a different scanline order we only set a flag!
         static void IMAGEIO_API Save(const Image<Rgba32F, TopDown> &img, std::ofstream& os,
             Compression compression = ZIP);
@@ -125,12 +155,23 @@ namespace pcg {
             Save(img, filename, WRITE_RGB, ZIP);
         }
 
+        // Save views over external memory
+        static void IMAGEIO_API Save(const ImageView<Rgba32F, TopDown> &view, std::ofstream& os,
+            RgbaChannels rgbaChannels, Compression compression = ZIP);
+        static void IMAGEIO_API Save(const ImageView<Rgba32F, TopDown> &view, const char* filename,
+            RgbaChannels rgbaChannels, Compression compression = ZIP);
+        static void IMAGEIO_API Save(const RGBAImageSoAView &view, std::ofstream& os,
+            RgbaChannels rgbaChannels, Compression compression = ZIP);
+        static void IMAGEIO_API Save(const RGBAImageSoAView &view, const char* filename,
+            RgbaChannels rgbaChannels, Compression compression = ZIP);
+
         // Lazily set the number of threads to use for OpenEXR IO
         static void IMAGEIO_API setNumThreads(int num);
 
     private:
         static void IMAGEIO_API LoadHelper(Image<Rgba32F, TopDown> &img, const char *filename);
         static void IMAGEIO_API LoadHelper(Image<Rgba32F, TopDown> &img, std::istream &is);
+        static void IMAGEIO_API LoadHelper(Image<Rgba32F, BottomUp> &img, const char *filename);
 
         // Declare the super utility functions for saving
         template <ScanLineMode S, class OStreamArgT>
@@ -0,0 +1,36 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Conversions to half used when saving OpenEXR files, defined in
+// OpenEXRHalf.cpp for each instruction set. The AVX2 kernels use the F16C
+// instructions, so they are picked at runtime like the others.
+
+#if !defined(PCG_OPENEXRIOPRIVATE_H)
+#define PCG_OPENEXRIOPRIVATE_H
+
+#include "Rgba32F.h"
+#include "Rgba16F.h"
+#include "SimdDispatch.h"
+
+// Rounds the Rgba32F pixels to the nearest half. Rgba16F has the same
+// layout as Imf::Rgba.
+PCG_SIMD_DECLARE(void, OpenEXRIO_ToHalf, (const pcg::Rgba32F *src,
+    pcg::Rgba16F *dest, int count))
+
+// Rounds and interleaves the pixels of the planes of SoA images
+PCG_SIMD_DECLARE(void, OpenEXRIO_ToHalfSoA, (const float *r, const float *g,
+    const float *b, const float *a, pcg::Rgba16F *dest, int count))
+
+#endif /* PCG_OPENEXRIOPRIVATE_H */
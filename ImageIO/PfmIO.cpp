@@ -14,6 +14,8 @@
 ============================================================================*/
 
 #include "PfmIO.h"
+#include "HdrScanlineIOPrivate.h"
+#include "MappedFile.h"
 
 #include <sstream>
 #include <fstream>
@@ -21,6 +23,12 @@
 #include <ctype.h>
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #if defined(_MSC_VER)
 #include <cstdlib>
 #endif
@@ -58,6 +66,12 @@ order(PfmIO::getNativeOrder())
 {
 }
 
+PfmIO::Header::Header(const RGBImageSoA &img) :
+isColor(true), width(img.Width()), height(img.Height()),
+order(PfmIO::getNativeOrder())
+{
+}
+
 PfmIO::Header::Header(std::istream &is)
 {
     {
@@ -122,157 +136,405 @@ void PfmIO::Header::write(std::ostream &os)
 
 namespace {
 
-// Helper class to wrap operations for SoA Images: it is non-thread safe
-class SoAHelper
+// Size of the blocks of scanlines used for the stream I/O
+const size_t PFM_BLOCK_SIZE = 1 << 22;
+
+// Approximate number of floats converted by each parallel task
+const size_t PFM_GRAIN_SIZE = 1 << 14;
+
+inline uint32_t swap32(uint32_t x)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong(x);
+#elif defined(__GNUC__)
+    return __builtin_bswap32(x);
+#else
+    return ((x << 24) & 0xFF000000u) |
+           ((x <<  8) & 0xFF0000u) |
+           ((x >>  8) & 0x00FFu) |
+           ((x >> 24) & 0xFFu);
+#endif
+}
+
+// Reverses the bytes of each 32-bit element using only SSE2
+inline __m128 swap32(__m128 v)
+{
+    __m128i x = _mm_castps_si128(v);
+    x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8),  _mm_srli_epi16(x, 8));
+    return _mm_castsi128_ps(x);
+}
+
+// The file data has no alignment guarantees, thus it is always accessed
+// through unaligned loads
+template <bool Swap>
+inline float loadFloat(const float* src)
 {
-    float * PCG_RESTRICT m_r;
-    float * PCG_RESTRICT m_g;
-    float * PCG_RESTRICT m_b;
-    float * PCG_RESTRICT m_a;
-    mutable size_t offset;
+    uint32_t bits;
+    memcpy(&bits, src, sizeof(bits));
+    if (Swap) {
+        bits = swap32(bits);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
 
-    SoAHelper() {}
+template <bool Swap>
+inline __m128 loadVec(const float* src)
+{
+    const __m128 v = _mm_loadu_ps(src);
+    return Swap ? swap32(v) : v;
+}
 
-public:
 
-    // Initialize from a scanline
-    static SoAHelper fromScanline(const RGBAImageSoA& img, int scanline,
-        pcg::ScanLineMode mode)
-    {
-        SoAHelper h;
-        h.m_r = img.GetScanlinePointer<RGBAImageSoA::R>(scanline, mode);
-        h.m_g = img.GetScanlinePointer<RGBAImageSoA::G>(scanline, mode);
-        h.m_b = img.GetScanlinePointer<RGBAImageSoA::B>(scanline, mode);
-        h.m_a = img.GetScanlinePointer<RGBAImageSoA::A>(scanline, mode);
-        h.offset = 0;
-        return h;
-    };
 
-    SoAHelper& operator[] (size_t offset) {
-        this->offset = offset;
-        return *this;
+// Expands RGB triplets into Rgba32F pixels with alpha set to 1. Notice that
+// the components of Rgba32F are stored as [a b g r].
+template <bool Swap>
+void rgbToRgba(Rgba32F* PCG_RESTRICT dest, const float* src, int count)
+{
+    __m128* PCG_RESTRICT out = reinterpret_cast<__m128*>(dest);
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, src += 12, out += 4) {
+        const __m128 v0 = loadVec<Swap>(src);   // r0 g0 b0 r1
+        const __m128 v1 = loadVec<Swap>(src+4); // g1 b1 r2 g2
+        const __m128 v2 = loadVec<Swap>(src+8); // b2 r3 g3 b3
+
+        __m128 t = _mm_shuffle_ps(one, v0, _MM_SHUFFLE(2,2,0,0));
+        out[0] = _mm_shuffle_ps(t, v0, _MM_SHUFFLE(0,1,2,0));
+
+        t = _mm_shuffle_ps(one, v1, _MM_SHUFFLE(1,1,0,0));
+        __m128 s = _mm_shuffle_ps(v1, v0, _MM_SHUFFLE(3,3,0,0));
+        out[1] = _mm_shuffle_ps(t, s, _MM_SHUFFLE(2,0,2,0));
+
+        t = _mm_shuffle_ps(one, v2, _MM_SHUFFLE(0,0,0,0));
+        out[2] = _mm_shuffle_ps(t, v1, _MM_SHUFFLE(2,3,2,0));
+
+        t = _mm_shuffle_ps(one, v2, _MM_SHUFFLE(3,3,0,0));
+        out[3] = _mm_shuffle_ps(t, v2, _MM_SHUFFLE(1,2,2,0));
+    }
+    for (; i < count; ++i, src += 3) {
+        dest[i].set(loadFloat<Swap>(src), loadFloat<Swap>(src+1),
+            loadFloat<Swap>(src+2));
     }
+}
 
-    const SoAHelper& operator[] (size_t offset) const {
-        this->offset = offset;
-        return *this;
+// Splits RGB triplets into separate planes, with alpha set to 1 unless the
+// alpha plane is NULL
+template <bool Swap>
+void rgbToSoA(float* PCG_RESTRICT r, float* PCG_RESTRICT g,
+              float* PCG_RESTRICT b, float* PCG_RESTRICT a,
+              const float* src, int count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, src += 12) {
+        const __m128 v0 = loadVec<Swap>(src);   // r0 g0 b0 r1
+        const __m128 v1 = loadVec<Swap>(src+4); // g1 b1 r2 g2
+        const __m128 v2 = loadVec<Swap>(src+8); // b2 r3 g3 b3
+
+        __m128 t = _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(3,3,0,0));
+        __m128 s = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1,1,2,2));
+        _mm_storeu_ps(r + i, _mm_shuffle_ps(t, s, _MM_SHUFFLE(2,0,2,0)));
+
+        t = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0,0,1,1));
+        s = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2,2,3,3));
+        _mm_storeu_ps(g + i, _mm_shuffle_ps(t, s, _MM_SHUFFLE(2,0,2,0)));
+
+        t = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1,1,2,2));
+        s = _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3,3,0,0));
+        _mm_storeu_ps(b + i, _mm_shuffle_ps(t, s, _MM_SHUFFLE(2,0,2,0)));
+
+        if (a != NULL) {
+            _mm_storeu_ps(a + i, one);
+        }
+    }
+    for (; i < count; ++i, src += 3) {
+        r[i] = loadFloat<Swap>(src);
+        g[i] = loadFloat<Swap>(src+1);
+        b[i] = loadFloat<Swap>(src+2);
+        if (a != NULL) {
+            a[i] = 1.0f;
+        }
     }
+}
 
-    void set(float red, float green, float blue, float alpha = 1.0) {
-        m_r[offset] = red;
-        m_g[offset] = green;
-        m_b[offset] = blue;
-        m_a[offset] = alpha;
+template <bool Swap>
+void grayToRgba(Rgba32F* PCG_RESTRICT dest, const float* src, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const float v = loadFloat<Swap>(src + i);
+        dest[i].set(v, v, v);
     }
+}
 
-    inline float r() const {
-        return m_r[offset];
+template <bool Swap>
+void grayToSoA(float* PCG_RESTRICT r, float* PCG_RESTRICT g,
+               float* PCG_RESTRICT b, float* PCG_RESTRICT a,
+               const float* src, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const float v = loadFloat<Swap>(src + i);
+        r[i] = g[i] = b[i] = v;
+        if (a != NULL) {
+            a[i] = 1.0f;
+        }
     }
-    inline float g() const {
-        return m_g[offset];
+}
+
+// Packs Rgba32F pixels into RGB triplets
+void rgbaToRgb(float* PCG_RESTRICT dest, const Rgba32F* src, int count)
+{
+    const __m128* PCG_RESTRICT in = reinterpret_cast<const __m128*>(src);
+    int i = 0;
+    for (; i + 4 <= count; i += 4, dest += 12, in += 4) {
+        const __m128 p0 = in[0], p1 = in[1], p2 = in[2], p3 = in[3];
+
+        __m128 s = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3,3,1,1));
+        _mm_storeu_ps(dest,   _mm_shuffle_ps(p0, s, _MM_SHUFFLE(2,0,2,3)));
+        _mm_storeu_ps(dest+4, _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2,3,1,2)));
+        s = _mm_shuffle_ps(p2, p3, _MM_SHUFFLE(3,3,1,1));
+        _mm_storeu_ps(dest+8, _mm_shuffle_ps(s, p3, _MM_SHUFFLE(1,2,2,0)));
     }
-    inline float b() const {
-        return m_b[offset];
+    for (; i < count; ++i, dest += 3) {
+        dest[0] = src[i].r();
+        dest[1] = src[i].g();
+        dest[2] = src[i].b();
     }
-};
+}
 
+// Interleaves the color planes into RGB triplets
+void soaToRgb(float* PCG_RESTRICT dest, const float* PCG_RESTRICT r,
+    const float* PCG_RESTRICT g, const float* PCG_RESTRICT b, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4, dest += 12) {
+        const __m128 vr = _mm_loadu_ps(r + i);
+        const __m128 vg = _mm_loadu_ps(g + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+
+        __m128 t = _mm_shuffle_ps(vr, vg, _MM_SHUFFLE(0,0,0,0));
+        __m128 u = _mm_shuffle_ps(vb, vr, _MM_SHUFFLE(1,1,0,0));
+        _mm_storeu_ps(dest,   _mm_shuffle_ps(t, u, _MM_SHUFFLE(2,0,2,0)));
+
+        t = _mm_shuffle_ps(vg, vb, _MM_SHUFFLE(1,1,1,1));
+        u = _mm_shuffle_ps(vr, vg, _MM_SHUFFLE(2,2,2,2));
+        _mm_storeu_ps(dest+4, _mm_shuffle_ps(t, u, _MM_SHUFFLE(2,0,2,0)));
+
+        t = _mm_shuffle_ps(vb, vr, _MM_SHUFFLE(3,3,2,2));
+        u = _mm_shuffle_ps(vg, vb, _MM_SHUFFLE(3,3,3,3));
+        _mm_storeu_ps(dest+8, _mm_shuffle_ps(t, u, _MM_SHUFFLE(2,0,2,0)));
+    }
+    for (; i < count; ++i, dest += 3) {
+        dest[0] = r[i];
+        dest[1] = g[i];
+        dest[2] = b[i];
+    }
+}
+
+
+
+// Converts one scanline from the file. The rows are indexed bottom-up, as
+// they are stored in the file.
 template <ScanLineMode S>
-Rgba32F*
-getScanlineIterator(const Image<Rgba32F, S> &img, int scanline, ScanLineMode m){
-    return img.GetScanlinePointer(scanline, m);
+void loadScanline(Image<Rgba32F, S> &img, int row, const float* src,
+                  bool swapBytes, bool isColor)
+{
+    Rgba32F* dest = img.GetScanlinePointer(row, BottomUp);
+    if (isColor) {
+        if (swapBytes) rgbToRgba<true> (dest, src, img.Width());
+        else           rgbToRgba<false>(dest, src, img.Width());
+    } else {
+        if (swapBytes) grayToRgba<true> (dest, src, img.Width());
+        else           grayToRgba<false>(dest, src, img.Width());
+    }
 }
 
-SoAHelper
-getScanlineIterator(const RGBAImageSoA &img, int scanline, ScanLineMode m) {
-    return SoAHelper::fromScanline(img, scanline, m);
+inline float* alphaScanline(RGBAImageSoA &img, int row)
+{
+    return img.GetScanlinePointer<RGBAImageSoA::A>(row, BottomUp);
 }
 
+inline float* alphaScanline(RGBImageSoA &, int)
+{
+    return NULL;
+}
 
+template <class ImageSoA>
+void loadScanline(ImageSoA &img, int row, const float* src,
+                  bool swapBytes, bool isColor)
+{
+    typedef typename ImageSoA::R R;
+    typedef typename ImageSoA::G G;
+    typedef typename ImageSoA::B B;
+    float* r = img.template GetScanlinePointer<R>(row, BottomUp);
+    float* g = img.template GetScanlinePointer<G>(row, BottomUp);
+    float* b = img.template GetScanlinePointer<B>(row, BottomUp);
+    float* a = alphaScanline(img, row);
+    if (isColor) {
+        if (swapBytes) rgbToSoA<true> (r, g, b, a, src, img.Width());
+        else           rgbToSoA<false>(r, g, b, a, src, img.Width());
+    } else {
+        if (swapBytes) grayToSoA<true> (r, g, b, a, src, img.Width());
+        else           grayToSoA<false>(r, g, b, a, src, img.Width());
+    }
+}
 
-template <class ImageIter, class ImageType>
-void PfmIO_Save_data(const ImageType &img, std::ostream &os)
+// Packs one scanline as RGB triplets, indexing the rows bottom-up
+template <ScanLineMode S>
+void storeScanline(const Image<Rgba32F, S> &img, int row, float* dest)
 {
-    // Allocate one full scanline
-    const size_t scanline_len = img.Width() * 3 * sizeof(float);
-    float *buffer = new float[scanline_len];
-
-    for (int i = 0; i < img.Height(); ++i) {
-        ImageIter it = getScanlineIterator(img, i, BottomUp);
-        for (int j = 0; j < img.Width(); ++j) {
-            const int idx = j*3;
-            buffer[idx]   = it[j].r();
-            buffer[idx+1] = it[j].g();
-            buffer[idx+2] = it[j].b();
-        }
-        os.write((const char*)buffer, scanline_len);
-        if (os.fail()) {
-            delete [] buffer;
-            throw PfmIOException("Couldn't write the scanline data");
+    rgbaToRgb(dest, img.GetScanlinePointer(row, BottomUp), img.Width());
+}
+
+template <class ImageSoA>
+void storeScanline(const ImageSoA &img, int row, float* dest)
+{
+    typedef typename ImageSoA::R R;
+    typedef typename ImageSoA::G G;
+    typedef typename ImageSoA::B B;
+    soaToRgb(dest,
+        img.template GetScanlinePointer<R>(row, BottomUp),
+        img.template GetScanlinePointer<G>(row, BottomUp),
+        img.template GetScanlinePointer<B>(row, BottomUp),
+        img.Width());
+}
+
+inline int grainSize(int width, int numChannels)
+{
+    return std::max(1, static_cast<int>(PFM_GRAIN_SIZE /
+        (static_cast<size_t>(width) * numChannels)));
+}
+
+
+
+// TBB functor to convert a block of consecutive scanlines from the file
+template <class ImageType>
+class LoadScanlinesFunctor
+{
+public:
+    LoadScanlinesFunctor(ImageType &img, int firstRow, const char* data,
+        bool swapBytes, bool isColor) :
+    m_img(img), m_firstRow(firstRow), m_data(data),
+    m_scanline_len(img.Width() * (isColor ? 3 : 1) * sizeof(float)),
+    m_swapBytes(swapBytes), m_isColor(isColor) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        for (int k = range.begin(); k != range.end(); ++k) {
+            const float* src = reinterpret_cast<const float*>(
+                m_data + k * m_scanline_len);
+            loadScanline(m_img, m_firstRow + k, src, m_swapBytes, m_isColor);
         }
     }
 
-    delete [] buffer;
+private:
+    ImageType &m_img;
+    const int m_firstRow;
+    const char* m_data;
+    const size_t m_scanline_len;
+    const bool m_swapBytes;
+    const bool m_isColor;
+};
+
+template <class ImageType>
+void loadScanlines(ImageType &img, int firstRow, int count, const char* data,
+                   bool swapBytes, bool isColor)
+{
+    LoadScanlinesFunctor<ImageType> func(img,firstRow,data,swapBytes,isColor);
+    tbb::parallel_for(tbb::blocked_range<int>(0, count,
+        grainSize(img.Width(), isColor ? 3 : 1)), func);
 }
 
-inline void swapByteOrder(unsigned int *ptr, int count)
+// TBB functor to pack a block of consecutive scanlines
+template <class ImageType>
+class StoreScanlinesFunctor
 {
-    for (int i = 0; i < count; ++i) {
-#if defined(_MSC_VER)
-        ptr[i] = _byteswap_ulong(ptr[i]);
-#elif defined(__GNUC__)
-        ptr[i] = __builtin_bswap32(ptr[i]);
-#else
-        ptr[i] = ((ptr[i] << 24) & 0xFF000000u) |
-                 ((ptr[i] <<  8) & 0xFF0000u) |
-                 ((ptr[i] >>  8) & 0x00FFu) |
-                 ((ptr[i] >> 24) & 0xFFu);
-#endif
+public:
+    StoreScanlinesFunctor(const ImageType &img, int firstRow, float* data) :
+    m_img(img), m_firstRow(firstRow), m_data(data) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        const size_t scanline_len = m_img.Width() * 3;
+        for (int k = range.begin(); k != range.end(); ++k) {
+            storeScanline(m_img, m_firstRow + k, m_data + k * scanline_len);
+        }
     }
+
+private:
+    const ImageType &m_img;
+    const int m_firstRow;
+    float* m_data;
+};
+
+template <class ImageType>
+void storeScanlines(const ImageType &img, int firstRow, int count, float* data)
+{
+    StoreScanlinesFunctor<ImageType> func(img, firstRow, data);
+    tbb::parallel_for(tbb::blocked_range<int>(0, count,
+        grainSize(img.Width(), 3)), func);
 }
 
 
 
+template <class ImageType>
+void PfmIO_Save_data(const ImageType &img, std::ostream &os)
+{
+    // Pack blocks of whole scanlines in parallel, then write them at once
+    const size_t scanline_len = img.Width() * 3 * sizeof(float);
+    const int blockHeight = std::min(img.Height(),
+        std::max(1, static_cast<int>(PFM_BLOCK_SIZE / scanline_len)));
+    std::vector<float> buffer(static_cast<size_t>(img.Width()) * 3 *
+        blockHeight);
+
+    for (int h = 0; h < img.Height(); h += blockHeight) {
+        const int count = std::min(blockHeight, img.Height() - h);
+        storeScanlines(img, h, count, &buffer[0]);
+        os.write((const char*)&buffer[0], count * scanline_len);
+        if (os.fail()) {
+            throw PfmIOException("Couldn't write the scanline data");
+        }
+    }
+}
+
+
 
 // Load function just for the data, assumes the istream is right
 // at the beginning of the pixels and the image has been allocated
-template <class ImageIter, class ImageType>
+template <class ImageType>
 void Pfm_Load_data(ImageType &img, std::istream &is, 
                    bool swapBytes, bool isColor)
 {
     const int numChannels = isColor ? 3 : 1;
-
-    // Allocate one full scanline
     const size_t scanline_len = img.Width() * numChannels * sizeof(float);
-    float *buffer = new float[scanline_len];
-    if (buffer == NULL) {
-        throw PfmIOException("Couldn't allocate the temporary buffer.");
-    }
 
-    for (int h = 0; h < img.Height(); ++h) {
-        is.read((char*)buffer, scanline_len);
-        if ( is.fail() ) {
-            delete [] buffer;
+    // Memory backed streams are converted in place
+    MemoryStreamBuf *mem = MemoryStreamBuf::fromStream(is);
+    if (mem != NULL) {
+        const size_t total = scanline_len * img.Height();
+        if (mem->available() < total) {
             throw PfmIOException("Couldn't read all the scanline data.");
         }
+        loadScanlines(img, 0, img.Height(), mem->current(),
+            swapBytes, isColor);
+        mem->consume(total);
+        return;
+    }
 
-        if (swapBytes) {
-            swapByteOrder((unsigned int *)buffer, img.Width() * numChannels);
-        }
+    // Otherwise read large blocks of whole scanlines
+    const int blockHeight = std::min(img.Height(),
+        std::max(1, static_cast<int>(PFM_BLOCK_SIZE / scanline_len)));
+    std::vector<char> buffer(scanline_len * blockHeight);
 
-        ImageIter it = getScanlineIterator(img, h, BottomUp);
-        if (isColor) {
-            for (int i = 0; i < img.Width(); ++i) {
-                const int idx = i*3;
-                it[i].set(buffer[idx], buffer[idx+1], buffer[idx+2]);
-            }
-        } else {
-            for (int i = 0; i < img.Width(); ++i) {
-                const float &v = buffer[i];
-                it[i].set(v,v,v);
-            }
+    for (int h = 0; h < img.Height(); h += blockHeight) {
+        const int count = std::min(blockHeight, img.Height() - h);
+        is.read(&buffer[0], count * scanline_len);
+        if ( is.fail() ) {
+            throw PfmIOException("Couldn't read all the scanline data.");
         }
+        loadScanlines(img, h, count, &buffer[0], swapBytes, isColor);
     }
-    delete [] buffer;
 }
 
 
@@ -311,21 +573,28 @@ void PfmIO::Save(const Image<Rgba32F, TopDown>  &img, std::ostream &os)
 {
     Header hdr(img);
     hdr.write(os);
-    PfmIO_Save_data<const Rgba32F*>(img, os);
+    PfmIO_Save_data(img, os);
 }
 
 void PfmIO::Save(const Image<Rgba32F, BottomUp>  &img, std::ostream &os)
 {
     Header hdr(img);
     hdr.write(os);
-    PfmIO_Save_data<const Rgba32F*>(img, os);
+    PfmIO_Save_data(img, os);
 }
 
 void PfmIO::Save(const RGBAImageSoA  &img, std::ostream &os)
 {
     Header hdr(img);
     hdr.write(os);
-    PfmIO_Save_data<const SoAHelper>(img, os);
+    PfmIO_Save_data(img, os);
+}
+
+void PfmIO::Save(const RGBImageSoA  &img, std::ostream &os)
+{
+    Header hdr(img);
+    hdr.write(os);
+    PfmIO_Save_data(img, os);
 }
 
 void PfmIO::Load(Image<Rgba32F, TopDown> &img, std::istream &is)
@@ -337,7 +606,7 @@ void PfmIO::Load(Image<Rgba32F, TopDown> &img, std::istream &is)
     img.Alloc(hdr.width, hdr.height);
 
     // Reads the pixels
-    Pfm_Load_data<Rgba32F*>(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
+    Pfm_Load_data(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
 }
 
 void PfmIO::Load(Image<Rgba32F, BottomUp> &img, std::istream &is)
@@ -349,7 +618,7 @@ void PfmIO::Load(Image<Rgba32F, BottomUp> &img, std::istream &is)
     img.Alloc(hdr.width, hdr.height);
 
     // Reads the pixels
-    Pfm_Load_data<Rgba32F*>(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
+    Pfm_Load_data(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
 }
 
 void PfmIO::Load(RGBAImageSoA &img, std::istream &is)
@@ -361,7 +630,19 @@ void PfmIO::Load(RGBAImageSoA &img, std::istream &is)
     img.Alloc(hdr.width, hdr.height);
 
     // Reads the pixels
-    Pfm_Load_data<SoAHelper>(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
+    Pfm_Load_data(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
+}
+
+void PfmIO::Load(RGBImageSoA &img, std::istream &is)
+{
+    // Read the header
+    Header hdr(is);
+
+    // Allocates the space
+    img.Alloc(hdr.width, hdr.height);
+
+    // Reads the pixels
+    Pfm_Load_data(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
 }
 
 
@@ -375,6 +656,9 @@ void PfmIO::Save(const Image<Rgba32F, BottomUp> &img, const char *filename) {
 void PfmIO::Save(const RGBAImageSoA &img, const char *filename) {
     PfmIO_Save_helper(img, filename);
 }
+void PfmIO::Save(const RGBImageSoA &img, const char *filename) {
+    PfmIO_Save_helper(img, filename);
+}
 
 
 void PfmIO::Load(Image<Rgba32F, TopDown>  &img, const char *filename) {
@@ -386,3 +670,150 @@ void PfmIO::Load(Image<Rgba32F, BottomUp> &img, const char *filename) {
 void PfmIO::Load(RGBAImageSoA &img, const char *filename) {
     PfmIO_Load_helper(img, filename);
 }
+void PfmIO::Load(RGBImageSoA &img, const char *filename) {
+    PfmIO_Load_helper(img, filename);
+}
+
+
+
+// Streaming scanline access. PFM files are stored bottom-up, so each band of
+// top-down scanlines is read from (or written to) its position in the file.
+namespace pcg
+{
+namespace scanlineio_internal
+{
+
+class PfmScanlineReader : public ScanlineReaderImpl
+{
+public:
+    PfmScanlineReader(const char* filename) :
+    m_is(filename, std::ios_base::binary), m_next(0)
+    {
+        if (m_is.fail()) {
+            throw PfmIOException((std::string)"Couldn't open the file " +
+                filename);
+        }
+        m_hdr = PfmIO::Header(m_is);
+        m_width  = m_hdr.width;
+        m_height = m_hdr.height;
+        m_dataStart = m_is.tellg();
+        m_swapBytes = m_hdr.order != PfmIO::getNativeOrder();
+    }
+
+    virtual void read(Image<Rgba32F, TopDown>& band) {
+        readBand(band);
+    }
+
+    virtual void read(RGBAImageSoA& band) {
+        readBand(band);
+    }
+
+private:
+    // The band is contiguous in the file, with its scanlines in reverse
+    // order, thus the file rows are the bottom-up rows of the band
+    template <class ImageType>
+    void readBand(ImageType& band)
+    {
+        const size_t scanline_len =
+            m_width * (m_hdr.isColor ? 3 : 1) * sizeof(float);
+        const int count = band.Height();
+        m_buffer.resize(scanline_len * count);
+
+        const std::streamoff firstRow = m_height - m_next - count;
+        m_is.seekg(m_dataStart +
+            firstRow * static_cast<std::streamoff>(scanline_len));
+        m_is.read(&m_buffer[0], m_buffer.size());
+        if (m_is.fail()) {
+            throw PfmIOException("Couldn't read all the scanline data.");
+        }
+        loadScanlines(band, 0, count, &m_buffer[0],
+            m_swapBytes, m_hdr.isColor);
+        m_next += count;
+    }
+
+    std::ifstream m_is;
+    PfmIO::Header m_hdr;
+    std::streamoff m_dataStart;
+    bool m_swapBytes;
+    int m_next;
+    std::vector<char> m_buffer;
+};
+
+
+
+class PfmScanlineWriter : public ScanlineWriterImpl
+{
+public:
+    PfmScanlineWriter(const char* filename, int width, int height) :
+    m_os(filename, std::ios_base::binary), m_next(0)
+    {
+        if (m_os.fail()) {
+            throw PfmIOException((std::string)"Couldn't save the file " +
+                filename);
+        }
+        m_hdr.width  = width;
+        m_hdr.height = height;
+        m_hdr.write(m_os);
+        m_dataStart = m_os.tellp();
+        if (m_os.fail()) {
+            throw PfmIOException("Couldn't write the header");
+        }
+    }
+
+    virtual void write(const Image<Rgba32F, TopDown>& band) {
+        writeBand(band);
+    }
+
+    virtual void write(const RGBAImageSoA& band) {
+        writeBand(band);
+    }
+
+    virtual void close()
+    {
+        m_os.close();
+        if (m_os.fail()) {
+            throw PfmIOException("Couldn't write the scanline data");
+        }
+    }
+
+private:
+    template <class ImageType>
+    void writeBand(const ImageType& band)
+    {
+        const size_t scanline_len = m_hdr.width * 3;
+        const int count = band.Height();
+        m_buffer.resize(scanline_len * count);
+        storeScanlines(band, 0, count, &m_buffer[0]);
+
+        const std::streamoff firstRow = m_hdr.height - m_next - count;
+        m_os.seekp(m_dataStart + firstRow *
+            static_cast<std::streamoff>(scanline_len * sizeof(float)));
+        m_os.write((const char*)&m_buffer[0], m_buffer.size() * sizeof(float));
+        if (m_os.fail()) {
+            throw PfmIOException("Couldn't write the scanline data");
+        }
+        m_next += count;
+    }
+
+    std::ofstream m_os;
+    PfmIO::Header m_hdr;
+    std::streamoff m_dataStart;
+    int m_next;
+    std::vector<float> m_buffer;
+};
+
+
+
+ScanlineReaderImpl* newPfmScanlineReader(const char* filename)
+{
+    return new PfmScanlineReader(filename);
+}
+
+ScanlineWriterImpl* newPfmScanlineWriter(const char* filename,
+    int width, int height)
+{
+    return new PfmScanlineWriter(filename, width, height);
+}
+
+} // namespace scanlineio_internal
+} // namespace pcg
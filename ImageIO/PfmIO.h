@@ -35,9 +35,18 @@ namespace pcg {
 
     PCG_DEFINE_EXC(PfmIOException, IOException)
 
+    namespace scanlineio_internal {
+        class PfmScanlineReader;
+        class PfmScanlineWriter;
+    }
+
     class PfmIO {
 
     private:
+        // The streaming scanline classes reuse the header
+        friend class scanlineio_internal::PfmScanlineReader;
+        friend class scanlineio_internal::PfmScanlineWriter;
+
         enum ByteOrder {
             LittleEndian,
             BigEndian
@@ -53,6 +62,7 @@ namespace pcg {
             Header(const Image<Rgba32F, TopDown> &img);
             Header(const Image<Rgba32F, BottomUp> &img);
             Header(const RGBAImageSoA &img);
+            Header(const RGBImageSoA &img);
             Header(std::istream &is);
 
             void write(std::ostream &os);
@@ -64,16 +74,20 @@ namespace pcg {
         static void IMAGEIO_API Load(Image<Rgba32F, TopDown>  &img, const char *filename);
         static void IMAGEIO_API Load(Image<Rgba32F, BottomUp> &img, const char *filename);
         static void IMAGEIO_API Load(RGBAImageSoA &img, const char *filename);
+        static void IMAGEIO_API Load(RGBImageSoA &img, const char *filename);
         static void IMAGEIO_API Load(Image<Rgba32F, TopDown>  &img, std::istream &is);
         static void IMAGEIO_API Load(Image<Rgba32F, BottomUp> &img, std::istream &is);
         static void IMAGEIO_API Load(RGBAImageSoA &img, std::istream &is);
+        static void IMAGEIO_API Load(RGBImageSoA &img, std::istream &is);
 
         static IMAGEIO_API void Save(const Image<Rgba32F, TopDown>  &img, std::ostream &os);
         static IMAGEIO_API void Save(const Image<Rgba32F, BottomUp> &img, std::ostream &os);
         static IMAGEIO_API void Save(const RGBAImageSoA &img, std::ostream &os);
+        static IMAGEIO_API void Save(const RGBImageSoA &img, std::ostream &os);
         static void IMAGEIO_API Save(const Image<Rgba32F, TopDown>  &img, const char *filename);
         static void IMAGEIO_API Save(const Image<Rgba32F, BottomUp> &img, const char *filename);
         static IMAGEIO_API void Save(const RGBAImageSoA &img, const char *filename);
+        static IMAGEIO_API void Save(const RGBImageSoA &img, const char *filename);
     };
 
 }
@@ -0,0 +1,177 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Parallel loops over the pixels of an ImageSoA which follow the placement
+// of its planes. When the allocator placed the pages (see
+// FirstTouchAllocator) each chunk of pixels runs as a single task, assigned
+// to its thread by the same partitioner which touched the pages, so that
+// every thread reads its local memory. Otherwise they are the plain TBB
+// loops over the whole range.
+
+#pragma once
+#if !defined(PCG_PLANECHUNKS_H)
+#define PCG_PLANECHUNKS_H
+
+#include "ImageSoA.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/partitioner.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+
+namespace pcg
+{
+
+// The iterators advance pixelsPerStep pixels per step from origin, the first
+// pixel of the image, or of a buffer with the same layout as its planes.
+template <typename Iter>
+class PlaneChunks
+{
+public:
+    // Ranges split by TBB
+    PlaneChunks() : m_img(NULL), m_origin(), m_pixelsPerStep(1) {}
+
+    // Ranges split as the pixels of img, which may be NULL
+    PlaneChunks(const ImageSoABase* img, Iter origin, ptrdiff_t pixelsPerStep) :
+    m_img(img != NULL && img->NumChunks() > 0 ? img : NULL),
+    m_origin(origin), m_pixelsPerStep(pixelsPerStep)
+    {
+        assert(pixelsPerStep > 0);
+    }
+
+    // Number of chunks, 0 if the ranges are split by TBB
+    int size() const {
+        return m_img != NULL ? m_img->NumChunks() : 0;
+    }
+
+    // Part of [begin, end) within the k-th chunk. The last chunk extends up
+    // to end, which may include the padding of the last vector.
+    tbb::blocked_range<Iter> chunk(int k, Iter begin, Iter end) const
+    {
+        assert(0 <= k && k < size());
+        const ptrdiff_t start = begin - m_origin;
+        const ptrdiff_t count = end - begin;
+        const ptrdiff_t first = m_img->ChunkBegin(k) / m_pixelsPerStep - start;
+        const ptrdiff_t last  = k + 1 != size() ?
+            m_img->ChunkBegin(k + 1) / m_pixelsPerStep - start : count;
+        const ptrdiff_t lo = std::min(std::max(first, ptrdiff_t(0)), count);
+        const ptrdiff_t hi = std::min(std::max(last,  lo), count);
+        return tbb::blocked_range<Iter>(begin + lo, begin + hi);
+    }
+
+    // Calls body(range) over [begin, end), as tbb::parallel_for
+    template <class Body>
+    void parallelFor(Iter begin, Iter end, size_t grainsize,
+        const Body& body) const
+    {
+        if (size() == 0) {
+            tbb::parallel_for(
+                tbb::blocked_range<Iter>(begin, end, grainsize), body);
+            return;
+        }
+        const ForChunks<Body> forChunks(*this, begin, end, body);
+        const tbb::blocked_range<int> chunks(0, size(), 1);
+#if TBB_INTERFACE_VERSION >= 9100
+        tbb::parallel_for(chunks, forChunks, tbb::static_partitioner());
+#else
+        tbb::parallel_for(chunks, forChunks, tbb::simple_partitioner());
+#endif
+    }
+
+    // Accumulates body(range) over [begin, end), as tbb::parallel_reduce.
+    // Body needs the splitting constructor and join.
+    template <class Body>
+    void parallelReduce(Iter begin, Iter end, size_t grainsize,
+        Body& body) const
+    {
+        if (size() == 0) {
+            tbb::parallel_reduce(
+                tbb::blocked_range<Iter>(begin, end, grainsize), body);
+            return;
+        }
+        ReduceChunks<Body> reduceChunks(*this, begin, end, body);
+        const tbb::blocked_range<int> chunks(0, size(), 1);
+#if TBB_INTERFACE_VERSION >= 9100
+        tbb::parallel_reduce(chunks, reduceChunks, tbb::static_partitioner());
+#else
+        tbb::parallel_reduce(chunks, reduceChunks, tbb::simple_partitioner());
+#endif
+        body.join(reduceChunks.body);
+    }
+
+private:
+    template <class Body>
+    struct ForChunks
+    {
+        ForChunks(const PlaneChunks& c, Iter b, Iter e, const Body& f) :
+        chunks(c), begin(b), end(e), body(f) {}
+
+        void operator() (const tbb::blocked_range<int>& range) const {
+            for (int k = range.begin(); k != range.end(); ++k) {
+                tbb::blocked_range<Iter> r = chunks.chunk(k, begin, end);
+                if (!r.empty()) {
+                    body(r);
+                }
+            }
+        }
+
+        const PlaneChunks& chunks;
+        const Iter begin;
+        const Iter end;
+        const Body& body;
+    };
+
+    // Starts from a split of the given body, joined back at the end
+    template <class Body>
+    struct ReduceChunks
+    {
+        ReduceChunks(const PlaneChunks& c, Iter b, Iter e, Body& f) :
+        chunks(c), begin(b), end(e), body(f, tbb::split()) {}
+
+        ReduceChunks(ReduceChunks& other, tbb::split) :
+        chunks(other.chunks), begin(other.begin), end(other.end),
+        body(other.body, tbb::split()) {}
+
+        void operator() (const tbb::blocked_range<int>& range) {
+            for (int k = range.begin(); k != range.end(); ++k) {
+                tbb::blocked_range<Iter> r = chunks.chunk(k, begin, end);
+                if (!r.empty()) {
+                    body(r);
+                }
+            }
+        }
+
+        void join(ReduceChunks& rhs) {
+            body.join(rhs.body);
+        }
+
+        const PlaneChunks& chunks;
+        const Iter begin;
+        const Iter end;
+        Body body;
+    };
+
+    const ImageSoABase* m_img;
+    Iter m_origin;
+    ptrdiff_t m_pixelsPerStep;
+};
+
+} // namespace pcg
+
+#endif // PCG_PLANECHUNKS_H
@@ -37,6 +37,27 @@
 namespace pcg {
 namespace pngio_internal {
 
+	// Sets up the color space and modification time chunks
+	void setInfoChunks(png_structp pngPtr, png_infop infoPtr,
+		const bool isSrgb, const float invGamma)
+	{
+		if (isSrgb) {
+			// From the png book, section 10.6:
+			// value 0 for perceptual, 1 for relative colorimetric, 
+			// 2 for saturation-preserving, and 3 for absolute colorimetric. 
+			png_set_sRGB_gAMA_and_cHRM(pngPtr, infoPtr, PNG_sRGB_INTENT_ABSOLUTE);
+		}
+		else {
+			png_set_gAMA(pngPtr, infoPtr, invGamma);
+		}
+
+		time_t modtime = time(NULL);
+		png_time pngtime;
+
+		png_convert_from_time_t(&pngtime, modtime);
+		png_set_tIME(pngPtr, infoPtr, &pngtime);
+	}
+
 	// invGamma is as used in the tone mapper: stored_value = actual_value^invGamma
 	template <typename T, ScanLineMode S>
 	void Save(const Image<T, S> &img, const char *filename, 
@@ -97,23 +118,7 @@ namespace pngio_internal {
 			PNG_FILTER_TYPE_DEFAULT);
 
 		// Add the info chunks
-		{
-			if (isSrgb) {
-				// From the png book, section 10.6:
-				// value 0 for perceptual, 1 for relative colorimetric, 
-				// 2 for saturation-preserving, and 3 for absolute colorimetric. 
-				png_set_sRGB_gAMA_and_cHRM(pngPtr, infoPtr, PNG_sRGB_INTENT_ABSOLUTE);
-			}
-			else {
-				png_set_gAMA(pngPtr, infoPtr, invGamma);
-			}
-
-			time_t modtime = time(NULL);
-			png_time pngtime;
-
-			png_convert_from_time_t(&pngtime, modtime);
-			png_set_tIME(pngPtr, infoPtr, &pngtime);
-		}
+		setInfoChunks(pngPtr, infoPtr, isSrgb, invGamma);
 
 		// Setup the scanlines pointers
 		png_bytep * rowPtr = new png_bytep[img.Height()];
@@ -215,3 +220,208 @@ void pcg::PngIO::Save(Image<Bgra8,BottomUp> &img,
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
 		PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_AFTER);
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Streaming scanline access
+///////////////////////////////////////////////////////////////////////////////
+
+namespace pcg {
+namespace pngio_internal {
+
+	struct ScanlineWriterState {
+		FILE *fp;
+		png_structp pngPtr;
+		png_infop infoPtr;
+
+		ScanlineWriterState() : fp(NULL), pngPtr(NULL), infoPtr(NULL) {}
+
+		~ScanlineWriterState() {
+			if (pngPtr != NULL) {
+				png_destroy_write_struct(&pngPtr, infoPtr != NULL ? &infoPtr : NULL);
+			}
+			if (fp != NULL) {
+				fclose(fp);
+			}
+		}
+	};
+
+	// The functions below return false upon a libpng error. Since libpng
+	// reports the errors through longjmp, they must not have any local
+	// objects with destructors.
+
+	bool writeHeader(png_structp pngPtr, png_infop infoPtr, FILE *fp,
+		int width, int height, bool bpp16, const bool isSrgb, const float invGamma)
+	{
+		if ( setjmp(png_jmpbuf(pngPtr)) ) {
+			return false;
+		}
+
+		png_init_io(pngPtr, fp);
+		png_set_IHDR(pngPtr, infoPtr, width, height, bpp16 ? 16 : 8, 
+			PNG_COLOR_TYPE_RGB, 
+			PNG_INTERLACE_NONE, 
+			PNG_COMPRESSION_TYPE_DEFAULT, 
+			PNG_FILTER_TYPE_DEFAULT);
+		setInfoChunks(pngPtr, infoPtr, isSrgb, invGamma);
+		png_write_info(pngPtr, infoPtr);
+
+		// Same transformations as PngIO::Save for Bgra8 and Rgba16 images
+		png_set_filler(pngPtr, 0, PNG_FILLER_AFTER);
+		if (!bpp16) {
+			png_set_bgr(pngPtr);
+		}
+		else if (isLittleEndian()) {
+			png_set_swap(pngPtr);
+		}
+		return true;
+	}
+
+	bool writeRows(png_structp pngPtr, const unsigned char *data,
+		size_t stride, int count)
+	{
+		if ( setjmp(png_jmpbuf(pngPtr)) ) {
+			return false;
+		}
+
+		for (int j = 0; j < count; ++j, data += stride) {
+			png_write_row(pngPtr, const_cast<png_bytep>(data));
+		}
+		return true;
+	}
+
+	bool writeEnd(png_structp pngPtr)
+	{
+		if ( setjmp(png_jmpbuf(pngPtr)) ) {
+			return false;
+		}
+
+		png_write_end(pngPtr, NULL);
+		return true;
+	}
+
+}} /* End of private namespace */
+
+
+
+pcg::PngScanlineWriter::PngScanlineWriter(const char *filename,
+	int width, int height, bool bpp16, const bool isSrgb, const float invGamma) :
+m_state(NULL), m_width(width), m_height(height), m_bpp16(bpp16), m_next(0)
+{
+	open(filename, isSrgb, invGamma);
+}
+
+pcg::PngScanlineWriter::PngScanlineWriter(const std::string &filename,
+	int width, int height, bool bpp16, const bool isSrgb, const float invGamma) :
+m_state(NULL), m_width(width), m_height(height), m_bpp16(bpp16), m_next(0)
+{
+	open(filename.c_str(), isSrgb, invGamma);
+}
+
+pcg::PngScanlineWriter::~PngScanlineWriter()
+{
+	delete m_state;
+}
+
+void pcg::PngScanlineWriter::open(const char *filename,
+	const bool isSrgb, const float invGamma)
+{
+	if (filename == NULL) {
+		throw IllegalArgumentException("The filename cannot be null.");
+	}
+	if (m_width <= 0 || m_height <= 0) {
+		throw IllegalArgumentException("Invalid image dimensions.");
+	}
+
+	pngio_internal::ScanlineWriterState *state =
+		new pngio_internal::ScanlineWriterState;
+#if defined(_MSC_VER) && _MSC_VER >= 1500
+	if (fopen_s(&state->fp, filename, "wb") != 0) {
+		state->fp = NULL;
+	}
+#else
+	state->fp = fopen(filename, "wb");
+#endif
+	if (state->fp == NULL) {
+		delete state;
+		throw IOException(std::string("Cannot open the file ") + filename);
+	}
+
+	state->pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (state->pngPtr != NULL) {
+		state->infoPtr = png_create_info_struct(state->pngPtr);
+	}
+	if (state->infoPtr == NULL) {
+		delete state;
+		throw RuntimeException("Error: Fail to create the png structures.");
+	}
+
+	if (!pngio_internal::writeHeader(state->pngPtr, state->infoPtr, state->fp,
+		m_width, m_height, m_bpp16, isSrgb, invGamma)) {
+		delete state;
+		throw IOException("Couldn't write the png header.");
+	}
+	m_state = state;
+}
+
+void pcg::PngScanlineWriter::checkBand(int bandWidth, int bandHeight,
+	bool bandBpp16) const
+{
+	if (m_state == NULL) {
+		throw IOException("The file is already closed.");
+	}
+	if (bandBpp16 != m_bpp16) {
+		throw IllegalArgumentException("The band does not match the bit depth.");
+	}
+	if (bandWidth != m_width) {
+		throw IllegalArgumentException("The band must have the same width "
+			"as the file.");
+	}
+	if (bandHeight > m_height - m_next) {
+		throw IllegalArgumentException("The band goes past the last scanline.");
+	}
+}
+
+void pcg::PngScanlineWriter::writeRows(const void *data, size_t stride,
+	int count)
+{
+	if (!pngio_internal::writeRows(m_state->pngPtr,
+		static_cast<const unsigned char*>(data), stride, count)) {
+		throw IOException("Couldn't write the png scanlines.");
+	}
+	m_next += count;
+}
+
+void pcg::PngScanlineWriter::Write(const Image<Bgra8,TopDown> &band)
+{
+	checkBand(band.Width(), band.Height(), false);
+	writeRows(band.GetDataPointer(), band.Width() * sizeof(Bgra8),
+		band.Height());
+}
+
+void pcg::PngScanlineWriter::Write(const Image<Rgba16,TopDown> &band)
+{
+	checkBand(band.Width(), band.Height(), true);
+	writeRows(band.GetDataPointer(), band.Width() * sizeof(Rgba16),
+		band.Height());
+}
+
+void pcg::PngScanlineWriter::Close()
+{
+	if (m_state == NULL) {
+		return;
+	}
+	if (m_next != m_height) {
+		throw IOException("Not all the scanlines have been written.");
+	}
+
+	const bool ok = pngio_internal::writeEnd(m_state->pngPtr);
+	FILE *fp = m_state->fp;
+	m_state->fp = NULL;
+	delete m_state;
+	m_state = NULL;
+	if (fclose(fp) != 0 || !ok) {
+		throw IOException("Couldn't finish the png file.");
+	}
+}
@@ -20,8 +20,14 @@
 #include "Image.h"
 #include "LDRPixels.h"
 
+#include <string>
+
 namespace pcg {
 
+	namespace pngio_internal {
+		struct ScanlineWriterState;
+	}
+
 	class PngIO {
 	public:
 
@@ -41,6 +47,66 @@ namespace pcg {
 			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
 	};
 
+
+	// Incremental writer of RGB png files, in bands of top-down scanlines, so
+	// that tone mapped images may be encoded without ever holding them whole.
+	// The 8-bit files take Bgra8 bands, the 16-bit ones Rgba16 bands; the
+	// alpha is dropped as in PngIO::Save.
+	class IMAGEIO_API PngScanlineWriter {
+	public:
+		// Creates the file and writes its header. Throws an IOException if
+		// the file cannot be created.
+		PngScanlineWriter(const char *filename, int width, int height,
+			bool bpp16, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+		PngScanlineWriter(const std::string &filename, int width, int height,
+			bool bpp16, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+
+		// Closes the file if it is still open, ignoring any error
+		~PngScanlineWriter();
+
+		inline int Width() const {
+			return m_width;
+		}
+
+		inline int Height() const {
+			return m_height;
+		}
+
+		inline bool IsBpp16() const {
+			return m_bpp16;
+		}
+
+		// Index of the next scanline to be written
+		inline int NextScanline() const {
+			return m_next;
+		}
+
+		// Writes the band as the next scanlines. The band must have the same
+		// width as the file, must not go past its last scanline and its
+		// pixels must match the bit depth of the file.
+		void Write(const Image<Bgra8,TopDown> &band);
+		void Write(const Image<Rgba16,TopDown> &band);
+
+		// Finishes the file. Throws an IOException if not all the scanlines
+		// were written.
+		void Close();
+
+	private:
+		// Non-copyable
+		PngScanlineWriter(const PngScanlineWriter&);
+		PngScanlineWriter& operator= (const PngScanlineWriter&);
+
+		void open(const char *filename, const bool isSrgb, const float invGamma);
+		void checkBand(int bandWidth, int bandHeight, bool bandBpp16) const;
+		void writeRows(const void *data, size_t stride, int count);
+
+		pngio_internal::ScanlineWriterState *m_state;
+		const int m_width;
+		const int m_height;
+		const bool m_bpp16;
+		int m_next;
+	};
+
 }
 
 #endif /* PCG_PNGIO_H */
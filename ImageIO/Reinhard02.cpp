@@ -33,12 +33,18 @@
 
 #include "Reinhard02.h"
 #include "ImageIterators.h"
+#include "PlaneChunks.h"
+#include "SimdDispatch.h"
 #include "Vec4f.h"
 #include "Vec4i.h"
 #if PCG_USE_AVX
 # include "Vec8f.h"
 # include "Vec8i.h"
 #endif
+#if PCG_USE_AVX512
+# include "Vec16f.h"
+# include "Vec16i.h"
+#endif
 
 #include <limits>
 #include <vector>
@@ -49,6 +55,21 @@
 #include <tbb/enumerable_thread_specific.h>
 
 
+// Entry points of the kernels for each instruction set. The luminance ones
+// fill Lw as LuminanceHelper does. When placement is not NULL the pixels and
+// Lw, which has the layout of a plane, are split in its chunks.
+PCG_SIMD_DECLARE(void, Reinhard02_LuminanceAoS, (const Rgba32F* pixels,
+    size_t count, float* Lw,
+    size_t* outZeroCount, float* outLmin, float* outLmax))
+PCG_SIMD_DECLARE(void, Reinhard02_LuminanceSoA, (float* r, float* g, float* b,
+    size_t count, float* Lw,
+    size_t* outZeroCount, float* outLmin, float* outLmax,
+    const ImageSoABase* placement))
+PCG_SIMD_DECLARE(Reinhard02::Params, Reinhard02_Estimate, (float* Lw,
+    size_t count, size_t zeroCount, float Lmin, float Lmax,
+    const ImageSoABase* placement))
+
+
 // Flag to use Intel's fast log routine. Very fast but has a terrible accuracy,
 // yet makes the whole process run about 4x faster (in MSVC++ 2008)
 #define USE_AM_LOG 0
@@ -112,7 +133,11 @@ namespace constants
 {
 
 // Writing manually the same constant many times is error prone
-#if PCG_USE_AVX
+#if PCG_USE_AVX512
+#define PCG_VEC_UNION(x) {x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x}
+typedef pcg::Vec16fUnion VecfUnion;
+typedef pcg::Vec16iUnion VeciUnion;
+#elif PCG_USE_AVX
 #define PCG_VEC_UNION(x) {x, x, x, x, x, x, x, x}
 typedef pcg::Vec8fUnion VecfUnion;
 typedef pcg::Vec8iUnion VeciUnion;
@@ -136,22 +161,25 @@ static const VecfUnion LUM_MINVAL = {PCG_VEC_UNION( float_limits::min() )};
 static const VeciUnion INT_ONE = {PCG_VEC_UNION( 1 )};
 static const VeciUnion MASK_NAN = {PCG_VEC_UNION( 0x7f800000 )};
 
-const Vec4f LUM_TAIL_MASKS_V4[3] = {
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0, 0, 0,-1>())),
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0, 0,-1,-1>())),
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0,-1,-1,-1>()))
+// Tail masks are plain unions (in memory order) so that they are constant
+// initialized: a Vec4f/Vec8f constructor would add a dynamic initializer
+// which, in the AVX variants, runs VEX instructions when the library loads
+static const pcg::Vec4iUnion LUM_TAIL_MASKS_V4[3] = {
+    {{-1, 0, 0, 0}},
+    {{-1,-1, 0, 0}},
+    {{-1,-1,-1, 0}}
 };
 
 #if PCG_USE_AVX
 static const VecfUnion LUM_MAXVAL = {PCG_VEC_UNION( float_limits::max() )};
-const Vec8f LUM_TAIL_MASKS_V8[7] = {
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0, 0, 0,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0, 0,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0,-1,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0,-1,-1,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0,-1,-1,-1,-1,-1,-1,-1>()))
+static const pcg::Vec8iUnion LUM_TAIL_MASKS_V8[7] = {
+    {{-1, 0, 0, 0, 0, 0, 0, 0}},
+    {{-1,-1, 0, 0, 0, 0, 0, 0}},
+    {{-1,-1,-1, 0, 0, 0, 0, 0}},
+    {{-1,-1,-1,-1, 0, 0, 0, 0}},
+    {{-1,-1,-1,-1,-1, 0, 0, 0}},
+    {{-1,-1,-1,-1,-1,-1, 0, 0}},
+    {{-1,-1,-1,-1,-1,-1,-1, 0}}
 };
 #endif
 
@@ -231,6 +259,20 @@ struct iterator_traits<RGBA32FVec8ImageSoAIterator>
 };
 #endif
 
+#if PCG_USE_AVX512
+template <>
+struct iterator_traits<RGBA32FVec16ImageSoAIterator>
+{
+    typedef Vec16f  vf;
+    typedef Vec16bf vbf;
+    typedef Vec16i  vi;
+
+    enum Constants {
+        VEC_LEN = 16
+    };
+};
+#endif
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -258,6 +300,17 @@ struct vector_traits<Vec8f>
 };
 #endif
 
+#if PCG_USE_AVX512
+template <>
+struct vector_traits<Vec16f>
+{
+    enum Constants {
+        VEC_LEN    = 16,
+        BLOCK_SIZE = 256
+    };
+};
+#endif
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -270,7 +323,8 @@ struct tail_mask_traits<Vec4f>
 {
     template <int tailElements>
     static inline const Vec4f& getTailMask() {
-        return constants::LUM_TAIL_MASKS_V4[tailElements-1];
+        return constants::get<Vec4f>(
+            constants::LUM_TAIL_MASKS_V4[tailElements-1]);
     }
 };
 
@@ -280,7 +334,8 @@ struct tail_mask_traits<Vec8f>
 {
     template <int tailElements>
     static inline const Vec8f& getTailMask() {
-        return constants::LUM_TAIL_MASKS_V8[tailElements-1];
+        return constants::get<Vec8f>(
+            constants::LUM_TAIL_MASKS_V8[tailElements-1]);
     }
 };
 #endif
@@ -295,14 +350,14 @@ inline const VecType& getTailMask() {
 template <>
 inline const Vec4f& getTailMask<Vec4f,0>() {
     assert("This should never be used" == 0);
-    return constants::LUM_TAIL_MASKS_V4[0];
+    return constants::get<Vec4f>(constants::LUM_TAIL_MASKS_V4[0]);
 }
 
 #if PCG_USE_AVX
 template <>
 inline const Vec8f& getTailMask<Vec8f,0>() {
     assert("This should never be used" == 0);
-    return constants::LUM_TAIL_MASKS_V8[0];
+    return constants::get<Vec8f>(constants::LUM_TAIL_MASKS_V8[0]);
 }
 #endif
 
@@ -398,6 +453,32 @@ inline Vec8f simd_log(const Vec8f& v) {
 
 
 
+#if PCG_USE_AVX512
+
+inline float horizontal_min(const float& x, const Vec16f& vec) {
+    return fminf(x, reduce_min(vec));
+}
+
+inline float horizontal_max(const float& x, const Vec16f& vec) {
+    return fmaxf(x, reduce_max(vec));
+}
+
+inline float horizontal_sum(const Vec16f& vec) {
+    return reduce_add(vec);
+}
+
+inline Vec16i truncate(const Vec16f& v) {
+    return _mm512_cvttps_epi32(v);
+}
+
+inline Vec16f simd_log(const Vec16f& v) {
+    return ssemath::log_avx512(v);
+}
+
+#endif // PCG_USE_AVX512
+
+
+
 // Little helper to extract RGB elements from an iterator
 template <class RGBIterator, typename VecT>
 inline void extractRGB(RGBIterator it, VecT &outR, VecT &outG, VecT &outB) {
@@ -511,6 +592,23 @@ inline Vec8i addMasked(const Vec8bf& testMask, const Vec8i& a, const Vec8i& b) {
 
 #endif // PCG_USE_AVX
 
+#if PCG_USE_AVX512
+
+inline Vec16bf getValidLuminanceMask(const Vec16f& Lw) {
+    // The ordered comparisons are false for NaN
+    const Vec16f MINVAL(constants::get<Vec16f>(constants::LUM_MINVAL));
+    const Vec16f MAXVAL(constants::get<Vec16f>(constants::LUM_MAXVAL));
+    return (Lw >= MINVAL) & (Lw <= MAXVAL);
+}
+
+// Adds one to the elements of a whose bit is set in the mask
+inline Vec16i addMasked(const Vec16bf& addMask, const Vec16i& a) {
+    return _mm512_mask_add_epi32(a, addMask, a,
+        _mm512_set1_epi32(1));
+}
+
+#endif // PCG_USE_AVX512
+
 
 
 // Helper functor to call a "process" function using only the needed cases
@@ -713,6 +811,118 @@ private:
 
 
 
+#if PCG_USE_AVX512
+
+// With AVX-512 the tail elements of the last vector block are handled with
+// opmask loads and stores instead of a specialization per tail count: the
+// elements past the end are neither read nor written.
+template <>
+struct LuminanceFunctor<RGBA32FVec16ImageSoAIterator>
+{
+    typedef RGBA32FVec16ImageSoAIterator SourceIterator;
+    typedef Vec16f  Vecf;
+    typedef Vec16bf Vecbf;
+    typedef Vec16i  Veci;
+
+    // Remember where the data starts
+    SourceIterator pixelsBegin;
+    SourceIterator pixelsEnd;
+
+    // Target luminance array
+    Vecf* const PCG_RESTRICT Lw;
+
+    // Number of tail elements (in the last vector component)
+    const size_t numTail;
+
+    // Data to be reduced
+    size_t zero_count;
+    float Lmin;
+    float Lmax;
+
+    // Constructor for the initial phase
+    LuminanceFunctor (SourceIterator begin, SourceIterator end, Vecf* Lw_,
+        size_t nTail) :
+    pixelsBegin(begin), pixelsEnd(end), Lw(Lw_), numTail(nTail), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity())
+    {
+        assert(numTail < 16);
+    }
+
+    // Constructor for each split
+    LuminanceFunctor (LuminanceFunctor& l, tbb::split) :
+    pixelsBegin(l.pixelsBegin), pixelsEnd(l.pixelsEnd), Lw(l.Lw),
+    numTail(l.numTail), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    // TBB method: joins this functor with the given one
+    void join (LuminanceFunctor& rhs)
+    {
+        zero_count += rhs.zero_count;
+        Lmin = fminf (Lmin, rhs.Lmin);
+        Lmax = fmaxf (Lmax, rhs.Lmax);
+    }
+
+    // Method invoked by TBB
+    void operator() (const tbb::blocked_range<SourceIterator> &range)
+    {
+        const bool hasTail = numTail != 0 && range.end() == pixelsEnd;
+        const Vecbf lastMask = Vecbf::first(hasTail ? numTail : 16);
+
+        // Offset for the output
+        Vecf* dest = Lw + (range.begin() - pixelsBegin);
+
+        // Initialize the working values
+        Vecf vec_min(Lmin);
+        Vecf vec_max(Lmax);
+        Veci vec_zero_count = Veci::zero();
+
+        // Internal copies of the global constants
+        const Vecf LUM_R(constants::get<Vecf>(constants::LUM_R));
+        const Vecf LUM_G(constants::get<Vecf>(constants::LUM_G));
+        const Vecf LUM_B(constants::get<Vecf>(constants::LUM_B));
+
+        for (SourceIterator it = range.begin(); it != range.end();
+             ++it, ++dest) {
+            const SourceIterator next = it + 1;
+            const Vecbf loadMask = next != range.end() ? Vecbf::first(16) :
+                lastMask;
+
+            // Raw luminance, with NaN and Inf
+            const Vecf pixelR = Vecf::load(
+                reinterpret_cast<const float*>(&it->r()), loadMask);
+            const Vecf pixelG = Vecf::load(
+                reinterpret_cast<const float*>(&it->g()), loadMask);
+            const Vecf pixelB = Vecf::load(
+                reinterpret_cast<const float*>(&it->b()), loadMask);
+            const Vecf Lw = LUM_R*pixelR + LUM_G*pixelG + LUM_B*pixelB;
+
+            // Write the valid luminance values, zero for the invalid ones
+            const Vecbf isValid = getValidLuminanceMask(Lw) & loadMask;
+            const Vecf validLw = _mm512_maskz_mov_ps(isValid, Lw);
+            store(reinterpret_cast<float*>(dest), loadMask, validLw);
+
+            // Update the min/max
+            vec_min = _mm512_mask_min_ps(vec_min, isValid, vec_min, Lw);
+            vec_max = _mm512_mask_max_ps(vec_max, isValid, vec_max, Lw);
+
+            // Update the zero count, only with the loaded elements
+            vec_zero_count = addMasked(andnot(isValid, loadMask),
+                vec_zero_count);
+        }
+
+        // Accumulate the totals for min, max and zero_count
+        Lmin = horizontal_min(Lmin, vec_min);
+        Lmax = horizontal_max(Lmax, vec_max);
+        zero_count += reduce_add(vec_zero_count);
+        assert(zero_count <= static_cast<size_t>((pixelsEnd - pixelsBegin) *
+            16));
+    }
+};
+
+#endif // PCG_USE_AVX512
+
+
+
 // Helper function to compact an array, moving all the zeros together.
 // Returns the position of the first non-zero element.
 // NOTE: The function assumes there is at least one zero in the array
@@ -749,12 +959,15 @@ size_t compactZeros (afloat_t * Lw, const size_t count)
 class AccumulateNoHistogramFunctor
 {
 public:
-#if !PCG_USE_AVX
-    typedef Vec4f Vecf;
-    typedef __m128i VecInt32;
-#else
+#if PCG_USE_AVX512
+    typedef Vec16f Vecf;
+    typedef __m512i VecInt32;
+#elif PCG_USE_AVX
     typedef Vec8f Vecf;
     typedef __m256i VecInt32;
+#else
+    typedef Vec4f Vecf;
+    typedef __m128i VecInt32;
 #endif
 
     // Current total
@@ -779,6 +992,10 @@ public:
     // Method invoked by TBB: accumulates the data for the subrange
     void operator() (const tbb::blocked_range<const Vecf*>& range)
     {
+#if PCG_USE_AVX512
+        const bool hasTail = m_numTail != 0 && range.end() == m_LwVecEnd;
+        process(range.begin(), range.end(), hasTail ? m_numTail : 16);
+#else
         if (m_numTail == 0 || range.end() != m_LwVecEnd) {
             process<0>(range.begin(), range.end());
         }
@@ -791,14 +1008,49 @@ public:
             TailProcess<vector_traits<Vecf>::VEC_LEN>::process(this,
                 bulkEnd, range.end(), m_numTail);
         }
+#endif
     }
 
 
-    // Helper function which handles everything
+    // Helper function which handles everything. The range is within the
+    // buffer which starts at Lw_origin, split as the chunks of placement.
     static float accumulate (const float * PCG_RESTRICT Lw,
-                             const float * PCG_RESTRICT Lw_end);
+                             const float * PCG_RESTRICT Lw_end,
+                             const float * Lw_origin,
+                             const ImageSoABase * placement);
 
 private:
+#if PCG_USE_AVX512
+    // The last vector has only validLast elements. The rest are loaded as
+    // one, so that their logarithm is zero.
+    inline void process(const Vecf* const PCG_RESTRICT begin,
+        const Vecf* const PCG_RESTRICT end, size_t validLast)
+    {
+        const Vecf ONE(1.0f);
+        const Vec16bf lastMask = Vec16bf::first(static_cast<int>(validLast));
+
+        // Prepare Kahan summation with 16 elements
+        Vecf vec_sum = Vecf::zero();
+        Vecf vec_c   = Vecf::zero();
+
+        for (const Vecf* it = begin; it != end; ++it) {
+            const Vec16bf loadMask = (it + 1 != end) ? Vec16bf::first(16) :
+                lastMask;
+            const Vecf vec_lum = _mm512_mask_load_ps(ONE, loadMask, it);
+            const Vecf vec_log_lum = simd_log(vec_lum);
+
+            // Update the sum with error compensation
+            const Vecf y = vec_log_lum - vec_c;
+            const Vecf t = vec_sum + y;
+            vec_c   = (t - vec_sum) - y;
+            vec_sum = t;
+        }
+
+        // Accumulate the horizontal result
+        const float L_sum_tmp = horizontal_sum(vec_sum);
+        m_Lsum += L_sum_tmp;
+    }
+#else
     friend struct TailProcess<vector_traits<Vecf>::VEC_LEN>;
 
     template <int tailElements>
@@ -830,6 +1082,7 @@ private:
         const float L_sum_tmp = horizontal_sum(vec_sum);
         m_Lsum += L_sum_tmp;
     }
+#endif // PCG_USE_AVX512
 
 
     // Remember where the data ends
@@ -844,7 +1097,9 @@ private:
 
 float 
 AccumulateNoHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
-                                          const float * PCG_RESTRICT Lw_end)
+                                          const float * PCG_RESTRICT Lw_end,
+                                          const float * Lw_origin,
+                                          const ImageSoABase * placement)
 {
     const size_t numElements = Lw_end - Lw;
     const size_t VEC_LEN   = vector_traits<Vecf>::VEC_LEN;
@@ -853,8 +1108,9 @@ AccumulateNoHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
         ((numElements + (VEC_LEN-1)) & ~(VEC_LEN-1)));
     AccumulateNoHistogramFunctor acc (LwVecEnd, numElements % VEC_LEN);
     
-    tbb::blocked_range<const Vecf*> range(LwVecBegin, LwVecEnd, 32/VEC_LEN);
-    tbb::parallel_reduce (range, acc);
+    const PlaneChunks<const Vecf*> chunks(placement,
+        reinterpret_cast<const Vecf*>(Lw_origin), VEC_LEN);
+    chunks.parallelReduce(LwVecBegin, LwVecEnd, 32/VEC_LEN, acc);
     return static_cast<float>(acc.Lsum());
 }
 
@@ -871,12 +1127,15 @@ struct AccumulateHistogramFunctor
     typedef std::vector<int, tbb::cache_aligned_allocator<int> > hist_t;
     typedef tbb::enumerable_thread_specific<hist_t> threadhist_t;
 
-#if !PCG_USE_AVX
-    typedef Vec4f Vecf;
-    typedef __m128i VecInt32;
-#else
+#if PCG_USE_AVX512
+    typedef Vec16f Vecf;
+    typedef __m512i VecInt32;
+#elif PCG_USE_AVX
     typedef Vec8f Vecf;
     typedef __m256i VecInt32;
+#else
+    typedef Vec4f Vecf;
+    typedef __m128i VecInt32;
 #endif
 
     // Structure to hold all the common parameters
@@ -961,6 +1220,10 @@ struct AccumulateHistogramFunctor
     // Method invoked by TBB: accumulates the data for the subrange
     void operator() (const tbb::blocked_range<const Vecf*>& range)
     {
+#if PCG_USE_AVX512
+        const bool hasTail = numTail != 0 && range.end() == LwVecEnd;
+        process(range.begin(), range.end(), hasTail ? numTail : 16);
+#else
         if (numTail == 0 || range.end() != LwVecEnd) {
             process<vector_traits<Vecf>::VEC_LEN>(range.begin(), range.end());
         }
@@ -973,17 +1236,85 @@ struct AccumulateHistogramFunctor
             TailProcess<vector_traits<Vecf>::VEC_LEN>::process(this,
                 bulkEnd, range.end(), numTail);
         }
+#endif
     }
 
 
-    // Helper function which handles everything
+    // Helper function which handles everything. The range is within the
+    // buffer which starts at Lw_origin, split as the chunks of placement.
     static float accumulate ( const float * PCG_RESTRICT Lw,
                               const float * PCG_RESTRICT Lw_end,
                               const float Lmin, const float Lmax,
-                              float &L1, float &L99);
+                              float &L1, float &L99,
+                              const float * Lw_origin,
+                              const ImageSoABase * placement);
 
 
 private:
+#if PCG_USE_AVX512
+    // The last vector has only validLast elements. The rest are loaded as
+    // one and left out of the histogram.
+    inline void process(const Vecf* const PCG_RESTRICT begin,
+        const Vecf* const PCG_RESTRICT end, size_t validLast)
+    {
+        hist_t & histogram = params.localHistogram();
+
+        // Local copies of the helper constants
+        const Vecf vec_res_factor(params.vec_res_factor);
+        const Vecf vec_Lmin_log(params.vec_Lmin_log);
+        const Vecf ONE(1.0f);
+        const Vec16bf lastMask = Vec16bf::first(static_cast<int>(validLast));
+
+        // Prepare Kahan summation with 16 elements
+        Vecf vec_sum = Vecf::zero();
+        Vecf vec_c   = Vecf::zero();
+
+        // Temporary storage for the indices
+        const size_t BLOCK_SIZE = vector_traits<Vecf>::BLOCK_SIZE;
+        union {
+            VecInt32 indices_vec[BLOCK_SIZE];
+            int32_t  indices_i32[16*BLOCK_SIZE];
+        } u;
+
+        for (const Vecf* it = begin; it != end;) {
+            const size_t numIter = std::min(static_cast<size_t>(end - it),
+                                            BLOCK_SIZE);
+            const bool isLastBlock = it + numIter == end;
+            for (size_t i = 0; i != numIter; ++i, ++it) {
+                const Vec16bf loadMask = (it + 1 != end) ?
+                    Vec16bf::first(16) : lastMask;
+                const Vecf vec_lum = _mm512_mask_load_ps(ONE, loadMask, it);
+                const Vecf vec_log_lum = simd_log(vec_lum);
+
+                // Update the sum with error compensation
+                const Vecf y = vec_log_lum - vec_c;
+                const Vecf t = vec_sum + y;
+                vec_c   = (t - vec_sum) - y;
+                vec_sum = t;
+
+                // Get the histogram bin indices
+                Vecf idx_temp = vec_res_factor * (vec_log_lum - vec_Lmin_log);
+                u.indices_vec[i] = truncate(idx_temp);
+            }
+
+            // Update the histogram
+            for (size_t i = 0; i != numIter; ++i) {
+                const int32_t* const indices_base = &u.indices_i32[16 * i];
+                const size_t numValid =
+                    (isLastBlock && i + 1 == numIter) ? validLast : 16;
+                for (size_t k = 0; k != numValid; ++k) {
+                    const int32_t& index = indices_base[k];
+                    assert (index >= 0 && index < (int32_t)histogram.size());
+                    ++histogram[index];
+                }
+            }
+        }
+
+        // Accumulate the horizontal result
+        const float L_sum_tmp = horizontal_sum(vec_sum);
+        L_sum += L_sum_tmp;
+    }
+#else
     friend struct TailProcess<vector_traits<Vecf>::VEC_LEN>;
 
     template <int validPerVector>
@@ -1048,6 +1379,7 @@ private:
         const float L_sum_tmp = horizontal_sum(vec_sum);
         L_sum += L_sum_tmp;
     }
+#endif // PCG_USE_AVX512
 };
 
 
@@ -1079,7 +1411,9 @@ float
 AccumulateHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
                                         const float * PCG_RESTRICT Lw_end,
                                         const float Lmin, const float Lmax,
-                                        float &L1, float &L99)
+                                        float &L1, float &L99,
+                                        const float * Lw_origin,
+                                        const ImageSoABase * placement)
 {
     AccumulateHistogramFunctor::Params params = 
         AccumulateHistogramFunctor::Params::init (Lmin, Lmax);
@@ -1091,8 +1425,9 @@ AccumulateHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
         ((numElements + (VEC_LEN-1)) & ~(VEC_LEN-1)));
     AccumulateHistogramFunctor acc (LwVecEnd, params, numElements % VEC_LEN);
     
-    tbb::blocked_range<const Vecf*> range(LwVecBegin, LwVecEnd, 32/VEC_LEN);
-    tbb::parallel_reduce (range, acc);
+    const PlaneChunks<const Vecf*> chunks(placement,
+        reinterpret_cast<const Vecf*>(Lw_origin), VEC_LEN);
+    chunks.parallelReduce(LwVecBegin, LwVecEnd, 32/VEC_LEN, acc);
 
     AccumulateHistogramFunctor::hist_t & histogram = params.flatHistogram();
     const float & Lmin_log = params.Lmin_log;
@@ -1178,14 +1513,17 @@ struct SumThresholdFunctor
 // Returns the accumulation of those log-luminances and stores the number
 // of elements added
 float sumBeyondThreshold(const float * Lw, const float * Lw_end,
-                         const float lum_cutoff, ptrdiff_t &removed_count)
+                         const float lum_cutoff, ptrdiff_t &removed_count,
+                         const float * Lw_origin,
+                         const ImageSoABase * placement)
 {
     const ptrdiff_t count = Lw_end - Lw;
     const ptrdiff_t threshold = static_cast<ptrdiff_t> (0.01 * count);
 
     // Run in parallel
     SumThresholdFunctor stf(lum_cutoff, threshold);
-    tbb::parallel_reduce(SumThresholdFunctor::range_t(Lw, Lw_end, 4), stf);
+    const PlaneChunks<const float*> chunks(placement, Lw_origin, 1);
+    chunks.parallelReduce(Lw, Lw_end, 4, stf);
     removed_count = stf.removed_count;
     return static_cast<float> (stf.removed_sum);
 }
@@ -1195,11 +1533,13 @@ float sumBeyondThreshold(const float * Lw, const float * Lw_end,
 // Helper to call the appropriate instantiation of the luminance helper:
 // Stores the luminance in the destination Lw array, zeroing invalid values.
 // Returns the count of zero values and the non-zero minimum and maximum 
-// luminance (in the same units as the original image)
+// luminance (in the same units as the original image). The pixels are split
+// in the chunks of placement, if not NULL.
 template <typename SourceIterator>
 void LuminanceHelper(SourceIterator begin, SourceIterator end,
     afloat_t * PCG_RESTRICT Lw, size_t tailElements,
-    size_t* outZeroCount, float* outLmin, float* outLmax)
+    size_t* outZeroCount, float* outLmin, float* outLmax,
+    const ImageSoABase* placement)
 {
     typedef typename iterator_traits<SourceIterator>::vf vf;
     const size_t VEC_LEN = iterator_traits<SourceIterator>::VEC_LEN;
@@ -1209,10 +1549,122 @@ void LuminanceHelper(SourceIterator begin, SourceIterator end,
     assert(tailElements < VEC_LEN);
 
     vf* const PCG_RESTRICT LwVec = reinterpret_cast<vf*>(Lw);
-    tbb::blocked_range<SourceIterator> range(begin, end, VEC_LEN);
+    const PlaneChunks<SourceIterator> chunks(placement, begin, VEC_LEN);
 
     LuminanceFunctor<SourceIterator> lumFunctor(begin,end,LwVec, tailElements);
-    tbb::parallel_reduce(range, lumFunctor);
+    chunks.parallelReduce(begin, end, VEC_LEN, lumFunctor);
+    *outZeroCount = lumFunctor.zero_count;
+    *outLmin      = lumFunctor.Lmin;
+    *outLmax      = lumFunctor.Lmax;
+}
+
+
+
+// Pixel accessors for the scanlines of views
+class AoSViewRows
+{
+public:
+    AoSViewRows(const Rgba32F* pixels, int width, ptrdiff_t stride) :
+    m_pixels(pixels), m_width(width), m_stride(stride) {}
+
+    inline int width() const { return m_width; }
+
+    inline void get(int j, int i, float& r, float& g, float& b) const {
+        const Rgba32F& p = m_pixels[m_stride*j + i];
+        r = p.r();
+        g = p.g();
+        b = p.b();
+    }
+
+private:
+    const Rgba32F* m_pixels;
+    const int m_width;
+    const ptrdiff_t m_stride;
+};
+
+class SoAViewRows
+{
+public:
+    SoAViewRows(const RGBAImageSoAView& view) : m_view(view) {}
+
+    inline int width() const { return m_view.Width(); }
+
+    inline void get(int j, int i, float& r, float& g, float& b) const {
+        r = m_view.GetScanlinePointer<RGBAImageSoAView::R>(j)[i];
+        g = m_view.GetScanlinePointer<RGBAImageSoAView::G>(j)[i];
+        b = m_view.GetScanlinePointer<RGBAImageSoAView::B>(j)[i];
+    }
+
+private:
+    const RGBAImageSoAView& m_view;
+};
+
+
+
+// TBB functor object to fill the array of luminances from the scanlines of a
+// view, with the same rules as LuminanceFunctor. Views are not padded, so the
+// pixels are read one at a time.
+template <class ViewRows>
+struct LuminanceRowsFunctor
+{
+    const ViewRows& rows;
+    float* const PCG_RESTRICT Lw;
+
+    // Data to be reduced
+    size_t zero_count;
+    float Lmin;
+    float Lmax;
+
+    LuminanceRowsFunctor (const ViewRows& r, float* Lw_) :
+    rows(r), Lw(Lw_), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    LuminanceRowsFunctor (LuminanceRowsFunctor& l, tbb::split) :
+    rows(l.rows), Lw(l.Lw), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    void join (LuminanceRowsFunctor& rhs)
+    {
+        zero_count += rhs.zero_count;
+        Lmin = fminf (Lmin, rhs.Lmin);
+        Lmax = fmaxf (Lmax, rhs.Lmax);
+    }
+
+    void operator() (const tbb::blocked_range<int> &range)
+    {
+        const int width = rows.width();
+        for (int j = range.begin(); j != range.end(); ++j) {
+            float * PCG_RESTRICT dest = Lw + static_cast<ptrdiff_t>(j)*width;
+            for (int i = 0; i != width; ++i) {
+                float r, g, b;
+                rows.get(j, i, r, g, b);
+                const float L = 0.27f*r + 0.67f*g + 0.06f*b;
+
+                // Same as getValidLuminanceMask: isnormal(L) && L > 0
+                if (L >= float_limits::min() && L <= float_limits::max()) {
+                    dest[i] = L;
+                    Lmin = fminf (Lmin, L);
+                    Lmax = fmaxf (Lmax, L);
+                } else {
+                    dest[i] = 0.0f;
+                    ++zero_count;
+                }
+            }
+        }
+    }
+};
+
+
+
+// Helper to fill the luminance array from the scanlines of a view, returning
+// the same values as LuminanceHelper
+template <class ViewRows>
+void LuminanceRowsHelper(const ViewRows& rows, int height,
+    afloat_t * PCG_RESTRICT Lw,
+    size_t* outZeroCount, float* outLmin, float* outLmax)
+{
+    LuminanceRowsFunctor<ViewRows> lumFunctor(rows, Lw);
+    tbb::parallel_reduce(tbb::blocked_range<int>(0, height), lumFunctor);
     *outZeroCount = lumFunctor.zero_count;
     *outLmin      = lumFunctor.Lmin;
     *outLmax      = lumFunctor.Lmax;
@@ -1222,23 +1674,62 @@ void LuminanceHelper(SourceIterator begin, SourceIterator end,
 
 
 
+void
+pcg::PCG_SIMD_NS::Reinhard02_LuminanceAoS (const Rgba32F * pixels,
+    size_t count, float * Lw,
+    size_t* outZeroCount, float* outLmin, float* outLmax)
+{
+    RGBA32FVec4ImageIterator begin(pixels);
+    RGBA32FVec4ImageIterator end(pixels + ((count + 3) & ~0x3));
+    const size_t numTail = count % 4;
+    LuminanceHelper(begin, end, Lw, numTail, outZeroCount, outLmin, outLmax,
+        NULL);
+}
+
+
+
+void
+pcg::PCG_SIMD_NS::Reinhard02_LuminanceSoA (float * r, float * g, float * b,
+    size_t count, float * Lw,
+    size_t* outZeroCount, float* outLmin, float* outLmax,
+    const ImageSoABase* placement)
+{
+#if PCG_USE_AVX512
+    typedef RGBA32FVec16ImageSoAIterator ImageIterator;
+#elif PCG_USE_AVX
+    typedef RGBA32FVec8ImageSoAIterator ImageIterator;
+#else
+    typedef RGBA32FVec4ImageSoAIterator ImageIterator;
+#endif
+    // The luminance does not depend on alpha, so the red plane stands in
+    const ptrdiff_t numVec = (count + iterator_traits<ImageIterator>::VEC_LEN
+        - 1) / iterator_traits<ImageIterator>::VEC_LEN;
+    ImageIterator begin = ImageIterator::begin(r, g, b, r);
+    ImageIterator end   = begin + numVec;
+    const size_t numTail = count % iterator_traits<ImageIterator>::VEC_LEN;
+    LuminanceHelper(begin, end, Lw, numTail, outZeroCount, outLmin, outLmax,
+        placement);
+}
+
+
+
 Reinhard02::Params
-Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
-    const LuminanceResult& lumResult)
+pcg::PCG_SIMD_NS::Reinhard02_Estimate (float * Lw, size_t count,
+    size_t zero_count, float Lmin, float Lmax,
+    const ImageSoABase* placement)
 {
-    assert (lumResult.zero_count <= count);
-    const size_t& zero_count = lumResult.zero_count;
-    const float& Lmin        = lumResult.Lmin;
-    const float& Lmax        = lumResult.Lmax;
+    assert (zero_count <= count);
 
     // Abort if all the values are zero
     if (zero_count == count) {
-        return Params(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        return Reinhard02::Params(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
     }
     const size_t nonzero_off = zero_count==0 ? 0 : compactZeros(Lw, count);
 
-    // If necessary move some elements to keep the 32-bytes alignment
-    const size_t nonzero_delta = nonzero_off & 0x7;
+    // If necessary move some elements to keep the vectors aligned
+    const size_t VEC_LEN =
+        vector_traits<AccumulateHistogramFunctor::Vecf>::VEC_LEN;
+    const size_t nonzero_delta = nonzero_off & (VEC_LEN-1);
     _mm_prefetch ((char*)(Lw + nonzero_off - nonzero_delta), _MM_HINT_T0);
     _mm_prefetch ((char*)(Lw + count - nonzero_delta), _MM_HINT_T0);
     afloat_t * Lw_nonzero = Lw + nonzero_off;
@@ -1256,8 +1747,9 @@ Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
     float L99 = Lmax_log;
     float L_sum = (Lmax_log - Lmin_log) > 5e-8 ?
         AccumulateHistogramFunctor::accumulate(Lw_nonzero, Lw_end,
-            Lmin, Lmax, L1, L99)
-      : AccumulateNoHistogramFunctor::accumulate(Lw_nonzero, Lw_end);
+            Lmin, Lmax, L1, L99, Lw, placement)
+      : AccumulateNoHistogramFunctor::accumulate(Lw_nonzero, Lw_end,
+            Lw, placement);
 
     // Remove the value from the logaritmic total L_sum 
     // if log(luminance) > L99_real ---> luminance > exp(L99_real)
@@ -1267,7 +1759,7 @@ Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
     ptrdiff_t removed_count = 0;
     const float lum_cutoff = expf (expf (L99));
     const float removed_sum = sumBeyondThreshold (Lw_nonzero, Lw_end,
-        lum_cutoff, removed_count);
+        lum_cutoff, removed_count, Lw, placement);
     L_sum -= removed_sum;
 
     // Average log luminance (equation 1 of the JGT paper)
@@ -1298,7 +1790,53 @@ Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
         l_white = std::max(0.125f * std::numeric_limits<float>::max(), l_w);
     }
    
-    return Params(key, l_white, l_w, Lmin, Lmax);
+    return Reinhard02::Params(key, l_white, l_w, Lmin, Lmax);
+}
+
+
+#if !PCG_SIMD_IS_VARIANT
+
+namespace
+{
+
+// Estimates the parameters from the planes of an image. When placement is
+// not NULL the kernels split the pixels in its chunks, the luminance buffer
+// thus gets the same placement as the planes.
+Reinhard02::Params
+EstimateParamsSoA (float * r, float * g, float * b, size_t count,
+    const ImageSoABase* placement)
+{
+    assert(r != NULL && g != NULL && b != NULL && count > 0);
+
+    // Allocate the array with the luminances with AVX-512 friendly alignment
+    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (64, (count+15) & ~0xF);  
+    if (Lw == NULL) {
+        throw RuntimeException("Couldn't allocate the memory for the "
+            "luminance buffer");
+    }
+    // Use a special auto pointer to get rid of the aligned buffer
+    auto_afloat_ptr Lw_autoptr (Lw);
+
+    // Compute the luminance
+    size_t zero_count;
+    float Lmin, Lmax;
+    PCG_SIMD_DISPATCH(Reinhard02_LuminanceSoA)(r, g, b, count, Lw,
+        &zero_count, &Lmin, &Lmax, placement);
+
+    // Estimate the values
+    return PCG_SIMD_DISPATCH(Reinhard02_Estimate)(Lw, count,
+        zero_count, Lmin, Lmax, placement);
+}
+
+} // namespace
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
+    const LuminanceResult& lumResult)
+{
+    return PCG_SIMD_DISPATCH(Reinhard02_Estimate)(Lw, count,
+        lumResult.zero_count, lumResult.Lmin, lumResult.Lmax, NULL);
 }
 
 
@@ -1308,8 +1846,8 @@ Reinhard02::EstimateParams (const Rgba32F * const pixels, size_t count)
     assert(pixels != NULL);   
     assert(reinterpret_cast<uintptr_t>(pixels) % 16 == 0);
 
-    // Allocate the array with the luminances with AVX[2]-friendly alignment
-    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (32, (count+7) & ~0x7);  
+    // Allocate the array with the luminances with AVX-512 friendly alignment
+    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (64, (count+15) & ~0xF);  
     if (Lw == NULL) {
         throw RuntimeException("Couldn't allocate the memory for the "
             "luminance buffer");
@@ -1318,11 +1856,8 @@ Reinhard02::EstimateParams (const Rgba32F * const pixels, size_t count)
     auto_afloat_ptr Lw_autoptr (Lw);
 
     // Compute the luminance
-    RGBA32FVec4ImageIterator begin(pixels);
-    RGBA32FVec4ImageIterator end(pixels + ((count + 3) & ~0x3));
-    const size_t numTail = count % 4;
     LuminanceResult lumResult;
-    LuminanceHelper(begin, end, Lw, numTail,
+    PCG_SIMD_DISPATCH(Reinhard02_LuminanceAoS)(pixels, count, Lw,
         &lumResult.zero_count, &lumResult.Lmin, &lumResult.Lmax);
 
     // Estimate the values
@@ -1337,10 +1872,74 @@ Reinhard02::EstimateParams (const RGBAImageSoA& img)
     if (img.Size() == 0) {
         throw IllegalArgumentException("Empty image");
     }
+    return EstimateParamsSoA(img.GetDataPointer<RGBAImageSoA::R>(),
+        img.GetDataPointer<RGBAImageSoA::G>(),
+        img.GetDataPointer<RGBAImageSoA::B>(),
+        static_cast<size_t>(img.Size()), &img);
+}
+
 
-    // Allocate the array with the luminances with AVX[2]-friendly alignment
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const RGBImageSoA& img)
+{
+    if (img.Size() == 0) {
+        throw IllegalArgumentException("Empty image");
+    }
+    return EstimateParamsSoA(img.GetDataPointer<RGBImageSoA::R>(),
+        img.GetDataPointer<RGBImageSoA::G>(),
+        img.GetDataPointer<RGBImageSoA::B>(),
+        static_cast<size_t>(img.Size()), &img);
+}
+
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (float * r, float * g, float * b, size_t count)
+{
+    return EstimateParamsSoA(r, g, b, count, NULL);
+}
+
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const Rgba32F * pixels, int width, int height,
+    ptrdiff_t stride)
+{
+    assert(pixels != NULL && width > 0 && height > 0);
+
+    // Allocate the array with the luminances with AVX-512 friendly alignment
+    const size_t count = static_cast<size_t>(width) * height;
+    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (64, (count+15) & ~0xF);  
+    if (Lw == NULL) {
+        throw RuntimeException("Couldn't allocate the memory for the "
+            "luminance buffer");
+    }
+    // Use a special auto pointer to get rid of the aligned buffer
+    auto_afloat_ptr Lw_autoptr (Lw);
+
+    // Compute the luminance
+    const AoSViewRows rows(pixels, width, stride);
+    LuminanceResult lumResult;
+    LuminanceRowsHelper(rows, height, Lw,
+        &lumResult.zero_count, &lumResult.Lmin, &lumResult.Lmax);
+
+    // Estimate the values
+    Params params = EstimateParams(Lw, count, lumResult);
+    return params;
+}
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const RGBAImageSoAView& img)
+{
+    if (img.Size() == 0) {
+        throw IllegalArgumentException("Empty image");
+    }
+
+    // Allocate the array with the luminances with AVX-512 friendly alignment
     const size_t count = static_cast<size_t>(img.Size());
-    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (32, (count+7) & ~0x7);  
+    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (64, (count+15) & ~0xF);  
     if (Lw == NULL) {
         throw RuntimeException("Couldn't allocate the memory for the "
             "luminance buffer");
@@ -1349,19 +1948,14 @@ Reinhard02::EstimateParams (const RGBAImageSoA& img)
     auto_afloat_ptr Lw_autoptr (Lw);
 
     // Compute the luminance
-#if !PCG_USE_AVX
-    typedef RGBA32FVec4ImageSoAIterator ImageIterator;
-#else
-    typedef RGBA32FVec8ImageSoAIterator ImageIterator;
-#endif
-    ImageIterator begin = ImageIterator::begin(img);
-    ImageIterator end   = ImageIterator::end(img);
-    const size_t numTail = count % iterator_traits<ImageIterator>::VEC_LEN;
+    const SoAViewRows rows(img);
     LuminanceResult lumResult;
-    LuminanceHelper(begin, end, Lw, numTail,
+    LuminanceRowsHelper(rows, img.Height(), Lw,
         &lumResult.zero_count, &lumResult.Lmin, &lumResult.Lmax);
 
     // Estimate the values
     Params params = EstimateParams(Lw, count, lumResult);
     return params;
 }
+
+#endif // !PCG_SIMD_IS_VARIANT
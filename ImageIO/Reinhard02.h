@@ -20,6 +20,7 @@
 #include "ImageIO.h"
 #include "Image.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "Rgba32F.h"
 
 namespace pcg
@@ -68,6 +69,22 @@ public:
 
     static IMAGEIO_API Params EstimateParams (const RGBAImageSoA& img);
 
+    // Opaque SoA images
+    static IMAGEIO_API Params EstimateParams (const RGBImageSoA& img);
+
+    // Views over external memory, only the pixels within the views are read
+    template <ScanLineMode S>
+    static Params EstimateParams (const ImageView<Rgba32F, S> &img)
+    {
+        if (img.Size() == 0) {
+            throw IllegalArgumentException("Empty image");
+        }
+        return EstimateParams (img.GetDataPointer(), img.Width(),
+            img.Height(), img.Stride());
+    }
+
+    static IMAGEIO_API Params EstimateParams (const RGBAImageSoAView& img);
+
 
 private:
 
@@ -83,6 +100,13 @@ private:
 
     static IMAGEIO_API Params
         EstimateParams (const Rgba32F * pixels, size_t count);
+
+    static IMAGEIO_API Params EstimateParams (const Rgba32F * pixels,
+        int width, int height, ptrdiff_t stride);
+
+    // Padded and aligned planes, as those of the SoA images
+    static IMAGEIO_API Params EstimateParams (float * r, float * g, float * b,
+        size_t count);
 };
 
 
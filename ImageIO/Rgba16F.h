@@ -0,0 +1,198 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// A structure which represents a RGBA pixel with half precision
+// (IEEE 754 binary16) components. It has the same layout as Imf::Rgba, so
+// OpenEXR files may be decoded straight into these pixels. Arithmetic is
+// meant to be done in single precision, after widening the values.
+
+#pragma once
+#if !defined (PCG_RGBA16F_H)
+#define PCG_RGBA16F_H
+
+#include "StdAfx.h"
+#include "ImageIO.h"
+#include "Rgba32F.h"
+
+#include <cstring>
+
+// F16C is available in all the AVX2 capable processors. Builds for older
+// processors only get it in the AVX2 variants of the dispatched kernels,
+// which are compiled with -mf16c (see SimdDispatch.h).
+#if !defined(PCG_USE_F16C)
+# if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#  define PCG_USE_F16C 1
+#  include <immintrin.h>
+# else
+#  define PCG_USE_F16C 0
+# endif
+#endif
+
+
+namespace pcg {
+
+// Converts the 4 binary16 values in the lower 64 bits to single precision.
+// Without F16C the exponent and mantissa are scaled by 2^112, which turns the
+// denormals into normal floats, then infinities and NaNs are patched.
+inline __m128 halfToFloat4(const __m128i h)
+{
+#if PCG_USE_F16C
+    return _mm_cvtph_ps(h);
+#else
+    const __m128i h32 = _mm_unpacklo_epi16(h, _mm_setzero_si128());
+    const __m128i expmant = _mm_and_si128(h32, _mm_set1_epi32(0x7fff));
+    const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h32, expmant), 16);
+    const __m128 scaled = _mm_mul_ps(
+        _mm_castsi128_ps(_mm_slli_epi32(expmant, 13)),
+        _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+    const __m128i infnan = _mm_and_si128(
+        _mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7bff)),
+        _mm_set1_epi32(0x7f800000));
+    return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infnan)));
+#endif
+}
+
+#if PCG_USE_AVX
+// Converts 8 binary16 values to single precision
+inline __m256 halfToFloat8(const __m128i h)
+{
+#if PCG_USE_F16C
+    return _mm256_cvtph_ps(h);
+#else
+    const __m128 lo = halfToFloat4(h);
+    const __m128 hi = halfToFloat4(_mm_unpackhi_epi64(h, h));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#endif
+}
+#endif // PCG_USE_AVX
+
+#if PCG_USE_AVX512
+// Converts 16 binary16 values to single precision. AVX-512 F includes the
+// F16C conversions for the 512-bit registers.
+inline __m512 halfToFloat16(const __m256i h)
+{
+    return _mm512_cvtph_ps(h);
+}
+#endif // PCG_USE_AVX512
+
+// Scalar binary16 to single precision conversion
+inline float halfToFloat(const uint16_t h)
+{
+    return _mm_cvtss_f32(halfToFloat4(_mm_cvtsi32_si128(h)));
+}
+
+// Single precision to binary16 conversion, rounding to nearest even.
+// Overflows become infinities and NaNs remain quiet NaNs.
+inline uint16_t floatToHalf(const float value)
+{
+#if PCG_USE_F16C
+    return static_cast<uint16_t>(_mm_cvtsi128_si32(
+        _mm_cvtps_ph(_mm_set_ss(value), _MM_FROUND_TO_NEAREST_INT)));
+#else
+    uint32_t f;
+    memcpy(&f, &value, sizeof(float));
+    const uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t h;
+    if (f >= 0x47800000u) {
+        // Too large for a half: infinity or NaN
+        h = f > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    } else if (f < 0x38800000u) {
+        // Denormal or zero: let the FPU do the rounding by adding 0.5
+        float tmp;
+        memcpy(&tmp, &f, sizeof(float));
+        tmp += 0.5f;
+        memcpy(&h, &tmp, sizeof(float));
+        h -= 0x3f000000u;
+    } else {
+        // Rebias the exponent and round the mantissa to nearest even
+        const uint32_t mantOdd = (f >> 13) & 1;
+        f += 0xc8000fffu + mantOdd;
+        h = f >> 13;
+    }
+    return static_cast<uint16_t>(h | (sign >> 16));
+#endif
+}
+
+
+
+struct Rgba16F {
+
+    // Raw binary16 components, in the same order as Imf::Rgba
+    uint16_t rBits;
+    uint16_t gBits;
+    uint16_t bBits;
+    uint16_t aBits;
+
+    // Default constructor. It does nothing and therefore it contains trash!
+    Rgba16F() {}
+
+    // Construct from explicit values, rounding to the nearest half
+    Rgba16F(const float r, const float g, const float b, const float a = 1.0f)
+    {
+        set(r, g, b, a);
+    }
+
+    // Rounds the full precision pixel to the nearest half
+    explicit Rgba16F(const Rgba32F &p)
+    {
+        set(p.r(), p.g(), p.b(), p.a());
+    }
+
+    // Components widened to single precision (read only)
+    inline float r() const { return halfToFloat(rBits); }
+    inline float g() const { return halfToFloat(gBits); }
+    inline float b() const { return halfToFloat(bBits); }
+    inline float a() const { return halfToFloat(aBits); }
+
+    // Sets the components, rounding to the nearest half
+    inline void set(const float r, const float g, const float b,
+        const float a = 1.0f)
+    {
+        rBits = floatToHalf(r);
+        gBits = floatToHalf(g);
+        bBits = floatToHalf(b);
+        aBits = floatToHalf(a);
+    }
+
+    // Widens the pixel to single precision
+    inline Rgba32F toRgba32F() const
+    {
+        const __m128 v = halfToFloat4(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(this)));
+        return Rgba32F(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0,1,2,3)));
+    }
+
+    // Bitwise equality
+    inline bool operator== (const Rgba16F &p) const {
+        return rBits == p.rBits && gBits == p.gBits &&
+               bBits == p.bBits && aBits == p.aBits;
+    }
+
+    inline bool operator!= (const Rgba16F &p) const {
+        return !(*this == p);
+    }
+
+    friend std::ostream& operator<<(std::ostream & os, const Rgba16F &p)
+    {
+        os << p.toRgba32F();
+        return os;
+    }
+};
+
+} // namespace pcg
+
+#endif /* PCG_RGBA16F_H */
@@ -42,13 +42,19 @@
 
 #include "RgbeIO.h"
 #include "RgbeIOPrivate.h"
+#include "HdrScanlineIOPrivate.h"
+#include "MappedFile.h"
 #include "Exception.h"
-#include "Vec4f.h"
-#include "Vec4i.h"
+#include "SimdDispatch.h"
 
 #include <string.h>
 #include <fstream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 using namespace pcg;
 
@@ -197,12 +203,11 @@ int rgbeions::readHeader(istream &is, int &width, int &height, rgbe_header_info
 /* Run length encoding adds considerable complexity but does */
 /* save some space.  For each scanline, each channel (r,g,b,e) is */
 /* encoded separately for better compression. */
-int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbytes)
+void rgbeions::encodeBytes_RLE(std::vector<unsigned char> &out,
+							   const unsigned char *data, int numbytes)
 {
 	int cur, beg_run, run_count, old_run_count, nonrun_count;
-	unsigned char buf[2];
 	const int MINRUNLENGTH = 4;
-	const char *bufC = reinterpret_cast<char*>(&buf[0]);	// To make os.write() happy
 
 	cur = 0;
 	while(cur < numbytes) {
@@ -219,11 +224,8 @@ int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbyte
 		}
 		/* if data before next big run is a short run then write it as such */
 		if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
-			buf[0] = 128 + old_run_count;   /*write short run*/
-			buf[1] = data[cur];
-			os.write(bufC, 2);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(128 + old_run_count));   /*write short run*/
+			out.push_back(data[cur]);
 			cur = beg_run;
 		}
 		/* write out bytes until we reach the start of the next run */
@@ -231,26 +233,17 @@ int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbyte
 			nonrun_count = beg_run - cur;
 			if (nonrun_count > 128) 
 				nonrun_count = 128;
-			buf[0] = nonrun_count;
-			os.write(bufC, 1);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
-			os.write(reinterpret_cast<const char*>(&data[cur]), nonrun_count);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(nonrun_count));
+			out.insert(out.end(), &data[cur], &data[cur] + nonrun_count);
 			cur += nonrun_count;
 		}
 		/* write out next run if one was found */
 		if (run_count >= MINRUNLENGTH) {
-			buf[0] = 128 + run_count;
-			buf[1] = data[beg_run];
-			os.write(bufC, 2);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(128 + run_count));
+			out.push_back(data[beg_run]);
 			cur += run_count;
 		}
 	}
-	return RGBE_RETURN_SUCCESS;
 }
 
 
@@ -263,172 +256,340 @@ namespace pcg {
 		// ####         READING         #######################################
 		// ####################################################################
 		
-		// Forward declaration
-		template <class T>
-		int readPixels_RLE(istream&, T*, int, int);
+		// Helper which reads the stream in large blocks, so that the pixels
+		// are parsed from memory instead of issuing a tiny istream::read call
+		// for each run. When it goes out of scope the bytes which were read
+		// ahead but not consumed are returned to the stream if it is seekable.
+		class BlockReader {
+		public:
+			BlockReader(istream &is, size_t blockSize) :
+			m_is(is), m_mem(MemoryStreamBuf::fromStream(is)),
+			m_blockSize(blockSize), m_pos(0), m_end(0), m_eof(false) {}
+
+			~BlockReader() {
+				if (m_mem != NULL || m_is.bad()) {
+					return;
+				}
+				m_is.clear();
+				const std::streamoff pending = static_cast<std::streamoff>(m_end - m_pos);
+				if (pending != 0) {
+					m_is.seekg(-pending, ios_base::cur);
+					m_is.clear();
+				}
+			}
 
-		// The basic utility methods for loading from an RGBE file which has
-		// already been successfully open. This handles the general case by going line by line
-		template < class T, ScanLineMode S >
-		int read(istream &is, Image<T,S> &img)
-		{
-			const int width  = img.Width();
-			const int height = img.Height();
-			for (int j = 0; j < height; ++j) {
+			// Tries to have at least n bytes available, reading a new block
+			// from the stream if required. Returns the number of bytes
+			// actually available, which is less than n only at the end of
+			// the stream. Memory backed streams are used in place.
+			size_t fill(size_t n) {
+				if (m_mem != NULL) {
+					return m_mem->available();
+				}
+				size_t avail = m_end - m_pos;
+				if (avail >= n || m_eof) {
+					return avail;
+				}
 
-				T* dest = img.GetScanlinePointer(j, TopDown);
-				int retVal = readPixels_RLE(is, dest, width, 1);
-				if (retVal != RGBE_RETURN_SUCCESS) {
-					return retVal;
+				// Move the leftovers to the front and get a new block
+				const size_t capacity = std::max(n, m_blockSize);
+				if (m_pos != 0 && avail != 0) {
+					memmove(&m_buffer[0], &m_buffer[m_pos], avail);
+				}
+				if (m_buffer.size() < capacity) {
+					m_buffer.resize(capacity);
+				}
+				m_pos = 0;
+				m_end = avail;
+
+				m_is.read(reinterpret_cast<char*>(&m_buffer[avail]),
+					static_cast<std::streamsize>(capacity - avail));
+				const size_t count = static_cast<size_t>(m_is.gcount());
+				if (count != capacity - avail) {
+					m_eof = true;
 				}
+				m_end += count;
+				return m_end;
 			}
-			return RGBE_RETURN_SUCCESS;
-		}
 
-		// Easy case: the destination is TopDown, just as the RGBE files
-		template <class T>
-		int read(istream &is, Image<T,TopDown> &img)
-		{
-			return readPixels_RLE(is, img.GetDataPointer(), img.Width(), img.Height());
+			// Pointer to the first available byte
+			inline const unsigned char* data() const {
+				if (m_mem != NULL) {
+					return reinterpret_cast<const unsigned char*>(m_mem->current());
+				}
+				return &m_buffer[0] + m_pos;
+			}
+
+			// Whether the stream is backed by memory: the pointers returned
+			// by data() then remain valid after the bytes are consumed
+			inline bool isInPlace() const {
+				return m_mem != NULL;
+			}
+
+			// Marks n bytes as used
+			inline void consume(size_t n) {
+				if (m_mem != NULL) {
+					m_mem->consume(n);
+					return;
+				}
+				assert(n <= m_end - m_pos);
+				m_pos += n;
+			}
+
+		private:
+			istream &m_is;
+			MemoryStreamBuf *m_mem;
+			const size_t m_blockSize;
+			std::vector<unsigned char> m_buffer;
+			size_t m_pos;
+			size_t m_end;
+			bool m_eof;
+		};
+
+		// Size of the blocks read from the stream
+		const static size_t RGBE_BLOCK_SIZE = 1 << 20;
+
+		// Upper bound of the encoded size of an RLE scanline: the header and
+		// four channels, in the worst case each pixel encoded as a run of 1
+		inline size_t maxScanlineSize_RLE(int scanline_width) {
+			return 4 + 8 * static_cast<size_t>(scanline_width);
 		}
 
 		/* simple read routine.  will not correctly handle run length encoding.
-		 * It's also quite slow because it reads element by element and converts them on the fly
+		 * The flat pixels are converted straight from the memory blocks.
 		 */
 		template <class T>
-		int readPixels(istream &is, T *data, int numpixels)
+		int readPixels(BlockReader &reader, T *data, int numpixels)
 		{
-
-			Rgbe rgbe;
-
-			while(numpixels-- > 0) {
-				is.read(reinterpret_cast<char*>(&rgbe), sizeof(Rgbe));
-				if ( is.fail() )
+			while(numpixels > 0) {
+				const size_t wanted = std::min(static_cast<size_t>(numpixels),
+					RGBE_BLOCK_SIZE / sizeof(Rgbe));
+				const size_t avail = reader.fill(sizeof(Rgbe) * wanted);
+				const size_t count = std::min(wanted, avail / sizeof(Rgbe));
+				if (count == 0)
 					return rgbe_error(rgbe_read_error,NULL);
-				*data++ = rgbe;
+
+				const unsigned char *src = reader.data();
+				for (size_t i = 0; i < count; ++i, src += sizeof(Rgbe)) {
+					*data++ = Rgbe(src[0], src[1], src[2], src[3]);
+				}
+				reader.consume(sizeof(Rgbe) * count);
+				numpixels -= static_cast<int>(count);
 			}
 			return RGBE_RETURN_SUCCESS;
 		}
 
-		// If we are just directly copying RGBE pixels we can do much better (about 10x faster). 
-		// It assumes that the data has been already allocated!
-		template <>
-		int readPixels(istream &is, Rgbe *data, int numpixels)
+		// Parses the four channels of a single RLE scanline, whose header
+		// has already been consumed, from the memory in [src,src_end). If
+		// scanline_buffer is not NULL the channels are decoded into it,
+		// otherwise the data is only validated. Upon success next points
+		// to the byte after the scanline.
+		inline int parseScanline_RLE(const unsigned char *src,
+			const unsigned char *src_end, unsigned char *scanline_buffer,
+			int scanline_width, const unsigned char **next)
 		{
-			is.read(reinterpret_cast<char*>(data), sizeof(Rgbe)*numpixels);
-			if ( is.fail() )
-				return rgbe_error(rgbe_read_error,NULL);
+			int pos = 0;
+			/* read each of the four channels for the scanline into the buffer */
+			for(int i=0;i<4;i++) {
+				const int pos_end = (i+1)*scanline_width;
+				while(pos < pos_end) {
+					if (src_end - src < 2)
+						return rgbe_error(rgbe_read_error,NULL);
+					int count;
+					if (src[0] > 128) {
+						/* a run of the same value */
+						count = src[0]-128;
+						if ((count == 0)||(count > pos_end - pos))
+							return rgbe_error(rgbe_format_error,"bad scanline data");
+						if (scanline_buffer != NULL)
+							memset(&scanline_buffer[pos], src[1], count);
+						src += 2;
+					}
+					else {
+						/* a non-run */
+						count = src[0];
+						if ((count == 0)||(count > pos_end - pos))
+							return rgbe_error(rgbe_format_error,"bad scanline data");
+						++src;
+						if (src_end - src < count)
+							return rgbe_error(rgbe_read_error,NULL);
+						if (scanline_buffer != NULL)
+							memcpy(&scanline_buffer[pos], src, count);
+						src += count;
+					}
+					pos += count;
+				}
+			}
+			*next = src;
 			return RGBE_RETURN_SUCCESS;
 		}
 
-		template <class T>
-		int readPixels_RLE(istream &is, T *data, int scanline_width,
-			int num_scanlines)
+		// Location of the compressed RLE data of consecutive scanlines, so
+		// that they may be decoded independently. The scanline j spans the
+		// bytes [begins[j], ends[j]) from data(), excluding its header. The
+		// data of memory backed streams is used in place, otherwise it is
+		// copied into the payload.
+		struct ScanlineIndex {
+			const unsigned char *mapped;
+			std::vector<unsigned char> payload;
+			std::vector<size_t> begins;
+			std::vector<size_t> ends;
+
+			ScanlineIndex() : mapped(NULL) {}
+
+			// Number of indexed scanlines
+			inline int count() const {
+				return static_cast<int>(begins.size());
+			}
+
+			// Base of the offsets, only valid if count() > 0
+			inline const unsigned char* data() const {
+				return mapped != NULL ? mapped : &payload[0];
+			}
+		};
+
+		// Serial stage of the decoder: indexes the RLE data of up to
+		// num_scanlines, validating each run. It stops
+		// early, without consuming anything else, if it finds a scanline
+		// which is not run length encoded; the rest of the file is flat.
+		int indexScanlines_RLE(BlockReader &reader, int scanline_width,
+			int num_scanlines, ScanlineIndex &index)
 		{
 			Rgbe rgbe;
-			unsigned char *scanline_buffer = NULL, *ptr = NULL, *ptr_end = NULL;
-			int i, count;
-			unsigned char buf[2];
-
-			if ((scanline_width < 8)||(scanline_width > 0x7fff))
-				/* run length encoding is not allowed so read flat*/
-				return readPixels(is,data,scanline_width*num_scanlines);
-			scanline_buffer = NULL;
-			/* read in each successive scanline */
-			while(num_scanlines > 0) {
-				is.read(reinterpret_cast<char*>(&rgbe), sizeof(rgbe));
-				if ( is.fail() ) {
-					delete [] scanline_buffer;
+			const size_t max_scanline_size = maxScanlineSize_RLE(scanline_width);
+
+			for (int j = 0; j < num_scanlines; ++j) {
+				const size_t avail = reader.fill(max_scanline_size);
+				if (avail < sizeof(rgbe))
 					return rgbe_error(rgbe_read_error,NULL);
-				}
+				const unsigned char *src = reader.data();
+				rgbe = Rgbe(src[0], src[1], src[2], src[3]);
 				if ((rgbe[0] != 2)||(rgbe[1] != 2)||(rgbe[2] & 0x80)) {
 					/* this file is not run length encoded */
-					*data++ = rgbe;
-					delete [] scanline_buffer;
-					return readPixels(is,data,scanline_width*num_scanlines-1);
+					break;
 				}
-				if ((((int)rgbe[2])<<8 | rgbe[3]) != scanline_width) {
-					delete [] scanline_buffer;
+				if ((((int)rgbe[2])<<8 | rgbe[3]) != scanline_width)
 					return rgbe_error(rgbe_format_error,"wrong scanline width");
-				}
-				if (scanline_buffer == NULL)
-					scanline_buffer = new unsigned char[4*scanline_width];
-				if (scanline_buffer == NULL) 
-					return rgbe_error(rgbe_memory_error,"unable to allocate buffer space");
-
-				ptr = &scanline_buffer[0];
-				/* read each of the four channels for the scanline into the buffer */
-				for(i=0;i<4;i++) {
-					ptr_end = &scanline_buffer[(i+1)*scanline_width];
-					while(ptr < ptr_end) {
-						is.read(reinterpret_cast<char*>(&buf[0]), 2);
-						if ( is.fail() ) {
-							delete [] scanline_buffer;
-							return rgbe_error(rgbe_read_error,NULL);
-						}
-						if (buf[0] > 128) {
-							/* a run of the same value */
-							count = buf[0]-128;
-							if ((count == 0)||(count > ptr_end - ptr)) {
-								delete [] scanline_buffer;
-								return rgbe_error(rgbe_format_error,"bad scanline data");
-							}
-							while(count-- > 0)
-								*ptr++ = buf[1];
-						}
-						else {
-							/* a non-run */
-							count = buf[0];
-							if ((count == 0)||(count > ptr_end - ptr)) {
-								delete [] scanline_buffer;
-								return rgbe_error(rgbe_format_error,"bad scanline data");
-							}
-							*ptr++ = buf[1];
-							if (--count > 0) {
-								is.read( reinterpret_cast<char*>(ptr), count );
-								if ( is.fail() ) {
-									delete [] scanline_buffer;
-									return rgbe_error(rgbe_read_error,NULL);
-								}
-								ptr += count;
-							}
-						}
+
+				const unsigned char *begin = src + sizeof(rgbe);
+				const unsigned char *next  = NULL;
+				int retVal = parseScanline_RLE(begin, src + avail, NULL,
+					scanline_width, &next);
+				if (retVal != RGBE_RETURN_SUCCESS)
+					return retVal;
+
+				if (reader.isInPlace()) {
+					if (index.mapped == NULL) {
+						index.mapped = begin;
 					}
+					index.begins.push_back(begin - index.mapped);
+					index.ends.push_back(next - index.mapped);
+				}
+				else {
+					index.begins.push_back(index.payload.size());
+					index.payload.insert(index.payload.end(), begin, next);
+					index.ends.push_back(index.payload.size());
 				}
-				/* now convert data from buffer into floats */
-				for(i=0;i<scanline_width;i++) {
+				reader.consume(next - src);
+			}
+			return RGBE_RETURN_SUCCESS;
+		}
+
+		// Destination of the decoded scanlines for regular images: converts
+		// the pixels to the image type with a cast
+		template <class T, ScanLineMode S>
+		class ImageScanlineSink {
+		public:
+			ImageScanlineSink(Image<T,S> &img) : m_img(img) {}
+
+			void operator() (int j, const unsigned char *scanline_buffer) const {
+				const int scanline_width = m_img.Width();
+				T* data = m_img.GetScanlinePointer(j, TopDown);
+				Rgbe rgbe;
+				for(int i=0;i<scanline_width;i++) {
 					rgbe.r = scanline_buffer[i];
 					rgbe.g = scanline_buffer[i+scanline_width];
 					rgbe.b = scanline_buffer[i+2*scanline_width];
 					rgbe.e = scanline_buffer[i+3*scanline_width];
-					*data++ = rgbe;
+					data[i] = rgbe;
 				}
-				num_scanlines--;
 			}
-			delete [] scanline_buffer;
-			return RGBE_RETURN_SUCCESS;
-		}
 
+		private:
+			Image<T,S> &m_img;
+		};
+
+		// Parallel stage of the decoder: each task expands its indexed
+		// scanlines into a private buffer and hands them to the sink,
+		// which converts them into the final pixels while still in cache
+		template <class Sink>
+		class DecodeScanlinesFunctor {
+		public:
+			DecodeScanlinesFunctor(const ScanlineIndex &index, int scanline_width,
+				const Sink &sink) :
+			m_index(index), m_width(scanline_width), m_sink(sink) {}
+
+			void operator() (const tbb::blocked_range<int> &range) const {
+				std::vector<unsigned char> scanline_buffer(4*m_width);
+				const unsigned char *data = m_index.data();
+				for (int j = range.begin(); j != range.end(); ++j) {
+					const unsigned char *next = NULL;
+					const int retVal = parseScanline_RLE(
+						data + m_index.begins[j], data + m_index.ends[j],
+						&scanline_buffer[0], m_width, &next);
+					// The data was already validated by the serial stage
+					assert(retVal == RGBE_RETURN_SUCCESS);
+					(void)retVal;
+					m_sink(j, &scanline_buffer[0]);
+				}
+			}
 
-		// ####################################################################
-		// ####         WRITING         #######################################
-		// ####################################################################
-		
-		// Forward declaration
-		template <class T>
-		int writePixels_RLE(ostream&, const T*, int, int);
+		private:
+			const ScanlineIndex &m_index;
+			const int m_width;
+			const Sink &m_sink;
+		};
+
+		template <class Sink>
+		void decodeScanlines_RLE(const ScanlineIndex &index, int scanline_width,
+			const Sink &sink)
+		{
+			if (index.count() == 0) {
+				return;
+			}
+			// Keep enough pixels per task to amortize the scheduling
+			const int grainSize = std::max(1, (1 << 14) / scanline_width);
+			DecodeScanlinesFunctor<Sink> decoder(index, scanline_width, sink);
+			tbb::parallel_for(tbb::blocked_range<int>(0, index.count(), grainSize),
+				decoder);
+		}
 
-		// The basic utility methods for saving to an RGBE file which has
-		// already been successfully open. This handles the general case by going line by line
+		// Reads the next img.Height() scanlines. A serial pass locates the RLE
+		// scanlines, which are then decoded in parallel. Once a scanline is
+		// not run length encoded the flat flag is set and the rest of the
+		// file is read flat.
 		template < class T, ScanLineMode S >
-		int write(ostream &os, const Image<T,S> &img)
+		int readScanlines(BlockReader &reader, Image<T,S> &img, bool &flat)
 		{
 			const int width  = img.Width();
 			const int height = img.Height();
-			for (int j = 0; j < height; ++j) {
 
+			int first_flat = 0;
+			if (!flat && (width >= 8) && (width <= 0x7fff)) {
+				ScanlineIndex index;
+				int retVal = indexScanlines_RLE(reader, width, height, index);
+				if (retVal != RGBE_RETURN_SUCCESS) {
+					return retVal;
+				}
+				decodeScanlines_RLE(index, width, ImageScanlineSink<T,S>(img));
+				first_flat = index.count();
+			}
+
+			/* run length encoding is not allowed or not used, so read flat */
+			flat = flat || (first_flat < height);
+			for (int j = first_flat; j < height; ++j) {
 				T* dest = img.GetScanlinePointer(j, TopDown);
-				int retVal = writePixels_RLE(os, dest, width, 1);
+				int retVal = readPixels(reader, dest, width);
 				if (retVal != RGBE_RETURN_SUCCESS) {
 					return retVal;
 				}
@@ -436,13 +597,21 @@ namespace pcg {
 			return RGBE_RETURN_SUCCESS;
 		}
 
-		// Easy case: the destination is TopDown, just as the RGBE files
-		template <class T>
-		int write(ostream &os, const Image<T,TopDown> &img)
+		// The basic utility method for loading from an RGBE file which has
+		// already been successfully open.
+		template < class T, ScanLineMode S >
+		int read(istream &is, Image<T,S> &img)
 		{
-			return writePixels_RLE(os, img.GetDataPointer(), img.Width(), img.Height());
+			BlockReader reader(is, RGBE_BLOCK_SIZE);
+			bool flat = false;
+			return readScanlines(reader, img, flat);
 		}
 
+
+		// ####################################################################
+		// ####         WRITING         #######################################
+		// ####################################################################
+		
 		/* simple write routine that does not use run length encoding */
 		/* These routines can be made faster by allocating a larger buffer and
 		   fread-ing and fwrite-ing the data in larger chunks.
@@ -477,51 +646,101 @@ namespace pcg {
 			return RGBE_RETURN_SUCCESS;
 		}
 
-
+		// Appends a single RLE scanline, including its header, to the output
+		// buffer. The scanline_buffer must have space for 4*scanline_width bytes.
 		template <class T>
-		int writePixels_RLE(ostream &os, const T *pixels, int scanline_width,
-			int num_scanlines)
+		void encodeScanline_RLE(std::vector<unsigned char> &out, const T *pixels,
+			int scanline_width, unsigned char *scanline_buffer)
 		{
-			unsigned char rgbe[4];
-			unsigned char *buffer;
-			int i, err;
+			out.push_back(2);
+			out.push_back(2);
+			out.push_back(static_cast<unsigned char>(scanline_width >> 8));
+			out.push_back(static_cast<unsigned char>(scanline_width & 0xFF));
+			for(int i=0;i<scanline_width;i++) {
+
+				const Rgbe rgbe = (Rgbe)*pixels++;
+				scanline_buffer[i]                  = rgbe[0];
+				scanline_buffer[i+scanline_width]   = rgbe[1];
+				scanline_buffer[i+2*scanline_width] = rgbe[2];
+				scanline_buffer[i+3*scanline_width] = rgbe[3];
+			}
+			/* write out each of the four channels separately run length encoded */
+			/* first red, then green, then blue, then exponent */
+			for(int i=0;i<4;i++) {
+				encodeBytes_RLE(out, &scanline_buffer[i*scanline_width],
+					scanline_width);
+			}
+		}
+
+		// Parallel stage of the encoder: each scanline of the current batch
+		// is encoded into its own byte buffer
+		template <class T, ScanLineMode S>
+		class EncodeScanlinesFunctor {
+		public:
+			EncodeScanlinesFunctor(const Image<T,S> &img, int first_scanline,
+				std::vector<std::vector<unsigned char> > &buffers) :
+			m_img(img), m_first(first_scanline), m_buffers(buffers) {}
+
+			void operator() (const tbb::blocked_range<int> &range) const {
+				const int scanline_width = m_img.Width();
+				std::vector<unsigned char> scanline_buffer(4*scanline_width);
+				for (int k = range.begin(); k != range.end(); ++k) {
+					std::vector<unsigned char> &out = m_buffers[k];
+					out.clear();
+					const T* pixels = m_img.GetScanlinePointer(m_first+k, TopDown);
+					encodeScanline_RLE(out, pixels, scanline_width,
+						&scanline_buffer[0]);
+				}
+			}
+
+		private:
+			const Image<T,S> &m_img;
+			const int m_first;
+			std::vector<std::vector<unsigned char> > &m_buffers;
+		};
 
-			if ((scanline_width < 8)||(scanline_width > 0x7fff))
+		// The basic utility method for saving to an RGBE file which has
+		// already been successfully open. The scanlines are RLE encoded in
+		// parallel by batches, then a serial stage writes them in order.
+		template < class T, ScanLineMode S >
+		int write(ostream &os, const Image<T,S> &img)
+		{
+			const int width  = img.Width();
+			const int height = img.Height();
+
+			if ((width < 8)||(width > 0x7fff)) {
 				/* run length encoding is not allowed so write flat*/
-				return writePixels(os,pixels,scanline_width*num_scanlines);
-			buffer = new unsigned char[4*scanline_width];
-			if (buffer == NULL) 
-				/* no buffer space so write flat */
-				return writePixels(os,pixels,scanline_width*num_scanlines);
-			while(num_scanlines-- > 0) {
-				rgbe[0] = 2;
-				rgbe[1] = 2;
-				rgbe[2] = scanline_width >> 8;
-				rgbe[3] = scanline_width & 0xFF;
-				os.write(reinterpret_cast<char*>(&rgbe[0]), 4);
-				if ( os.fail() ) {
-					delete [] buffer;
-					return rgbe_error(rgbe_write_error,NULL);
+				for (int j = 0; j < height; ++j) {
+					const T* pixels = img.GetScanlinePointer(j, TopDown);
+					int retVal = writePixels(os, pixels, width);
+					if (retVal != RGBE_RETURN_SUCCESS) {
+						return retVal;
+					}
 				}
-				for(i=0;i<scanline_width;i++) {
+				return RGBE_RETURN_SUCCESS;
+			}
 
-					const Rgbe rgbe = (Rgbe)*pixels++;
-					buffer[i]                  = rgbe[0];
-					buffer[i+scanline_width]   = rgbe[1];
-					buffer[i+2*scanline_width] = rgbe[2];
-					buffer[i+3*scanline_width] = rgbe[3];
+			// Limit the number of scanlines held in memory at once
+			const int batch_size = std::min(height,
+				std::max(1, static_cast<int>(RGBE_BLOCK_SIZE) / width));
+			std::vector<std::vector<unsigned char> > buffers(batch_size);
+			std::vector<unsigned char> batch;
+			for (int j = 0; j < height; j += batch_size) {
+				const int count = std::min(batch_size, height - j);
+				EncodeScanlinesFunctor<T,S> encoder(img, j, buffers);
+				tbb::parallel_for(tbb::blocked_range<int>(0, count), encoder);
+
+				// Gather the whole batch so that it takes a single write
+				batch.clear();
+				for (int k = 0; k < count; ++k) {
+					batch.insert(batch.end(), buffers[k].begin(), buffers[k].end());
 				}
-				/* write out each of the four channels separately run length encoded */
-				/* first red, then green, then blue, then exponent */
-				for(i=0;i<4;i++) {
-					if ((err = writeBytes_RLE(os,&buffer[i*scanline_width],
-						scanline_width)) != RGBE_RETURN_SUCCESS) {
-							delete [] buffer;
-							return err;
-					}
+				os.write(reinterpret_cast<const char*>(&batch[0]),
+					static_cast<std::streamsize>(batch.size()));
+				if ( os.fail() ) {
+					return rgbe_error(rgbe_write_error,NULL);
 				}
 			}
-			delete [] buffer;
 			return RGBE_RETURN_SUCCESS;
 		}
 
@@ -724,168 +943,126 @@ void RgbeIO::Save(const Image<Rgb32F,BottomUp> &img, const char *filename) {
 namespace
 {
 
-inline void stream(Vec4f& target, const Vec4f& value) {
-    _mm_stream_ps(reinterpret_cast<float*>(&target), value);
+// Alpha plane of a scanline, NULL for the images without alpha
+inline float* alphaScanline(RGBAImageSoA& img, int j)
+{
+    return img.GetScanlinePointer<RGBAImageSoA::A>(j);
 }
 
-inline Vec4i sll(const Vec4i& a, int count) {
-    return _mm_slli_epi32(a, count);
+inline float* alphaScanline(RGBImageSoA&, int)
+{
+    return NULL;
 }
 
-inline Vec4i srl(const Vec4i& a, int count) {
-    return _mm_srli_epi32(a, count);
-}
 
-inline Vec4f toFloat(const Vec4i& a) {
-    return _mm_cvtepi32_ps(a);
-}
 
-inline Vec4f castAsFloat(const Vec4i& a) {
-    return _mm_castsi128_ps(a);
-}
+// Destination of the decoded scanlines for SoA images: the four channel
+// runs of each scanline are converted straight into the R,G,B[,A] planes
+template <class ImageSoA>
+class SoAScanlineSink
+{
+public:
+    SoAScanlineSink(ImageSoA& img) : m_img(img) {}
+
+    void operator() (int j, const unsigned char* scanline_buffer) const
+    {
+        float* r = m_img.template GetScanlinePointer<R>(j);
+        float* g = m_img.template GetScanlinePointer<G>(j);
+        float* b = m_img.template GetScanlinePointer<B>(j);
+        float* a = alphaScanline(m_img, j);
+        PCG_SIMD_DISPATCH(RgbeIO_DecodeSoA)(scanline_buffer, m_img.Width(),
+            r, g, b, a);
+    }
 
-inline Vec4f castAsFloat(const Vec4bi& a) {
-    return _mm_castsi128_ps(a);
-}
+private:
+    typedef typename ImageSoA::R R;
+    typedef typename ImageSoA::G G;
+    typedef typename ImageSoA::B B;
+
+    ImageSoA& m_img;
+};
+
+
+
+// Reads the next img.Height() scanlines of an RGBE file. The RLE scanlines
+// are decoded in parallel straight into the SoA planes, without the
+// temporary Rgbe image. The flat flag works as in rgbeio_internal::read.
+template <class ImageSoA>
+int ReadImageSoA(rgbeions::BlockReader& reader, ImageSoA& img, bool& flat)
+{
+    using namespace rgbeions;
+    const int width  = img.Width();
+    const int height = img.Height();
+    SoAScanlineSink<ImageSoA> sink(img);
+
+    int first_flat = 0;
+    if (!flat && (width >= 8) && (width <= 0x7fff)) {
+        ScanlineIndex index;
+        int retVal = indexScanlines_RLE(reader, width, height, index);
+        if (retVal != RGBE_RETURN_SUCCESS) {
+            return retVal;
+        }
+        decodeScanlines_RLE(index, width, sink);
+        first_flat = index.count();
+    }
 
-inline Vec4i castAsInt(const Vec4f& a) {
-    return _mm_castps_si128(a);
+    // Flat scanlines are split into channels to reuse the sink
+    flat = flat || (first_flat < height);
+    if (first_flat < height) {
+        std::vector<Rgbe> pixels(width);
+        std::vector<unsigned char> scanline_buffer(4*width);
+        for (int j = first_flat; j < height; ++j) {
+            int retVal = readPixels(reader, &pixels[0], width);
+            if (retVal != RGBE_RETURN_SUCCESS) {
+                return retVal;
+            }
+            for (int i = 0; i < width; ++i) {
+                scanline_buffer[i]         = pixels[i].r;
+                scanline_buffer[i+width]   = pixels[i].g;
+                scanline_buffer[i+2*width] = pixels[i].b;
+                scanline_buffer[i+3*width] = pixels[i].e;
+            }
+            sink(j, &scanline_buffer[0]);
+        }
+    }
+    return RGBE_RETURN_SUCCESS;
 }
 
 
 
-void LoadImageSoA(const Image<Rgbe, TopDown>& imgRGBE, RGBAImageSoA& img)
+template <class ImageSoA>
+void LoadImageSoA(ImageSoA& img, istream& is)
 {
-    img.Alloc(imgRGBE.Width(), imgRGBE.Height());
-
-    // Convert them using the RTGI2 method, processing multiple pixels at a time
-    const Vec4i* PCG_RESTRICT vecRGBE =
-        reinterpret_cast<Vec4i*>(imgRGBE.GetDataPointer());
-    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
-
-    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
-    const Vec4i const_9(Vec4i::constant<9>());
-    const Vec4f const_1p(1.0f);
-
-    typedef Vec4f* PCG_RESTRICT RVec4f;
-    RVec4f rPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::R>());
-    RVec4f gPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::G>());
-    RVec4f bPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::B>());
-    RVec4f aPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::A>());
-
-    const int vecCount = imgRGBE.Size() / 4;
-    for (int i = 0; i != vecCount; ++i) {
-        const Vec4i& rgbe = vecRGBE[i];
-        // Unpack the RGBE pixel
-        Vec4f r = toFloat(const_0xFF & rgbe);
-        Vec4f g = toFloat(const_0xFF & (srl(rgbe,  8)));
-        Vec4f b = toFloat(const_0xFF & (srl(rgbe, 16)));
-        Vec4i e = srl(rgbe, 24);
-
-        // Values in the range 1 to 9 would require "denormal" multipliers and
-        // are below minimum values for RGBE exponents so we truncate them to 0
-        const Vec4i exponentMask(e > const_9);
-        e =  sll((e - const_9), 23) & exponentMask;
-        const Vec4f scale = castAsFloat(e);
-
-        r *= scale;
-        g *= scale;
-        b *= scale;
-        stream(rPtr[i], r);
-        stream(gPtr[i], g);
-        stream(bPtr[i], b);
-        stream(aPtr[i], const_1p);
+    int width, height;
+    rgbeions::rgbe_header_info info;
+    if (rgbeions::readHeader(is, width, height, info) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE header.");
+    }
+
+    img.Alloc(width, height);
+    rgbeions::BlockReader reader(is, rgbeions::RGBE_BLOCK_SIZE);
+    bool flat = false;
+    if (ReadImageSoA(reader, img, flat) != rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE pixel data.");
     }
 }
 
 
 
-void SaveImageSoA(Image<Rgbe, TopDown>& dest, const RGBAImageSoA& src)
+template <class ImageSoA>
+void SaveImageSoA(Image<Rgbe, TopDown>& dest, const ImageSoA& src)
 {
-    dest.Alloc(src.Width(), src.Height());
-
-    // Convert them using the RTGI2 method, processing multiple pixels at a time
-    Vec4i* PCG_RESTRICT vecRGBE=reinterpret_cast<Vec4i*>(dest.GetDataPointer());
-    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
-
-    typedef const Vec4f* PCG_RESTRICT const RVec4f;
-    RVec4f rPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::R>());
-    RVec4f gPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::G>());
-    RVec4f bPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::B>());
-
-    const Vec4f min_val(1e-32f);
-    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
-    const Vec4i const_0x1FF(Vec4i::constant<0x1FF>());
-    const Vec4i const_253(Vec4i::constant<253>());
-    const Vec4i const_1(Vec4i::constant<1>());
-
-    const int vecCount = src.Size() / 4;
-    for (int i = 0; i != vecCount; ++i) {
-        Vec4f red   = rPtr[i];
-        Vec4f green = gPtr[i];
-        Vec4f blue  = bPtr[i];
-
-        // Kill NaN pixels to avoid signaling errors
-        Vec4f maskValid((red == red) & (green == green) & (blue == blue));
-        red   &= maskValid;
-        green &= maskValid;
-        blue  &= maskValid;
-
-        // Negative values cannot be encoded, so we truncate them to zero
-        red   = simd_max(red,   Vec4f::zero());
-        green = simd_max(green, Vec4f::zero());
-        blue  = simd_max(blue,  Vec4f::zero());
-
-        // Find the largest value of the three color components
-        Vec4f maxValue = simd_max(blue, simd_max(red, green));
-
-        // Consider all values less than this to be zero. This constant comes
-        // from Ward's definition in "Real Pixels" (Graphics Gems II)
-        maskValid &= Vec4f(maxValue >= min_val);
-
-        // Extract the exponent from the IEEE single precision value
-        Vec4i biasedExponent = srl(castAsInt(maxValue), 23) & const_0xFF;
-        // Overflow
-        maskValid = andnot(castAsFloat(biasedExponent > const_253), maskValid);
-
-        // Construct an additive normalizer which is just 2^(exp+1).
-        // Adding this to each float will move the relevant mantissa bits to a
-        // known fixed location for easy extraction
-        Vec4f additiveNormalizer = castAsFloat(sll(biasedExponent+const_1, 23));
-        // Initially we keep an extra bit (9-bits) so that we can perform
-        // rounding to 8-bits in the next step
-        Vec4i rawR = srl(castAsInt(red  +additiveNormalizer), 14) & const_0x1FF;
-        Vec4i rawG = srl(castAsInt(green+additiveNormalizer), 14) & const_0x1FF;
-        Vec4i rawB = srl(castAsInt(blue +additiveNormalizer), 14) & const_0x1FF;
-        // rgbeBiasedExponent = (ieeeBiasedExponent-127) + 128 since IEEE single
-        // float and rgbe have different exponent bias values
-        Vec4i e = biasedExponent + const_1 + const_1;
-        // round to nearest representable 8 bit value
-        Vec4i r = srl(rawR + const_1, 1);
-        Vec4i g = srl(rawG + const_1, 1);
-        Vec4i b = srl(rawB + const_1, 1);
-
-        // Check to see if rounding causes an overflow condition and fix if
-        // necessary. Note that we actually avoid branches
-        Vec4bi maskOverflow = (r>const_0xFF) | (g>const_0xFF) | (b>const_0xFF);
-        e += Vec4i(maskOverflow) & const_1;
-        const Vec4i const_2 = const_1 + const_1;
-        Vec4i rOver = srl(rawR + const_2, 2);
-        Vec4i gOver = srl(rawG + const_2, 2);
-        Vec4i bOver = srl(rawB + const_2, 2);
-        r = select(maskOverflow, rOver, r);
-        g = select(maskOverflow, gOver, g);
-        b = select(maskOverflow, bOver, b);
-        // Overflow after rounding
-        Vec4i finalMask = andnot(Vec4i(e > const_0xFF), castAsInt(maskValid));
-
-        // Set to zero if the pixel is invalid, then build the final value
-        r &= finalMask;
-        g &= finalMask;
-        b &= finalMask;
-        e &= finalMask;
-        vecRGBE[i] = sll(e, 24) | sll(b, 16) | sll(g, 8) | r;
+    if (dest.Width() != src.Width() || dest.Height() != src.Height()) {
+        dest.Alloc(src.Width(), src.Height());
     }
+
+    typedef typename ImageSoA::R R;
+    typedef typename ImageSoA::G G;
+    typedef typename ImageSoA::B B;
+    PCG_SIMD_DISPATCH(RgbeIO_EncodeSoA)(dest.GetDataPointer(),
+        src.template GetDataPointer<R>(), src.template GetDataPointer<G>(),
+        src.template GetDataPointer<B>(), src.Size());
 }
 
 } // namespace
@@ -894,16 +1071,18 @@ void SaveImageSoA(Image<Rgbe, TopDown>& dest, const RGBAImageSoA& src)
 
 void RgbeIO::Load(RGBAImageSoA& img, istream& is)
 {
-    Image<Rgbe, TopDown> imgRGBE;
-    Load(imgRGBE, is);
-    LoadImageSoA(imgRGBE, img);
+    LoadImageSoA(img, is);
 }
 
 void RgbeIO::Load(RGBAImageSoA& img, const char* filename)
 {
-    Image<Rgbe, TopDown> imgRGBE;
-    Load(imgRGBE, filename);
-    LoadImageSoA(imgRGBE, img);
+    ifstream rgbeFile(filename, ios_base::binary);
+    if (! rgbeFile.fail() ) {
+        LoadImageSoA(img, rgbeFile);
+    }
+    else {
+        throw IOException("RGBE Load badness!!");
+    }
 }
 
 void RgbeIO::Save(const RGBAImageSoA& img, ostream& os)
@@ -919,3 +1098,159 @@ void RgbeIO::Save(const RGBAImageSoA& img, const char* filename)
     SaveImageSoA(imgRGBE, img);
     Save(imgRGBE, filename);
 }
+
+void RgbeIO::Load(RGBImageSoA& img, istream& is)
+{
+    LoadImageSoA(img, is);
+}
+
+void RgbeIO::Load(RGBImageSoA& img, const char* filename)
+{
+    ifstream rgbeFile(filename, ios_base::binary);
+    if (! rgbeFile.fail() ) {
+        LoadImageSoA(img, rgbeFile);
+    }
+    else {
+        throw IOException("RGBE Load badness!!");
+    }
+}
+
+void RgbeIO::Save(const RGBImageSoA& img, ostream& os)
+{
+    Image<Rgbe, TopDown> imgRGBE;
+    SaveImageSoA(imgRGBE, img);
+    Save(imgRGBE, os);
+}
+
+void RgbeIO::Save(const RGBImageSoA& img, const char* filename)
+{
+    Image<Rgbe, TopDown> imgRGBE;
+    SaveImageSoA(imgRGBE, img);
+    Save(imgRGBE, filename);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Streaming scanline access
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+class RgbeScanlineReader : public scanlineio_internal::ScanlineReaderImpl
+{
+public:
+    RgbeScanlineReader(const char* filename) :
+    m_is(filename, ios_base::binary), m_reader(NULL), m_flat(false)
+    {
+        if (m_is.fail()) {
+            throw IOException(std::string("Couldn't open the file ") +
+                filename);
+        }
+        rgbeions::rgbe_header_info info;
+        if (rgbeions::readHeader(m_is, m_width, m_height, info) !=
+            rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("Couldn't read RGBE header.");
+        }
+        m_reader = new rgbeions::BlockReader(m_is, rgbeions::RGBE_BLOCK_SIZE);
+    }
+
+    virtual ~RgbeScanlineReader() {
+        delete m_reader;
+    }
+
+    virtual void read(Image<Rgba32F, TopDown>& band) {
+        if (rgbeions::readScanlines(*m_reader, band, m_flat) !=
+            rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("Couldn't read RGBE pixel data.");
+        }
+    }
+
+    virtual void read(RGBAImageSoA& band) {
+        if (ReadImageSoA(*m_reader, band, m_flat) !=
+            rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("Couldn't read RGBE pixel data.");
+        }
+    }
+
+    // The raw pixels, straight from the RLE decoder
+    virtual void read(Image<Rgbe, TopDown>& band) {
+        if (rgbeions::readScanlines(*m_reader, band, m_flat) !=
+            rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("Couldn't read RGBE pixel data.");
+        }
+    }
+
+private:
+    ifstream m_is;
+    rgbeions::BlockReader* m_reader;
+    bool m_flat;
+};
+
+
+
+class RgbeScanlineWriter : public scanlineio_internal::ScanlineWriterImpl
+{
+public:
+    RgbeScanlineWriter(const char* filename, int width, int height) :
+    m_os(filename, ios_base::binary)
+    {
+        if (m_os.fail()) {
+            throw IOException(std::string("Couldn't create the file ") +
+                filename);
+        }
+
+        /* Write the header for a raw image (without gamma correction) */
+        rgbeions::rgbe_header_info info;
+        info.exposure = 1.0f;
+        info.gamma    = 1.0f;
+        info.setValidExposure(true);
+        info.setValidGamma(true);
+        if (rgbeions::writeHeader(m_os, width, height, info) !=
+            rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("RGBE Save badness!!");
+        }
+    }
+
+    virtual void write(const Image<Rgba32F, TopDown>& band) {
+        if (rgbeions::write(m_os, band) != rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("RGBE Save badness!!");
+        }
+    }
+
+    virtual void write(const RGBAImageSoA& band) {
+        SaveImageSoA(m_tmp, band);
+        if (rgbeions::write(m_os, m_tmp) != rgbeions::RGBE_RETURN_SUCCESS) {
+            throw IOException("RGBE Save badness!!");
+        }
+    }
+
+    virtual void close() {
+        m_os.close();
+        if (m_os.fail()) {
+            throw IOException("RGBE Save badness!!");
+        }
+    }
+
+private:
+    ofstream m_os;
+    Image<Rgbe, TopDown> m_tmp;
+};
+
+} // namespace
+
+
+
+scanlineio_internal::ScanlineReaderImpl*
+scanlineio_internal::newRgbeScanlineReader(const char* filename)
+{
+    return new RgbeScanlineReader(filename);
+}
+
+scanlineio_internal::ScanlineWriterImpl*
+scanlineio_internal::newRgbeScanlineWriter(const char* filename,
+    int width, int height)
+{
+    return new RgbeScanlineWriter(filename, width, height);
+}
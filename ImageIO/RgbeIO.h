@@ -57,6 +57,10 @@ namespace pcg {
 		static IMAGEIO_API void Load(RGBAImageSoA& img, istream& is);
 		static IMAGEIO_API void Load(RGBAImageSoA& img, const char* filename);
 
+		// RGB SoA Image, without the alpha plane
+		static IMAGEIO_API void Load(RGBImageSoA& img, istream& is);
+		static IMAGEIO_API void Load(RGBImageSoA& img, const char* filename);
+
 
 		// ### Save functions ###
 
@@ -82,6 +86,10 @@ namespace pcg {
 		static IMAGEIO_API void Save(const RGBAImageSoA& img, ostream& os);
 		static IMAGEIO_API void Save(const RGBAImageSoA& img, const char* filename);
 
+		// RGB SoA Image
+		static IMAGEIO_API void Save(const RGBImageSoA& img, ostream& os);
+		static IMAGEIO_API void Save(const RGBImageSoA& img, const char* filename);
+
 	};
 
 
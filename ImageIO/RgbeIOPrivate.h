@@ -18,6 +18,11 @@
 #if !defined(RGBEIOPRIVATE_H)
 #define RGBEIOPRIVATE_H
 
+#include "rgbe.h"
+#include "SimdDispatch.h"
+
+#include <vector>
+
 namespace pcg {
 
 	// The is stuff which won't be defined here because it uses a lot of templates
@@ -130,11 +135,28 @@ namespace pcg {
 		/* Run length encoding adds considerable complexity but does */
 		/* save some space.  For each scanline, each channel (r,g,b,e) is */
 		/* encoded separately for better compression. */
-		int writeBytes_RLE(ostream &os, const unsigned char *data, int numbytes);
+		/* The encoded bytes are appended to the output buffer, so that */
+		/* several scanlines may be encoded concurrently. */
+		void encodeBytes_RLE(std::vector<unsigned char> &out,
+			const unsigned char *data, int numbytes);
 
 	}
 
 }
 
 
+// SIMD conversions for the SoA images, defined in RgbeSoA.cpp for each
+// instruction set.
+
+// Converts the four channel runs of a decoded RLE scanline into the planes.
+// The alpha plane, which is set to one, may be NULL.
+PCG_SIMD_DECLARE(void, RgbeIO_DecodeSoA, (const unsigned char *scanline,
+	int width, float *r, float *g, float *b, float *a))
+
+// Encodes the pixels of the planes. Both the planes and the destination
+// are padded to a multiple of 4 pixels.
+PCG_SIMD_DECLARE(void, RgbeIO_EncodeSoA, (Rgbe *dest,
+	const float *r, const float *g, const float *b, ptrdiff_t count))
+
+
 #endif /* RGBEIOPRIVATE_H */
@@ -0,0 +1,225 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// SIMD conversions between RGBE and the planes of the SoA images, compiled
+// once per instruction set (see SimdDispatch.h)
+
+#include "StdAfx.h"
+#include "rgbe.h"
+#include "RgbeIOPrivate.h"
+#include "Vec4f.h"
+#include "Vec4i.h"
+
+#include <cassert>
+
+using namespace pcg;
+
+
+namespace
+{
+
+inline Vec4i sll(const Vec4i& a, int count) {
+    return _mm_slli_epi32(a, count);
+}
+
+inline Vec4i srl(const Vec4i& a, int count) {
+    return _mm_srli_epi32(a, count);
+}
+
+inline Vec4f toFloat(const Vec4i& a) {
+    return _mm_cvtepi32_ps(a);
+}
+
+inline Vec4f castAsFloat(const Vec4i& a) {
+    return _mm_castsi128_ps(a);
+}
+
+inline Vec4f castAsFloat(const Vec4bi& a) {
+    return _mm_castsi128_ps(a);
+}
+
+inline Vec4i castAsInt(const Vec4f& a) {
+    return _mm_castps_si128(a);
+}
+
+
+
+// Converts blocks of 4 RGBE pixels into the SoA planes
+// Computes the RGBE multiplier 2^(e-136) like the SIMD code below, which
+// truncates the exponents in the range 1 to 9 to zero
+inline float rgbeScale(unsigned char e) {
+    if (e <= 9) {
+        return 0.0f;
+    }
+    union { int32_t i; float f; } u;
+    u.i = static_cast<int32_t>(e - 9) << 23;
+    return u.f;
+}
+
+// Expands 16 consecutive bytes into four vectors of 32-bit integers
+inline void unpackBytes(const unsigned char* src, Vec4i (&v)[4])
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    v[0] = _mm_unpacklo_epi16(lo, zero);
+    v[1] = _mm_unpackhi_epi16(lo, zero);
+    v[2] = _mm_unpacklo_epi16(hi, zero);
+    v[3] = _mm_unpackhi_epi16(hi, zero);
+}
+
+} // namespace
+
+
+
+void pcg::PCG_SIMD_NS::RgbeIO_DecodeSoA(const unsigned char *scanline,
+    int width, float *r, float *g, float *b, float *a)
+{
+    const unsigned char* PCG_RESTRICT rSrc = scanline;
+    const unsigned char* PCG_RESTRICT gSrc = scanline + width;
+    const unsigned char* PCG_RESTRICT bSrc = scanline + 2*width;
+    const unsigned char* PCG_RESTRICT eSrc = scanline + 3*width;
+
+    // Convert them using the RTGI2 method, 16 pixels at a time
+    const Vec4i const_9(Vec4i::constant<9>());
+    const Vec4f const_1p(1.0f);
+    const int bulkEnd = width & ~0xF;
+    for (int i = 0; i != bulkEnd; i += 16) {
+        Vec4i rv[4], gv[4], bv[4], ev[4];
+        unpackBytes(rSrc + i, rv);
+        unpackBytes(gSrc + i, gv);
+        unpackBytes(bSrc + i, bv);
+        unpackBytes(eSrc + i, ev);
+
+        for (int k = 0; k != 4; ++k) {
+            // Values in the range 1 to 9 would require "denormal"
+            // multipliers and are below minimum values for RGBE
+            // exponents so we truncate them to 0
+            const Vec4i& e = ev[k];
+            const Vec4i exponentMask(e > const_9);
+            const Vec4f scale = castAsFloat(sll((e - const_9), 23) &
+                                            exponentMask);
+
+            const int idx = i + 4*k;
+            _mm_storeu_ps(r + idx, toFloat(rv[k]) * scale);
+            _mm_storeu_ps(g + idx, toFloat(gv[k]) * scale);
+            _mm_storeu_ps(b + idx, toFloat(bv[k]) * scale);
+            if (a != NULL) {
+                _mm_storeu_ps(a + idx, const_1p);
+            }
+        }
+    }
+
+    for (int i = bulkEnd; i != width; ++i) {
+        const float scale = rgbeScale(eSrc[i]);
+        r[i] = rSrc[i] * scale;
+        g[i] = gSrc[i] * scale;
+        b[i] = bSrc[i] * scale;
+        if (a != NULL) {
+            a[i] = 1.0f;
+        }
+    }
+}
+
+
+
+void pcg::PCG_SIMD_NS::RgbeIO_EncodeSoA(Rgbe *dest,
+    const float *r, const float *g, const float *b, ptrdiff_t count)
+{
+    // Convert them using the RTGI2 method, processing multiple pixels at a time
+    Vec4i* PCG_RESTRICT vecRGBE = reinterpret_cast<Vec4i*>(dest);
+    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
+
+    typedef const Vec4f* PCG_RESTRICT const RVec4f;
+    RVec4f rPtr = reinterpret_cast<const Vec4f*>(r);
+    RVec4f gPtr = reinterpret_cast<const Vec4f*>(g);
+    RVec4f bPtr = reinterpret_cast<const Vec4f*>(b);
+
+    const Vec4f min_val(1e-32f);
+    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
+    const Vec4i const_0x1FF(Vec4i::constant<0x1FF>());
+    const Vec4i const_253(Vec4i::constant<253>());
+    const Vec4i const_1(Vec4i::constant<1>());
+
+    // Both images are padded, so the last vector is always complete
+    const ptrdiff_t vecCount = (count + 3) / 4;
+    for (ptrdiff_t i = 0; i != vecCount; ++i) {
+        Vec4f red   = rPtr[i];
+        Vec4f green = gPtr[i];
+        Vec4f blue  = bPtr[i];
+
+        // Kill NaN pixels to avoid signaling errors
+        Vec4f maskValid((red == red) & (green == green) & (blue == blue));
+        red   &= maskValid;
+        green &= maskValid;
+        blue  &= maskValid;
+
+        // Negative values cannot be encoded, so we truncate them to zero
+        red   = simd_max(red,   Vec4f::zero());
+        green = simd_max(green, Vec4f::zero());
+        blue  = simd_max(blue,  Vec4f::zero());
+
+        // Find the largest value of the three color components
+        Vec4f maxValue = simd_max(blue, simd_max(red, green));
+
+        // Consider all values less than this to be zero. This constant comes
+        // from Ward's definition in "Real Pixels" (Graphics Gems II)
+        maskValid &= Vec4f(maxValue >= min_val);
+
+        // Extract the exponent from the IEEE single precision value
+        Vec4i biasedExponent = srl(castAsInt(maxValue), 23) & const_0xFF;
+        // Overflow
+        maskValid = andnot(castAsFloat(biasedExponent > const_253), maskValid);
+
+        // Construct an additive normalizer which is just 2^(exp+1).
+        // Adding this to each float will move the relevant mantissa bits to a
+        // known fixed location for easy extraction
+        Vec4f additiveNormalizer = castAsFloat(sll(biasedExponent+const_1, 23));
+        // Initially we keep an extra bit (9-bits) so that we can perform
+        // rounding to 8-bits in the next step
+        Vec4i rawR = srl(castAsInt(red  +additiveNormalizer), 14) & const_0x1FF;
+        Vec4i rawG = srl(castAsInt(green+additiveNormalizer), 14) & const_0x1FF;
+        Vec4i rawB = srl(castAsInt(blue +additiveNormalizer), 14) & const_0x1FF;
+        // rgbeBiasedExponent = (ieeeBiasedExponent-127) + 128 since IEEE single
+        // float and rgbe have different exponent bias values
+        Vec4i e = biasedExponent + const_1 + const_1;
+        // round to nearest representable 8 bit value
+        Vec4i rv = srl(rawR + const_1, 1);
+        Vec4i gv = srl(rawG + const_1, 1);
+        Vec4i bv = srl(rawB + const_1, 1);
+
+        // Check to see if rounding causes an overflow condition and fix if
+        // necessary. Note that we actually avoid branches
+        Vec4bi maskOverflow = (rv>const_0xFF) | (gv>const_0xFF) | (bv>const_0xFF);
+        e += Vec4i(maskOverflow) & const_1;
+        const Vec4i const_2 = const_1 + const_1;
+        Vec4i rOver = srl(rawR + const_2, 2);
+        Vec4i gOver = srl(rawG + const_2, 2);
+        Vec4i bOver = srl(rawB + const_2, 2);
+        rv = select(maskOverflow, rOver, rv);
+        gv = select(maskOverflow, gOver, gv);
+        bv = select(maskOverflow, bOver, bv);
+        // Overflow after rounding
+        Vec4i finalMask = andnot(Vec4i(e > const_0xFF), castAsInt(maskValid));
+
+        // Set to zero if the pixel is invalid, then build the final value
+        rv &= finalMask;
+        gv &= finalMask;
+        bv &= finalMask;
+        e &= finalMask;
+        vecRGBE[i] = sll(e, 24) | sll(bv, 16) | sll(gv, 8) | rv;
+    }
+}
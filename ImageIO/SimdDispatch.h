@@ -0,0 +1,114 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal support for the kernels compiled once per instruction set.
+//
+// A source file with dispatched kernels defines their entry points inside
+// namespace pcg::PCG_SIMD_NS. The build compiles it as usual, where
+// PCG_SIMD_NS is simd_base, and once more for each newer instruction set
+// through a generated file which defines PCG_SIMD_VARIANT as the namespace
+// (e.g. simd_avx2) and then includes the original source. Everything else
+// in the file, such as the public methods which pick the kernels with
+// PCG_SIMD_DISPATCH, must be within #if !PCG_SIMD_IS_VARIANT.
+
+#if !defined(PCG_SIMDDISPATCH_H)
+#define PCG_SIMDDISPATCH_H
+
+#include "CpuDispatch.h"
+
+#if defined(PCG_SIMD_VARIANT)
+# define PCG_SIMD_NS PCG_SIMD_VARIANT
+# define PCG_SIMD_IS_VARIANT 1
+#else
+# define PCG_SIMD_NS simd_base
+# define PCG_SIMD_IS_VARIANT 0
+#endif
+
+// Instruction sets with kernels besides the baseline, set by the build
+#if !defined(PCG_SIMD_HAVE_AVX)
+# define PCG_SIMD_HAVE_AVX 0
+#endif
+#if !defined(PCG_SIMD_HAVE_AVX2)
+# define PCG_SIMD_HAVE_AVX2 0
+#endif
+#if !defined(PCG_SIMD_HAVE_AVX512)
+# define PCG_SIMD_HAVE_AVX512 0
+#endif
+
+
+// Declares a kernel entry point for all the instruction sets, e.g.
+//   PCG_SIMD_DECLARE(void, Foo_Kernel, (float* values, size_t count))
+// The entry points must have distinct names, not overloads.
+#define PCG_SIMD_DECLARE(ret, name, args)          \
+    namespace pcg {                                \
+    namespace simd_base   { ret name args; }       \
+    namespace simd_avx    { ret name args; }       \
+    namespace simd_avx2   { ret name args; }       \
+    namespace simd_avx512 { ret name args; }       \
+    }
+
+#if PCG_SIMD_HAVE_AVX
+# define PCG_SIMD_KERNEL_AVX(name) &pcg::simd_avx::name
+#else
+# define PCG_SIMD_KERNEL_AVX(name) 0
+#endif
+#if PCG_SIMD_HAVE_AVX2
+# define PCG_SIMD_KERNEL_AVX2(name) &pcg::simd_avx2::name
+#else
+# define PCG_SIMD_KERNEL_AVX2(name) 0
+#endif
+#if PCG_SIMD_HAVE_AVX512
+# define PCG_SIMD_KERNEL_AVX512(name) &pcg::simd_avx512::name
+#else
+# define PCG_SIMD_KERNEL_AVX512(name) 0
+#endif
+
+// Pointer to the entry point for CpuDispatch::Current()
+#define PCG_SIMD_DISPATCH(name)                             \
+    pcg::simd_internal::select(&pcg::simd_base::name,       \
+        PCG_SIMD_KERNEL_AVX(name), PCG_SIMD_KERNEL_AVX2(name), \
+        PCG_SIMD_KERNEL_AVX512(name))
+
+
+namespace pcg
+{
+namespace simd_internal
+{
+
+// Keeps the other arguments of select out of the template deduction
+template <typename T>
+struct identity { typedef T type; };
+
+template <typename Fn>
+inline Fn select(Fn base, typename identity<Fn>::type avx,
+    typename identity<Fn>::type avx2, typename identity<Fn>::type avx512)
+{
+    const SimdLevel level = CpuDispatch::Current();
+    if (avx512 != 0 && level >= SIMD_AVX512) {
+        return avx512;
+    }
+    if (avx2 != 0 && level >= SIMD_AVX2) {
+        return avx2;
+    }
+    if (avx != 0 && level >= SIMD_AVX) {
+        return avx;
+    }
+    return base;
+}
+
+} // namespace simd_internal
+} // namespace pcg
+
+#endif /* PCG_SIMDDISPATCH_H */
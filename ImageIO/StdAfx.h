@@ -45,6 +45,15 @@
 # define ALIGN32_END __attribute__((aligned(32)))
 #endif
 
+/* 64 byte alignment for AVX-512 */
+#if defined(_MSC_VER) || defined(__ICC)
+# define ALIGN64_BEG __declspec(align(64))
+# define ALIGN64_END 
+#else
+# define ALIGN64_BEG
+# define ALIGN64_END __attribute__((aligned(64)))
+#endif
+
 /* Forcing inlining */
 #if defined(_MSC_VER) || defined(__ICC)
 # define FORCEINLINE_BEG __forceinline
@@ -0,0 +1,149 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "TiledImageSoA.h"
+#include "Exception.h"
+
+#include <cstring>
+
+#include <tbb/parallel_for.h>
+
+using pcg::TiledRGBAImageSoA;
+
+
+namespace
+{
+
+// Copies each tile to or from the scanline planes
+template <bool toTiles>
+struct TileCopyFunctor
+{
+    TileCopyFunctor(const TiledRGBAImageSoA &tiled,
+        const pcg::RGBAImageSoA &img) : m_tiled(tiled), m_img(img) {}
+
+    template <class ChannelSpec>
+    inline void copyPlane(const TiledRGBAImageSoA::Tile &tile) const
+    {
+        float *tilePlane = m_tiled.GetTilePlane<ChannelSpec>(tile.tx, tile.ty);
+        const size_t rowBytes = tile.width * sizeof(float);
+
+        for (int j = 0; j < tile.height; ++j) {
+            float *row = tilePlane + j * TiledRGBAImageSoA::TILE_SIZE;
+            float *scanline = m_img.GetScanlinePointer<ChannelSpec>(
+                tile.y + j, pcg::TopDown) + tile.x;
+            if (toTiles) {
+                memcpy(row, scanline, rowBytes);
+                std::fill(row + tile.width,
+                    row + TiledRGBAImageSoA::TILE_SIZE, 0.0f);
+            } else {
+                memcpy(scanline, row, rowBytes);
+            }
+        }
+        if (toTiles) {
+            std::fill(tilePlane + tile.height * TiledRGBAImageSoA::TILE_SIZE,
+                tilePlane + TiledRGBAImageSoA::TILE_PIXELS, 0.0f);
+        }
+    }
+
+    void operator() (const TiledRGBAImageSoA::TileRange &range) const
+    {
+        for (TiledRGBAImageSoA::TileIterator it = range.begin();
+             it != range.end(); ++it) {
+            const TiledRGBAImageSoA::Tile tile = *it;
+            copyPlane<TiledRGBAImageSoA::R>(tile);
+            copyPlane<TiledRGBAImageSoA::G>(tile);
+            copyPlane<TiledRGBAImageSoA::B>(tile);
+            copyPlane<TiledRGBAImageSoA::A>(tile);
+        }
+    }
+
+private:
+    const TiledRGBAImageSoA &m_tiled;
+    const pcg::RGBAImageSoA &m_img;
+};
+
+} // namespace
+
+
+
+// Definitions for the constants bound to references, as by std::min
+const int TiledRGBAImageSoA::NUM_CHANNELS;
+const int TiledRGBAImageSoA::TILE_SIZE;
+const int TiledRGBAImageSoA::TILE_PIXELS;
+
+
+
+void TiledRGBAImageSoA::Alloc(int w, int h)
+{
+    assert(w > 0 && h > 0);
+    Clear();
+    m_width  = w;
+    m_height = h;
+    m_tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_totalBytes = static_cast<size_t>(m_tilesX) * m_tilesY *
+        NUM_CHANNELS * TILE_PIXELS * sizeof(float);
+    m_allocator = ImageAllocator::Current();
+    m_data = static_cast<float*>(m_allocator->Allocate(m_totalBytes));
+    if (m_data == NULL) {
+        m_allocator = NULL;
+        m_totalBytes = 0;
+        m_width = m_height = m_tilesX = m_tilesY = 0;
+        throw RuntimeException("Couldn't allocate memory for the image.");
+    }
+}
+
+
+
+void TiledRGBAImageSoA::Clear()
+{
+    if (m_data != NULL) {
+        m_allocator->Release(m_data, m_totalBytes);
+        m_data = NULL;
+        m_totalBytes = 0;
+        m_allocator  = NULL;
+    }
+    m_width = m_height = 0;
+    m_tilesX = m_tilesY = 0;
+}
+
+
+
+void TiledRGBAImageSoA::CopyFrom(const RGBAImageSoA &img)
+{
+    if (img.Size() == 0) {
+        Clear();
+        return;
+    }
+    if (img.Width() != m_width || img.Height() != m_height) {
+        Alloc(img.Width(), img.Height());
+    }
+    tbb::parallel_for(Tiles(), TileCopyFunctor<true>(*this, img));
+}
+
+
+
+void TiledRGBAImageSoA::CopyTo(RGBAImageSoA &img) const
+{
+    if (Size() == 0) {
+        img.Clear();
+        return;
+    }
+    if (img.Width() != m_width || img.Height() != m_height) {
+        img.Alloc(m_width, m_height);
+    }
+    tbb::parallel_for(Tiles(), TileCopyFunctor<false>(*this, img));
+}
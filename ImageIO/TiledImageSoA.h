@@ -0,0 +1,320 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Tiled SoA layout for the operations which read 2D neighborhoods, such as
+// filters, resampling or local tone mapping. In the scanline layout each
+// step along a column jumps a whole scanline, whereas here the image is split
+// into square tiles of TILE_SIZE pixels stored one after the other, each with
+// its own R, G, B and A planes, so that a tile and its neighbors fit in the
+// cache. The tiles are processed through TileRange, which models the TBB
+// Range concept so that it may be given directly to tbb::parallel_for.
+
+#pragma once
+#if !defined(PCG_TILEDIMAGESOA_H)
+#define PCG_TILEDIMAGESOA_H
+
+#include "ImageIO.h"
+#include "ImageSoA.h"
+#include "ImageAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace pcg
+{
+
+class TiledRGBAImageSoA
+{
+public:
+    // Same channel tags as RGBAImageSoA
+    typedef RGBAImageSoA::R R;
+    typedef RGBAImageSoA::G G;
+    typedef RGBAImageSoA::B B;
+    typedef RGBAImageSoA::A A;
+
+    static const int NUM_CHANNELS = 4;
+
+    // Size in pixels of the side of the tiles
+    static const int TILE_SIZE = 64;
+
+    // Number of pixels in each tile plane, also its stride between tiles
+    static const int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+
+    // Location and planes of a single tile. The tiles on the right and bottom
+    // edges of the image contain less than TILE_SIZE valid pixels per side;
+    // their planes are still TILE_SIZE x TILE_SIZE, with TILE_SIZE as the
+    // stride between rows.
+    struct Tile
+    {
+        // Tile coordinates
+        int tx;
+        int ty;
+
+        // Pixel coordinates of the upper left corner
+        int x;
+        int y;
+
+        // Number of valid pixels in each direction
+        int width;
+        int height;
+
+        // Planes of the tile
+        float *r;
+        float *g;
+        float *b;
+        float *a;
+    };
+
+
+    // Forward iterator over the tiles of a TileRange, in scanline order
+    class TileIterator
+    {
+    public:
+        TileIterator() : m_img(NULL), m_tx(0), m_ty(0), m_txBegin(0),
+            m_txEnd(0) {}
+
+        Tile operator* () const {
+            return m_img->GetTile(m_tx, m_ty);
+        }
+
+        TileIterator& operator++ () {
+            if (++m_tx == m_txEnd) {
+                m_tx = m_txBegin;
+                ++m_ty;
+            }
+            return *this;
+        }
+
+        TileIterator operator++ (int) {
+            TileIterator tmp(*this);
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator== (const TileIterator &other) const {
+            return m_tx == other.m_tx && m_ty == other.m_ty;
+        }
+
+        bool operator!= (const TileIterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class TiledRGBAImageSoA;
+
+        TileIterator(const TiledRGBAImageSoA *img, int tx, int ty,
+            int txBegin, int txEnd) : m_img(img), m_tx(tx), m_ty(ty),
+            m_txBegin(txBegin), m_txEnd(txEnd) {}
+
+        const TiledRGBAImageSoA *m_img;
+        int m_tx;
+        int m_ty;
+        int m_txBegin;
+        int m_txEnd;
+    };
+
+
+    // Rectangular block of tiles. It splits in halves along its longest
+    // side until neither side has more than grainSize tiles.
+    class TileRange
+    {
+    public:
+        TileRange(const TiledRGBAImageSoA &img, int txBegin, int txEnd,
+            int tyBegin, int tyEnd, int grainSize = 1) :
+        m_img(&img), m_txBegin(txBegin), m_txEnd(txEnd),
+        m_tyBegin(tyBegin), m_tyEnd(tyEnd), m_grain(grainSize)
+        {
+            assert(0 <= txBegin && txBegin <= txEnd && txEnd <= img.TilesX());
+            assert(0 <= tyBegin && tyBegin <= tyEnd && tyEnd <= img.TilesY());
+            assert(grainSize > 0);
+        }
+
+        // Splitting constructor required by TBB, where Split is tbb::split.
+        // This range takes the second half, the other one keeps the first.
+        template <typename Split>
+        TileRange(TileRange &other, Split) : m_img(other.m_img),
+        m_txBegin(other.m_txBegin), m_txEnd(other.m_txEnd),
+        m_tyBegin(other.m_tyBegin), m_tyEnd(other.m_tyEnd),
+        m_grain(other.m_grain)
+        {
+            assert(other.is_divisible());
+            if ((m_txEnd - m_txBegin) >= (m_tyEnd - m_tyBegin)) {
+                m_txBegin = m_txBegin + (m_txEnd - m_txBegin) / 2;
+                other.m_txEnd = m_txBegin;
+            } else {
+                m_tyBegin = m_tyBegin + (m_tyEnd - m_tyBegin) / 2;
+                other.m_tyEnd = m_tyBegin;
+            }
+        }
+
+        bool empty() const {
+            return m_txBegin >= m_txEnd || m_tyBegin >= m_tyEnd;
+        }
+
+        bool is_divisible() const {
+            return (m_txEnd - m_txBegin) > m_grain ||
+                   (m_tyEnd - m_tyBegin) > m_grain;
+        }
+
+        // Number of tiles in the range
+        int size() const {
+            return empty() ? 0 :
+                (m_txEnd - m_txBegin) * (m_tyEnd - m_tyBegin);
+        }
+
+        TileIterator begin() const {
+            return empty() ? end() :
+                TileIterator(m_img, m_txBegin, m_tyBegin, m_txBegin, m_txEnd);
+        }
+
+        TileIterator end() const {
+            return TileIterator(m_img, m_txBegin, m_tyEnd, m_txBegin, m_txEnd);
+        }
+
+        int TileBeginX() const { return m_txBegin; }
+        int TileEndX()   const { return m_txEnd; }
+        int TileBeginY() const { return m_tyBegin; }
+        int TileEndY()   const { return m_tyEnd; }
+
+    private:
+        const TiledRGBAImageSoA *m_img;
+        int m_txBegin;
+        int m_txEnd;
+        int m_tyBegin;
+        int m_tyEnd;
+        int m_grain;
+    };
+
+
+
+    // Creates an empty image. To do anything useful afterwards you need
+    // to use the Alloc(int,int) method.
+    TiledRGBAImageSoA() : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0),
+        m_data(NULL), m_totalBytes(0), m_allocator(NULL) {}
+
+    // Creates a new image allocating the required space
+    TiledRGBAImageSoA(int w, int h) : m_width(0), m_height(0),
+        m_tilesX(0), m_tilesY(0), m_data(NULL), m_totalBytes(0),
+        m_allocator(NULL)
+    {
+        Alloc(w, h);
+    }
+
+    // Creates a tiled copy of the given image
+    explicit TiledRGBAImageSoA(const RGBAImageSoA &img) : m_width(0),
+        m_height(0), m_tilesX(0), m_tilesY(0), m_data(NULL), m_totalBytes(0),
+        m_allocator(NULL)
+    {
+        CopyFrom(img);
+    }
+
+    ~TiledRGBAImageSoA() {
+        Clear();
+    }
+
+    // Allocates new space for the image data, deleting the previous one.
+    // The contents are undefined.
+    void IMAGEIO_API Alloc(int w, int h);
+
+    // Deallocates the memory and resets the image dimensions to 0
+    void IMAGEIO_API Clear();
+
+    // Copies the pixels of a scanline image, reallocating this one if its
+    // size is different. The padding of the edge tiles is set to zero.
+    void IMAGEIO_API CopyFrom(const RGBAImageSoA &img);
+
+    // Copies the pixels into a scanline image, which is reallocated if its
+    // size is different
+    void IMAGEIO_API CopyTo(RGBAImageSoA &img) const;
+
+    int Width()  const { return m_width; }
+    int Height() const { return m_height; }
+
+    // Number of pixels in the image (Width*Height)
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(m_width)*m_height; }
+
+    // Number of tiles in each direction
+    int TilesX() const { return m_tilesX; }
+    int TilesY() const { return m_tilesY; }
+
+    int NumTiles() const { return m_tilesX * m_tilesY; }
+
+    // Range with all the tiles of the image
+    TileRange Tiles(int grainSize = 1) const {
+        return TileRange(*this, 0, m_tilesX, 0, m_tilesY, grainSize);
+    }
+
+    Tile GetTile(int tx, int ty) const
+    {
+        assert(tx >= 0 && tx < m_tilesX);
+        assert(ty >= 0 && ty < m_tilesY);
+        Tile tile;
+        tile.tx = tx;
+        tile.ty = ty;
+        tile.x  = tx * TILE_SIZE;
+        tile.y  = ty * TILE_SIZE;
+        tile.width  = std::min(TILE_SIZE, m_width  - tile.x);
+        tile.height = std::min(TILE_SIZE, m_height - tile.y);
+        tile.r = GetTilePlane<R>(tx, ty);
+        tile.g = GetTilePlane<G>(tx, ty);
+        tile.b = GetTilePlane<B>(tx, ty);
+        tile.a = GetTilePlane<A>(tx, ty);
+        return tile;
+    }
+
+    // Returns the plane of a channel within a tile
+    template <class ChannelSpec>
+    float* GetTilePlane(int tx, int ty) const
+    {
+        assert(tx >= 0 && tx < m_tilesX);
+        assert(ty >= 0 && ty < m_tilesY);
+        const ptrdiff_t tileIdx = static_cast<ptrdiff_t>(ty) * m_tilesX + tx;
+        return m_data +
+            (tileIdx * NUM_CHANNELS + ChannelSpec::IDX) * TILE_PIXELS;
+    }
+
+    // Returns a reference to the i-th pixel in the j-th scanline, with the
+    // scanlines in top-down order
+    template <class ChannelSpec>
+    float& ElementAt(int i, int j) const
+    {
+        assert(i >= 0 && i < m_width);
+        assert(j >= 0 && j < m_height);
+        float *plane = GetTilePlane<ChannelSpec>(i / TILE_SIZE, j / TILE_SIZE);
+        return plane[(j % TILE_SIZE) * TILE_SIZE + (i % TILE_SIZE)];
+    }
+
+private:
+    // Non-copyable
+    TiledRGBAImageSoA(const TiledRGBAImageSoA&);
+    TiledRGBAImageSoA& operator= (const TiledRGBAImageSoA&);
+
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+
+    float *m_data;
+
+    // Size of the block and allocator which provided it
+    size_t m_totalBytes;
+    ImageAllocator *m_allocator;
+};
+
+} // namespace pcg
+
+#endif /* PCG_TILEDIMAGESOA_H */
@@ -387,7 +387,7 @@ public:
 
     // Linear-style operator. This should only be used on files using the same
     // scanline mode
-    void operator()(const blocked_range<int>& r) const {
+    void operator()(const blocked_range<ptrdiff_t>& r) const {
 
         // Local copies of the variables
         const __m128 ones  = pcg::ToneMapper::ONES;
@@ -396,7 +396,7 @@ public:
         const Rgba32F expF = this->expF;
 
         if (lut != NULL) {
-            for (int i = r.begin(); i != r.end(); ++i) {
+            for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                 ToneMapKernel(src[i], dest[i], expF, ones, zeros, lutQ);
             }
         } else {
@@ -405,12 +405,12 @@ public:
                 (1<<(sizeof(typename T::pixel_t)<<3))-1));
 
             if (isSRGB) {
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     ToneMapKernel_sRGB(src[i], dest[i],
                         expF, ones, zeros, qFactor);
                 }
             } else {
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     ToneMapKernel_gamma(src[i], dest[i],
                         expF, ones, zeros, qFactor, tm.InvGamma());
                 }
@@ -510,15 +510,15 @@ public:
 
     // Linear-style operator. This should only be used on files using the
     // same scanline mode
-    void operator()(const blocked_range<int>& r) const
+    void operator()(const blocked_range<ptrdiff_t>& r) const
     {
-        const int end_sse = r.begin() + (r.size() & ~0x3);
+        const ptrdiff_t end_sse = r.begin() + (r.size() & ~0x3);
         assert (end_sse <= r.end());
-        for (int i = r.begin(); i < end_sse; i += 4) {
+        for (ptrdiff_t i = r.begin(); i < end_sse; i += 4) {
             ToneMapKernel4 (&src[i], &dest[i]);
         }
 
-        for (int i = end_sse; i < r.end(); ++i) {
+        for (ptrdiff_t i = end_sse; i < r.end(); ++i) {
             ToneMapKernel (src[i], dest[i]);
         }
     }
@@ -834,8 +834,9 @@ template<class T, ScanLineMode M>
 void ToneMap(Image<T, M> &dest, const Image<Rgba32F, M> &src, 
     const ToneMapper &tm, bool useLut, TmoTechnique technique) 
 {
-    const int numPixels = src.Size();
-    const blocked_range<int> range = blocked_range<int>(0,numPixels,4);
+    const ptrdiff_t numPixels = src.Size();
+    const blocked_range<ptrdiff_t> range =
+        blocked_range<ptrdiff_t>(0,numPixels,4);
     ToneMapHelper(dest, src, tm, useLut, technique, range);
 }
 
@@ -23,7 +23,10 @@
 #include "StdAfx.h"
 #include "ToneMapper.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "ImageIterators.h"
+#include "PlaneChunks.h"
+#include "SimdDispatch.h"
 #include "Vec4f.h"
 #include "Vec4i.h"
 
@@ -31,6 +34,10 @@
 # include "Vec8f.h"
 # include "Vec8i.h"
 #endif
+#if PCG_USE_AVX512
+# include "Vec16f.h"
+# include "Vec16i.h"
+#endif
 
 
 // FIXME Make this a setup flag
@@ -59,10 +66,70 @@ namespace ssemath
 
 #include <algorithm>
 #include <iterator>
+#include <cstring>
 
 #include <cassert>
 
 
+// Entry points of the kernels for each instruction set
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32F, (const ToneMapperSoA& tm,
+    Image<Bgra8, TopDown>& dest,
+    const Image<Rgba32F, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA16F, (const ToneMapperSoA& tm,
+    Image<Bgra8, TopDown>& dest,
+    const Image<Rgba16F, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FSoA, (const ToneMapperSoA& tm,
+    Image<Bgra8, TopDown>& dest,
+    const RGBAImageSoA& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA16FSoA, (const ToneMapperSoA& tm,
+    Image<Bgra8, TopDown>& dest,
+    const RGBA16FImageSoA& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBSoA, (const ToneMapperSoA& tm,
+    Image<Bgra8, TopDown>& dest,
+    const RGBImageSoA& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FView, (const ToneMapperSoA& tm,
+    const ImageView<Bgra8, TopDown>& dest,
+    const ImageView<Rgba32F, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FSoAView, (const ToneMapperSoA& tm,
+    const ImageView<Bgra8, TopDown>& dest,
+    const RGBAImageSoAView& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FView_RGBA8, (const ToneMapperSoA& tm,
+    const ImageView<Rgba8, TopDown>& dest,
+    const ImageView<Rgba32F, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FView_RGBA16, (const ToneMapperSoA& tm,
+    const ImageView<Rgba16, TopDown>& dest,
+    const ImageView<Rgba32F, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FSoAView_RGBA8, (const ToneMapperSoA& tm,
+    const ImageView<Rgba8, TopDown>& dest,
+    const RGBAImageSoAView& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBA32FSoAView_RGBA16, (const ToneMapperSoA& tm,
+    const ImageView<Rgba16, TopDown>& dest,
+    const RGBAImageSoAView& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBEView, (const ToneMapperSoA& tm,
+    const ImageView<Bgra8, TopDown>& dest,
+    const ImageView<Rgbe, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBEView_RGBA8, (const ToneMapperSoA& tm,
+    const ImageView<Rgba8, TopDown>& dest,
+    const ImageView<Rgbe, TopDown>& src,
+    TmoTechnique technique))
+PCG_SIMD_DECLARE(void, ToneMapperSoA_RGBEView_RGBA16, (const ToneMapperSoA& tm,
+    const ImageView<Rgba16, TopDown>& dest,
+    const ImageView<Rgbe, TopDown>& src,
+    TmoTechnique technique))
+
+
 namespace
 {
 
@@ -261,6 +328,173 @@ inline pcg::Vec8f zero() {
 
 #endif // PCG_USE_AVX
 
+
+
+#if PCG_USE_AVX512
+
+template <>
+inline pcg::Vec16f rcp(const pcg::Vec16f& x)
+{
+    return rcp_nr(x);
+}
+
+template <>
+inline pcg::Vec16f pow(const pcg::Vec16f& x, const pcg::Vec16f& y)
+{
+    const pcg::Vec16f result = ssemath::pow_avx512(x, y);
+    return result;
+}
+
+// There is no 16-wide version of the approximate math, use both halves
+template <>
+inline pcg::Vec16f fastpow(const pcg::Vec16f& x, const pcg::Vec16f& y)
+{
+    const __m256 lo = am::pow_avx(_mm512_extractf32x8_ps(x, 0),
+                                  _mm512_extractf32x8_ps(y, 0));
+    const __m256 hi = am::pow_avx(_mm512_extractf32x8_ps(x, 1),
+                                  _mm512_extractf32x8_ps(y, 1));
+    const pcg::Vec16f result =
+        _mm512_insertf32x8(_mm512_castps256_ps512(lo), hi, 1);
+    return result;
+}
+
+template <>
+inline pcg::Vec16i round(const pcg::Vec16f& x)
+{
+    return _mm512_cvtps_epi32(x);
+}
+
+template <>
+inline pcg::Vec16f select_gt(const pcg::Vec16f& a, const pcg::Vec16f& b,
+    const pcg::Vec16f& c, const pcg::Vec16f& d)
+{
+    return select(a > b, c, d);
+}
+
+template <>
+inline pcg::Vec16f min(const pcg::Vec16f& a, const pcg::Vec16f& b) {
+    return simd_min(a, b);
+}
+
+template <>
+inline pcg::Vec16f max(const pcg::Vec16f& a, const pcg::Vec16f& b) {
+    return simd_max(a, b);
+}
+
+template <>
+inline pcg::Vec16f zero() {
+    return _mm512_setzero_ps();
+}
+
+#endif // PCG_USE_AVX512
+
+
+// Linear interpolation in a DisplayLUT table: the index is the bit pattern
+// clamped to [base, 1] minus the base, shifted to keep only the top bits of
+// the mantissa; the rest is the interpolation weight. Clamping the integers
+// covers any input, there is no need to clamp the floats beforehand.
+template <typename T>
+inline T lookup(const float* table, int32_t base, int shift, const T& x)
+{
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(float));
+    const int32_t offset = std::min(std::max(bits, base),
+        static_cast<int32_t>(pcg::DisplayLUT::ONE_BITS)) - base;
+    const float* entry = table + (offset >> shift);
+    const float t = static_cast<float>(offset & ((1 << shift) - 1)) *
+        (1.0f / static_cast<float>(1 << shift));
+    return entry[0] + t * (entry[1] - entry[0]);
+}
+
+// There is no gather before AVX2, the entries are read one by one
+inline __m128 lookup_sse(const float* table, const __m128i& baseVec,
+    const __m128i& shiftVec, const __m128i& maskVec, const __m128& scaleVec,
+    const __m128& x)
+{
+    // There is no integer min/max before SSE4.1 either
+    const __m128i oneVec = _mm_set1_epi32(pcg::DisplayLUT::ONE_BITS);
+    __m128i bits = _mm_castps_si128(x);
+    const __m128i isLow = _mm_cmplt_epi32(bits, baseVec);
+    bits = _mm_or_si128(_mm_and_si128(isLow, baseVec),
+                        _mm_andnot_si128(isLow, bits));
+    const __m128i isHigh = _mm_cmpgt_epi32(bits, oneVec);
+    bits = _mm_or_si128(_mm_and_si128(isHigh, oneVec),
+                        _mm_andnot_si128(isHigh, bits));
+    const __m128i offset = _mm_sub_epi32(bits, baseVec);
+    const __m128 t = _mm_mul_ps(
+        _mm_cvtepi32_ps(_mm_and_si128(offset, maskVec)), scaleVec);
+
+    ALIGN16_BEG int32_t idx[4] ALIGN16_END;
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx),
+        _mm_srl_epi32(offset, shiftVec));
+    const __m128 y0 = _mm_setr_ps(table[idx[0]], table[idx[1]],
+                                  table[idx[2]], table[idx[3]]);
+    const __m128 y1 = _mm_setr_ps(table[idx[0]+1], table[idx[1]+1],
+                                  table[idx[2]+1], table[idx[3]+1]);
+    return _mm_add_ps(y0, _mm_mul_ps(t, _mm_sub_ps(y1, y0)));
+}
+
+template <>
+inline pcg::Vec4f lookup(const float* table, int32_t base, int shift,
+    const pcg::Vec4f& x)
+{
+    return lookup_sse(table, _mm_set1_epi32(base), _mm_cvtsi32_si128(shift),
+        _mm_set1_epi32((1 << shift) - 1),
+        _mm_set1_ps(1.0f / static_cast<float>(1 << shift)), x);
+}
+
+#if PCG_USE_AVX
+template <>
+inline pcg::Vec8f lookup(const float* table, int32_t base, int shift,
+    const pcg::Vec8f& x)
+{
+#if !PCG_USE_AVX2
+    const __m128i baseVec  = _mm_set1_epi32(base);
+    const __m128i shiftVec = _mm_cvtsi32_si128(shift);
+    const __m128i maskVec  = _mm_set1_epi32((1 << shift) - 1);
+    const __m128  scaleVec = _mm_set1_ps(1.0f / static_cast<float>(1 << shift));
+    const __m128 lo = lookup_sse(table, baseVec, shiftVec, maskVec, scaleVec,
+        _mm256_castps256_ps128(x));
+    const __m128 hi = lookup_sse(table, baseVec, shiftVec, maskVec, scaleVec,
+        _mm256_extractf128_ps(x, 1));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#else
+    const __m256i baseVec = _mm256_set1_epi32(base);
+    const __m256i offset = _mm256_sub_epi32(_mm256_min_epi32(
+        _mm256_max_epi32(_mm256_castps_si256(x), baseVec),
+        _mm256_set1_epi32(pcg::DisplayLUT::ONE_BITS)), baseVec);
+    const __m256i idx = _mm256_srl_epi32(offset, _mm_cvtsi32_si128(shift));
+    const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(
+        offset, _mm256_set1_epi32((1 << shift) - 1))),
+        _mm256_set1_ps(1.0f / static_cast<float>(1 << shift)));
+
+    const __m256 y0 = _mm256_i32gather_ps(table,     idx, 4);
+    const __m256 y1 = _mm256_i32gather_ps(table + 1, idx, 4);
+    return _mm256_add_ps(y0, _mm256_mul_ps(t, _mm256_sub_ps(y1, y0)));
+#endif
+}
+#endif // PCG_USE_AVX
+
+#if PCG_USE_AVX512
+template <>
+inline pcg::Vec16f lookup(const float* table, int32_t base, int shift,
+    const pcg::Vec16f& x)
+{
+    const __m512i baseVec = _mm512_set1_epi32(base);
+    const __m512i offset = _mm512_sub_epi32(_mm512_min_epi32(
+        _mm512_max_epi32(_mm512_castps_si512(x), baseVec),
+        _mm512_set1_epi32(pcg::DisplayLUT::ONE_BITS)), baseVec);
+    const __m512i idx = _mm512_srl_epi32(offset, _mm_cvtsi32_si128(shift));
+    const __m512 t = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(
+        offset, _mm512_set1_epi32((1 << shift) - 1))),
+        _mm512_set1_ps(1.0f / static_cast<float>(1 << shift)));
+
+    const __m512 y0 = _mm512_i32gather_ps(idx, table,     4);
+    const __m512 y1 = _mm512_i32gather_ps(idx, table + 1, 4);
+    return _mm512_add_ps(y0, _mm512_mul_ps(t, _mm512_sub_ps(y1, y0)));
+}
+#endif // PCG_USE_AVX512
+
 } // namespace ops
 
 
@@ -413,9 +647,41 @@ inline const pcg::Vec8f& getValue(const pcg::Vec8fUnion& value) {
 #endif // PCG_USE_AVX
 
 
+#if PCG_USE_AVX512
+
+// Helper function to set either a scalar or a float from a Vec16fUnion
+template <typename T>
+inline const T& getValue(const pcg::Vec16fUnion& value);
+
+template <>
+inline const float& MAY_BE_UNUSED getValue(const pcg::Vec16fUnion& value) {
+    return value.f[0];
+}
+
+template <>
+inline const pcg::Vec4f& getValue(const pcg::Vec16fUnion& value) {
+    return *reinterpret_cast<const pcg::Vec4f*>(&value.xmm[0]);
+}
+
+template <>
+inline const pcg::Vec8f& getValue(const pcg::Vec16fUnion& value) {
+    return *reinterpret_cast<const pcg::Vec8f*>(&value.ymm[0]);
+}
+
+template <>
+inline const pcg::Vec16f& getValue(const pcg::Vec16fUnion& value) {
+    return *reinterpret_cast<const pcg::Vec16f*>(&value.zmm);
+}
+
+#endif // PCG_USE_AVX512
+
+
 
 // Writing manually the same constant many times is error prone
-#if PCG_USE_AVX
+#if PCG_USE_AVX512
+#define PCG_TMOSOA_VECF(x) {x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x}
+typedef pcg::Vec16fUnion VecfUnion;
+#elif PCG_USE_AVX
 #define PCG_TMOSOA_VECF(x) {x, x, x, x, x, x, x, x}
 typedef pcg::Vec8fUnion VecfUnion;
 #else
@@ -426,9 +692,7 @@ typedef pcg::Vec4fUnion VecfUnion;
 static const VecfUnion ONE  = {PCG_TMOSOA_VECF( 1.0f )};
     
 static const VecfUnion Q_8bit  = {PCG_TMOSOA_VECF(   255.0f )};
-#if TONEMAPPERSOA_HAS_16BIT
 static const VecfUnion Q_16bit = {PCG_TMOSOA_VECF( 65535.0f )};
-#endif
 
 // Luminance conversion
 static const VecfUnion LVec[3] = {
@@ -641,6 +905,27 @@ private:
 };
 
 
+// Interpolates the table of the tone mapper (see DisplayLUT)
+template <typename T>
+struct DisplayTransformer_LUT
+{
+    DisplayTransformer_LUT(const pcg::DisplayLUT& lut) :
+    m_table(lut.Table()), m_base(lut.Base()), m_shift(23 - lut.Precision())
+    {}
+
+    inline T operator() (const T& x) const throw()
+    {
+        assert(m_table != NULL);
+        return ops::lookup(m_table, m_base, m_shift, x);
+    }
+
+private:
+    const float* m_table;
+    const int32_t m_base;
+    const int m_shift;
+};
+
+
 template <typename T>
 struct SRGB_NonLinear_Ref
 {
@@ -777,7 +1062,6 @@ struct Quantizer8bit
 };
 
 
-#if TONEMAPPERSOA_HAS_16BIT
 template <typename T, typename QT>
 struct Quantizer16bit
 {
@@ -789,7 +1073,6 @@ struct Quantizer16bit
         return ops::round<QT>(FACTOR * x);
     }
 };
-#endif // TONEMAPPERSOA_HAS_16BIT
 
 
 
@@ -815,11 +1098,26 @@ struct PixelAssembler_BGRA8
 
 
 
-struct PixelAssembler_BGRA8Vec4
+// Position of the red and blue channels within the packed 32-bit pixels. The
+// Rgba8 pixels use the same storage as the Bgra8 ones.
+struct BGRA8Layout
+{
+    enum { R_SHIFT = 16, B_SHIFT = 0 };
+};
+
+struct RGBA8Layout
+{
+    enum { R_SHIFT = 0, B_SHIFT = 16 };
+};
+
+
+
+template <class Layout>
+struct PixelAssembler_8bitVec4
 {
     typedef pcg::PixelBGRA8Vec4 pixel_t;
     typedef Quantizer8bit<pcg::Vec4f, pcg::Vec4i> quantizer_t;
-    typedef quantizer_t::value_t value_t;
+    typedef typename quantizer_t::value_t value_t;
 
     inline void operator() (
         const value_t& r, const value_t& g, const value_t& b, const value_t& a,
@@ -827,23 +1125,67 @@ struct PixelAssembler_BGRA8Vec4
     {
         // For some stupid reason the operator<< overload doesn't seem to work
         pcg::Vec4i aShift = _mm_slli_epi32(a, 24);
-        pcg::Vec4i rShift = _mm_slli_epi32(r, 16);
+        pcg::Vec4i rShift = _mm_slli_epi32(r, Layout::R_SHIFT);
         pcg::Vec4i gShift = _mm_slli_epi32(g, 8);
+        pcg::Vec4i bShift = _mm_slli_epi32(b, Layout::B_SHIFT);
 
-        const pcg::Vec4i pixel = aShift | rShift | gShift | b;
+        const pcg::Vec4i pixel = aShift | rShift | gShift | bShift;
         _mm_stream_si128(&outPixel.xmm, pixel);
     }
 };
 
+typedef PixelAssembler_8bitVec4<BGRA8Layout> PixelAssembler_BGRA8Vec4;
+typedef PixelAssembler_8bitVec4<RGBA8Layout> PixelAssembler_RGBA8Vec4;
+
+
+
+// Helper struct which represents 4 packed Rgba16 values
+struct PixelRGBA16Vec4
+{
+    union {
+        __m128i xmm[2];
+        uint16_t components[16];
+    };
+};
+
+struct PixelAssembler_RGBA16Vec4
+{
+    typedef PixelRGBA16Vec4 pixel_t;
+    typedef Quantizer16bit<pcg::Vec4f, pcg::Vec4i> quantizer_t;
+    typedef quantizer_t::value_t value_t;
+
+    // Interleaves the channels of 4 pixels: lo gets pixels 0-1, hi 2-3
+    static inline void build(const __m128i& r, const __m128i& g,
+        const __m128i& b, const __m128i& a, __m128i& lo, __m128i& hi) throw()
+    {
+        // Each 32-bit element holds two channels: [r | g<<16], [b | a<<16]
+        const __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+        const __m128i ba = _mm_or_si128(b, _mm_slli_epi32(a, 16));
+        lo = _mm_unpacklo_epi32(rg, ba);
+        hi = _mm_unpackhi_epi32(rg, ba);
+    }
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+        __m128i lo, hi;
+        build(r, g, b, a, lo, hi);
+        _mm_stream_si128(&outPixel.xmm[0], lo);
+        _mm_stream_si128(&outPixel.xmm[1], hi);
+    }
+};
+
 
 
 #if PCG_USE_AVX
 
-struct PixelAssembler_BGRA8Vec8
+template <class Layout>
+struct PixelAssembler_8bitVec8
 {
     typedef pcg::PixelBGRA8Vec8 pixel_t;
     typedef Quantizer8bit<pcg::Vec8f, pcg::Vec8i> quantizer_t;
-    typedef quantizer_t::value_t value_t;
+    typedef typename quantizer_t::value_t value_t;
 
 #if !PCG_USE_AVX2
     template <int offset>
@@ -858,10 +1200,11 @@ struct PixelAssembler_BGRA8Vec8
         pcg::Vec4i b0 = _mm256_extractf128_si256(b, offset);
 
         pcg::Vec4i a0Shift = _mm_slli_epi32(a0, 24);
-        pcg::Vec4i r0Shift = _mm_slli_epi32(r0, 16);
+        pcg::Vec4i r0Shift = _mm_slli_epi32(r0, Layout::R_SHIFT);
         pcg::Vec4i g0Shift = _mm_slli_epi32(g0, 8);
+        pcg::Vec4i b0Shift = _mm_slli_epi32(b0, Layout::B_SHIFT);
 
-        const pcg::Vec4i pixel = a0Shift | r0Shift | g0Shift | b0;
+        const pcg::Vec4i pixel = a0Shift | r0Shift | g0Shift | b0Shift;
         return pixel;
     }
 #endif /* !PCG_USE_AVX2 */
@@ -881,19 +1224,144 @@ struct PixelAssembler_BGRA8Vec8
             _mm256_insertf128_si256(_mm256_castsi128_si256(pix0), pix1, 1);
 #else
         pcg::Vec8i aShift = _mm256_slli_epi32(a, 24);
-        pcg::Vec8i rShift = _mm256_slli_epi32(r, 16);
+        pcg::Vec8i rShift = _mm256_slli_epi32(r, Layout::R_SHIFT);
         pcg::Vec8i gShift = _mm256_slli_epi32(g, 8);
+        pcg::Vec8i bShift = _mm256_slli_epi32(b, Layout::B_SHIFT);
 
-        const pcg::Vec8i pixel = aShift | rShift | gShift | b;
+        const pcg::Vec8i pixel = aShift | rShift | gShift | bShift;
 #endif /* !PCG_USE_AVX2 */
 
         _mm256_stream_si256(&outPixel.ymm, pixel);
     }
 };
 
+typedef PixelAssembler_8bitVec8<BGRA8Layout> PixelAssembler_BGRA8Vec8;
+typedef PixelAssembler_8bitVec8<RGBA8Layout> PixelAssembler_RGBA8Vec8;
+
+
+
+// Helper struct which represents 8 packed Rgba16 values
+struct PixelRGBA16Vec8
+{
+    union {
+        __m256i ymm[2];
+        __m128i xmm[4];
+        uint16_t components[32];
+    };
+};
+
+struct PixelAssembler_RGBA16Vec8
+{
+    typedef PixelRGBA16Vec8 pixel_t;
+    typedef Quantizer16bit<pcg::Vec8f, pcg::Vec8i> quantizer_t;
+    typedef quantizer_t::value_t value_t;
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+#if !PCG_USE_AVX2
+        // Without 256-bit integer operations assemble each half separately
+        __m128i p0, p1, p2, p3;
+        PixelAssembler_RGBA16Vec4::build(
+            _mm256_castsi256_si128(r), _mm256_castsi256_si128(g),
+            _mm256_castsi256_si128(b), _mm256_castsi256_si128(a), p0, p1);
+        PixelAssembler_RGBA16Vec4::build(
+            _mm256_extractf128_si256(r, 1), _mm256_extractf128_si256(g, 1),
+            _mm256_extractf128_si256(b, 1), _mm256_extractf128_si256(a, 1),
+            p2, p3);
+        const __m256i pixels0 =
+            _mm256_insertf128_si256(_mm256_castsi128_si256(p0), p1, 1);
+        const __m256i pixels1 =
+            _mm256_insertf128_si256(_mm256_castsi128_si256(p2), p3, 1);
+#else
+        const __m256i rg = _mm256_or_si256(r, _mm256_slli_epi32(g, 16));
+        const __m256i ba = _mm256_or_si256(b, _mm256_slli_epi32(a, 16));
+
+        // The unpack instructions work within each 128-bit lane:
+        // lo = [0 1 | 4 5], hi = [2 3 | 6 7]
+        const __m256i lo = _mm256_unpacklo_epi32(rg, ba);
+        const __m256i hi = _mm256_unpackhi_epi32(rg, ba);
+        const __m256i pixels0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+        const __m256i pixels1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+#endif /* !PCG_USE_AVX2 */
+
+        _mm256_stream_si256(&outPixel.ymm[0], pixels0);
+        _mm256_stream_si256(&outPixel.ymm[1], pixels1);
+    }
+};
+
 #endif // PCG_USE_AVX
 
 
+
+#if PCG_USE_AVX512
+
+template <class Layout>
+struct PixelAssembler_8bitVec16
+{
+    typedef pcg::PixelBGRA8Vec16 pixel_t;
+    typedef Quantizer8bit<pcg::Vec16f, pcg::Vec16i> quantizer_t;
+    typedef typename quantizer_t::value_t value_t;
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+        pcg::Vec16i aShift = _mm512_slli_epi32(a, 24);
+        pcg::Vec16i rShift = _mm512_slli_epi32(r, Layout::R_SHIFT);
+        pcg::Vec16i gShift = _mm512_slli_epi32(g, 8);
+        pcg::Vec16i bShift = _mm512_slli_epi32(b, Layout::B_SHIFT);
+
+        const pcg::Vec16i pixel = aShift | rShift | gShift | bShift;
+        _mm512_stream_si512(&outPixel.zmm, pixel);
+    }
+};
+
+typedef PixelAssembler_8bitVec16<BGRA8Layout> PixelAssembler_BGRA8Vec16;
+typedef PixelAssembler_8bitVec16<RGBA8Layout> PixelAssembler_RGBA8Vec16;
+
+
+
+// Helper struct which represents 16 packed Rgba16 values
+struct PixelRGBA16Vec16
+{
+    union {
+        __m512i zmm[2];
+        uint16_t components[64];
+    };
+};
+
+struct PixelAssembler_RGBA16Vec16
+{
+    typedef PixelRGBA16Vec16 pixel_t;
+    typedef Quantizer16bit<pcg::Vec16f, pcg::Vec16i> quantizer_t;
+    typedef quantizer_t::value_t value_t;
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+        const __m512i rg = _mm512_or_si512(r, _mm512_slli_epi32(g, 16));
+        const __m512i ba = _mm512_or_si512(b, _mm512_slli_epi32(a, 16));
+
+        // Within each 128-bit lane k the unpacks yield the 64-bit pixels
+        // lo = [4k 4k+1], hi = [4k+2 4k+3]; gather them back in order
+        const __m512i lo = _mm512_unpacklo_epi32(rg, ba);
+        const __m512i hi = _mm512_unpackhi_epi32(rg, ba);
+        const __m512i idx0 = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+        const __m512i idx1 = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+        const __m512i pixels0 = _mm512_permutex2var_epi64(lo, idx0, hi);
+        const __m512i pixels1 = _mm512_permutex2var_epi64(lo, idx1, hi);
+
+        _mm512_stream_si512(&outPixel.zmm[0], pixels0);
+        _mm512_stream_si512(&outPixel.zmm[1], pixels1);
+    }
+};
+
+#endif // PCG_USE_AVX512
+
+
 template <class LuminanceScaler>
 struct BlockSizeTraits
 {
@@ -996,98 +1464,464 @@ private:
 
 
 template <class Kernel, typename SourceIter, typename DestIter>
-void processPixels(const Kernel& kernel, 
+void processPixels(const Kernel& kernel,
+    const pcg::PlaneChunks<SourceIter>& chunks,
     SourceIter begin, SourceIter end, DestIter dest)
 {
     ProcessorTBB<SourceIter, DestIter, Kernel> pTBB(begin, dest, kernel);
-    tbb::blocked_range<SourceIter> range(begin, end);
     
 #if 1
-    tbb::parallel_for(range, pTBB);
+    chunks.parallelFor(begin, end, 1, pTBB);
 #else
+    tbb::blocked_range<SourceIter> range(begin, end);
     pTBB(range);
 #endif
 }
 
 
-template<class LuminanceScaler, class DisplayTransformer, class PixelAssembler>
-ToneMappingKernel<LuminanceScaler, DisplayTransformer, PixelAssembler>
-setupKernel(const LuminanceScaler& luminanceScaler,
-            const DisplayTransformer& displayTransformer,
-            const PixelAssembler& pixelAssembler)
+// Contiguous range of source vectors, with enough padding at the end of
+// both the source and the destination to process whole vectors. The range
+// is split as the chunks of the source pixels, if any.
+template <typename SourceIter, typename DestIter>
+class LinearRegion
 {
-    ToneMappingKernel<LuminanceScaler,DisplayTransformer,PixelAssembler>
-        kernel(luminanceScaler, displayTransformer, pixelAssembler);
-    return kernel;
-}
-
-
+public:
+    // Contiguous destinations are always Bgra8 images
+    typedef pcg::Bgra8 pixel_t;
 
+    LinearRegion(SourceIter begin, SourceIter end, DestIter dest,
+        const pcg::PlaneChunks<SourceIter>& chunks) :
+    m_begin(begin), m_end(end), m_dest(dest), m_chunks(chunks)
+    {}
 
-// Traits to choose a pixel assembler
-template <typename LuminanceScalerValueType, typename DestinationType>
-struct pixel_assembler_traits;
+    template <class Kernel>
+    void process(const Kernel& kernel) const
+    {
+        processPixels(kernel, m_chunks, m_begin, m_end, m_dest);
+    }
 
-#if !USE_VECTOR4_ITERATOR
-template <>
-struct pixel_assembler_traits<float, pcg::Bgra8>
-{
-    typedef PixelAssembler_BGRA8 assembler_t;
+private:
+    SourceIter m_begin;
+    SourceIter m_end;
+    DestIter   m_dest;
+    pcg::PlaneChunks<SourceIter> m_chunks;
 };
-#endif
 
-template <>
-struct pixel_assembler_traits<pcg::Vec4f, pcg::Bgra8>
+template <typename SourceIter, typename DestIter>
+inline LinearRegion<SourceIter, DestIter>
+linearRegion(SourceIter begin, SourceIter end, DestIter dest)
 {
-    typedef PixelAssembler_BGRA8Vec4 assembler_t;
-};
+    return LinearRegion<SourceIter, DestIter>(begin, end, dest,
+        pcg::PlaneChunks<SourceIter>());
+}
 
-#if PCG_USE_AVX
-template <>
-struct pixel_assembler_traits<pcg::Vec8f, pcg::Bgra8>
+// Region over the pixels of an ImageSoA, processed in the chunks placed by
+// its allocator
+template <typename SourceIter, typename DestIter>
+inline LinearRegion<SourceIter, DestIter>
+linearRegion(const pcg::ImageSoABase& src,
+    SourceIter begin, SourceIter end, DestIter dest, ptrdiff_t pixelsPerStep)
 {
-    typedef PixelAssembler_BGRA8Vec8 assembler_t;
-};
-#endif
+    return LinearRegion<SourceIter, DestIter>(begin, end, dest,
+        pcg::PlaneChunks<SourceIter>(&src, begin, pixelsPerStep));
+}
 
 
 
-template <class LuminanceScaler, class DisplayTransform, typename SourceIter, typename DestIter>
-void ToneMapAux(const LuminanceScaler &scaler, const DisplayTransform &display,
-    SourceIter begin, SourceIter end, DestIter dest)
+// Number of pixels per staging buffer when processing views
+const int VIEW_CHUNK = 64;
+
+// Scanlines of an AoS view, read 4 pixels at a time
+class AoSViewRows
 {
-    typedef typename pixel_assembler_traits<typename LuminanceScaler::value_t,
-        pcg::Bgra8>::assembler_t assembler_t;
-    assembler_t assembler;
-    typedef ToneMappingKernel<LuminanceScaler, DisplayTransform,
-        assembler_t> kernel_t;
+public:
+    typedef pcg::RGBA32FVec4ImageIterator iterator;
+    static const int VEC_LEN = 4;
 
-    kernel_t kernel=setupKernel(scaler, display, assembler);
-    processPixels(kernel, begin, end, dest);
-}
+    struct Buffer
+    {
+        pcg::Rgba32F pixels[VIEW_CHUNK];
+    };
 
+    AoSViewRows(const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& view) :
+    m_view(view)
+    {}
 
-enum DisplayMethod
-{
-    EDISPLAY_GAMMA_REF,
-    EDISPLAY_GAMMA_FAST,
-    EDISPLAY_SRGB_REF,
-    EDISPLAY_SRGB_FAST1,
-    EDISPLAY_SRGB_FAST2
-};
+    inline bool isContiguous() const {
+        return m_view.IsContiguous();
+    }
 
-inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
-{
-    if (tm.isSRGB()) {
-        switch (tm.SRGBMethod()) {
-        case pcg::ToneMapperSoA::SRGB_REF:
-            return EDISPLAY_SRGB_REF;
-        case pcg::ToneMapperSoA::SRGB_FAST1:
-            return EDISPLAY_SRGB_FAST1;
-        case pcg::ToneMapperSoA::SRGB_FAST2:
-            return EDISPLAY_SRGB_FAST2;
-        default:
-            throw pcg::RuntimeException("Unexpected sRGB method");
+    // Views over external memory need not honor the alignment of Rgba32F,
+    // while the iterator reads whole aligned vectors
+    inline bool isAligned(int j, ptrdiff_t x) const {
+        return reinterpret_cast<uintptr_t>(m_view.GetScanlinePointer(j) + x) %
+            sizeof(__m128) == 0;
+    }
+
+    inline iterator at(int j, ptrdiff_t x) const {
+        return iterator(m_view.GetScanlinePointer(j) + x);
+    }
+
+    // Copies the pixels into the buffer, zeroing the rest of the last vector
+    iterator stage(Buffer& buf, int j, ptrdiff_t x, int count) const
+    {
+        // The source may be unaligned, only the buffer is read as vectors
+        const pcg::Rgba32F* src = m_view.GetScanlinePointer(j) + x;
+        std::copy(src, src + count, buf.pixels);
+        for (int i = count; i % VEC_LEN != 0; ++i) {
+            buf.pixels[i].zero();
+        }
+        return iterator(buf.pixels);
+    }
+
+private:
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& m_view;
+};
+
+// Scanlines of a SoA view, read N pixels at a time
+template <int N>
+class SoAViewRows
+{
+public:
+    typedef pcg::RGBA32FVecImageSoAIterator<N> iterator;
+    typedef typename pcg::RGBA32FVec_traits<N>::value_type vec_t;
+    static const int VEC_LEN = N;
+
+    struct Buffer
+    {
+        vec_t r[VIEW_CHUNK/N];
+        vec_t g[VIEW_CHUNK/N];
+        vec_t b[VIEW_CHUNK/N];
+        vec_t a[VIEW_CHUNK/N];
+    };
+
+    SoAViewRows(const pcg::RGBAImageSoAView& view) : m_view(view)
+    {}
+
+    inline bool isContiguous() const {
+        return m_view.IsContiguous();
+    }
+
+    inline bool isAligned(int j, ptrdiff_t x) const {
+        return isAligned(m_view.GetScanlinePointer<R>(j) + x) &&
+               isAligned(m_view.GetScanlinePointer<G>(j) + x) &&
+               isAligned(m_view.GetScanlinePointer<B>(j) + x) &&
+               isAligned(m_view.GetScanlinePointer<A>(j) + x);
+    }
+
+    inline iterator at(int j, ptrdiff_t x) const {
+        return iterator::begin(m_view.GetScanlinePointer<R>(j) + x,
+                               m_view.GetScanlinePointer<G>(j) + x,
+                               m_view.GetScanlinePointer<B>(j) + x,
+                               m_view.GetScanlinePointer<A>(j) + x);
+    }
+
+    // Copies the pixels into the buffer, zeroing the rest of the last vector
+    iterator stage(Buffer& buf, int j, ptrdiff_t x, int count) const
+    {
+        float* r = reinterpret_cast<float*>(buf.r);
+        float* g = reinterpret_cast<float*>(buf.g);
+        float* b = reinterpret_cast<float*>(buf.b);
+        float* a = reinterpret_cast<float*>(buf.a);
+        stage(r, m_view.GetScanlinePointer<R>(j) + x, count);
+        stage(g, m_view.GetScanlinePointer<G>(j) + x, count);
+        stage(b, m_view.GetScanlinePointer<B>(j) + x, count);
+        stage(a, m_view.GetScanlinePointer<A>(j) + x, count);
+        return iterator::begin(r, g, b, a);
+    }
+
+private:
+    typedef pcg::RGBAImageSoAView::R R;
+    typedef pcg::RGBAImageSoAView::G G;
+    typedef pcg::RGBAImageSoAView::B B;
+    typedef pcg::RGBAImageSoAView::A A;
+
+    static inline bool isAligned(const float* ptr) {
+        return reinterpret_cast<uintptr_t>(ptr) % sizeof(vec_t) == 0;
+    }
+
+    static inline void stage(float* dest, const float* src, int count) {
+        std::copy(src, src + count, dest);
+        std::fill(dest + count, dest + ((count + N-1) & ~(N-1)), 0.0f);
+    }
+
+    const pcg::RGBAImageSoAView& m_view;
+};
+
+// Scanlines of an RGBE view, decoded N pixels at a time
+template <int N>
+class RgbeViewRows
+{
+public:
+    typedef pcg::RgbeVecImageIterator<N> iterator;
+    static const int VEC_LEN = N;
+
+    struct Buffer
+    {
+        pcg::Rgbe pixels[VIEW_CHUNK];
+    };
+
+    RgbeViewRows(const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& view) :
+    m_view(view)
+    {}
+
+    inline bool isContiguous() const {
+        return m_view.IsContiguous();
+    }
+
+    // The pixels are read with unaligned loads
+    inline bool isAligned(int, ptrdiff_t) const {
+        return true;
+    }
+
+    inline iterator at(int j, ptrdiff_t x) const {
+        return iterator(m_view.GetScanlinePointer(j) + x);
+    }
+
+    // Copies the pixels into the buffer, zeroing the rest of the last vector
+    iterator stage(Buffer& buf, int j, ptrdiff_t x, int count) const
+    {
+        const pcg::Rgbe* src = m_view.GetScanlinePointer(j) + x;
+        std::copy(src, src + count, buf.pixels);
+        std::fill(buf.pixels + count, buf.pixels + ((count + N-1) & ~(N-1)),
+            pcg::Rgbe());
+        return iterator(buf.pixels);
+    }
+
+private:
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& m_view;
+};
+
+
+
+// Views may have arbitrary strides and no padding at all. Scanlines are
+// processed in parallel, whole vectors in place when the memory is suitably
+// aligned; everything else goes through small aligned buffers, so that
+// nothing outside the views is ever touched. Contiguous views are treated
+// as a single, very long scanline.
+template <class SourceRows, typename DestVec, typename DestPixel>
+class ViewRegion
+{
+public:
+    typedef DestPixel pixel_t;
+
+    ViewRegion(const SourceRows& src,
+        const pcg::ImageView<DestPixel, pcg::TopDown>& dest) :
+    m_src(src), m_dest(dest)
+    {}
+
+    template <class Kernel>
+    void process(const Kernel& kernel) const
+    {
+        const bool isLinear = m_src.isContiguous() && m_dest.IsContiguous();
+        const Processor<Kernel> p(*this, kernel, isLinear);
+        if (isLinear) {
+            const ptrdiff_t numVectors = (m_dest.Size() + N-1) / N;
+            tbb::parallel_for(
+                tbb::blocked_range<ptrdiff_t>(0, numVectors, VIEW_CHUNK/N), p);
+        } else {
+            tbb::parallel_for(
+                tbb::blocked_range<ptrdiff_t>(0, m_dest.Height()), p);
+        }
+    }
+
+private:
+    static const int N = SourceRows::VEC_LEN;
+    typedef typename SourceRows::iterator SourceIter;
+
+    // The widest stores are at most 64 bytes
+    static const size_t DEST_ALIGNMENT =
+        sizeof(DestVec) < 64 ? sizeof(DestVec) : 64;
+
+    template <class Kernel>
+    class Processor
+    {
+    public:
+        Processor(const ViewRegion& region, const Kernel& kernel,
+            bool isLinear) :
+        m_region(region), m_kernel(kernel), m_isLinear(isLinear)
+        {}
+
+        // The range is either the vectors of the single scanline of
+        // contiguous views, or full scanlines
+        void operator() (const tbb::blocked_range<ptrdiff_t>& range) const {
+            if (m_isLinear) {
+                const ptrdiff_t end =
+                    std::min(N * range.end(), m_region.m_dest.Size());
+                m_region.processSegment(m_kernel, 0, N * range.begin(), end);
+            } else {
+                for (ptrdiff_t j = range.begin(); j != range.end(); ++j) {
+                    m_region.processSegment(m_kernel, static_cast<int>(j), 0,
+                        m_region.m_dest.Width());
+                }
+            }
+        }
+
+    private:
+        const ViewRegion& m_region;
+        const Kernel& m_kernel;
+        const bool m_isLinear;
+    };
+
+    template <class Kernel>
+    void processSegment(const Kernel& kernel, int j,
+        ptrdiff_t begin, ptrdiff_t end) const
+    {
+        DestPixel* out = m_dest.GetScanlinePointer(j) + begin;
+        const ptrdiff_t count = end - begin;
+        ptrdiff_t done = 0;
+
+        if (m_src.isAligned(j, begin) &&
+            reinterpret_cast<uintptr_t>(out) % DEST_ALIGNMENT == 0) {
+            done = count - (count % N);
+            const SourceIter it = m_src.at(j, begin);
+            kernel(it, it + done/N, reinterpret_cast<DestVec*>(out));
+        }
+
+        while (done < count) {
+            const int n = static_cast<int>(
+                std::min(count - done, static_cast<ptrdiff_t>(VIEW_CHUNK)));
+            typename SourceRows::Buffer buf;
+            DestVec outBuf[VIEW_CHUNK/N];
+            const SourceIter it = m_src.stage(buf, j, begin + done, n);
+            kernel(it, it + (n + N-1)/N, outBuf);
+            std::copy(reinterpret_cast<const DestPixel*>(outBuf),
+                reinterpret_cast<const DestPixel*>(outBuf) + n, out + done);
+            done += n;
+        }
+    }
+
+    const SourceRows& m_src;
+    const pcg::ImageView<DestPixel, pcg::TopDown>& m_dest;
+};
+
+
+
+template<class LuminanceScaler, class DisplayTransformer, class PixelAssembler>
+ToneMappingKernel<LuminanceScaler, DisplayTransformer, PixelAssembler>
+setupKernel(const LuminanceScaler& luminanceScaler,
+            const DisplayTransformer& displayTransformer,
+            const PixelAssembler& pixelAssembler)
+{
+    ToneMappingKernel<LuminanceScaler,DisplayTransformer,PixelAssembler>
+        kernel(luminanceScaler, displayTransformer, pixelAssembler);
+    return kernel;
+}
+
+
+
+
+// Traits to choose a pixel assembler
+template <typename LuminanceScalerValueType, typename DestinationType>
+struct pixel_assembler_traits;
+
+#if !USE_VECTOR4_ITERATOR
+template <>
+struct pixel_assembler_traits<float, pcg::Bgra8>
+{
+    typedef PixelAssembler_BGRA8 assembler_t;
+};
+#endif
+
+template <>
+struct pixel_assembler_traits<pcg::Vec4f, pcg::Bgra8>
+{
+    typedef PixelAssembler_BGRA8Vec4 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec4f, pcg::Rgba8>
+{
+    typedef PixelAssembler_RGBA8Vec4 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec4f, pcg::Rgba16>
+{
+    typedef PixelAssembler_RGBA16Vec4 assembler_t;
+};
+
+#if PCG_USE_AVX
+template <>
+struct pixel_assembler_traits<pcg::Vec8f, pcg::Bgra8>
+{
+    typedef PixelAssembler_BGRA8Vec8 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec8f, pcg::Rgba8>
+{
+    typedef PixelAssembler_RGBA8Vec8 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec8f, pcg::Rgba16>
+{
+    typedef PixelAssembler_RGBA16Vec8 assembler_t;
+};
+#endif
+
+#if PCG_USE_AVX512
+template <>
+struct pixel_assembler_traits<pcg::Vec16f, pcg::Bgra8>
+{
+    typedef PixelAssembler_BGRA8Vec16 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec16f, pcg::Rgba8>
+{
+    typedef PixelAssembler_RGBA8Vec16 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec16f, pcg::Rgba16>
+{
+    typedef PixelAssembler_RGBA16Vec16 assembler_t;
+};
+#endif
+
+
+
+template <class LuminanceScaler, class DisplayTransform, class Region>
+void ToneMapAux(const LuminanceScaler &scaler, const DisplayTransform &display,
+    const Region &region)
+{
+    typedef typename pixel_assembler_traits<typename LuminanceScaler::value_t,
+        typename Region::pixel_t>::assembler_t assembler_t;
+    assembler_t assembler;
+    typedef ToneMappingKernel<LuminanceScaler, DisplayTransform,
+        assembler_t> kernel_t;
+
+    kernel_t kernel=setupKernel(scaler, display, assembler);
+    region.process(kernel);
+}
+
+
+enum DisplayMethod
+{
+    EDISPLAY_GAMMA_REF,
+    EDISPLAY_GAMMA_FAST,
+    EDISPLAY_SRGB_REF,
+    EDISPLAY_SRGB_FAST1,
+    EDISPLAY_SRGB_FAST2,
+    EDISPLAY_LUT
+};
+
+inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
+{
+    if (tm.isSRGB()) {
+        switch (tm.SRGBMethod()) {
+        case pcg::ToneMapperSoA::SRGB_REF:
+            return EDISPLAY_SRGB_REF;
+        case pcg::ToneMapperSoA::SRGB_FAST1:
+            return EDISPLAY_SRGB_FAST1;
+        case pcg::ToneMapperSoA::SRGB_FAST2:
+            return EDISPLAY_SRGB_FAST2;
+        case pcg::ToneMapperSoA::SRGB_LUT:
+            return EDISPLAY_LUT;
+        default:
+            throw pcg::RuntimeException("Unexpected sRGB method");
         }
     }
     else {
@@ -1096,6 +1930,8 @@ inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
             return EDISPLAY_GAMMA_REF;
         case pcg::ToneMapperSoA::GAMMA_FAST:
             return EDISPLAY_GAMMA_FAST;
+        case pcg::ToneMapperSoA::GAMMA_LUT:
+            return EDISPLAY_LUT;
         default:
             throw pcg::RuntimeException("Unexpected gamma method");
         }
@@ -1104,9 +1940,9 @@ inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
 
 
 
-template <class LuminanceScaler, typename SourceIter, typename DestIter>
+template <class LuminanceScaler, class Region>
 void ToneMapAuxDelegate(const LuminanceScaler& scaler, DisplayMethod dMethod,
-    float invGamma, SourceIter begin, SourceIter end, DestIter dest)
+    float invGamma, const pcg::DisplayLUT& lut, const Region& region)
 {
     // Setup the display transforms
     typedef typename LuminanceScaler::value_t value_t;
@@ -1115,50 +1951,161 @@ void ToneMapAuxDelegate(const LuminanceScaler& scaler, DisplayMethod dMethod,
     const typename Display_sRGB_Ref<value_t>::display_t   displaySRGB0;
     const typename Display_sRGB_Fast1<value_t>::display_t displaySRGB1;
     const typename Display_sRGB_Fast2<value_t>::display_t displaySRGB2;
+    const DisplayTransformer_LUT<value_t> displayLUT(lut);
 
     switch(dMethod) {
     case EDISPLAY_GAMMA_REF:
-        ToneMapAux(scaler, displayGamma, begin, end, dest);
+        ToneMapAux(scaler, displayGamma, region);
         break;
     case EDISPLAY_GAMMA_FAST:
-        ToneMapAux(scaler, displayGammaFast, begin, end, dest);
+        ToneMapAux(scaler, displayGammaFast, region);
         break;
     case EDISPLAY_SRGB_REF:
-        ToneMapAux(scaler, displaySRGB0, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB0, region);
         break;
     case EDISPLAY_SRGB_FAST1:
-        ToneMapAux(scaler, displaySRGB1, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB1, region);
         break;
     case EDISPLAY_SRGB_FAST2:
-        ToneMapAux(scaler, displaySRGB2, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB2, region);
+        break;
+    case EDISPLAY_LUT:
+        ToneMapAux(scaler, displayLUT, region);
         break;
     default:
         throw pcg::IllegalArgumentException("Unknown display method");
     }
 }
 
-} // namespace
 
 
+// Sets up the luminance scaler for the technique and tone maps the range
+template <typename ScalerValueType, class Region>
+void ToneMapRange(pcg::TmoTechnique technique, float exposureFactor,
+    const pcg::Reinhard02::Params& params, DisplayMethod dMethod,
+    float invGamma, const pcg::DisplayLUT& lut, const Region& region)
+{
+    LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
+    LuminanceScaler_Exposure<ScalerValueType>   sExposure;
+
+    switch(technique) {
+    case pcg::REINHARD02:
+        sReinhard02.setExposureFactor(exposureFactor);
+        sReinhard02.SetParams(params);
+        ToneMapAuxDelegate(sReinhard02, dMethod, invGamma, lut, region);
+        break;
+    case pcg::EXPOSURE:
+        sExposure.setExposureFactor(exposureFactor);
+        ToneMapAuxDelegate(sExposure, dMethod, invGamma, lut, region);
+        break;
+    default:
+        throw pcg::IllegalArgumentException("Invalid tone mapping technique");
+        break;
+    }
+}
+
+
+
+// Tone maps an AoS view into any destination pixel type
+template <typename DestPixel>
+void ToneMapAoSView(const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<DestPixel, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+    typedef typename pixel_assembler_traits<pcg::Vec4f,
+        DestPixel>::assembler_t::pixel_t PixelVec;
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+    const AoSViewRows rows(src);
+    const ViewRegion<AoSViewRows, PixelVec, DestPixel> region(rows, dest);
+    ToneMapRange<pcg::Vec4f>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(), region);
+}
+
 
 
-void pcg::ToneMapperSoA::SetExposure(float exposure)
+// Tone maps a SoA view into any destination pixel type
+template <typename DestPixel>
+void ToneMapSoAView(const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<DestPixel, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique)
 {
-    m_exposure = exposure;
-    m_exposureFactor = pow(2.0f, exposure);
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+#if PCG_USE_AVX512
+    typedef SoAViewRows<16> Rows;
+    typedef pcg::Vec16f ScalerValueType;
+#elif PCG_USE_AVX
+    typedef SoAViewRows<8> Rows;
+    typedef pcg::Vec8f ScalerValueType;
+#else
+    typedef SoAViewRows<4> Rows;
+    typedef pcg::Vec4f ScalerValueType;
+#endif
+    typedef typename pixel_assembler_traits<ScalerValueType,
+        DestPixel>::assembler_t::pixel_t PixelVec;
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+    const Rows rows(src);
+    const ViewRegion<Rows, PixelVec, DestPixel> region(rows, dest);
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(), region);
 }
 
 
 
-void pcg::ToneMapperSoA::ToneMap(
+// Tone maps an RGBE view into any destination pixel type. The pixels are
+// decoded within the kernel, the float values never reach memory.
+template <typename DestPixel>
+void ToneMapRgbeView(const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<DestPixel, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+#if PCG_USE_AVX512
+    typedef RgbeViewRows<16> Rows;
+    typedef pcg::Vec16f ScalerValueType;
+#elif PCG_USE_AVX
+    typedef RgbeViewRows<8> Rows;
+    typedef pcg::Vec8f ScalerValueType;
+#else
+    typedef RgbeViewRows<4> Rows;
+    typedef pcg::Vec4f ScalerValueType;
+#endif
+    typedef typename pixel_assembler_traits<ScalerValueType,
+        DestPixel>::assembler_t::pixel_t PixelVec;
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+    const Rows rows(src);
+    const ViewRegion<Rows, PixelVec, DestPixel> region(rows, dest);
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(), region);
+}
+
+} // namespace
+
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32F(
+    const pcg::ToneMapperSoA& tm,
     pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
     const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
-    pcg::TmoTechnique technique) const
+    pcg::TmoTechnique technique)
 {
     assert(src.Width()  == dest.Width());
     assert(src.Height() == dest.Height());
 
-    const DisplayMethod dMethod(getDisplayMethod(*this));
+    const DisplayMethod dMethod(getDisplayMethod(tm));
 
 #if !USE_VECTOR4_ITERATOR
     const pcg::Rgba32F* begin = src.GetDataPointer();
@@ -1171,38 +2118,52 @@ void pcg::ToneMapperSoA::ToneMap(
     PixelBGRA8Vec4* out            = PixelBGRA8Vec4::begin(dest);
     typedef Vec4f ScalerValueType;
 #endif
-    LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
-    LuminanceScaler_Exposure<ScalerValueType>   sExposure;
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(),
+        linearRegion(begin, end, out));
+}
 
-    switch(technique) {
-    case pcg::REINHARD02:
-        sReinhard02.setExposureFactor(this->m_exposureFactor);
-        sReinhard02.SetParams(this->ParamsReinhard02());
-        ToneMapAuxDelegate(sReinhard02, dMethod, m_invGamma, begin, end, out);
-        break;
-    case pcg::EXPOSURE:
-        sExposure.setExposureFactor(this->m_exposureFactor);
-        ToneMapAuxDelegate(sExposure, dMethod, m_invGamma, begin, end, out);
-        break;
-    default:
-        throw IllegalArgumentException("Invalid tone mapping technique");
-        break;
-    }
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA16F(
+    const pcg::ToneMapperSoA& tm,
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgba16F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+
+    // The pixels are widened to float within the kernel
+    RGBA16FVec4ImageIterator begin = RGBA16FVec4ImageIterator::begin(src);
+    RGBA16FVec4ImageIterator end   = RGBA16FVec4ImageIterator::end(src);
+    PixelBGRA8Vec4* out            = PixelBGRA8Vec4::begin(dest);
+
+    ToneMapRange<Vec4f>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(),
+        linearRegion(begin, end, out));
 }
 
 
 
-void pcg::ToneMapperSoA::ToneMap(
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FSoA(
+    const pcg::ToneMapperSoA& tm,
     pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
     const pcg::RGBAImageSoA& src,
-    pcg::TmoTechnique technique) const
+    pcg::TmoTechnique technique)
 {
     assert(src.Width()  == dest.Width());
     assert(src.Height() == dest.Height());
 
-    const DisplayMethod dMethod(getDisplayMethod(*this));
+    const DisplayMethod dMethod(getDisplayMethod(tm));
     
-#if PCG_USE_AVX
+#if PCG_USE_AVX512
+    typedef RGBA32FVec16ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec16 PixelVec;
+    typedef Vec16f ScalerValueType;
+#elif PCG_USE_AVX
     typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
     typedef PixelBGRA8Vec8 PixelVec;
     typedef Vec8f ScalerValueType;
@@ -1216,21 +2177,500 @@ void pcg::ToneMapperSoA::ToneMap(
     IteratorSoA end   = IteratorSoA::end(src);
     PixelVec* out     = PixelVec::begin(dest);
 
-    LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
-    LuminanceScaler_Exposure<ScalerValueType> sExposure;
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(),
+        linearRegion(src, begin, end, out,
+            sizeof(ScalerValueType) / sizeof(float)));
+}
 
-    switch(technique) {
-    case pcg::REINHARD02:
-        sReinhard02.setExposureFactor(this->m_exposureFactor);
-        sReinhard02.SetParams(this->ParamsReinhard02());
-        ToneMapAuxDelegate(sReinhard02, dMethod, m_invGamma, begin, end, out);
-        break;
-    case pcg::EXPOSURE:
-        sExposure.setExposureFactor(this->m_exposureFactor);
-        ToneMapAuxDelegate(sExposure, dMethod, m_invGamma, begin, end, out);
-        break;
-    default:
-        throw IllegalArgumentException("Invalid tone mapping technique");
-        break;
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA16FSoA(
+    const pcg::ToneMapperSoA& tm,
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBA16FImageSoA& src,
+    pcg::TmoTechnique technique)
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+
+    // The pixels are widened to float within the kernel
+#if PCG_USE_AVX512
+    typedef RGBA16FVec16ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec16 PixelVec;
+    typedef Vec16f ScalerValueType;
+#elif PCG_USE_AVX
+    typedef RGBA16FVec8ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec8 PixelVec;
+    typedef Vec8f ScalerValueType;
+#else
+    typedef RGBA16FVec4ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec4 PixelVec;
+    typedef Vec4f ScalerValueType;
+#endif
+
+    IteratorSoA begin = IteratorSoA::begin(src);
+    IteratorSoA end   = IteratorSoA::end(src);
+    PixelVec* out     = PixelVec::begin(dest);
+
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(),
+        linearRegion(src, begin, end, out,
+            sizeof(ScalerValueType) / sizeof(float)));
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBSoA(
+    const pcg::ToneMapperSoA& tm,
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBImageSoA& src,
+    pcg::TmoTechnique technique)
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+
+    const DisplayMethod dMethod(getDisplayMethod(tm));
+
+    // The iterator provides the constant alpha
+#if PCG_USE_AVX512
+    typedef RGB32FVec16ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec16 PixelVec;
+    typedef Vec16f ScalerValueType;
+#elif PCG_USE_AVX
+    typedef RGB32FVec8ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec8 PixelVec;
+    typedef Vec8f ScalerValueType;
+#else
+    typedef RGB32FVec4ImageSoAIterator IteratorSoA;
+    typedef PixelBGRA8Vec4 PixelVec;
+    typedef Vec4f ScalerValueType;
+#endif
+
+    IteratorSoA begin = IteratorSoA::begin(src);
+    IteratorSoA end   = IteratorSoA::end(src);
+    PixelVec* out     = PixelVec::begin(dest);
+
+    ToneMapRange<ScalerValueType>(technique, tm.ExposureFactor(),
+        tm.ParamsReinhard02(), dMethod, tm.InvGamma(), tm.LUT(),
+        linearRegion(src, begin, end, out,
+            sizeof(ScalerValueType) / sizeof(float)));
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FView(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapAoSView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FView_RGBA8(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapAoSView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FView_RGBA16(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapAoSView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FSoAView(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapSoAView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FSoAView_RGBA8(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapSoAView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBA32FSoAView_RGBA16(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapSoAView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBEView(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapRgbeView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBEView_RGBA8(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapRgbeView(tm, dest, src, technique);
+}
+
+
+
+void pcg::PCG_SIMD_NS::ToneMapperSoA_RGBEView_RGBA16(
+    const pcg::ToneMapperSoA& tm,
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique)
+{
+    ToneMapRgbeView(tm, dest, src, technique);
+}
+
+
+
+#if !PCG_SIMD_IS_VARIANT
+
+void pcg::ToneMapperSoA::SetExposure(float exposure)
+{
+    m_exposure = exposure;
+    m_exposureFactor = pow(2.0f, exposure);
+}
+
+
+
+void pcg::ToneMapperSoA::UpdateLUT()
+{
+    if (m_useSRGB) {
+        if (m_sRGBMethod == SRGB_LUT && (!m_lut.IsSRGB() ||
+            m_lut.Precision() != m_lutPrecision)) {
+            m_lut.SetSRGB(m_lutPrecision);
+        }
+    } else {
+        if (m_gammaMethod == GAMMA_LUT && (m_lut.IsEmpty() ||
+            m_lut.IsSRGB() || m_lut.Gamma() != m_gamma ||
+            m_lut.Precision() != m_lutPrecision)) {
+            m_lut.SetGamma(m_gamma, m_lutPrecision);
+        }
+    }
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32F)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgba16F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA16F)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FSoA)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBA16FImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA16FSoA)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBSoA)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FView)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FSoAView)(*this, dest, src, technique);
+}
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FView_RGBA8)(*this, dest, src,
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FView_RGBA16)(*this, dest, src,
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FSoAView_RGBA8)(*this, dest, src,
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBA32FSoAView_RGBA16)(*this, dest, src,
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBEView)(*this, dest, src, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBEView_RGBA8)(*this, dest, src,
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    PCG_SIMD_DISPATCH(ToneMapperSoA_RGBEView_RGBA16)(*this, dest, src,
+        technique);
+}
+
+
+
+namespace
+{
+
+// Top-down view of the whole image. Bottom-up images store their last
+// scanline first, thus the view walks their memory backwards.
+template <typename T, pcg::ScanLineMode S>
+inline pcg::ImageView<T, pcg::TopDown> topDownView(pcg::Image<T, S>& img)
+{
+    if (img.Height() == 0) {
+        return pcg::ImageView<T, pcg::TopDown>();
     }
+    const int w = img.Width();
+    return pcg::ImageView<T, pcg::TopDown>(
+        img.GetScanlinePointer(0, pcg::TopDown), w, img.Height(),
+        S == pcg::TopDown ? w : -w);
 }
+
+} // namespace
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::BottomUp>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::RGBAImageSoAView srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::RGBAImageSoAView srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::BottomUp>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::RGBAImageSoAView srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::RGBAImageSoAView srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::BottomUp>& dest,
+    const pcg::Image<pcg::Rgba32F, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgba32F, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::RGBAImageSoAView srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::Image<pcg::Rgbe, pcg::TopDown>& src,
+    pcg::TmoTechnique technique) const
+{
+    const pcg::ImageView<pcg::Rgbe, pcg::TopDown> srcView(src);
+    ToneMap(topDownView(dest), srcView, technique);
+}
+
+#endif // !PCG_SIMD_IS_VARIANT
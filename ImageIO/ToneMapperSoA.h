@@ -19,8 +19,12 @@
 
 #include "Image.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
+#include "DisplayLUT.h"
 #include "Reinhard02.h"
 #include "Rgba32F.h"
+#include "Rgba16F.h"
+#include "rgbe.h"
 #include "LDRPixels.h"
 #include "ToneMapper.h"
 
@@ -41,7 +45,10 @@ public:
         // This is as fast the old 4K LUT but vastly more accurate.
         SRGB_FAST1,
         // Rational approximation with maximum relative error < 1.623e-4
-        SRGB_FAST2
+        SRGB_FAST2,
+        // Lookup table indexed by the bits of the floats (see DisplayLUT).
+        // Its accuracy depends on the LUT precision.
+        SRGB_LUT
     };
 
     // Method to evaluate Gamma
@@ -50,7 +57,10 @@ public:
         // Reference, most accurate and slowest
         GAMMA_REF,
         // Approximation with about 12 bits of accuracy
-        GAMMA_FAST
+        GAMMA_FAST,
+        // Lookup table indexed by the bits of the floats, rebuilt only when
+        // the gamma changes
+        GAMMA_LUT
     };
 
     
@@ -60,7 +70,8 @@ public:
     ToneMapperSoA(bool useSRGB = true, float gamma = 2.2f) :
     m_exposure(0.0f), m_exposureFactor(1.0f),
     m_gamma(gamma), m_invGamma(1.0f / gamma), m_useSRGB(useSRGB),
-    m_sRGBMethod(SRGB_FAST2), m_gammaMethod(GAMMA_FAST)
+    m_sRGBMethod(SRGB_FAST2), m_gammaMethod(GAMMA_FAST),
+    m_lutPrecision(DisplayLUT::DEFAULT_PRECISION)
     {
         assert(gamma > 0.0f);
     }
@@ -83,16 +94,19 @@ public:
         assert(gamma > 0.0f);
         m_gamma    = gamma;
         m_invGamma = 1.0f / gamma;
+        UpdateLUT();
     }
 
     // Enables or disables the sRGB curve
     inline void SetSRGB(bool enable) {
         m_useSRGB = enable;
+        UpdateLUT();
     }
 
     // Selects the sRGB method to use. This does not enable sRGB automatically.
     inline void SetSRGBMethod(ESRGBMethod sRGBMethod) {
         m_sRGBMethod = sRGBMethod;
+        UpdateLUT();
     }
 
     // Returns the gamma employed when sRGB is not used
@@ -108,6 +122,16 @@ public:
     // Selects the gamma method to use. This does not enable gamma automatically.
     inline void SetGammaMethod(EGammaMethod gammaMethod) {
         m_gammaMethod = gammaMethod;
+        UpdateLUT();
+    }
+
+    // Number of mantissa bits in the index of the LUT methods, between
+    // DisplayLUT::MIN_PRECISION and DisplayLUT::MAX_PRECISION
+    inline void SetLUTPrecision(int precision) {
+        assert(precision >= DisplayLUT::MIN_PRECISION &&
+               precision <= DisplayLUT::MAX_PRECISION);
+        m_lutPrecision = precision;
+        UpdateLUT();
     }
 
     // Returns the exposure
@@ -115,6 +139,11 @@ public:
         return m_exposure;
     }
 
+    // Returns the scale factor for the exposure: 2^exposure
+    inline float ExposureFactor() const {
+        return m_exposureFactor;
+    }
+
     // Reference to the current set of Reinhard02 parameters
     inline const Reinhard02::Params& ParamsReinhard02() const {
         return m_paramsTMO;
@@ -135,6 +164,17 @@ public:
         return m_gammaMethod;
     }
 
+    // Current precision of the LUT methods
+    inline int LUTPrecision() const {
+        return m_lutPrecision;
+    }
+
+    // Table of the current display transform. It is only set up while one
+    // of the LUT methods is in use.
+    inline const DisplayLUT& LUT() const {
+        return m_lut;
+    }
+
 
 
     void ToneMap(Image<Bgra8, TopDown>& dest,
@@ -145,9 +185,116 @@ public:
         const RGBAImageSoA& src,
         TmoTechnique technique = EXPOSURE) const;
 
+    // Half precision sources are widened to float inside the SIMD kernel
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const Image<Rgba16F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const RGBA16FImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Opaque sources, the alpha of the result is 255
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const RGBImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Views over external memory, e.g. the bits of a QImage. Only the pixels
+    // within the views are read and written.
+    void ToneMap(const ImageView<Bgra8, TopDown>& dest,
+        const ImageView<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Bgra8, TopDown>& dest,
+        const RGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba8, TopDown>& dest,
+        const ImageView<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba8, TopDown>& dest,
+        const RGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // The sRGB FAST2 method is accurate to about 12 bits, use FAST1 or REF
+    // when the full range of the 16-bit outputs matters
+    void ToneMap(const ImageView<Rgba16, TopDown>& dest,
+        const ImageView<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba16, TopDown>& dest,
+        const RGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Other LDR formats and scanline orders, processed as views over the
+    // destination images: bottom-up images are views with a negative stride
+    void ToneMap(Image<Bgra8, BottomUp>& dest,
+        const Image<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Bgra8, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, TopDown>& dest,
+        const Image<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, TopDown>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, BottomUp>& dest,
+        const Image<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, TopDown>& dest,
+        const Image<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, TopDown>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, BottomUp>& dest,
+        const Image<Rgba32F, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // RGBE sources are decoded within the SIMD kernels, thus the full
+    // precision image is never materialized. Top-down RGBE scanlines are
+    // the order of the files, see RgbeIO and HdrScanlineReader.
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const Image<Rgbe, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Bgra8, TopDown>& dest,
+        const ImageView<Rgbe, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba8, TopDown>& dest,
+        const ImageView<Rgbe, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba16, TopDown>& dest,
+        const ImageView<Rgbe, TopDown>& src,
+        TmoTechnique technique = EXPOSURE) const;
+
 
 private:
 
+    // Rebuilds the LUT if one of its methods is in use and the display
+    // transform or the precision changed
+    void UpdateLUT();
+
     // Exposure of the image
     float m_exposure;
 
@@ -169,6 +316,10 @@ private:
     // Method used for Gamma
     EGammaMethod m_gammaMethod;
 
+    // Precision and table for the LUT methods
+    int m_lutPrecision;
+    DisplayLUT m_lut;
+
     // Parameters for the global Reinhard02 TMO
     Reinhard02::Params m_paramsTMO;
 };
@@ -0,0 +1,289 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_VEC16F_H)
+#define PCG_VEC16F_H
+
+#include "StdAfx.h"
+
+#include <cassert>
+
+namespace pcg
+{
+
+// Helper class intended to represent the mask produced by logical operations
+// applied to the floating point numbers. Unlike SSE and AVX, AVX-512 keeps a
+// single bit per element in the opmask registers.
+struct Vec16bf
+{
+private:
+    __mmask16 k;
+
+public:
+    // Initialize from raw values
+    Vec16bf(__mmask16 b) : k(b) {}
+
+    // Mask with only the first n elements set, as for the tail of an array
+    static inline Vec16bf first(int n) {
+        assert(n >= 0 && n <= 16);
+        return static_cast<__mmask16>((1u << n) - 1u);
+    }
+
+    // Cast operations
+    operator __mmask16() const {
+        return k;
+    }
+
+    // Logical operators
+    friend Vec16bf operator& (const Vec16bf& a, const Vec16bf& b) {
+        return static_cast<__mmask16>(a.k & b.k);
+    }
+    friend Vec16bf operator| (const Vec16bf& a, const Vec16bf& b) {
+        return static_cast<__mmask16>(a.k | b.k);
+    }
+    // (~a) & b
+    friend Vec16bf andnot(const Vec16bf& a, const Vec16bf& b) {
+        return static_cast<__mmask16>(~a.k & b.k);
+    }
+};
+
+
+
+// Helper union to provide compile time constants, by initializing the first
+// member of the union. Values are loaded into the ZMM registers in reverse
+// order: f15,f14,...,f1,f0
+union ALIGN64_BEG Vec16fUnion
+{
+    float f[16];
+    __m128 xmm[4];
+    __m256 ymm[2];
+    __m512 zmm;
+} ALIGN64_END;
+
+
+
+// Abstraction of a vector of 16 single precision floating point numbers,
+// using AVX-512 F and DQ instrinsics
+struct ALIGN64_BEG Vec16f
+{
+private:
+    union {
+        __m512 zmm;
+        float f[16];
+    };
+
+public:
+    // Trivial constructor
+    Vec16f() {}
+
+    // Initialize from a raw __m512 value
+    Vec16f(__m512 val) : zmm(val) {}
+
+    // Initialize from the helper union
+    Vec16f(const Vec16fUnion& vu) : zmm(vu.zmm) {}
+
+    // Initialize with the same value in all components
+    explicit Vec16f(float val) : zmm(_mm512_set1_ps(val)) {}
+
+    // Assignment
+    Vec16f& operator= (float val) {
+        zmm = _mm512_set1_ps(val);
+        return *this;
+    }
+
+    // Zero vector. Useful during code generation
+    inline static Vec16f zero() {
+        return _mm512_setzero_ps();
+    }
+
+    // Loads the elements set in the mask from 64-byte aligned memory, the
+    // rest are zero. Memory of the masked out elements is never accessed.
+    inline static Vec16f load(const float* ptr, const Vec16bf& mask) {
+        return _mm512_maskz_load_ps(mask, ptr);
+    }
+
+    // Stores the elements set in the mask into 64-byte aligned memory
+    friend inline void store(float* ptr, const Vec16bf& mask,
+        const Vec16f& v) {
+        _mm512_mask_store_ps(ptr, mask, v);
+    }
+
+    // Cast operations
+    operator __m512() const {
+        return zmm;
+    }
+
+    // Logical operators [binary]
+    friend Vec16f operator& (const Vec16f& a, const Vec16f& b) {
+        return _mm512_and_ps(a, b);
+    }
+    friend Vec16f operator| (const Vec16f& a, const Vec16f& b) {
+        return _mm512_or_ps(a, b);
+    }
+    friend Vec16f operator^ (const Vec16f& a, const Vec16f& b) {
+        return _mm512_xor_ps(a, b);
+    }
+    friend Vec16f andnot(const Vec16f& a, const Vec16f& b) {
+        return _mm512_andnot_ps(a, b);
+    }
+
+    // Logical operators [Members]
+    Vec16f& operator&= (const Vec16f& a) {
+        zmm = _mm512_and_ps(zmm, a.zmm);
+        return *this;
+    }
+    Vec16f& operator|= (const Vec16f& a) {
+        zmm = _mm512_or_ps(zmm, a.zmm);
+        return *this;
+    }
+    Vec16f& operator^= (const Vec16f& a) {
+        zmm = _mm512_xor_ps(zmm, a.zmm);
+        return *this;
+    }
+
+    // Arithmetic operations [binary]
+    friend Vec16f operator+ (const Vec16f& a, const Vec16f& b) {
+        return _mm512_add_ps(a, b);
+    }
+    friend Vec16f operator- (const Vec16f& a, const Vec16f& b) {
+        return _mm512_sub_ps(a, b);
+    }
+    friend Vec16f operator* (const Vec16f& a, const Vec16f& b) {
+        return _mm512_mul_ps(a, b);
+    }
+    friend Vec16f operator/ (const Vec16f& a, const Vec16f& b) {
+        return _mm512_div_ps(a, b);
+    }
+    // Arithmetic operations [members]
+    Vec16f& operator+= (const Vec16f& a) {
+        zmm = _mm512_add_ps(zmm, a.zmm);
+        return *this;
+    }
+    Vec16f& operator-= (const Vec16f& a) {
+        zmm = _mm512_sub_ps(zmm, a.zmm);
+        return *this;
+    }
+    Vec16f& operator*= (const Vec16f& a) {
+        zmm = _mm512_mul_ps(zmm, a.zmm);
+        return *this;
+    }
+    Vec16f& operator/= (const Vec16f& a) {
+        zmm = _mm512_div_ps(zmm, a.zmm);
+        return *this;
+    }
+
+    // Newton-Rhapson Reciprocal:
+    // [2 * rcp(x) - (x * rcp(x) * rcp(x))]
+    friend inline Vec16f rcp_nr(const Vec16f& v) {
+        Vec16f x0 = _mm512_rcp14_ps(v);
+        return _mm512_sub_ps(_mm512_add_ps(x0,x0),
+                             _mm512_mul_ps(_mm512_mul_ps(x0,v), x0));
+    }
+
+    // SIMD Reciprocal approximation, with a relative error below 2^-14
+    friend inline Vec16f simd_rcp(const Vec16f& v) {
+        return _mm512_rcp14_ps(v);
+    }
+
+    // Element access (slow!) [const version]
+    const float& operator[] (size_t i) const {
+        assert(i < 16);
+        return f[i];
+    }
+
+    // Element access (slow!)
+    float& operator[] (size_t i) {
+        assert(i < 16);
+        return f[i];
+    }
+
+    // Min and max
+    friend Vec16f simd_min(const Vec16f& a, const Vec16f& b) {
+        return _mm512_min_ps(a, b);
+    }
+    friend Vec16f simd_max(const Vec16f& a, const Vec16f& b) {
+        return _mm512_max_ps(a, b);
+    }
+
+    // Horizontal reductions of all the elements. The halves are extracted
+    // explicitly: the _mm512_reduce_* of GCC 12 use _mm512_extractf64x4_pd,
+    // whose undefined pass-through vector trips -Wmaybe-uninitialized.
+    #define PCG_VEC16F_REDUCE(name, op256, op128)                      \
+    friend float name(const Vec16f& a) {                               \
+        const __m256 r8 = op256(_mm512_extractf32x8_ps(a, 0),          \
+                                _mm512_extractf32x8_ps(a, 1));         \
+        __m128 r4 = op128(_mm256_castps256_ps128(r8),                  \
+                          _mm256_extractf128_ps(r8, 1));               \
+        r4 = op128(r4, _mm_movehl_ps(r4, r4));                         \
+        r4 = op128(r4, _mm_shuffle_ps(r4, r4, _MM_SHUFFLE(1,1,1,1)));  \
+        return _mm_cvtss_f32(r4);                                      \
+    }
+        PCG_VEC16F_REDUCE(reduce_min, _mm256_min_ps, _mm_min_ps)
+        PCG_VEC16F_REDUCE(reduce_max, _mm256_max_ps, _mm_max_ps)
+        PCG_VEC16F_REDUCE(reduce_add, _mm256_add_ps, _mm_add_ps)
+    #undef PCG_VEC16F_REDUCE
+
+    // Comparisons, return a mask. Ordered/unordered, quiet or signaling refer
+    // to the behavior with respect to NaN as per IEEE 754-2008 Section 5.11.
+    #define PCG_VEC16F_COMP(op, pred)                           \
+    friend Vec16bf cmp##op (const Vec16f& a, const Vec16f& b) { \
+        return _mm512_cmp_ps_mask(a, b, pred);                  \
+    }
+        PCG_VEC16F_COMP(eq,  _CMP_EQ_OQ)   // cmpeq(a,b)
+        PCG_VEC16F_COMP(lt,  _CMP_LT_OQ)   // cmplt(a,b)
+        PCG_VEC16F_COMP(le,  _CMP_LE_OQ)   // cmple(a,b)
+        PCG_VEC16F_COMP(gt,  _CMP_GT_OQ)   // cmpgt(a,b)
+        PCG_VEC16F_COMP(ge,  _CMP_GE_OQ)   // cmpge(a,b)
+        PCG_VEC16F_COMP(neq, _CMP_NEQ_UQ)  // cmpneq(a,b)
+        PCG_VEC16F_COMP(nlt, _CMP_NLT_UQ)  // cmpnlt(a,b)
+        PCG_VEC16F_COMP(nle, _CMP_NLE_UQ)  // cmpnle(a,b)
+        PCG_VEC16F_COMP(ngt, _CMP_NGT_UQ)  // cmpngt(a,b)
+        PCG_VEC16F_COMP(nge, _CMP_NGE_UQ)  // cmpnge(a,b)
+    #undef PCG_VEC16F_COMP
+
+    friend Vec16bf operator==(const Vec16f& a, const Vec16f& b) {
+        return cmpeq(a, b);
+    }
+    friend Vec16bf operator!=(const Vec16f& a, const Vec16f& b) {
+        return cmpneq(a, b);
+    }
+    friend Vec16bf operator<(const Vec16f& a, const Vec16f& b) {
+        return cmplt(a, b);
+    }
+    friend Vec16bf operator<=(const Vec16f& a, const Vec16f& b) {
+        return cmple(a, b);
+    }
+    friend Vec16bf operator>(const Vec16f& a, const Vec16f& b) {
+        return cmpgt(a, b);
+    }
+    friend Vec16bf operator>=(const Vec16f& a, const Vec16f& b) {
+        return cmpge(a, b);
+    }
+
+    // Select (mask) ? a : b
+    friend inline Vec16f select(const Vec16bf& mask,
+        const Vec16f& a, const Vec16f& b) {
+        return _mm512_mask_blend_ps(mask, b, a);
+    }
+
+
+} ALIGN64_END;
+
+
+} // namespace pcg
+
+
+#endif /* PCG_VEC16F_H */
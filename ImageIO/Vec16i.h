@@ -0,0 +1,142 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_VEC16I_H)
+#define PCG_VEC16I_H
+
+#include "StdAfx.h"
+
+#include <cassert>
+
+namespace pcg
+{
+
+// Helper union to provide compile time constants, by initializing the first
+// member of the union. Values are loaded into the ZMM registers in reverse
+// order: i15,i14,...,i1,i0
+union ALIGN64_BEG Vec16iUnion
+{
+    int32_t i32[16];
+    __m512i zmm;
+} ALIGN64_END;
+
+
+struct ALIGN64_BEG Vec16i
+{
+private:
+    union {
+        __m512i zmm;
+        int32_t i32[16];
+    };
+
+public:
+    // Trivial constructor
+    Vec16i() {}
+
+    // Initialize from a raw __m512i value
+    Vec16i(__m512i val) : zmm(val) {}
+
+    // Initialize with the same value in all components
+    explicit Vec16i(int32_t val) : zmm(_mm512_set1_epi32(val)) {}
+
+    // Assignment
+    Vec16i& operator= (int32_t val) {
+        zmm = _mm512_set1_epi32(val);
+        return *this;
+    }
+
+    // Zero vector. Useful during code generation
+    inline static Vec16i zero() {
+        return _mm512_setzero_si512();
+    }
+
+    // Cast operations
+    operator __m512i() const {
+        return zmm;
+    }
+
+    // Logical operators [binary]
+    friend Vec16i operator& (const Vec16i& a, const Vec16i& b) {
+        return _mm512_and_si512(a, b);
+    }
+    friend Vec16i operator| (const Vec16i& a, const Vec16i& b) {
+        return _mm512_or_si512(a, b);
+    }
+    friend Vec16i operator^ (const Vec16i& a, const Vec16i& b) {
+        return _mm512_xor_si512(a, b);
+    }
+    friend Vec16i andnot(const Vec16i& a, const Vec16i& b) {
+        return _mm512_andnot_si512(a, b);
+    }
+
+    // Arithmetic operations [binary]
+    friend Vec16i operator+ (const Vec16i& a, const Vec16i& b) {
+        return _mm512_add_epi32(a, b);
+    }
+    friend Vec16i operator- (const Vec16i& a, const Vec16i& b) {
+        return _mm512_sub_epi32(a, b);
+    }
+
+    // Sum of all the elements
+    friend int32_t reduce_add(const Vec16i& a) {
+        const __m256i s8 = _mm256_add_epi32(_mm512_extracti32x8_epi32(a, 0),
+                                            _mm512_extracti32x8_epi32(a, 1));
+        __m128i s4 = _mm_add_epi32(_mm256_castsi256_si128(s8),
+                                   _mm256_extracti128_si256(s8, 1));
+        s4 = _mm_add_epi32(s4, _mm_unpackhi_epi64(s4, s4));
+        s4 = _mm_add_epi32(s4, _mm_shuffle_epi32(s4, _MM_SHUFFLE(1,1,1,1)));
+        return _mm_cvtsi128_si32(s4);
+    }
+
+    // Test if all elements are zero
+    inline bool isZero() const {
+        return _mm512_test_epi32_mask(zmm, zmm) == 0;
+    }
+
+    // Element access (slow!) [const version]
+    const int32_t& operator[] (size_t i) const {
+        assert(i < 16);
+        return i32[i];
+    }
+
+    // Element access (slow!)
+    int32_t& operator[] (size_t i) {
+        assert(i < 16);
+        return i32[i];
+    }
+
+
+
+    // Compile time constants
+    template <int32_t value>
+    static const __m512i& constant() {
+        static const union {
+            int32_t i32[16];
+            __m512i zmm;
+        } u = {{value, value, value, value, value, value, value, value,
+                value, value, value, value, value, value, value, value}};
+        return u.zmm;
+    }
+
+
+} ALIGN64_END;
+
+
+
+} // namespace pcg
+
+
+#endif /* PCG_VEC16I_H */
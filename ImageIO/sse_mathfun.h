@@ -53,6 +53,19 @@
 # endif
 #endif
 
+#if USE_AVX2
+# if !defined(USE_AVX512)
+#  if PCG_USE_AVX512
+#   define USE_AVX512 1 /* AVX-512 F and DQ, Skylake-SP (2017) */
+#  else
+#   define USE_AVX512 0
+#  endif
+# endif
+#else
+# undef  USE_AVX512
+# define USE_AVX512 0
+#endif
+
 #include <xmmintrin.h>
 #include <emmintrin.h>
 #if USE_AVX
@@ -68,6 +81,10 @@ typedef __m128i v4si;
 typedef __m256  v8sf;
 typedef __m256i v8si;
 #endif
+#if USE_AVX512
+typedef __m512  v16sf;
+typedef __m512i v16si;
+#endif
 
 /* declare some SSE constants -- why can't I figure a better way to do that? */
 #if !USE_AVX
@@ -546,4 +563,131 @@ inline v8sf pow_avx(v8sf x, v8sf y) {
 
 #endif /* USE_AVX */
 
+
+
+#if USE_AVX512
+
+/* The constants are stored for 8 elements, broadcast them */
+#define _PS512(Name) _mm512_set1_ps(_ps_##Name[0])
+#define _PI512(Name) _mm512_set1_epi32(_pi32_##Name[0])
+#define _PS512_BITS(Name)                                       \
+    _mm512_castsi512_ps(_mm512_set1_epi32(((const int*)_ps_##Name)[0]))
+
+/* natural logarithm computed for 16 simultaneous float
+   return NaN for x <= 0
+*/
+inline v16sf log_avx512(v16sf x) {
+  const v16sf one = _PS512(1);
+
+  __mmask16 invalid_mask = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(),
+                                              _CMP_LE_OQ);
+
+  /* cut off denormalized stuff */
+  x = _mm512_max_ps(x, _PS512_BITS(min_norm_pos));
+
+  /* part 1: x = frexpf(x, &e); */
+  v16si zmm0 = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+
+  /* keep only the fractional part */
+  x = _mm512_and_ps(x, _PS512_BITS(inv_mant_mask));
+  x = _mm512_or_ps(x,  _PS512(0p5));
+
+  /* now e=zmm0 contain the really base-2 exponent */
+  zmm0 = _mm512_sub_epi32(zmm0, _PI512(0x7f));
+  v16sf e = _mm512_cvtepi32_ps(zmm0);
+
+  e = _mm512_add_ps(e, one);
+
+  /* part2:
+     if( x < SQRTHF ) {
+       e -= 1;
+       x = x + x - 1.0;
+     } else { x = x - 1.0; }
+  */
+  __mmask16 mask = _mm512_cmp_ps_mask(x, _PS512(cephes_SQRTHF), _CMP_LT_OQ);
+  v16sf tmp = _mm512_maskz_mov_ps(mask, x);
+  x = _mm512_sub_ps(x, one);
+  e = _mm512_mask_sub_ps(e, mask, e, one);
+  x = _mm512_add_ps(x, tmp);
+
+  v16sf z = _mm512_mul_ps(x,x);
+
+  v16sf y = _PS512(cephes_log_p0);
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p1));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p2));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p3));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p4));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p5));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p6));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p7));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_log_p8));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_mul_ps(y, z);
+
+  y = _mm512_fmadd_ps(e, _PS512(cephes_log_q1), y);
+  y = _mm512_fnmadd_ps(z, _PS512(0p5), y);
+
+  x = _mm512_add_ps(x, y);
+  x = _mm512_fmadd_ps(e, _PS512(cephes_log_q2), x);
+
+  /* negative arg will be NAN, all bits set as in the SSE and AVX versions */
+  x = _mm512_mask_mov_ps(x, invalid_mask,
+                         _mm512_castsi512_ps(_mm512_set1_epi32(-1)));
+  return x;
+}
+
+
+
+/* exponential computed for 16 simultaneous float
+*/
+inline v16sf exp_avx512(v16sf x) {
+  v16sf tmp, fx;
+  const v16sf one = _PS512(1);
+
+  x = _mm512_min_ps(x, _PS512(exp_hi));
+  x = _mm512_max_ps(x, _PS512(exp_lo));
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  fx = _mm512_fmadd_ps(x, _PS512(cephes_LOG2EF), _PS512(0p5));
+
+  /* Truncate (round to zero) */
+  tmp = _mm512_roundscale_ps(fx, 0x0B);
+  /* if greater, substract 1 */
+  __mmask16 mask = _mm512_cmp_ps_mask(tmp, fx, _CMP_GT_OQ);
+  fx = _mm512_mask_sub_ps(tmp, mask, tmp, one);
+
+  v16sf z = _mm512_fnmadd_ps(fx, _PS512(cephes_exp_C1), x);
+  x = _mm512_fnmadd_ps(fx, _PS512(cephes_exp_C2), z);
+
+  z = _mm512_mul_ps(x,x);
+
+  v16sf y = _PS512(cephes_exp_p0);
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_exp_p1));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_exp_p2));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_exp_p3));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_exp_p4));
+  y = _mm512_fmadd_ps(y,x, _PS512(cephes_exp_p5));
+  y = _mm512_fmadd_ps(y,z, x);
+  y = _mm512_add_ps(y, one);
+
+  /* build 2^n */
+  v16si zmm0 = _mm512_cvttps_epi32(fx);
+  zmm0 = _mm512_add_epi32(zmm0, _PI512(0x7f));
+  zmm0 = _mm512_slli_epi32(zmm0, 23);
+  v16sf pow2n = _mm512_castsi512_ps(zmm0);
+  y = _mm512_mul_ps(y, pow2n);
+  return y;
+}
+
+/* Approximation to pow(x,y): this just computes exp(y*log(x)) */
+inline v16sf pow_avx512(v16sf x, v16sf y) {
+    return exp_avx512(_mm512_mul_ps(log_avx512(x), y));
+}
+
+#undef _PS512
+#undef _PI512
+#undef _PS512_BITS
+
+#endif /* USE_AVX512 */
+
 #endif /* SSE_MATHFUN_H */
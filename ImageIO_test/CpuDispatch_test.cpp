@@ -0,0 +1,384 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "Timer.h"
+
+#include <CpuDispatch.h>
+#include <ImageComparator.h>
+#include <ImageSoA.h>
+#include <OpenEXRIO.h>
+#include <Reinhard02.h>
+#include <RgbeIO.h>
+#include <ToneMapperSoA.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+
+using pcg::CpuDispatch;
+using pcg::SimdLevel;
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+// Restores the instruction set in use when going out of scope
+class LevelGuard
+{
+public:
+    explicit LevelGuard(SimdLevel level) :
+    m_previous(CpuDispatch::SetCurrent(level)) {}
+
+    ~LevelGuard() {
+        CpuDispatch::SetCurrent(m_previous);
+    }
+
+private:
+    SimdLevel m_previous;
+};
+
+// Outputs of all the dispatched kernels for a single instruction set
+struct Results
+{
+    pcg::Image<pcg::Bgra8, pcg::TopDown> ldrExposure;
+    pcg::Image<pcg::Bgra8, pcg::TopDown> ldrReinhard;
+    pcg::Image<pcg::Rgba16, pcg::BottomUp> ldr16;
+    pcg::Reinhard02::Params params;
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> aos;
+    pcg::Image<pcg::Rgbe, pcg::BottomUp> rgbe;
+    // Red and blue of the conversion from RGBE and the decoded file
+    std::vector<float> fromRgbe;
+    std::vector<float> loaded;
+    ImageSoA ratio;
+    std::string rgbeFile;
+    // Halves of the OpenEXR files saved from the AoS and the SoA images
+    pcg::Image<pcg::Rgba16F, pcg::TopDown> exrAoS;
+    pcg::Image<pcg::Rgba16F, pcg::TopDown> exrSoA;
+};
+
+void appendRB(const ImageSoA& img, std::vector<float>& values)
+{
+    for (int i = 0; i < img.Size(); ++i) {
+        values.push_back(img.ElementAt<ImageSoA::R>(i));
+        values.push_back(img.ElementAt<ImageSoA::B>(i));
+    }
+}
+
+void run(const ImageSoA& src, const ImageSoA& other, Results& res)
+{
+    const int w = src.Width();
+    const int h = src.Height();
+
+    res.params = pcg::Reinhard02::EstimateParams(src);
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-0.5f);
+    tm.SetParams(res.params);
+    res.ldrExposure.Alloc(w, h);
+    res.ldrReinhard.Alloc(w, h);
+    tm.ToneMap(res.ldrExposure, src, pcg::EXPOSURE);
+    tm.ToneMap(res.ldrReinhard, src, pcg::REINHARD02);
+    res.ldr16.Alloc(w, h);
+    tm.ToneMap(res.ldr16, src, pcg::REINHARD02);
+
+    src.CopyTo(res.aos);
+    src.CopyTo(res.rgbe);
+    appendRB(ImageSoA(res.rgbe), res.fromRgbe);
+
+    res.ratio.Alloc(w, h);
+    pcg::ImageComparator::Compare(pcg::ImageComparator::RelativeError,
+        res.ratio, src, other);
+
+    std::stringstream ss;
+    pcg::RgbeIO::Save(src, ss);
+    res.rgbeFile = ss.str();
+
+    ImageSoA loaded;
+    pcg::RgbeIO::Load(loaded, ss);
+    appendRB(loaded, res.loaded);
+
+    const char* exrFile = "CpuDispatch_test.exr";
+    pcg::OpenEXRIO::Save(res.aos, exrFile, pcg::OpenEXRIO::WRITE_RGBA);
+    pcg::OpenEXRIO::Load(res.exrAoS, exrFile);
+    pcg::OpenEXRIO::Save(src, exrFile, pcg::OpenEXRIO::WRITE_RGBA);
+    pcg::OpenEXRIO::Load(res.exrSoA, exrFile);
+    std::remove(exrFile);
+}
+
+// Whether the kernels for the level are compiled and may run on this CPU
+bool isUsable(SimdLevel level)
+{
+    return CpuDispatch::IsCompiled(level) &&
+        (level <= CpuDispatch::Detected() || level == CpuDispatch::Baseline());
+}
+
+} // namespace
+
+
+
+class CpuDispatchTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x4b1d9e27, 0x0e83f6a2,
+            0x6c2a51d8, 0x31f7b04e, 0x7a58c3e9, 0x12e6d74b, 0x5d093fa1,
+            0x28b4e61c, 0x67c1a85f, 0x03fd2b96, 0x49a7e0d3, 0x1b6c5f48,
+            0x7e2093bd, 0x36d8c471, 0x5a41f02e, 0x0f9b6ec5
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    // Random HDR values, with a few zeros and out of range pixels
+    void fillRnd(ImageSoA &img)
+    {
+        for (int i = 0; i < img.Size(); ++i) {
+            const float scale = 1000.0f * m_rnd.nextFloat();
+            img.ElementAt<ImageSoA::R>(i) = scale * m_rnd.nextFloat();
+            img.ElementAt<ImageSoA::G>(i) = scale * m_rnd.nextFloat();
+            img.ElementAt<ImageSoA::B>(i) = scale * m_rnd.nextFloat();
+            img.ElementAt<ImageSoA::A>(i) = m_rnd.nextFloat();
+            if (i % 97 == 0) {
+                img.ElementAt<ImageSoA::G>(i) = 0.0f;
+            } else if (i % 89 == 0) {
+                img.ElementAt<ImageSoA::B>(i) = -1.0f;
+            }
+        }
+    }
+
+    RandomMT m_rnd;
+};
+
+
+
+TEST_F(CpuDispatchTest, Names)
+{
+    const SimdLevel levels[] = {
+        pcg::SIMD_SSE2, pcg::SIMD_AVX, pcg::SIMD_AVX2, pcg::SIMD_AVX512
+    };
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+        SimdLevel parsed = pcg::SIMD_SSE2;
+        ASSERT_TRUE(CpuDispatch::Parse(CpuDispatch::Name(levels[i]), parsed));
+        ASSERT_EQ(levels[i], parsed);
+    }
+
+    SimdLevel level = pcg::SIMD_AVX;
+    EXPECT_TRUE(CpuDispatch::Parse("AVX2", level));
+    EXPECT_EQ(pcg::SIMD_AVX2, level);
+    EXPECT_FALSE(CpuDispatch::Parse("avx5", level));
+    EXPECT_FALSE(CpuDispatch::Parse("", level));
+    EXPECT_FALSE(CpuDispatch::Parse(NULL, level));
+    EXPECT_EQ(pcg::SIMD_AVX2, level);
+}
+
+
+
+TEST_F(CpuDispatchTest, Current)
+{
+    const SimdLevel current = CpuDispatch::Current();
+    EXPECT_TRUE(CpuDispatch::IsCompiled(current));
+    EXPECT_TRUE(CpuDispatch::IsCompiled(CpuDispatch::Baseline()));
+    EXPECT_LE(CpuDispatch::Baseline(), current);
+    if (CpuDispatch::Baseline() <= CpuDispatch::Detected()) {
+        EXPECT_LE(current, CpuDispatch::Detected());
+    }
+
+    SimdLevel requested;
+    const char* env = getenv("HDRITOOLS_SIMD");
+    if (env != NULL && CpuDispatch::Parse(env, requested) &&
+        requested >= CpuDispatch::Baseline()) {
+        EXPECT_LE(current, requested);
+    }
+
+    {
+        LevelGuard guard(pcg::SIMD_SSE2);
+        EXPECT_EQ(CpuDispatch::Baseline(), CpuDispatch::Current());
+    }
+    EXPECT_EQ(current, CpuDispatch::Current());
+
+    std::cout << "> SIMD detected: " << CpuDispatch::Name(CpuDispatch::Detected())
+              << ", baseline: " << CpuDispatch::Name(CpuDispatch::Baseline())
+              << ", current: " << CpuDispatch::Name(current) << std::endl;
+}
+
+
+
+// Every compiled instruction set gives the same results as the baseline
+TEST_F(CpuDispatchTest, Consistency)
+{
+    const int w = 509;
+    const int h = 67;
+    ImageSoA src(w, h), other(w, h);
+    fillRnd(src);
+    fillRnd(other);
+
+    Results expected;
+    {
+        LevelGuard guard(CpuDispatch::Baseline());
+        run(src, other, expected);
+    }
+
+    for (int l = CpuDispatch::Baseline() + 1; l <= pcg::SIMD_AVX512; ++l) {
+        const SimdLevel level = static_cast<SimdLevel>(l);
+        if (!CpuDispatch::IsCompiled(level) || level > CpuDispatch::Detected()) {
+            continue;
+        }
+        LevelGuard guard(level);
+        ASSERT_EQ(level, CpuDispatch::Current());
+        SCOPED_TRACE(CpuDispatch::Name(level));
+
+        Results actual;
+        run(src, other, actual);
+
+        const pcg::Reinhard02::Params &pe = expected.params;
+        const pcg::Reinhard02::Params &pa = actual.params;
+        EXPECT_NEAR(pe.key, pa.key, 1e-4f * pe.key);
+        EXPECT_NEAR(pe.l_w, pa.l_w, 1e-4f * pe.l_w);
+        EXPECT_NEAR(pe.l_white, pa.l_white, 1e-4f * pe.l_white);
+        EXPECT_EQ(pe.l_min, pa.l_min);
+        EXPECT_EQ(pe.l_max, pa.l_max);
+
+        for (int i = 0; i < src.Size(); ++i) {
+            const pcg::Bgra8 &e = expected.ldrExposure[i];
+            const pcg::Bgra8 &a = actual.ldrExposure[i];
+            ASSERT_NEAR(e.r, a.r, 1);
+            ASSERT_NEAR(e.g, a.g, 1);
+            ASSERT_NEAR(e.b, a.b, 1);
+            ASSERT_EQ(e.a, a.a);
+            const pcg::Bgra8 &er = expected.ldrReinhard[i];
+            const pcg::Bgra8 &ar = actual.ldrReinhard[i];
+            ASSERT_NEAR(er.r, ar.r, 1);
+            ASSERT_NEAR(er.g, ar.g, 1);
+            ASSERT_NEAR(er.b, ar.b, 1);
+            ASSERT_EQ(er.a, ar.a);
+            const pcg::Rgba16 &e16 = expected.ldr16[i];
+            const pcg::Rgba16 &a16 = actual.ldr16[i];
+            ASSERT_NEAR(e16.r, a16.r, 3);
+            ASSERT_NEAR(e16.g, a16.g, 3);
+            ASSERT_NEAR(e16.b, a16.b, 3);
+            ASSERT_EQ(e16.a, a16.a);
+
+            ASSERT_EQ(expected.aos[i].r(), actual.aos[i].r());
+            ASSERT_EQ(expected.aos[i].a(), actual.aos[i].a());
+            ASSERT_EQ(0, memcmp(&expected.rgbe[i], &actual.rgbe[i],
+                sizeof(pcg::Rgbe)));
+            ASSERT_EQ(expected.exrAoS[i], actual.exrAoS[i]);
+            ASSERT_EQ(expected.exrSoA[i], actual.exrSoA[i]);
+
+            // The relative error of 0/0 is NaN in all the kernels
+            const float er1 = expected.ratio.ElementAt<ImageSoA::G>(i);
+            const float ar1 = actual.ratio.ElementAt<ImageSoA::G>(i);
+            if (er1 != er1) {
+                ASSERT_NE(ar1, ar1);
+            } else {
+                ASSERT_NEAR(er1, ar1, 1e-5f * std::abs(er1));
+            }
+        }
+        ASSERT_TRUE(expected.fromRgbe == actual.fromRgbe);
+        ASSERT_TRUE(expected.loaded == actual.loaded);
+        ASSERT_EQ(expected.rgbeFile, actual.rgbeFile);
+    }
+}
+
+
+
+// Average time of the tone mapping kernels for each usable instruction set,
+// in particular the 16-wide AVX-512 ones against the 8-wide AVX2 ones
+TEST_F(CpuDispatchTest, BenchmarkToneMap)
+{
+    const int w = 1920;
+    const int h = 1080;
+    ImageSoA src(w, h);
+    fillRnd(src);
+    const pcg::Reinhard02::Params params = pcg::Reinhard02::EstimateParams(src);
+    pcg::Image<pcg::Bgra8, pcg::TopDown> ldr(w, h);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(params);
+    const int N = 16;
+
+    for (int l = pcg::SIMD_SSE2; l <= pcg::SIMD_AVX512; ++l) {
+        const SimdLevel level = static_cast<SimdLevel>(l);
+        if (!isUsable(level)) {
+            continue;
+        }
+        LevelGuard guard(level);
+
+        Timer tExposure, tReinhard;
+        tm.ToneMap(ldr, src, pcg::EXPOSURE);
+        for (int i = 0; i != N; ++i) {
+            tExposure.start();
+            tm.ToneMap(ldr, src, pcg::EXPOSURE);
+            tExposure.stop();
+        }
+        tm.ToneMap(ldr, src, pcg::REINHARD02);
+        for (int i = 0; i != N; ++i) {
+            tReinhard.start();
+            tm.ToneMap(ldr, src, pcg::REINHARD02);
+            tReinhard.stop();
+        }
+
+        const double factor = 1e-6 / N;
+        std::cout << std::setw(8) << CpuDispatch::Name(CpuDispatch::Current())
+                  << ": exposure " << tExposure.nanoTime()*factor
+                  << " ms, reinhard02 " << tReinhard.nanoTime()*factor
+                  << " ms" << std::endl;
+    }
+}
+
+
+
+// Average time to estimate the Reinhard02 parameters for each usable
+// instruction set, where the image size leaves tails in the luminance buffer
+TEST_F(CpuDispatchTest, BenchmarkEstimateParams)
+{
+    const int w = 1923;
+    const int h = 1081;
+    ImageSoA src(w, h);
+    fillRnd(src);
+    const int N = 16;
+
+    for (int l = pcg::SIMD_SSE2; l <= pcg::SIMD_AVX512; ++l) {
+        const SimdLevel level = static_cast<SimdLevel>(l);
+        if (!isUsable(level)) {
+            continue;
+        }
+        LevelGuard guard(level);
+
+        Timer tEstimate;
+        pcg::Reinhard02::Params params = pcg::Reinhard02::EstimateParams(src);
+        for (int i = 0; i != N; ++i) {
+            tEstimate.start();
+            params = pcg::Reinhard02::EstimateParams(src);
+            tEstimate.stop();
+        }
+        EXPECT_GT(params.l_w, 0.0f);
+
+        std::cout << std::setw(8) << CpuDispatch::Name(CpuDispatch::Current())
+                  << ": " << tEstimate.nanoTime()*(1e-6/N) << " ms"
+                  << std::endl;
+    }
+}
@@ -0,0 +1,270 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <HdrScanlineIO.h>
+#include <LoadHDR.h>
+#include <OpenEXRIO.h>
+#include <PfmIO.h>
+#include <RgbeIO.h>
+#include <rgbe.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <deque>
+#include <string>
+
+
+
+class HdrScanlineIOTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x2b4f8d13, 0x6e0a37c5,
+            0x13d95e2f, 0x7a6c04b8, 0x41f2a9d6, 0x0c58e371, 0x5db3761a,
+            0x38e1c40d, 0x67a25f9e, 0x1f7d08b3, 0x4c96e2a5, 0x72b13d4f,
+            0x09e4a6c8, 0x5a3f91e7, 0x26c87b02, 0x6f15d3a9
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+        for (size_t i = 0; i < m_files.size(); ++i) {
+            std::remove(m_files[i].c_str());
+        }
+    }
+
+    // Registers a temporary file to be deleted after the test
+    const char* tmpFile(const char* name) {
+        m_files.push_back(name);
+        return m_files.back().c_str();
+    }
+
+    void fillRnd (pcg::Image<pcg::Rgba32F, pcg::TopDown> &img) {
+        for (int i = 0; i < img.Size(); ++i) {
+            const float s = 1000.0f * m_rnd.nextFloat();
+            const float r = s * m_rnd.nextFloat();
+            const float g = s * m_rnd.nextFloat();
+            const float b = s * m_rnd.nextFloat();
+            img[i].set (r, g, b, 1.0f);
+        }
+    }
+
+    // Saves a random image in the given format and loads it back with the
+    // regular codecs, so that the pixels are representable in the format
+    void createReference(pcg::Image<pcg::Rgba32F, pcg::TopDown> &reference,
+        const char* filename, pcg::HdrFormat format, int width, int height)
+    {
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> img(width, height);
+        fillRnd(img);
+        switch (format) {
+        case pcg::HDR_RGBE:
+            pcg::RgbeIO::Save(img, filename);
+            break;
+        case pcg::HDR_PFM:
+            pcg::PfmIO::Save(img, filename);
+            break;
+        case pcg::HDR_OPENEXR:
+            pcg::OpenEXRIO::Save(img, filename);
+            break;
+        }
+        pcg::LoadHDR(reference, filename);
+    }
+
+    template <class ImageCls>
+    static void assertRGBEquals(const pcg::Image<pcg::Rgba32F, pcg::TopDown>&
+        expected, int firstScanline, const ImageCls& band)
+    {
+        ASSERT_EQ(expected.Width(), band.Width());
+        for (int j = 0; j < band.Height(); ++j) {
+            for (int i = 0; i < band.Width(); ++i) {
+                const pcg::Rgba32F e = expected.ElementAt(i, firstScanline+j);
+                const pcg::Rgba32F a = band[j * band.Width() + i];
+                ASSERT_EQ(e.r(), a.r());
+                ASSERT_EQ(e.g(), a.g());
+                ASSERT_EQ(e.b(), a.b());
+            }
+        }
+    }
+
+    template <class ImageCls>
+    void testRead(const char* filename, pcg::HdrFormat format)
+    {
+        const int width = 123, height = 45, bandSize = 7;
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> reference;
+        createReference(reference, filename, format, width, height);
+
+        pcg::HdrScanlineReader reader(filename);
+        ASSERT_EQ(format, reader.Format());
+        ASSERT_EQ(width,  reader.Width());
+        ASSERT_EQ(height, reader.Height());
+
+        ImageCls band;
+        int count = 0;
+        while (!reader.IsDone()) {
+            const int first = reader.NextScanline();
+            const int n = reader.Read(band, bandSize);
+            ASSERT_EQ(std::min(bandSize, height - first), n);
+            ASSERT_EQ(n, band.Height());
+            assertRGBEquals(reference, first, band);
+            count += n;
+        }
+        ASSERT_EQ(height, count);
+        ASSERT_EQ(0, reader.Read(band, bandSize));
+    }
+
+    void testWrite(const char* refname, const char* filename,
+        pcg::HdrFormat format, bool useSoA)
+    {
+        const int width = 77, height = 31, bandSize = 5;
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> reference;
+        createReference(reference, refname, format, width, height);
+
+        {
+            pcg::HdrScanlineWriter writer(filename, width, height, format);
+            for (int j = 0; j < height; j += bandSize) {
+                const int n = std::min(bandSize, height - j);
+                pcg::Image<pcg::Rgba32F, pcg::TopDown> tmp(width, n);
+                for (int k = 0; k < tmp.Size(); ++k) {
+                    tmp[k] = reference.ElementAt(k % width, j + k / width);
+                }
+                if (useSoA) {
+                    pcg::RGBAImageSoA band(tmp);
+                    writer.Write(band);
+                } else {
+                    writer.Write(tmp);
+                }
+            }
+            ASSERT_NO_THROW(writer.Close());
+        }
+
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+        pcg::LoadHDR(result, filename);
+        ASSERT_EQ(height, result.Height());
+        assertRGBEquals(reference, 0, result);
+    }
+
+    RandomMT m_rnd;
+    std::deque<std::string> m_files;
+};
+
+
+
+TEST_F(HdrScanlineIOTest, ReadRgbe)
+{
+    testRead<pcg::Image<pcg::Rgba32F, pcg::TopDown> >(
+        tmpFile("HdrScanlineIO_read.hdr"), pcg::HDR_RGBE);
+    testRead<pcg::RGBAImageSoA>(
+        tmpFile("HdrScanlineIO_readSoA.hdr"), pcg::HDR_RGBE);
+    testRead<pcg::Image<pcg::Rgbe, pcg::TopDown> >(
+        tmpFile("HdrScanlineIO_readRaw.hdr"), pcg::HDR_RGBE);
+}
+
+TEST_F(HdrScanlineIOTest, ReadPfm)
+{
+    testRead<pcg::Image<pcg::Rgba32F, pcg::TopDown> >(
+        tmpFile("HdrScanlineIO_read.pfm"), pcg::HDR_PFM);
+    testRead<pcg::RGBAImageSoA>(
+        tmpFile("HdrScanlineIO_readSoA.pfm"), pcg::HDR_PFM);
+}
+
+TEST_F(HdrScanlineIOTest, ReadOpenEXR)
+{
+    testRead<pcg::Image<pcg::Rgba32F, pcg::TopDown> >(
+        tmpFile("HdrScanlineIO_read.exr"), pcg::HDR_OPENEXR);
+    testRead<pcg::RGBAImageSoA>(
+        tmpFile("HdrScanlineIO_readSoA.exr"), pcg::HDR_OPENEXR);
+}
+
+TEST_F(HdrScanlineIOTest, WriteRgbe)
+{
+    testWrite(tmpFile("HdrScanlineIO_ref.hdr"),
+        tmpFile("HdrScanlineIO_write.hdr"), pcg::HDR_RGBE, false);
+    testWrite(tmpFile("HdrScanlineIO_refSoA.hdr"),
+        tmpFile("HdrScanlineIO_writeSoA.hdr"), pcg::HDR_RGBE, true);
+}
+
+TEST_F(HdrScanlineIOTest, WritePfm)
+{
+    testWrite(tmpFile("HdrScanlineIO_ref.pfm"),
+        tmpFile("HdrScanlineIO_write.pfm"), pcg::HDR_PFM, false);
+    testWrite(tmpFile("HdrScanlineIO_refSoA.pfm"),
+        tmpFile("HdrScanlineIO_writeSoA.pfm"), pcg::HDR_PFM, true);
+}
+
+TEST_F(HdrScanlineIOTest, WriteOpenEXR)
+{
+    testWrite(tmpFile("HdrScanlineIO_ref.exr"),
+        tmpFile("HdrScanlineIO_write.exr"), pcg::HDR_OPENEXR, false);
+    testWrite(tmpFile("HdrScanlineIO_refSoA.exr"),
+        tmpFile("HdrScanlineIO_writeSoA.exr"), pcg::HDR_OPENEXR, true);
+}
+
+TEST_F(HdrScanlineIOTest, WriteOpenEXRAlpha)
+{
+    const char* filename = tmpFile("HdrScanlineIO_alpha.exr");
+    const int width = 19, height = 6;
+
+    // Multiples of 1/8 are exact in half precision
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img(width, height);
+    for (int i = 0; i < img.Size(); ++i) {
+        img[i].set(0.5f, 0.25f, 2.0f, (i % 9) / 8.0f);
+    }
+    {
+        pcg::HdrScanlineWriter writer(filename, width, height, pcg::HDR_OPENEXR);
+        writer.Write(img);
+        ASSERT_NO_THROW(writer.Close());
+    }
+
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+    pcg::OpenEXRIO::Load(result, filename);
+    ASSERT_EQ(img.Size(), result.Size());
+    for (int i = 0; i < img.Size(); ++i) {
+        ASSERT_EQ(img[i].a(), result[i].a());
+    }
+
+    pcg::HdrScanlineReader reader(filename);
+    pcg::RGBAImageSoA band;
+    ASSERT_EQ(height, reader.Read(band, height));
+    const float* a = band.GetDataPointer<pcg::RGBAImageSoA::A>();
+    for (int i = 0; i < img.Size(); ++i) {
+        ASSERT_EQ(img[i].a(), a[i]);
+    }
+}
+
+TEST_F(HdrScanlineIOTest, Incomplete)
+{
+    const char* filename = tmpFile("HdrScanlineIO_incomplete.hdr");
+    pcg::HdrScanlineWriter writer(filename, 16, 8, pcg::HDR_RGBE);
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> band(16, 4);
+    fillRnd(band);
+    writer.Write(band);
+
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> wide(17, 1);
+    ASSERT_THROW(writer.Write(wide), pcg::IllegalArgumentException);
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> tall(16, 5);
+    ASSERT_THROW(writer.Write(tall), pcg::IllegalArgumentException);
+    ASSERT_THROW(writer.Close(), pcg::IOException);
+}
@@ -0,0 +1,510 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <ImageAllocator.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <Rgba32F.h>
+#include <LDRPixels.h>
+#include <ToneMapperSoA.h>
+#include <Reinhard02.h>
+
+#include "Timer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <iostream>
+
+#if !defined(_MSC_VER) || _MSC_VER >= 1600
+#include <stdint.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+
+inline bool isAligned(const void* ptr, size_t alignment)
+{
+    return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+// Fills the new blocks with a pattern, to find out which bytes were touched
+class PatternAllocator : public pcg::ImageAllocator
+{
+public:
+    static const unsigned char PATTERN = 0xCD;
+
+    virtual void* Allocate(size_t bytes) {
+        void* ptr = pcg::ImageAllocator::Default()->Allocate(bytes);
+        if (ptr != NULL) {
+            memset(ptr, PATTERN, bytes);
+        }
+        return ptr;
+    }
+
+    virtual void Release(void* ptr, size_t bytes) {
+        pcg::ImageAllocator::Default()->Release(ptr, bytes);
+    }
+};
+
+// NUMA node of the page with the given address, or -1 if unknown
+int pageNode(const void* ptr)
+{
+#if defined(__linux__) && defined(SYS_move_pages)
+    void* page = const_cast<void*>(ptr);
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0) {
+        return status >= 0 ? status : -1;
+    }
+#else
+    (void) ptr;
+#endif
+    return -1;
+}
+
+} // namespace
+
+
+
+TEST(ImageAllocatorTest, SizeClass)
+{
+    pcg::PooledAllocator pool;
+    size_t prev = 0;
+    for (size_t bytes = 1; bytes < (size_t(1) << 30); bytes += bytes/3 + 1) {
+        const size_t size = pool.SizeClass(bytes);
+        ASSERT_GE(size, bytes);
+        ASSERT_LE(size, bytes + bytes/3 + 4096);
+        ASSERT_EQ(0, size % pcg::ImageAllocator::ALIGNMENT);
+        ASSERT_GE(size, prev);
+        ASSERT_EQ(size, pool.SizeClass(size));
+        prev = size;
+    }
+
+    // Slightly different frames share the class
+    const size_t frame = 1920 * 1080 * sizeof(pcg::Rgba32F);
+    EXPECT_EQ(pool.SizeClass(frame), pool.SizeClass(frame - 4*1920));
+
+    pcg::PooledAllocator poolHuge(pcg::PooledAllocator::DEFAULT_MAX_CACHED,
+        true);
+    EXPECT_EQ(0, poolHuge.SizeClass(3 << 20) % (2 << 20));
+    EXPECT_EQ(pool.SizeClass(1000), poolHuge.SizeClass(1000));
+}
+
+TEST(ImageAllocatorTest, Reuse)
+{
+    pcg::PooledAllocator pool;
+    void* p0 = pool.Allocate(1000000);
+    ASSERT_TRUE(p0 != NULL);
+    ASSERT_TRUE(isAligned(p0, pcg::ImageAllocator::ALIGNMENT));
+    memset(p0, 0xAB, 1000000);
+    EXPECT_EQ(0, pool.Hits());
+    EXPECT_EQ(1, pool.Misses());
+
+    pool.Release(p0, 1000000);
+    EXPECT_EQ(pool.SizeClass(1000000), pool.CachedBytes());
+
+    // Same class, same block
+    void* p1 = pool.Allocate(999000);
+    EXPECT_EQ(p0, p1);
+    EXPECT_EQ(1, pool.Hits());
+    EXPECT_EQ(0, pool.CachedBytes());
+
+    // Different class, new block
+    void* p2 = pool.Allocate(4000000);
+    EXPECT_NE(p1, p2);
+    EXPECT_EQ(2, pool.Misses());
+
+    pool.Release(p1, 999000);
+    pool.Release(p2, 4000000);
+    EXPECT_EQ(pool.SizeClass(1000000) + pool.SizeClass(4000000),
+        pool.CachedBytes());
+    pool.Trim();
+    EXPECT_EQ(0, pool.CachedBytes());
+}
+
+TEST(ImageAllocatorTest, MaxCached)
+{
+    pcg::PooledAllocator pool(1 << 20);
+    void* p0 = pool.Allocate(600000);
+    void* p1 = pool.Allocate(600000);
+    pool.Release(p0, 600000);
+    pool.Release(p1, 600000);
+    EXPECT_EQ(pool.SizeClass(600000), pool.CachedBytes());
+    EXPECT_EQ(p0, pool.Allocate(600000));
+    pool.Release(p0, 600000);
+}
+
+TEST(ImageAllocatorTest, HugePages)
+{
+    pcg::PooledAllocator pool(pcg::PooledAllocator::DEFAULT_MAX_CACHED, true);
+    const size_t bytes = 5 << 20;
+    void* p = pool.Allocate(bytes);
+    ASSERT_TRUE(p != NULL);
+    EXPECT_TRUE(isAligned(p, 2 << 20));
+    memset(p, 0, bytes);
+    pool.Release(p, bytes);
+
+    void* pSmall = pool.Allocate(1000);
+    ASSERT_TRUE(pSmall != NULL);
+    EXPECT_TRUE(isAligned(pSmall, pcg::ImageAllocator::ALIGNMENT));
+    pool.Release(pSmall, 1000);
+}
+
+TEST(ImageAllocatorTest, Images)
+{
+    pcg::ImageAllocator* const defaultAllocator =
+        pcg::ImageAllocator::Default();
+    ASSERT_EQ(defaultAllocator, pcg::ImageAllocator::Current());
+
+    pcg::PooledAllocator pool;
+    {
+        pcg::AllocatorScope scope(&pool);
+        ASSERT_EQ(&pool, pcg::ImageAllocator::Current());
+
+        pcg::Rgba32F* pixels = NULL;
+        {
+            pcg::Image<pcg::Rgba32F> img(640, 480);
+            pixels = img.GetDataPointer();
+            ASSERT_TRUE(isAligned(pixels, 64));
+        }
+        EXPECT_LT(0, pool.CachedBytes());
+
+        // The next token reuses the buffer, with the same or other type
+        pcg::Image<pcg::Rgba32F> img(640, 479);
+        EXPECT_EQ(pixels, img.GetDataPointer());
+        img.Clear();
+
+        pcg::RGBAImageSoA soa(640, 480);
+        EXPECT_EQ(1, pool.Misses());
+        EXPECT_EQ(2, pool.Hits());
+        EXPECT_EQ(reinterpret_cast<float*>(pixels),
+            soa.GetDataPointer<pcg::RGBAImageSoA::R>());
+
+        // Images keep releasing into the pool after the scope ends
+        pcg::Image<pcg::Bgra8> ldr(640, 480);
+        pcg::ImageAllocator::SetCurrent(NULL);
+        ASSERT_EQ(defaultAllocator, pcg::ImageAllocator::Current());
+        ldr.Clear();
+        EXPECT_EQ(pool.SizeClass(640 * 480 * sizeof(pcg::Bgra8)),
+            pool.CachedBytes());
+        pcg::ImageAllocator::SetCurrent(&pool);
+    }
+    EXPECT_EQ(defaultAllocator, pcg::ImageAllocator::Current());
+
+    pcg::Image<pcg::Rgba32F> img(16, 16);
+    EXPECT_EQ(2, pool.Hits());
+}
+
+TEST(ImageAllocatorTest, FirstTouch)
+{
+    pcg::PooledAllocator pool;
+    pcg::FirstTouchAllocator firstTouch(&pool);
+    const size_t bytes = 3000000;
+    char* p = static_cast<char*>(firstTouch.Allocate(bytes));
+    ASSERT_TRUE(p != NULL);
+    ASSERT_TRUE(isAligned(p, pcg::ImageAllocator::ALIGNMENT));
+    memset(p, 0xCD, bytes);
+    firstTouch.Release(p, bytes);
+    EXPECT_EQ(pool.SizeClass(bytes), pool.CachedBytes());
+    EXPECT_EQ(p, firstTouch.Allocate(bytes));
+    firstTouch.Release(p, bytes);
+
+    pcg::FirstTouchAllocator plain;
+    pcg::AllocatorScope scope(&plain);
+    pcg::RGBAImageSoA img(333, 111);
+    img.ElementAt<pcg::RGBAImageSoA::A>(332, 110) = 1.0f;
+    EXPECT_EQ(1.0f, img.ElementAt<pcg::RGBAImageSoA::A>(332, 110));
+}
+
+// The chunks split every plane in the same share of pixels, on whole vectors
+TEST(ImageAllocatorTest, FirstTouchChunks)
+{
+    const size_t planes[] = { 64, 4096, 333 * 111 * 4 + 60, 1 << 24 };
+    for (size_t n = 0; n != sizeof(planes)/sizeof(planes[0]); ++n) {
+        const size_t planeBytes = planes[n];
+        for (int numChunks = 1; numChunks <= 64; numChunks *= 3) {
+            size_t prev = 0;
+            ASSERT_EQ(0, pcg::FirstTouchAllocator::ChunkBegin(
+                planeBytes, 0, numChunks));
+            ASSERT_EQ(planeBytes, pcg::FirstTouchAllocator::ChunkBegin(
+                planeBytes, numChunks, numChunks));
+            for (int k = 1; k < numChunks; ++k) {
+                const size_t begin = pcg::FirstTouchAllocator::ChunkBegin(
+                    planeBytes, k, numChunks);
+                const double expected =
+                    static_cast<double>(planeBytes) * k / numChunks;
+                ASSERT_EQ(0, begin % pcg::ImageAllocator::ALIGNMENT);
+                ASSERT_LE(begin, expected);
+                ASSERT_GT(begin + pcg::ImageAllocator::ALIGNMENT, expected);
+                ASSERT_LE(prev, begin);
+                prev = begin;
+            }
+        }
+    }
+}
+
+// Exactly the first byte of each page of the block is written
+TEST(ImageAllocatorTest, FirstTouchPages)
+{
+    PatternAllocator pattern;
+    const size_t PAGE_BYTES = pcg::FirstTouchAllocator::PAGE_BYTES;
+    const size_t planeBytes = 5 * PAGE_BYTES + 3 * 64;
+    const size_t numPlanes  = 4;
+    const size_t bytes = planeBytes * numPlanes;
+    for (int numChunks = 1; numChunks <= 7; numChunks += 3) {
+        pcg::FirstTouchAllocator firstTouch(&pattern, numChunks);
+        ASSERT_EQ(numChunks, firstTouch.NumChunks());
+        const unsigned char* p = static_cast<const unsigned char*>(
+            firstTouch.AllocatePlanes(planeBytes, numPlanes));
+        ASSERT_TRUE(p != NULL);
+        for (size_t i = 0; i != bytes; ++i) {
+            const bool isPageStart = i == 0 ||
+                reinterpret_cast<uintptr_t>(p + i) % PAGE_BYTES == 0;
+            ASSERT_EQ(isPageStart ? 0 : PatternAllocator::PATTERN, p[i])
+                << i << " " << numChunks;
+        }
+        firstTouch.Release(const_cast<unsigned char*>(p), bytes);
+    }
+}
+
+// With several NUMA nodes, the same chunk of every plane of a SoA image is
+// placed on the same node. The pages in the middle of the chunks are
+// checked, as a transparent huge page may straddle their boundaries.
+TEST(ImageAllocatorTest, FirstTouchPlacement)
+{
+    const int numChunks = 8;
+    pcg::FirstTouchAllocator firstTouch(NULL, numChunks);
+    pcg::AllocatorScope scope(&firstTouch);
+    pcg::RGBAImageSoA img(4096, 2048);
+    const size_t planeBytes = static_cast<size_t>(img.Size()) * sizeof(float);
+    const char* planes[] = {
+        reinterpret_cast<const char*>(img.GetDataPointer<pcg::RGBAImageSoA::R>()),
+        reinterpret_cast<const char*>(img.GetDataPointer<pcg::RGBAImageSoA::G>()),
+        reinterpret_cast<const char*>(img.GetDataPointer<pcg::RGBAImageSoA::B>()),
+        reinterpret_cast<const char*>(img.GetDataPointer<pcg::RGBAImageSoA::A>())
+    };
+
+    std::cout << "> NUMA node of each chunk:";
+    for (int k = 0; k < numChunks; ++k) {
+        const size_t middle = (pcg::FirstTouchAllocator::ChunkBegin(
+            planeBytes, k, numChunks) + pcg::FirstTouchAllocator::ChunkBegin(
+            planeBytes, k + 1, numChunks)) / 2;
+        const int node = pageNode(planes[0] + middle);
+        std::cout << " " << node;
+        for (int p = 1; p < 4 && node >= 0; ++p) {
+            EXPECT_EQ(node, pageNode(planes[p] + middle)) << k << " " << p;
+        }
+    }
+    std::cout << std::endl;
+}
+
+// The SoA images record the chunks of the allocator, in pixels, and the
+// kernels which split the pixels in those chunks get the same results
+TEST(ImageAllocatorTest, FirstTouchKernels)
+{
+    const int width  = 333;
+    const int height = 111;
+    const int numChunks = 7;
+    pcg::FirstTouchAllocator firstTouch(NULL, numChunks);
+
+    pcg::RGBAImageSoA expected(width, height);
+    ASSERT_EQ(0, expected.NumChunks());
+    pcg::RGBAImageSoA img;
+    {
+        pcg::AllocatorScope scope(&firstTouch);
+        img.Alloc(width, height);
+    }
+    ASSERT_EQ(numChunks, img.NumChunks());
+    EXPECT_EQ(0, img.ChunkBegin(0));
+    EXPECT_EQ(img.Size(), img.ChunkBegin(numChunks));
+    for (int k = 1; k < numChunks; ++k) {
+        EXPECT_EQ(0, img.ChunkBegin(k) % 16);
+        EXPECT_LT(img.ChunkBegin(k - 1), img.ChunkBegin(k));
+    }
+
+    // Some black pixels, which the parameters estimation leaves out
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            const bool isBlack = (i + j) % 13 == 0;
+            const float r = isBlack ? 0.0f : 4.0f * i / width;
+            const float g = isBlack ? 0.0f : 2.0f * j / height;
+            const float b = isBlack ? 0.0f : 0.01f * ((i * j) % 97);
+            img.ElementAt<pcg::RGBAImageSoA::R>(i, j) = r;
+            img.ElementAt<pcg::RGBAImageSoA::G>(i, j) = g;
+            img.ElementAt<pcg::RGBAImageSoA::B>(i, j) = b;
+            img.ElementAt<pcg::RGBAImageSoA::A>(i, j) = 1.0f;
+            expected.ElementAt<pcg::RGBAImageSoA::R>(i, j) = r;
+            expected.ElementAt<pcg::RGBAImageSoA::G>(i, j) = g;
+            expected.ElementAt<pcg::RGBAImageSoA::B>(i, j) = b;
+            expected.ElementAt<pcg::RGBAImageSoA::A>(i, j) = 1.0f;
+        }
+    }
+
+    // The sums are split differently
+    const pcg::Reinhard02::Params params =
+        pcg::Reinhard02::EstimateParams(img);
+    const pcg::Reinhard02::Params paramsExpected =
+        pcg::Reinhard02::EstimateParams(expected);
+    EXPECT_FLOAT_EQ(paramsExpected.key,     params.key);
+    EXPECT_FLOAT_EQ(paramsExpected.l_w,     params.l_w);
+    EXPECT_FLOAT_EQ(paramsExpected.l_white, params.l_white);
+    EXPECT_EQ(paramsExpected.l_min, params.l_min);
+    EXPECT_EQ(paramsExpected.l_max, params.l_max);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(paramsExpected);
+    pcg::Image<pcg::Bgra8> ldr(width, height), ldrExpected(width, height);
+    tm.ToneMap(ldr, img, pcg::REINHARD02);
+    tm.ToneMap(ldrExpected, expected, pcg::REINHARD02);
+    for (int i = 0; i < ldr.Size(); ++i) {
+        ASSERT_EQ(ldrExpected[i].r, ldr[i].r) << i;
+        ASSERT_EQ(ldrExpected[i].g, ldr[i].g) << i;
+        ASSERT_EQ(ldrExpected[i].b, ldr[i].b) << i;
+        ASSERT_EQ(ldrExpected[i].a, ldr[i].a) << i;
+    }
+}
+
+// Runs the kernels over an image whose pixels were written by a single
+// thread, as the loaders do, when the pages were first touched by that
+// thread or in parallel by the FirstTouchAllocator, whose chunks the kernels
+// then follow. On machines with several NUMA nodes the latter avoids the
+// remote memory accesses of the workers on the other sockets; with a single
+// node both times should be about the same.
+TEST(ImageAllocatorTest, FirstTouchBenchmark)
+{
+    const int width  = 2048;
+    const int height = 2048;
+    const int numRuns = 10;
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-2.0f);
+
+    const char* names[] = { "serial first touch", "parallel first touch" };
+    pcg::FirstTouchAllocator firstTouch;
+    for (int k = 0; k < 2; ++k) {
+        pcg::AllocatorScope scope(k == 0 ?
+            pcg::ImageAllocator::Default() : &firstTouch);
+        pcg::RGBAImageSoA img(width, height);
+        pcg::Image<pcg::Bgra8> ldr(width, height);
+
+        // Single threaded fill
+        for (int j = 0; j < height; ++j) {
+            float* r = img.GetScanlinePointer<pcg::RGBAImageSoA::R>(j);
+            float* g = img.GetScanlinePointer<pcg::RGBAImageSoA::G>(j);
+            float* b = img.GetScanlinePointer<pcg::RGBAImageSoA::B>(j);
+            float* a = img.GetScanlinePointer<pcg::RGBAImageSoA::A>(j);
+            for (int i = 0; i < width; ++i) {
+                r[i] = 0.25f * i / width;
+                g[i] = 0.25f * j / height;
+                b[i] = 0.125f;
+                a[i] = 1.0f;
+            }
+        }
+
+        Timer timer;
+        for (int run = 0; run < numRuns; ++run) {
+            timer.start();
+            tm.ToneMap(ldr, img);
+            timer.stop();
+        }
+        Timer timerParams;
+        for (int run = 0; run < numRuns; ++run) {
+            timerParams.start();
+            tm.SetParams(pcg::Reinhard02::EstimateParams(img));
+            timerParams.stop();
+        }
+        std::cout << "> Tone map with " << names[k] << ": "
+                  << timer.milliTime() / numRuns << " ms, estimate the "
+                  << "parameters: " << timerParams.milliTime() / numRuns
+                  << " ms" << std::endl;
+    }
+}
+
+// Tone maps an image larger than the memory limit of the backing store,
+// which thus lives in a temporary file
+TEST(ImageAllocatorTest, OutOfCore)
+{
+    const size_t memoryLimit = 4 << 20;
+    const int width  = 1024;
+    const int height = 768;
+    pcg::MappedFileAllocator store(memoryLimit);
+
+    pcg::RGBAImageSoA img;
+    img.SetBackingStore(&store);
+    img.Alloc(width, height);
+    ASSERT_LT(memoryLimit, static_cast<size_t>(img.Size()) * 4*sizeof(float));
+    ASSERT_EQ(0, store.InMemoryBytes());
+    ASSERT_LE(static_cast<size_t>(img.Size()) * 4*sizeof(float),
+        store.MappedBytes());
+    ASSERT_TRUE(isAligned(img.GetDataPointer<pcg::RGBAImageSoA::R>(),
+        pcg::ImageSoABase::ALIGNMENT));
+
+    // The same pixels in regular memory
+    pcg::RGBAImageSoA expected(width, height);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            const float r = 4.0f * i / width;
+            const float g = 2.0f * j / height;
+            const float b = 0.01f * ((i * j) % 97);
+            img.ElementAt<pcg::RGBAImageSoA::R>(i, j) = r;
+            img.ElementAt<pcg::RGBAImageSoA::G>(i, j) = g;
+            img.ElementAt<pcg::RGBAImageSoA::B>(i, j) = b;
+            img.ElementAt<pcg::RGBAImageSoA::A>(i, j) = 1.0f;
+            expected.ElementAt<pcg::RGBAImageSoA::R>(i, j) = r;
+            expected.ElementAt<pcg::RGBAImageSoA::G>(i, j) = g;
+            expected.ElementAt<pcg::RGBAImageSoA::B>(i, j) = b;
+            expected.ElementAt<pcg::RGBAImageSoA::A>(i, j) = 1.0f;
+        }
+    }
+
+    // The LDR result fits within the limit
+    pcg::ToneMapperSoA tm;
+    pcg::Image<pcg::Bgra8> ldr, ldrExpected(width, height);
+    {
+        pcg::AllocatorScope scope(&store);
+        ldr.Alloc(width, height);
+    }
+    EXPECT_EQ(static_cast<size_t>(img.Size()) * sizeof(pcg::Bgra8),
+        store.InMemoryBytes());
+
+    const pcg::Reinhard02::Params params =
+        pcg::Reinhard02::EstimateParams(img);
+    const pcg::Reinhard02::Params paramsExpected =
+        pcg::Reinhard02::EstimateParams(expected);
+    EXPECT_EQ(paramsExpected.key,     params.key);
+    EXPECT_EQ(paramsExpected.l_w,     params.l_w);
+    EXPECT_EQ(paramsExpected.l_white, params.l_white);
+
+    tm.SetParams(params);
+    tm.ToneMap(ldr, img, pcg::REINHARD02);
+    tm.ToneMap(ldrExpected, expected, pcg::REINHARD02);
+    for (int i = 0; i < ldr.Size(); ++i) {
+        ASSERT_EQ(ldrExpected[i].r, ldr[i].r);
+        ASSERT_EQ(ldrExpected[i].g, ldr[i].g);
+        ASSERT_EQ(ldrExpected[i].b, ldr[i].b);
+        ASSERT_EQ(ldrExpected[i].a, ldr[i].a);
+    }
+
+    img.Clear();
+    ldr.Clear();
+    EXPECT_EQ(0, store.MappedBytes());
+    EXPECT_EQ(0, store.InMemoryBytes());
+}
@@ -17,9 +17,12 @@
 #include "Timer.h"
 
 #include <StdAfx.h>
+#include <ImageAllocator.h>
 #include <ImageSoA.h>
 #include <Image.h>
 #include <Rgba32F.h>
+#include <Rgb32F.h>
+#include <rgbe.h>
 
 #include <gtest/gtest.h>
 
@@ -274,6 +277,143 @@ protected:
 
 
 
+namespace
+{
+
+// Hands out the same placeholder for any size, so that images with more
+// than 2^31 pixels may be created to check their index arithmetic. The
+// pixels of those images must never be accessed.
+class PlaceholderAllocator : public pcg::ImageAllocator
+{
+public:
+    virtual void* Allocate(size_t) { return m_placeholder; }
+    virtual void Release(void*, size_t) {}
+
+private:
+    ALIGN64_BEG char m_placeholder[64] ALIGN64_END;
+};
+
+// Checks the indices of both scanline orders against the expected formula
+template <class ImageCls>
+void testIndices(const ImageCls &img, pcg::ScanLineMode imgMode)
+{
+    const ptrdiff_t w = img.Width();
+    const ptrdiff_t h = img.Height();
+    const int is[] = {0, 1, img.Width() - 1};
+    const int js[] = {0, 1, img.Height() / 2, img.Height() - 1};
+    for (size_t a = 0; a != sizeof(is)/sizeof(is[0]); ++a) {
+        for (size_t b = 0; b != sizeof(js)/sizeof(js[0]); ++b) {
+            const int i = is[a];
+            const int j = js[b];
+            const ptrdiff_t same = w*j + i;
+            const ptrdiff_t flipped = (h-j-1)*w + i;
+            const pcg::ScanLineMode other =
+                imgMode == pcg::TopDown ? pcg::BottomUp : pcg::TopDown;
+            ASSERT_EQ(same, img.GetIndex(i, j));
+            ASSERT_EQ(same, img.GetIndex(i, j, imgMode));
+            ASSERT_EQ(flipped, img.GetIndex(i, j, other));
+
+            int i2 = -1, j2 = -1;
+            img.GetIndices(same, i2, j2);
+            ASSERT_EQ(i, i2);
+            ASSERT_EQ(j, j2);
+        }
+    }
+}
+
+} // namespace
+
+
+
+// Images with more than 2^31 pixels, whose memory is never touched
+TEST(ImageIndexTest, Large)
+{
+    PlaceholderAllocator placeholder;
+    pcg::AllocatorScope scope(&placeholder);
+    const int w = 65536;
+    const int h = 40000;
+    const ptrdiff_t size = ptrdiff_t(w) * h;
+    ASSERT_GT(size, ptrdiff_t(1) << 31);
+
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> td(w, h);
+    EXPECT_EQ(size, td.Size());
+    testIndices(td, pcg::TopDown);
+
+    pcg::Image<pcg::Rgba32F, pcg::BottomUp> bu(w, h);
+    EXPECT_EQ(size, bu.Size());
+    testIndices(bu, pcg::BottomUp);
+
+    pcg::RGBAImageSoA soa(w, h);
+    EXPECT_EQ(size, soa.Size());
+    testIndices(soa, pcg::TopDown);
+}
+
+
+
+// GetIndex(i,j,mode) follows the given scanline order, as ElementAt does
+TEST(ImageIndexTest, ScanlineOrder)
+{
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> td(7, 5);
+    pcg::Image<pcg::Rgba32F, pcg::BottomUp> bu(7, 5);
+    testIndices(td, pcg::TopDown);
+    testIndices(bu, pcg::BottomUp);
+
+    for (int j = 0; j < 5; ++j) {
+        for (int i = 0; i < 7; ++i) {
+            ASSERT_EQ(&td.ElementAt(i, j, pcg::BottomUp),
+                &td[td.GetIndex(i, j, pcg::BottomUp)]);
+            ASSERT_EQ(&bu.ElementAt(i, j, pcg::TopDown),
+                &bu[bu.GetIndex(i, j, pcg::TopDown)]);
+        }
+    }
+}
+
+
+
+TEST(MultiChannelImageSoATest, Basic)
+{
+    typedef pcg::MultiChannelImageSoA Img;
+    Img::ChannelList channels;
+    channels.push_back(Img::Channel("Z"));
+    channels.push_back(Img::Channel("N.x", Img::HALF));
+    channels.push_back(Img::Channel("id", Img::UINT));
+
+    Img img(37, 11, channels);
+    ASSERT_EQ(37, img.Width());
+    ASSERT_EQ(11, img.Height());
+    ASSERT_EQ(3, img.NumChannels());
+    ASSERT_EQ(1, img.FindChannel("N.x"));
+    ASSERT_EQ(-1, img.FindChannel("N.y"));
+    ASSERT_THROW(img.ChannelIndex("N.y"), pcg::IllegalArgumentException);
+
+    // Each plane is aligned and padded
+    float* z = img.GetPlane<float>("Z");
+    uint16_t* nx = img.GetPlane<uint16_t>("N.x");
+    uint32_t* id = img.GetPlane<uint32_t>("id");
+    ASSERT_EQ(0, reinterpret_cast<intptr_t>(z)  % pcg::ImageSoABase::ALIGNMENT);
+    ASSERT_EQ(0, reinterpret_cast<intptr_t>(nx) % pcg::ImageSoABase::ALIGNMENT);
+    ASSERT_EQ(0, reinterpret_cast<intptr_t>(id) % pcg::ImageSoABase::ALIGNMENT);
+    ASSERT_LE(reinterpret_cast<int8_t*>(z + img.Size()),
+        reinterpret_cast<int8_t*>(nx));
+    ASSERT_LE(reinterpret_cast<int8_t*>(nx + img.Size()),
+        reinterpret_cast<int8_t*>(id));
+
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            img.ElementAt<float>(0, i, j) = static_cast<float>(i + j);
+            img.ElementAt<uint32_t>(2, i, j) = i * j;
+        }
+    }
+    ASSERT_EQ(46.0f, z[img.GetIndex(36, 10)]);
+    ASSERT_EQ(360u, img.GetScanlinePointer<uint32_t>(2, 10)[36]);
+    ASSERT_EQ(0u, img.GetScanlinePointer<uint32_t>(2, 10, pcg::BottomUp)[36]);
+
+    channels.push_back(Img::Channel("Z", Img::HALF));
+    ASSERT_THROW(img.Alloc(4, 4, channels), pcg::IllegalArgumentException);
+    img.Clear();
+    ASSERT_EQ(0, img.NumChannels());
+}
+
 TEST_F(RGBAImageSoATest, CopyConstruct)
 {
     const int N = 100;
@@ -347,3 +487,148 @@ TEST_F(RGBAImageSoATest, CopyConstructBottomUp)
 
     cout << "> Copy-constructor time: " << t1.milliTime()*1e-3 << " s" << endl;
 }
+
+
+
+TEST_F(RGBAImageSoATest, CopyTo)
+{
+    const int N = 20;
+    Timer t1;
+
+    for (int runIdx = 0; runIdx < N; ++runIdx) {
+        const int width  = 1 + m_rnd.nextInt(1024);
+        const int height = 1 + m_rnd.nextInt(1024);
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> imgTD(width, height);
+        fillRnd(imgTD);
+        Image img(imgTD);
+
+        // Different sizes are reallocated
+        pcg::Image<pcg::Rgba32F, pcg::TopDown>  outTD(3, 5);
+        pcg::Image<pcg::Rgba32F, pcg::BottomUp> outBU;
+        t1.start();
+        img.CopyTo(outTD);
+        img.CopyTo(outBU);
+        t1.stop();
+        ASSERT_EQ(width,  outTD.Width());
+        ASSERT_EQ(height, outTD.Height());
+        ASSERT_EQ(width,  outBU.Width());
+        ASSERT_EQ(height, outBU.Height());
+
+        for (int j = 0; j != height; ++j) {
+            const pcg::Rgba32F *p  = imgTD.GetScanlinePointer(j, pcg::TopDown);
+            const pcg::Rgba32F *td = outTD.GetScanlinePointer(j, pcg::TopDown);
+            const pcg::Rgba32F *bu = outBU.GetScanlinePointer(j, pcg::TopDown);
+            for (int i = 0; i != width; ++i) {
+                ASSERT_EQ(p[i].r(), td[i].r());
+                ASSERT_EQ(p[i].g(), td[i].g());
+                ASSERT_EQ(p[i].b(), td[i].b());
+                ASSERT_EQ(p[i].a(), td[i].a());
+                ASSERT_EQ(p[i].r(), bu[i].r());
+                ASSERT_EQ(p[i].g(), bu[i].g());
+                ASSERT_EQ(p[i].b(), bu[i].b());
+                ASSERT_EQ(p[i].a(), bu[i].a());
+            }
+        }
+    }
+
+    cout << "> CopyTo time: " << t1.milliTime()*1e-3 << " s" << endl;
+}
+
+
+
+TEST_F(RGBAImageSoATest, Rgb32F)
+{
+    const int N = 20;
+
+    for (int runIdx = 0; runIdx < N; ++runIdx) {
+        const int width  = 1 + m_rnd.nextInt(512);
+        const int height = 1 + m_rnd.nextInt(512);
+        pcg::Image<pcg::Rgba32F, pcg::BottomUp> imgOrig(width, height);
+        fillRnd(imgOrig);
+        imgOrig[0].setA(0.0f);
+
+        pcg::Image<pcg::Rgb32F, pcg::BottomUp> imgRgb(width, height);
+        for (int i = 0; i < imgOrig.Size(); ++i) {
+            imgRgb[i] = pcg::Rgb32F(imgOrig[i]);
+        }
+
+        // The alpha of the Rgb32F pixels is one
+        Image img(imgRgb);
+        for (int j = 0; j != height; ++j) {
+            const float *r = img.GetScanlinePointer<Image::R> (j,pcg::BottomUp);
+            const float *g = img.GetScanlinePointer<Image::G> (j,pcg::BottomUp);
+            const float *b = img.GetScanlinePointer<Image::B> (j,pcg::BottomUp);
+            const float *a = img.GetScanlinePointer<Image::A> (j,pcg::BottomUp);
+            const pcg::Rgb32F *p = imgRgb.GetScanlinePointer(j,pcg::BottomUp);
+            for (int i = 0; i != width; ++i) {
+                ASSERT_EQ(p[i].r, r[i]);
+                ASSERT_EQ(p[i].g, g[i]);
+                ASSERT_EQ(p[i].b, b[i]);
+                ASSERT_EQ(1.0f,   a[i]);
+            }
+        }
+
+        // Going back applies alpha, as the Rgba32F to Rgb32F conversion
+        Image imgAlpha(imgOrig);
+        pcg::Image<pcg::Rgb32F, pcg::TopDown> outTD;
+        pcg::Image<pcg::Rgb32F, pcg::BottomUp> outBU;
+        imgAlpha.CopyTo(outTD);
+        imgAlpha.CopyTo(outBU);
+        for (int j = 0; j != height; ++j) {
+            const pcg::Rgb32F *p  = imgRgb.GetScanlinePointer(j, pcg::TopDown);
+            const pcg::Rgb32F *td = outTD.GetScanlinePointer(j, pcg::TopDown);
+            const pcg::Rgb32F *bu = outBU.GetScanlinePointer(j, pcg::TopDown);
+            for (int i = 0; i != width; ++i) {
+                ASSERT_EQ(p[i].r, td[i].r);
+                ASSERT_EQ(p[i].g, td[i].g);
+                ASSERT_EQ(p[i].b, td[i].b);
+                ASSERT_EQ(p[i].r, bu[i].r);
+                ASSERT_EQ(p[i].g, bu[i].g);
+                ASSERT_EQ(p[i].b, bu[i].b);
+            }
+        }
+    }
+}
+
+
+
+TEST_F(RGBAImageSoATest, Rgbe)
+{
+    const int N = 20;
+
+    for (int runIdx = 0; runIdx < N; ++runIdx) {
+        const int width  = 1 + m_rnd.nextInt(512);
+        const int height = 1 + m_rnd.nextInt(512);
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> imgOrig(width, height);
+        fillRnd(imgOrig);
+
+        pcg::Image<pcg::Rgbe, pcg::TopDown> imgRgbe(width, height);
+        for (int i = 0; i < imgOrig.Size(); ++i) {
+            imgRgbe[i] = imgOrig[i];
+        }
+        imgRgbe[0].set(0, 0, 0, 0);
+
+        Image img(imgRgbe);
+        for (int i = 0; i < imgRgbe.Size(); ++i) {
+            const pcg::Rgba32F p = imgRgbe[i];
+            ASSERT_EQ(p.r(), img.ElementAt<Image::R>(i));
+            ASSERT_EQ(p.g(), img.ElementAt<Image::G>(i));
+            ASSERT_EQ(p.b(), img.ElementAt<Image::B>(i));
+            ASSERT_EQ(p.a(), img.ElementAt<Image::A>(i));
+        }
+
+        // Decoding is exact, thus encoding again yields the same pixels
+        pcg::Image<pcg::Rgbe, pcg::BottomUp> outBU;
+        img.CopyTo(outBU);
+        for (int j = 0; j != height; ++j) {
+            const pcg::Rgbe *p  = imgRgbe.GetScanlinePointer(j, pcg::TopDown);
+            const pcg::Rgbe *bu = outBU.GetScanlinePointer(j, pcg::TopDown);
+            for (int i = 0; i != width; ++i) {
+                ASSERT_EQ(p[i].r, bu[i].r);
+                ASSERT_EQ(p[i].g, bu[i].g);
+                ASSERT_EQ(p[i].b, bu[i].b);
+                ASSERT_EQ(p[i].e, bu[i].e);
+            }
+        }
+    }
+}
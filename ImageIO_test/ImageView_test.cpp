@@ -0,0 +1,476 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <ImageView.h>
+#include <ToneMapperSoA.h>
+#include <ImageComparator.h>
+#include <Reinhard02.h>
+#include <OpenEXRIO.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// Layout of an external buffer: the pixels start after "offset" elements
+// and consecutive scanlines are "stride" elements apart
+struct Layout
+{
+    int width;
+    int height;
+    int stride;
+    int offset;
+
+    size_t bufferSize() const {
+        return static_cast<size_t>(offset + stride*height + 7);
+    }
+};
+
+const Layout LAYOUTS[] = {
+    { 37, 5, 37, 0},    // Contiguous, odd width
+    { 37, 5, 41, 1},    // Padded scanlines, unaligned
+    {256, 3, 256, 0},   // Contiguous, whole vectors
+    {256, 3, 259, 3},   // Whole vectors, unaligned
+    { 17, 9, 20, 2},
+    {  3, 7, 3, 1}      // Smaller than a vector
+};
+const int NUM_LAYOUTS = sizeof(LAYOUTS) / sizeof(Layout);
+
+bool SamePixels(const pcg::Bgra8& p0, const pcg::Bgra8& p1)
+{
+    return p0.r == p1.r && p0.g == p1.g && p0.b == p1.b && p0.a == p1.a;
+}
+
+// Value used to detect writes outside of the views
+pcg::Bgra8 sentinel()
+{
+    pcg::Bgra8 p;
+    p.set(0x11, 0x22, 0x33, 0x44);
+    return p;
+}
+const pcg::Bgra8 SENTINEL = sentinel();
+
+} // namespace
+
+
+
+class ImageViewTest : public ::testing::Test
+{
+protected:
+    ImageViewTest() : m_filename("ImageView_test.exr") {}
+
+    virtual void SetUp()
+    {
+        // Python generated
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x5a3c20e9, 0x1d8f7b42,
+            0x63b0a51c, 0x2e47d9f8, 0x70c1368a, 0x0f9e5b27, 0x4836ec91,
+            0x39a2f05d, 0x17d46b8e, 0x6cf8a213, 0x251b9e7c, 0x7e6304d5,
+            0x0b87c6f1, 0x54e92a38, 0x42105fb6, 0x3f7d18c4
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+        std::remove(m_filename.c_str());
+    }
+
+    pcg::Rgba32F nextPixel()
+    {
+        const float s = static_cast<float>(512 + 32 * m_rnd.nextGaussian());
+        const float r = s * m_rnd.nextFloat();
+        const float g = s * m_rnd.nextFloat();
+        const float b = s * m_rnd.nextFloat();
+        const float a = m_rnd.nextFloat();
+        return pcg::Rgba32F(r, g, b, a);
+    }
+
+    void fillRnd(pcg::Image<pcg::Rgba32F> &img)
+    {
+        for (int i = 0; i < img.Size(); ++i) {
+            img[i] = nextPixel();
+        }
+    }
+
+    // Copies the pixels of an image into a view of the same size
+    static void copy(const pcg::ImageView<pcg::Rgba32F> &view,
+        const pcg::Image<pcg::Rgba32F> &img)
+    {
+        for (int j = 0; j < img.Height(); ++j) {
+            for (int i = 0; i < img.Width(); ++i) {
+                view.ElementAt(i, j) = img.ElementAt(i, j);
+            }
+        }
+    }
+
+    static void copy(const pcg::RGBAImageSoAView &view,
+        const pcg::Image<pcg::Rgba32F> &img)
+    {
+        typedef pcg::RGBAImageSoAView V;
+        for (int j = 0; j < img.Height(); ++j) {
+            for (int i = 0; i < img.Width(); ++i) {
+                const pcg::Rgba32F &p = img.ElementAt(i, j);
+                view.ElementAt<V::R>(i, j) = p.r();
+                view.ElementAt<V::G>(i, j) = p.g();
+                view.ElementAt<V::B>(i, j) = p.b();
+                view.ElementAt<V::A>(i, j) = p.a();
+            }
+        }
+    }
+
+    static pcg::Rgba32F pixel(const pcg::ImageView<pcg::Rgba32F> &view,
+        int i, int j)
+    {
+        return view.ElementAt(i, j);
+    }
+
+    static pcg::Rgba32F pixel(const pcg::RGBAImageSoAView &view, int i, int j)
+    {
+        return view(i, j);
+    }
+
+    // Buffer with four planes for the SoA views
+    struct PlanesBuffer
+    {
+        PlanesBuffer(const Layout &l) : r(l.bufferSize(), -1.0f),
+            g(l.bufferSize(), -1.0f), b(l.bufferSize(), -1.0f),
+            a(l.bufferSize(), -1.0f), layout(l) {}
+
+        pcg::RGBAImageSoAView view() {
+            const int o = layout.offset;
+            return pcg::RGBAImageSoAView(&r[o], &g[o], &b[o], &a[o],
+                layout.width, layout.height, layout.stride);
+        }
+
+        std::vector<float> r, g, b, a;
+        Layout layout;
+    };
+
+    // Buffer for the AoS views
+    struct PixelsBuffer
+    {
+        PixelsBuffer(const Layout &l) :
+            pixels(l.bufferSize(), pcg::Rgba32F(-1.0f)), layout(l) {}
+
+        pcg::ImageView<pcg::Rgba32F> view() {
+            return pcg::ImageView<pcg::Rgba32F>(&pixels[layout.offset],
+                layout.width, layout.height, layout.stride);
+        }
+
+        std::vector<pcg::Rgba32F> pixels;
+        Layout layout;
+    };
+
+    // Tone maps the image and a view with the same pixels, the results
+    // must be identical and the pixels outside of the view untouched
+    template <class Source>
+    void testToneMap(const pcg::ToneMapperSoA &tm,
+        const pcg::Image<pcg::Rgba32F> &img, const pcg::RGBAImageSoA &soa,
+        const Source &src, const Layout &l)
+    {
+        pcg::Image<pcg::Bgra8> expected(img.Width(), img.Height());
+        tm.ToneMap(expected, soa, pcg::REINHARD02);
+
+        std::vector<pcg::Bgra8> buffer(l.bufferSize(), SENTINEL);
+        pcg::ImageView<pcg::Bgra8> dest(&buffer[l.offset],
+            l.width, l.height, l.stride);
+        tm.ToneMap(dest, src, pcg::REINHARD02);
+
+        for (size_t k = 0; k < buffer.size(); ++k) {
+            const ptrdiff_t idx = static_cast<ptrdiff_t>(k) - l.offset;
+            const int j = idx >= 0 ? static_cast<int>(idx / l.stride) : -1;
+            const int i = idx >= 0 ? static_cast<int>(idx % l.stride) : -1;
+            if (j >= 0 && j < l.height && i < l.width) {
+                ASSERT_PRED2(SamePixels, expected.ElementAt(i, j), buffer[k])
+                    << "(" << i << "," << j << ")";
+            } else {
+                ASSERT_PRED2(SamePixels, SENTINEL, buffer[k]) << k;
+            }
+        }
+    }
+
+    template <class ViewBuffer>
+    void testCompare(const Layout &l)
+    {
+        pcg::Image<pcg::Rgba32F> src1(l.width, l.height);
+        pcg::Image<pcg::Rgba32F> src2(l.width, l.height);
+        pcg::Image<pcg::Rgba32F> expected(l.width, l.height);
+        fillRnd(src1);
+        fillRnd(src2);
+
+        ViewBuffer buf1(l), buf2(l), bufDest(l);
+        copy(buf1.view(), src1);
+        copy(buf2.view(), src2);
+
+        const pcg::ImageComparator::Type types[] = {
+            pcg::ImageComparator::AbsoluteDifference,
+            pcg::ImageComparator::Addition,
+            pcg::ImageComparator::Division,
+            pcg::ImageComparator::RelativeError,
+            pcg::ImageComparator::PositiveNegative,
+            pcg::ImageComparator::PositiveNegativeRelativeError
+        };
+        for (size_t t = 0; t < sizeof(types)/sizeof(types[0]); ++t) {
+            compare(types[t], expected, src1, src2, bufDest);
+            pcg::ImageComparator::Compare(types[t], bufDest.view(),
+                buf1.view(), buf2.view());
+            for (int j = 0; j < l.height; ++j) {
+                for (int i = 0; i < l.width; ++i) {
+                    ASSERT_RGBA32F_EQ(expected.ElementAt(i, j),
+                        pixel(bufDest.view(), i, j));
+                }
+            }
+        }
+    }
+
+    // The views must match the images with the same layout
+    static void compare(pcg::ImageComparator::Type type,
+        pcg::Image<pcg::Rgba32F> &dest, const pcg::Image<pcg::Rgba32F> &src1,
+        const pcg::Image<pcg::Rgba32F> &src2, const PixelsBuffer &)
+    {
+        pcg::ImageComparator::Compare(type, dest, src1, src2);
+    }
+
+    static void compare(pcg::ImageComparator::Type type,
+        pcg::Image<pcg::Rgba32F> &dest, const pcg::Image<pcg::Rgba32F> &src1,
+        const pcg::Image<pcg::Rgba32F> &src2, const PlanesBuffer &)
+    {
+        pcg::RGBAImageSoA soa1(src1), soa2(src2);
+        pcg::RGBAImageSoA soaDest(dest.Width(), dest.Height());
+        pcg::ImageComparator::Compare(type, soaDest, soa1, soa2);
+        for (int i = 0; i < dest.Size(); ++i) {
+            dest[i] = soaDest[i];
+        }
+    }
+
+    template <class ViewBuffer>
+    void testEXR(const Layout &l)
+    {
+        pcg::Image<pcg::Rgba32F> img(l.width, l.height);
+        fillRnd(img);
+        ViewBuffer buf(l);
+        copy(buf.view(), img);
+
+        // Saving the view must be equivalent to saving the image
+        pcg::Image<pcg::Rgba32F> expected, result;
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(), pcg::OpenEXRIO::WRITE_RGBA);
+        pcg::OpenEXRIO::Load(expected, m_filename.c_str());
+        pcg::OpenEXRIO::Save(buf.view(), m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA);
+        pcg::OpenEXRIO::Load(result, m_filename.c_str());
+        ASSERT_EQ(expected.Width(),  result.Width());
+        ASSERT_EQ(expected.Height(), result.Height());
+        for (int i = 0; i < expected.Size(); ++i) {
+            ASSERT_RGBA32F_EQ(expected[i], result[i]);
+        }
+
+        // Load back into a different view
+        Layout lOther = l;
+        lOther.stride += 5;
+        lOther.offset  = 2;
+        ViewBuffer other(lOther);
+        pcg::OpenEXRIO::Load(other.view(), m_filename.c_str());
+        for (int j = 0; j < l.height; ++j) {
+            for (int i = 0; i < l.width; ++i) {
+                ASSERT_RGBA32F_EQ(expected.ElementAt(i, j),
+                    pixel(other.view(), i, j));
+            }
+        }
+
+        // The views are never resized
+        Layout lWrong = l;
+        lWrong.width  += 1;
+        lWrong.stride += 1;
+        ViewBuffer wrong(lWrong);
+        ASSERT_THROW(pcg::OpenEXRIO::Load(wrong.view(), m_filename.c_str()),
+            pcg::IOException);
+    }
+
+    RandomMT m_rnd;
+    const std::string m_filename;
+};
+
+
+
+TEST_F(ImageViewTest, Basic)
+{
+    pcg::Image<pcg::Rgba32F> img(7, 3);
+    fillRnd(img);
+
+    pcg::ImageView<pcg::Rgba32F> view(img);
+    ASSERT_EQ(7, view.Width());
+    ASSERT_EQ(3, view.Height());
+    ASSERT_EQ(21, view.Size());
+    ASSERT_TRUE(view.IsContiguous());
+    ASSERT_EQ(img.GetDataPointer(), view.GetDataPointer());
+    for (int j = 0; j < 3; ++j) {
+        ASSERT_EQ(img.GetScanlinePointer(j, pcg::BottomUp),
+            view.GetScanlinePointer(j, pcg::BottomUp));
+        for (int i = 0; i < 7; ++i) {
+            ASSERT_EQ(&img.ElementAt(i, j), &view.ElementAt(i, j));
+        }
+    }
+
+    // Bottom-up bitmap seen as top-down through a negative stride
+    pcg::ImageView<pcg::Rgba32F> flipped(img.GetScanlinePointer(2), 7, 3, -7);
+    ASSERT_FALSE(flipped.IsContiguous());
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 7; ++i) {
+            ASSERT_EQ(&img.ElementAt(i, j, pcg::BottomUp),
+                &flipped.ElementAt(i, j));
+        }
+    }
+
+    // A sub-region of the image
+    pcg::ImageView<pcg::Rgba32F> sub(&img.ElementAt(2, 1), 4, 2, img.Width());
+    ASSERT_FALSE(sub.IsContiguous());
+    ASSERT_EQ(&img.ElementAt(5, 2), &sub.ElementAt(3, 1));
+    ASSERT_EQ(&img.ElementAt(2, 1), &sub.ElementAt(0, 1, pcg::BottomUp));
+
+    pcg::RGBAImageSoA soa(img);
+    pcg::RGBAImageSoAView soaView(soa);
+    ASSERT_TRUE(soaView.IsContiguous());
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 7; ++i) {
+            ASSERT_RGBA32F_EQ(img.ElementAt(i, j), soaView(i, j));
+        }
+    }
+}
+
+TEST_F(ImageViewTest, ToneMap)
+{
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-9.0f);
+    for (int n = 0; n < NUM_LAYOUTS; ++n) {
+        const Layout &l = LAYOUTS[n];
+        pcg::Image<pcg::Rgba32F> img(l.width, l.height);
+        fillRnd(img);
+        pcg::RGBAImageSoA soa(img);
+        tm.SetParams(pcg::Reinhard02::EstimateParams(soa));
+
+        PixelsBuffer aos(l);
+        copy(aos.view(), img);
+        PlanesBuffer planes(l);
+        copy(planes.view(), img);
+
+        testToneMap(tm, img, soa, aos.view(), l);
+        testToneMap(tm, img, soa, planes.view(), l);
+        testToneMap(tm, img, soa, pcg::ImageView<pcg::Rgba32F>(img), l);
+        testToneMap(tm, img, soa, pcg::RGBAImageSoAView(soa), l);
+    }
+}
+
+// AoS views over memory which is not aligned to 16 bytes, as may come from
+// external buffers, must be staged instead of read as whole vectors
+TEST_F(ImageViewTest, ToneMapUnaligned)
+{
+    const int w = 67;
+    const int h = 9;
+    pcg::Image<pcg::Rgba32F> img(w, h);
+    fillRnd(img);
+    pcg::RGBAImageSoA soa(img);
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(pcg::Reinhard02::EstimateParams(soa));
+    pcg::Image<pcg::Bgra8> expected(w, h);
+    tm.ToneMap(expected, soa, pcg::REINHARD02);
+
+    // Aligned storage shifted by one float
+    pcg::Image<pcg::Rgba32F> storage(w + 1, h);
+    float* base = reinterpret_cast<float*>(storage.GetDataPointer()) + 1;
+    memcpy(base, img.GetDataPointer(), img.Size() * sizeof(pcg::Rgba32F));
+    const pcg::ImageView<pcg::Rgba32F> view(
+        reinterpret_cast<pcg::Rgba32F*>(base), w, h);
+    ASSERT_TRUE(view.IsContiguous());
+
+    pcg::Image<pcg::Bgra8> result(w, h);
+    tm.ToneMap(pcg::ImageView<pcg::Bgra8>(result), view, pcg::REINHARD02);
+    for (int i = 0; i < expected.Size(); ++i) {
+        ASSERT_PRED2(SamePixels, expected[i], result[i]) << i;
+    }
+
+    // Same through the scanline path of views with a stride
+    const pcg::ImageView<pcg::Rgba32F> strided(
+        reinterpret_cast<pcg::Rgba32F*>(base), w - 1, h, w);
+    pcg::Image<pcg::Bgra8> stridedResult(w - 1, h);
+    tm.ToneMap(pcg::ImageView<pcg::Bgra8>(stridedResult), strided,
+        pcg::REINHARD02);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w - 1; ++i) {
+            ASSERT_PRED2(SamePixels, expected.ElementAt(i, j),
+                stridedResult.ElementAt(i, j)) << i << "," << j;
+        }
+    }
+}
+
+TEST_F(ImageViewTest, Compare)
+{
+    for (int n = 0; n < NUM_LAYOUTS; ++n) {
+        testCompare<PixelsBuffer>(LAYOUTS[n]);
+        testCompare<PlanesBuffer>(LAYOUTS[n]);
+    }
+}
+
+TEST_F(ImageViewTest, Reinhard02Params)
+{
+    for (int n = 0; n < NUM_LAYOUTS; ++n) {
+        const Layout &l = LAYOUTS[n];
+        pcg::Image<pcg::Rgba32F> img(l.width, l.height);
+        fillRnd(img);
+        // A few pixels without valid luminance
+        img[0].set(0.0f, 0.0f, 0.0f, 1.0f);
+        img[img.Size()-1].set(-1.0f, -1.0f, -1.0f, 1.0f);
+        const pcg::Reinhard02::Params expected =
+            pcg::Reinhard02::EstimateParams(img);
+
+        PixelsBuffer aos(l);
+        copy(aos.view(), img);
+        PlanesBuffer planes(l);
+        copy(planes.view(), img);
+        const pcg::Reinhard02::Params pAoS =
+            pcg::Reinhard02::EstimateParams(aos.view());
+        const pcg::Reinhard02::Params pSoA =
+            pcg::Reinhard02::EstimateParams(planes.view());
+
+        const pcg::Reinhard02::Params *params[] = { &pAoS, &pSoA };
+        for (int k = 0; k < 2; ++k) {
+            const pcg::Reinhard02::Params &p = *params[k];
+            ASSERT_NEAR(expected.key,     p.key,     1e-5f * expected.key);
+            ASSERT_NEAR(expected.l_w,     p.l_w,     1e-5f * expected.l_w);
+            ASSERT_NEAR(expected.l_white, p.l_white, 1e-5f * expected.l_white);
+            ASSERT_NEAR(expected.l_min,   p.l_min,   1e-5f * expected.l_min);
+            ASSERT_NEAR(expected.l_max,   p.l_max,   1e-5f * expected.l_max);
+        }
+    }
+}
+
+TEST_F(ImageViewTest, OpenEXR)
+{
+    for (int n = 0; n < NUM_LAYOUTS; ++n) {
+        testEXR<PixelsBuffer>(LAYOUTS[n]);
+        testEXR<PlanesBuffer>(LAYOUTS[n]);
+    }
+}
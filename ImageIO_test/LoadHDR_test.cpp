@@ -0,0 +1,177 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <LoadHDR.h>
+#include <OpenEXRIO.h>
+#include <PfmIO.h>
+#include <RgbeIO.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+
+class LoadHDRTest : public ::testing::Test
+{
+protected:
+    enum Format { RGBE, PFM, OpenEXR };
+
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x5e8c1a47, 0x0b3d72f9,
+            0x62a4e81c, 0x1d97f035, 0x7c05b6d2, 0x34e8290b, 0x4fa1c76e,
+            0x280d5b93, 0x6b72e4a0, 0x13c6f8d5, 0x59b0a23f, 0x07e4d16c,
+            0x45f93b28, 0x7a2c60e1, 0x3e81d94a, 0x1c5f07b7
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+        for (size_t i = 0; i < m_files.size(); ++i) {
+            std::remove(m_files[i].c_str());
+        }
+    }
+
+    // Registers a temporary file to be deleted after the test
+    const char* tmpFile(const char* name) {
+        m_files.push_back(name);
+        return m_files.back().c_str();
+    }
+
+    void saveRnd(const char* filename, Format format, int width, int height)
+    {
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> img(width, height);
+        for (int i = 0; i < img.Size(); ++i) {
+            const float s = 1000.0f * m_rnd.nextFloat();
+            img[i].set (s * m_rnd.nextFloat(), s * m_rnd.nextFloat(),
+                s * m_rnd.nextFloat(), 1.0f);
+        }
+        switch (format) {
+        case RGBE:
+            pcg::RgbeIO::Save(img, filename);
+            break;
+        case PFM:
+            pcg::PfmIO::Save(img, filename);
+            break;
+        case OpenEXR:
+            pcg::OpenEXRIO::Save(img, filename);
+            break;
+        }
+    }
+
+    // Loading by name uses a memory mapping, which must yield exactly the
+    // same pixels as reading through a file stream
+    void testMapped(const char* filename, Format format)
+    {
+        saveRnd(filename, format, 317, 123);
+
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> mapped, streamed;
+        pcg::LoadHDR(mapped, filename);
+        {
+            std::ifstream is(filename, std::ios::binary);
+            pcg::LoadHDR(streamed, is);
+        }
+        ASSERT_EQ(streamed.Width(),  mapped.Width());
+        ASSERT_EQ(streamed.Height(), mapped.Height());
+        for (int i = 0; i < streamed.Size(); ++i) {
+            ASSERT_EQ(streamed[i], mapped[i]);
+        }
+
+        pcg::RGBAImageSoA mappedSoA, streamedSoA;
+        pcg::LoadHDR(mappedSoA, filename);
+        {
+            std::ifstream is(filename, std::ios::binary);
+            pcg::LoadHDR(streamedSoA, is);
+        }
+        ASSERT_EQ(streamedSoA.Width(),  mappedSoA.Width());
+        ASSERT_EQ(streamedSoA.Height(), mappedSoA.Height());
+        for (int i = 0; i < streamedSoA.Size(); ++i) {
+            ASSERT_EQ(streamedSoA[i], mappedSoA[i]);
+        }
+    }
+
+    // A file missing its last bytes must be reported as an error
+    void testTruncated(const char* filename, const char* truncated,
+        Format format)
+    {
+        saveRnd(filename, format, 64, 32);
+        std::vector<char> data;
+        {
+            std::ifstream is(filename, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(is),
+                std::istreambuf_iterator<char>());
+        }
+        ASSERT_LT(256u, data.size());
+        {
+            std::ofstream os(truncated, std::ios::binary);
+            os.write(&data[0], data.size() - 256);
+        }
+
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> img;
+        ASSERT_THROW(pcg::LoadHDR(img, truncated), pcg::IOException);
+        pcg::RGBAImageSoA imgSoA;
+        ASSERT_THROW(pcg::LoadHDR(imgSoA, truncated), pcg::IOException);
+    }
+
+    RandomMT m_rnd;
+    std::deque<std::string> m_files;
+};
+
+
+
+TEST_F(LoadHDRTest, MappedRgbe)
+{
+    testMapped(tmpFile("LoadHDR_mapped.hdr"), RGBE);
+}
+
+TEST_F(LoadHDRTest, MappedPfm)
+{
+    testMapped(tmpFile("LoadHDR_mapped.pfm"), PFM);
+}
+
+TEST_F(LoadHDRTest, MappedOpenEXR)
+{
+    testMapped(tmpFile("LoadHDR_mapped.exr"), OpenEXR);
+}
+
+TEST_F(LoadHDRTest, Truncated)
+{
+    testTruncated(tmpFile("LoadHDR_full.hdr"),
+        tmpFile("LoadHDR_truncated.hdr"), RGBE);
+    testTruncated(tmpFile("LoadHDR_full.pfm"),
+        tmpFile("LoadHDR_truncated.pfm"), PFM);
+    testTruncated(tmpFile("LoadHDR_full.exr"),
+        tmpFile("LoadHDR_truncated.exr"), OpenEXR);
+}
+
+TEST_F(LoadHDRTest, Missing)
+{
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img;
+    ASSERT_THROW(pcg::LoadHDR(img, "LoadHDR_missing.hdr"), pcg::IOException);
+}
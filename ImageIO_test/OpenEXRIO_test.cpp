@@ -0,0 +1,316 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "Timer.h"
+#include "TestUtil.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <OpenEXRIO.h>
+#include <Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+
+using std::cout;
+using std::endl;
+
+
+
+class OpenEXRIOTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x4d2e8b17, 0x19a5c3f0,
+            0x6c07e94b, 0x2f81d65a, 0x75b3409e, 0x0a6fc218, 0x58d4e7a3,
+            0x33c9158d, 0x61e0b4f6, 0x0db72a59, 0x47a3f1c2, 0x2b5e96d4,
+            0x7f18c03a, 0x12d46b8e, 0x5ca9e271, 0x3807f5cd
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+        std::remove(m_filename.c_str());
+    }
+
+    // Random values within the range of half, including negative ones
+    template <pcg::ScanLineMode S>
+    void fillRnd (pcg::Image<pcg::Rgba32F, S> &img) {
+        for (int i = 0; i < img.Size(); ++i) {
+            const float s = 1000.0f * static_cast<float>(m_rnd.nextDouble());
+            const float r = s * static_cast<float>(2*m_rnd.nextDouble() - 1);
+            const float g = s * static_cast<float>(2*m_rnd.nextDouble() - 1);
+            const float b = s * static_cast<float>(2*m_rnd.nextDouble() - 1);
+            const float a = static_cast<float>(m_rnd.nextDouble());
+            img[i].set (r, g, b, a);
+        }
+    }
+
+    // Whether the value is the half closest to the expected one
+    static bool isHalfOf(float expected, float actual) {
+        const float tolerance = std::max(std::fabs(expected) / 2048.0f,
+            5.9604645e-8f);
+        return std::fabs(expected - actual) <= tolerance;
+    }
+
+    // The rows of the file follow the memory layout of the saved image
+    template <class ImageCls>
+    static void assertHalf(const ImageCls &expected,
+        const pcg::Image<pcg::Rgba32F, pcg::TopDown> &actual)
+    {
+        ASSERT_EQ(expected.Width(),  actual.Width());
+        ASSERT_EQ(expected.Height(), actual.Height());
+        for (int i = 0; i < actual.Size(); ++i) {
+            const pcg::Rgba32F e = expected[i];
+            const pcg::Rgba32F a = actual[i];
+            ASSERT_TRUE(isHalfOf(e.r(), a.r())) << e.r() << " " << a.r();
+            ASSERT_TRUE(isHalfOf(e.g(), a.g())) << e.g() << " " << a.g();
+            ASSERT_TRUE(isHalfOf(e.b(), a.b())) << e.b() << " " << a.b();
+            ASSERT_TRUE(isHalfOf(e.a(), a.a())) << e.a() << " " << a.a();
+        }
+    }
+
+    // Values which are already half must be saved exactly
+    void assertExact(const pcg::Image<pcg::Rgba32F, pcg::TopDown> &img,
+        pcg::OpenEXRIO::Compression compression)
+    {
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, compression);
+        pcg::OpenEXRIO::Load(result, m_filename.c_str());
+        for (int i = 0; i < img.Size(); ++i) {
+            ASSERT_EQ(img[i], result[i]);
+        }
+    }
+
+    template <pcg::ScanLineMode S>
+    void testRoundTrip(int width, int height,
+        pcg::OpenEXRIO::Compression compression)
+    {
+        pcg::Image<pcg::Rgba32F, S> img(width, height);
+        fillRnd(img);
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, compression);
+        pcg::OpenEXRIO::Load(result, m_filename.c_str());
+        assertHalf(img, result);
+        assertExact(result, compression);
+
+        pcg::RGBAImageSoA soa(img);
+        pcg::OpenEXRIO::Save(soa, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, compression);
+        pcg::OpenEXRIO::Load(result, m_filename.c_str());
+        assertHalf(soa, result);
+    }
+
+    void testSizes(pcg::OpenEXRIO::Compression compression)
+    {
+        // The last ones span several bands of scanlines
+        const int sizes[][2] = {{1,1}, {3,5}, {17,33}, {1024,300}, {333,900}};
+        for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k) {
+            testRoundTrip<pcg::TopDown>(sizes[k][0], sizes[k][1], compression);
+            testRoundTrip<pcg::BottomUp>(sizes[k][0], sizes[k][1],compression);
+        }
+    }
+
+    RandomMT m_rnd;
+    std::string m_filename;
+
+public:
+    OpenEXRIOTest() : m_filename("OpenEXRIO_test.exr") {}
+};
+
+
+
+TEST_F(OpenEXRIOTest, RoundTripNone)
+{
+    testSizes(pcg::OpenEXRIO::None);
+}
+
+TEST_F(OpenEXRIOTest, RoundTripZip)
+{
+    testSizes(pcg::OpenEXRIO::ZIP);
+}
+
+TEST_F(OpenEXRIOTest, RoundTripPiz)
+{
+    testSizes(pcg::OpenEXRIO::PIZ);
+}
+
+TEST_F(OpenEXRIOTest, LoadBottomUp)
+{
+    const pcg::OpenEXRIO::RgbaChannels channels[] = {
+        pcg::OpenEXRIO::WRITE_RGBA, pcg::OpenEXRIO::WRITE_YCA
+    };
+    for (size_t k = 0; k < sizeof(channels)/sizeof(channels[0]); ++k) {
+        // Subsampled chroma requires even dimensions
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> img(66, 44);
+        fillRnd(img);
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(), channels[k]);
+
+        pcg::Image<pcg::Rgba32F, pcg::TopDown>  expected;
+        pcg::Image<pcg::Rgba32F, pcg::BottomUp> result;
+        pcg::OpenEXRIO::Load(expected, m_filename.c_str());
+        pcg::OpenEXRIO::Load(result,   m_filename.c_str());
+        ASSERT_EQ(expected.Width(),  result.Width());
+        ASSERT_EQ(expected.Height(), result.Height());
+        for (int j = 0; j < expected.Height(); ++j) {
+            for (int i = 0; i < expected.Width(); ++i) {
+                ASSERT_EQ(expected.ElementAt(i, j),
+                    result.ElementAt(i, j, pcg::TopDown));
+            }
+        }
+    }
+}
+
+TEST_F(OpenEXRIOTest, LoadHalf)
+{
+    const pcg::OpenEXRIO::RgbaChannels channels[] = {
+        pcg::OpenEXRIO::WRITE_RGBA, pcg::OpenEXRIO::WRITE_RGB,
+        pcg::OpenEXRIO::WRITE_YCA
+    };
+    for (size_t k = 0; k < sizeof(channels)/sizeof(channels[0]); ++k) {
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> img(66, 44);
+        fillRnd(img);
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(), channels[k]);
+
+        // The single precision values are exactly the halves in the file
+        pcg::Image<pcg::Rgba32F, pcg::TopDown>  expected;
+        pcg::Image<pcg::Rgba16F, pcg::TopDown>  result;
+        pcg::Image<pcg::Rgba16F, pcg::BottomUp> resultBU;
+        pcg::RGBA16FImageSoA resultSoA;
+        pcg::OpenEXRIO::Load(expected,  m_filename.c_str());
+        pcg::OpenEXRIO::Load(result,    m_filename.c_str());
+        pcg::OpenEXRIO::Load(resultBU,  m_filename.c_str());
+        pcg::OpenEXRIO::Load(resultSoA, m_filename.c_str());
+        ASSERT_EQ(expected.Width(),  result.Width());
+        ASSERT_EQ(expected.Height(), result.Height());
+        ASSERT_EQ(expected.Width(),  resultBU.Width());
+        ASSERT_EQ(expected.Height(), resultBU.Height());
+        ASSERT_EQ(expected.Width(),  resultSoA.Width());
+        ASSERT_EQ(expected.Height(), resultSoA.Height());
+        for (int j = 0; j < expected.Height(); ++j) {
+            for (int i = 0; i < expected.Width(); ++i) {
+                const pcg::Rgba32F e = expected.ElementAt(i, j);
+                ASSERT_EQ(e, result.ElementAt(i, j).toRgba32F());
+                ASSERT_EQ(e,
+                    resultBU.ElementAt(i, j, pcg::TopDown).toRgba32F());
+                ASSERT_EQ(e, resultSoA[expected.GetIndex(i, j)]);
+            }
+        }
+    }
+}
+
+TEST_F(OpenEXRIOTest, LoadChannels)
+{
+    // Even dimensions, as required by the YC files
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img(46, 24);
+    fillRnd(img);
+    pcg::OpenEXRIO::Save(img, m_filename.c_str(), pcg::OpenEXRIO::WRITE_RGBA);
+    pcg::RGBA16FImageSoA expected;
+    pcg::OpenEXRIO::Load(expected, m_filename.c_str());
+
+    typedef pcg::MultiChannelImageSoA MultiImg;
+    std::vector<std::string> names;
+    names.push_back("G");
+    names.push_back("A");
+    MultiImg result;
+    pcg::OpenEXRIO::Load(result, m_filename.c_str(), names);
+    ASSERT_EQ(img.Width(),  result.Width());
+    ASSERT_EQ(img.Height(), result.Height());
+    ASSERT_EQ(2, result.NumChannels());
+    ASSERT_EQ(0, result.FindChannel("G"));
+    ASSERT_EQ(1, result.FindChannel("A"));
+    ASSERT_EQ(-1, result.FindChannel("R"));
+    ASSERT_EQ(MultiImg::HALF, result.Channels()[0].type);
+    const uint16_t* g = result.GetPlane<uint16_t>("G");
+    const uint16_t* a = result.GetPlane<uint16_t>("A");
+    ASSERT_EQ(0, reinterpret_cast<intptr_t>(g) % 64);
+    ASSERT_EQ(0, reinterpret_cast<intptr_t>(a) % 64);
+    for (int i = 0; i < img.Size(); ++i) {
+        ASSERT_EQ(expected.ElementAt<pcg::RGBA16FImageSoA::G>(i), g[i]);
+        ASSERT_EQ(expected.ElementAt<pcg::RGBA16FImageSoA::A>(i), a[i]);
+    }
+
+    // All the channels, in the order of the file
+    pcg::OpenEXRIO::Load(result, m_filename.c_str());
+    ASSERT_EQ(4, result.NumChannels());
+    ASSERT_EQ(expected.ElementAt<pcg::RGBA16FImageSoA::R>(44, 22),
+        result.ElementAt<uint16_t>(result.ChannelIndex("R"), 44, 22));
+    ASSERT_THROW(result.ChannelIndex("Z"), pcg::IllegalArgumentException);
+
+    names.push_back("Z");
+    ASSERT_THROW(pcg::OpenEXRIO::Load(result, m_filename.c_str(), names),
+        pcg::IOException);
+
+    // The chroma channels are subsampled
+    pcg::OpenEXRIO::Save(img, m_filename.c_str(), pcg::OpenEXRIO::WRITE_YC);
+    names.assign(1, "Y");
+    pcg::OpenEXRIO::Load(result, m_filename.c_str(), names);
+    ASSERT_EQ(1, result.NumChannels());
+    names.push_back("RY");
+    ASSERT_THROW(pcg::OpenEXRIO::Load(result, m_filename.c_str(), names),
+        pcg::IOException);
+}
+
+TEST_F(OpenEXRIOTest, Performance)
+{
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img(4096, 2048);
+    fillRnd(img);
+    pcg::RGBAImageSoA soa(img);
+
+    const int NUM_RUNS = 5;
+    Timer timer;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        timer.start();
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, pcg::OpenEXRIO::None);
+        timer.stop();
+    }
+    cout << "> Save (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timer.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerSoA;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        timerSoA.start();
+        pcg::OpenEXRIO::Save(soa, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, pcg::OpenEXRIO::None);
+        timerSoA.stop();
+    }
+    cout << "> Save (RGBAImageSoA, " << img.Width() << "x" << img.Height()
+         << "): " << (timerSoA.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerZip;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        timerZip.start();
+        pcg::OpenEXRIO::Save(img, m_filename.c_str(),
+            pcg::OpenEXRIO::WRITE_RGBA, pcg::OpenEXRIO::ZIP);
+        timerZip.stop();
+    }
+    cout << "> Save ZIP (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timerZip.milliTime() / NUM_RUNS) << " ms" << endl;
+}
@@ -0,0 +1,290 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "Timer.h"
+#include "TestUtil.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <PfmIO.h>
+#include <Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+
+using std::cout;
+using std::endl;
+
+
+
+class PfmIOTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x3a91e5c7, 0x6d0f28b4,
+            0x15c7a3e9, 0x7e42d106, 0x28b5f97a, 0x4c1e03d8, 0x09a76b2f,
+            0x53d8c41e, 0x6f2a9e75, 0x1b64d0c3, 0x47f3b58a, 0x0ec9127d,
+            0x72a5e6f1, 0x3d0b84c9, 0x5e97f213, 0x21c64ab8
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+
+    }
+
+    float nextFloat() {
+        return static_cast<float>(2000.0 * m_rnd.nextDouble() - 1000.0);
+    }
+
+    void fillRnd (pcg::Image<pcg::Rgba32F, pcg::TopDown> &img) {
+        for (int i = 0; i < img.Size(); ++i) {
+            const float r = nextFloat();
+            const float g = nextFloat();
+            const float b = nextFloat();
+            img[i].set (r, g, b, 1.0f);
+        }
+    }
+
+    static bool isLittleEndian() {
+        const int x = 1;
+        return *reinterpret_cast<const char*>(&x) == 1;
+    }
+
+    static void appendFloat(std::string &data, float v, bool swap) {
+        char bytes[sizeof(float)];
+        memcpy(bytes, &v, sizeof(float));
+        if (swap) {
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+        }
+        data.append(bytes, sizeof(float));
+    }
+
+    // Builds a file by hand, with either byte order, from the top-down
+    // values of each pixel, as 3 or 1 floats per pixel
+    static std::string makeFile(int width, int height, bool isColor,
+        bool littleEndian, const std::vector<float> &values)
+    {
+        const int numChannels = isColor ? 3 : 1;
+        std::ostringstream hdr;
+        hdr << (isColor ? "PF" : "Pf") << '\n' << width << ' ' << height
+            << '\n' << (littleEndian ? "-1.000000" : "1.000000") << '\n';
+        std::string data = hdr.str();
+        const bool swap = littleEndian != isLittleEndian();
+        for (int j = height - 1; j >= 0; --j) {
+            for (int i = 0; i < width * numChannels; ++i) {
+                appendFloat(data, values[j*width*numChannels + i], swap);
+            }
+        }
+        return data;
+    }
+
+    template <pcg::ScanLineMode S>
+    static pcg::Rgba32F pixelAt(const pcg::Image<pcg::Rgba32F, S> &img,
+        int i, int j) {
+        return img.ElementAt(i, j, pcg::TopDown);
+    }
+
+    static pcg::Rgba32F pixelAt(const pcg::RGBAImageSoA &img, int i, int j) {
+        return img[j * img.Width() + i];
+    }
+
+    static pcg::Rgba32F pixelAt(const pcg::RGBImageSoA &img, int i, int j) {
+        return img[j * img.Width() + i];
+    }
+
+    template <class ImageCls>
+    static void assertPixels(const pcg::Image<pcg::Rgba32F, pcg::TopDown>
+        &expected, const ImageCls &actual)
+    {
+        ASSERT_EQ(expected.Width(),  actual.Width());
+        ASSERT_EQ(expected.Height(), actual.Height());
+        for (int j = 0; j < expected.Height(); ++j) {
+            for (int i = 0; i < expected.Width(); ++i) {
+                const pcg::Rgba32F e = expected.ElementAt(i, j);
+                const pcg::Rgba32F a = pixelAt(actual, i, j);
+                ASSERT_EQ(e.r(), a.r());
+                ASSERT_EQ(e.g(), a.g());
+                ASSERT_EQ(e.b(), a.b());
+                ASSERT_EQ(1.0f,  a.a());
+            }
+        }
+    }
+
+    void testByteOrder(bool isColor, bool littleEndian)
+    {
+        const int sizes[][2] = {{1,1}, {3,2}, {4,4}, {7,5}, {13,3}, {64,9}};
+        for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k) {
+            const int width = sizes[k][0], height = sizes[k][1];
+            const int numChannels = isColor ? 3 : 1;
+            std::vector<float> values(width * height * numChannels);
+            pcg::Image<pcg::Rgba32F, pcg::TopDown> expected(width, height);
+            for (int i = 0; i < expected.Size(); ++i) {
+                float* v = &values[i * numChannels];
+                for (int c = 0; c < numChannels; ++c) {
+                    v[c] = nextFloat();
+                }
+                if (isColor) {
+                    expected[i].set(v[0], v[1], v[2]);
+                } else {
+                    expected[i].set(v[0], v[0], v[0]);
+                }
+            }
+            const std::string data =
+                makeFile(width, height, isColor, littleEndian, values);
+
+            pcg::Image<pcg::Rgba32F, pcg::TopDown> img;
+            std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(img, is);
+            assertPixels(expected, img);
+
+            pcg::Image<pcg::Rgba32F, pcg::BottomUp> imgBU;
+            std::istringstream isBU(data,std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(imgBU, isBU);
+            assertPixels(expected, imgBU);
+
+            pcg::RGBAImageSoA imgSoA;
+            std::istringstream isSoA(data,std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(imgSoA, isSoA);
+            assertPixels(expected, imgSoA);
+
+            pcg::RGBImageSoA imgRGB;
+            std::istringstream isRGB(data,std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(imgRGB, isRGB);
+            assertPixels(expected, imgRGB);
+        }
+    }
+
+    RandomMT m_rnd;
+};
+
+
+
+TEST_F(PfmIOTest, RoundTrip)
+{
+    const int widths[]  = {1, 2, 3, 4, 5, 7, 8, 13, 317};
+    const int heights[] = {1, 3, 29};
+    for (size_t w = 0; w < sizeof(widths)/sizeof(widths[0]); ++w) {
+        for (size_t h = 0; h < sizeof(heights)/sizeof(heights[0]); ++h) {
+            pcg::Image<pcg::Rgba32F, pcg::TopDown> img(widths[w], heights[h]);
+            fillRnd(img);
+
+            std::ostringstream os(std::ios_base::out | std::ios_base::binary);
+            pcg::PfmIO::Save(img, os);
+            const std::string data = os.str();
+
+            // Saving from SoA must produce exactly the same file
+            std::ostringstream osSoA(std::ios_base::out|std::ios_base::binary);
+            pcg::RGBAImageSoA soa(img);
+            pcg::PfmIO::Save(soa, osSoA);
+            ASSERT_EQ(data, osSoA.str());
+
+            pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+            std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(result, is);
+            assertPixels(img, result);
+
+            pcg::RGBAImageSoA resultSoA;
+            std::istringstream isSoA(data,std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(resultSoA, isSoA);
+            assertPixels(img, resultSoA);
+
+            // Opaque SoA images load and save without the alpha plane
+            pcg::RGBImageSoA resultRGB;
+            std::istringstream isRGB(data,std::ios_base::in|std::ios_base::binary);
+            pcg::PfmIO::Load(resultRGB, isRGB);
+            assertPixels(img, resultRGB);
+            std::ostringstream osRGB(std::ios_base::out|std::ios_base::binary);
+            pcg::PfmIO::Save(resultRGB, osRGB);
+            ASSERT_EQ(data, osRGB.str());
+        }
+    }
+}
+
+TEST_F(PfmIOTest, ByteOrder)
+{
+    testByteOrder(true,  true);
+    testByteOrder(true,  false);
+    testByteOrder(false, true);
+    testByteOrder(false, false);
+}
+
+TEST_F(PfmIOTest, Truncated)
+{
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img(16, 8);
+    fillRnd(img);
+    std::ostringstream os(std::ios_base::out | std::ios_base::binary);
+    pcg::PfmIO::Save(img, os);
+    const std::string data = os.str();
+
+    std::istringstream is(data.substr(0, data.size() - 4),
+        std::ios_base::in|std::ios_base::binary);
+    ASSERT_THROW(pcg::PfmIO::Load(img, is), pcg::IOException);
+}
+
+TEST_F(PfmIOTest, Performance)
+{
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> img(4096, 2048);
+    fillRnd(img);
+
+    std::ostringstream os(std::ios_base::out | std::ios_base::binary);
+    pcg::PfmIO::Save(img, os);
+    const std::string data = os.str();
+
+    const int NUM_RUNS = 10;
+    Timer timer;
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        timer.start();
+        pcg::PfmIO::Load(result, is);
+        timer.stop();
+    }
+    cout << "> Load (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timer.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerSoA;
+    pcg::RGBAImageSoA resultSoA;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        timerSoA.start();
+        pcg::PfmIO::Load(resultSoA, is);
+        timerSoA.stop();
+    }
+    cout << "> Load (RGBAImageSoA, " << img.Width() << "x" << img.Height()
+         << "): " << (timerSoA.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerSave;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+        timerSave.start();
+        pcg::PfmIO::Save(result, out);
+        timerSave.stop();
+    }
+    cout << "> Save (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timerSave.milliTime() / NUM_RUNS) << " ms" << endl;
+}
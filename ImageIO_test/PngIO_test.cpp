@@ -0,0 +1,239 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <LDRPixels.h>
+#include <PngIO.h>
+#include <Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <png.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+
+class PngIOTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x4e1b7a26, 0x19c53f84,
+            0x6a07d2e9, 0x32f8b615, 0x7c4e90ab, 0x0d6a24f7, 0x58b1e3c2,
+            0x21f79d60, 0x6e3c5a1d, 0x47a80b93, 0x13d6f458, 0x7b2e61c4,
+            0x05f9a87e, 0x3e64c12b, 0x69d07f35, 0x2a85b3e0
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+        for (size_t i = 0; i < m_files.size(); ++i) {
+            std::remove(m_files[i].c_str());
+        }
+    }
+
+    // Registers a temporary file to be deleted after the test
+    const char* tmpFile(const char* name) {
+        m_files.push_back(name);
+        return m_files.back().c_str();
+    }
+
+    void fillRnd(pcg::Image<pcg::Bgra8, pcg::TopDown> &img) {
+        for (int i = 0; i < img.Size(); ++i) {
+            img[i].set(m_rnd.nextInt(0x100), m_rnd.nextInt(0x100),
+                m_rnd.nextInt(0x100));
+        }
+    }
+
+    void fillRnd(pcg::Image<pcg::Rgba16, pcg::TopDown> &img) {
+        for (int i = 0; i < img.Size(); ++i) {
+            img[i].set(m_rnd.nextInt(0x10000), m_rnd.nextInt(0x10000),
+                m_rnd.nextInt(0x10000));
+        }
+    }
+
+    // Contents of the png file without the modification time chunk, which
+    // is the only one allowed to differ between two writes of an image
+    static std::string readChunks(const char* filename) {
+        std::ifstream is(filename, std::ios_base::in | std::ios_base::binary);
+        const std::string data((std::istreambuf_iterator<char>(is)),
+            std::istreambuf_iterator<char>());
+        std::string result = data.substr(0, 8);
+        size_t pos = 8;
+        while (pos + 12 <= data.size()) {
+            const unsigned char* p =
+                reinterpret_cast<const unsigned char*>(data.data() + pos);
+            const size_t length = (size_t(p[0]) << 24) | (size_t(p[1]) << 16) |
+                (size_t(p[2]) << 8) | size_t(p[3]);
+            const size_t chunkSize = length + 12;
+            if (data.compare(pos + 4, 4, "tIME") != 0) {
+                result.append(data, pos, chunkSize);
+            }
+            pos += chunkSize;
+        }
+        EXPECT_EQ(data.size(), pos);
+        return result;
+    }
+
+    // Writes the image in bands through the scanline writer, the result
+    // must be identical to the file written by PngIO::Save
+    template <class T>
+    void testWrite(const char* refname, const char* filename,
+        int width, int height, int bandHeight)
+    {
+        typedef pcg::Image<T, pcg::TopDown> ImageCls;
+        const bool bpp16 = sizeof(T) == sizeof(pcg::Rgba16);
+        ImageCls img(width, height);
+        fillRnd(img);
+        pcg::PngIO::Save(img, refname, false, 1.0f/1.8f);
+
+        pcg::PngScanlineWriter writer(filename, width, height, bpp16,
+            false, 1.0f/1.8f);
+        ASSERT_EQ(width,  writer.Width());
+        ASSERT_EQ(height, writer.Height());
+        ASSERT_EQ(bpp16,  writer.IsBpp16());
+        for (int y = 0; y < height; y += bandHeight) {
+            ASSERT_EQ(y, writer.NextScanline());
+            const int rows = std::min(bandHeight, height - y);
+            ImageCls slice(width, rows);
+            std::copy(img.GetDataPointer() + y * width,
+                img.GetDataPointer() + (y + rows) * width,
+                slice.GetDataPointer());
+            writer.Write(slice);
+        }
+        writer.Close();
+
+        ASSERT_EQ(readChunks(refname), readChunks(filename));
+    }
+
+    // Decodes the 8-bit RGB file into packed rows. Also returns whether the
+    // file has the sRGB chunk and its gamma, zero if it has no gAMA chunk.
+    static void readRGB8(const char* filename, int &width, int &height,
+        std::vector<unsigned char> &pixels, bool &hasSRGB, double &gamma)
+    {
+        FILE *fp = fopen(filename, "rb");
+        ASSERT_TRUE(fp != NULL) << filename;
+        png_structp pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+            NULL, NULL, NULL);
+        png_infop infoPtr = png_create_info_struct(pngPtr);
+        png_init_io(pngPtr, fp);
+        png_read_png(pngPtr, infoPtr, PNG_TRANSFORM_IDENTITY, NULL);
+
+        width  = static_cast<int>(png_get_image_width(pngPtr, infoPtr));
+        height = static_cast<int>(png_get_image_height(pngPtr, infoPtr));
+        EXPECT_EQ(8, png_get_bit_depth(pngPtr, infoPtr));
+        EXPECT_EQ(PNG_COLOR_TYPE_RGB, png_get_color_type(pngPtr, infoPtr));
+        hasSRGB = png_get_valid(pngPtr, infoPtr, PNG_INFO_sRGB) != 0;
+        gamma = 0.0;
+        png_get_gAMA(pngPtr, infoPtr, &gamma);
+
+        png_bytepp rows = png_get_rows(pngPtr, infoPtr);
+        pixels.resize(3 * width * height);
+        for (int y = 0; y < height; ++y) {
+            std::copy(rows[y], rows[y] + 3*width, &pixels[3 * width * y]);
+        }
+        png_destroy_read_struct(&pngPtr, &infoPtr, NULL);
+        fclose(fp);
+    }
+
+    RandomMT m_rnd;
+    std::deque<std::string> m_files;
+};
+
+
+
+TEST_F(PngIOTest, ScanlineWriter8)
+{
+    testWrite<pcg::Bgra8>(
+        tmpFile("PngIO_ref8.png"), tmpFile("PngIO_write8.png"), 317, 129, 16);
+    testWrite<pcg::Bgra8>(
+        tmpFile("PngIO_ref8b.png"), tmpFile("PngIO_write8b.png"), 1, 7, 1);
+}
+
+TEST_F(PngIOTest, ScanlineWriter16)
+{
+    testWrite<pcg::Rgba16>(
+        tmpFile("PngIO_ref16.png"), tmpFile("PngIO_write16.png"), 317, 129, 16);
+    testWrite<pcg::Rgba16>(
+        tmpFile("PngIO_ref16b.png"), tmpFile("PngIO_write16b.png"), 64, 3, 8);
+}
+
+TEST_F(PngIOTest, ScanlineWriterErrors)
+{
+    const char* filename = tmpFile("PngIO_errors.png");
+    pcg::PngScanlineWriter writer(filename, 16, 4, false);
+
+    pcg::Image<pcg::Bgra8, pcg::TopDown> wide(17, 1);
+    ASSERT_THROW(writer.Write(wide), pcg::IllegalArgumentException);
+    pcg::Image<pcg::Rgba16, pcg::TopDown> deep(16, 1);
+    ASSERT_THROW(writer.Write(deep), pcg::IllegalArgumentException);
+    pcg::Image<pcg::Bgra8, pcg::TopDown> tall(16, 5);
+    ASSERT_THROW(writer.Write(tall), pcg::IllegalArgumentException);
+
+    pcg::Image<pcg::Bgra8, pcg::TopDown> band(16, 3);
+    writer.Write(band);
+    ASSERT_THROW(writer.Close(), pcg::IOException);
+}
+
+
+
+// batchToneMapper streams its 8-bit png files through the scanline writer
+// instead of QImage::save. The pixels are the same RGB values QImage writes
+// from the Bgra8 data, but the files also carry the color space chunks as
+// the ones of PngIO::Save.
+TEST_F(PngIOTest, ScanlineWriter8Pixels)
+{
+    const int width = 211, height = 97;
+    pcg::Image<pcg::Bgra8, pcg::TopDown> img(width, height);
+    fillRnd(img);
+
+    const bool isSrgb[] = {true, false};
+    for (int k = 0; k < 2; ++k) {
+        const char* filename = tmpFile(k == 0 ?
+            "PngIO_pixels8s.png" : "PngIO_pixels8g.png");
+        pcg::PngScanlineWriter writer(filename, width, height, false,
+            isSrgb[k], 1.0f/2.2f);
+        writer.Write(img);
+        writer.Close();
+
+        int w = 0, h = 0;
+        std::vector<unsigned char> pixels;
+        bool hasSRGB = false;
+        double gamma = 0.0;
+        readRGB8(filename, w, h, pixels, hasSRGB, gamma);
+        ASSERT_EQ(width,  w);
+        ASSERT_EQ(height, h);
+        ASSERT_EQ(isSrgb[k], hasSRGB);
+        ASSERT_NEAR(isSrgb[k] ? 0.45455 : 1.0/2.2, gamma, 1e-5);
+        for (int i = 0; i < img.Size(); ++i) {
+            ASSERT_EQ(img[i].r, pixels[3*i + 0]) << i;
+            ASSERT_EQ(img[i].g, pixels[3*i + 1]) << i;
+            ASSERT_EQ(img[i].b, pixels[3*i + 2]) << i;
+        }
+    }
+}
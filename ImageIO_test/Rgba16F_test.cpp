@@ -0,0 +1,182 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <Rgba16F.h>
+#include <ImageSoA.h>
+#include <ImageIterators.h>
+
+#include "dSFMT/RandomMT.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+
+class Rgba16FTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp() {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x1f4c86d2, 0x6a0b3e97,
+            0x37d5f021, 0x58e9a64c, 0x0c62b7f3, 0x71a84d5e, 0x24fe1390,
+            0x4b3970c8, 0x66d12ea5, 0x0975c83b, 0x5ca0f4d6, 0x3e8b2917,
+            0x12f76a4e, 0x7b4dc5a0, 0x2d069e73, 0x43b81f2c
+        };
+        rnd.setSeed (seed);
+    }
+
+    // Random value within the range of half, including negative ones
+    float nextFloat() {
+        const float s = 1000.0f * rnd.nextFloat();
+        return s * (2.0f * rnd.nextFloat() - 1.0f);
+    }
+
+    RandomMT rnd;
+};
+
+
+
+namespace
+{
+
+// Straightforward decoding of a binary16 value
+float referenceHalf(uint16_t h)
+{
+    const int sign = (h >> 15) & 0x1;
+    const int exponent = (h >> 10) & 0x1f;
+    const int mantissa = h & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = std::ldexp(static_cast<float>(mantissa), -24);
+    } else if (exponent == 31) {
+        value = mantissa == 0 ? std::numeric_limits<float>::infinity() :
+                                std::numeric_limits<float>::quiet_NaN();
+    } else {
+        value = std::ldexp(static_cast<float>(mantissa | 0x400), exponent-25);
+    }
+    return sign ? -value : value;
+}
+
+inline bool isNaN(float x) {
+    return x != x;
+}
+
+} // namespace
+
+
+
+TEST_F(Rgba16FTest, HalfToFloat)
+{
+    for (int i = 0; i < 0x10000; ++i) {
+        const uint16_t h = static_cast<uint16_t>(i);
+        const float expected = referenceHalf(h);
+        const float actual = pcg::halfToFloat(h);
+        if (isNaN(expected)) {
+            ASSERT_TRUE(isNaN(actual)) << std::hex << i;
+        } else {
+            ASSERT_EQ(expected, actual) << std::hex << i;
+            ASSERT_EQ(std::signbit(expected), std::signbit(actual));
+        }
+    }
+}
+
+TEST_F(Rgba16FTest, FloatToHalf)
+{
+    // Every half must survive the round trip
+    for (int i = 0; i < 0x10000; ++i) {
+        const uint16_t h = static_cast<uint16_t>(i);
+        const float f = pcg::halfToFloat(h);
+        if (isNaN(f)) {
+            ASSERT_TRUE(isNaN(pcg::halfToFloat(pcg::floatToHalf(f))));
+        } else {
+            ASSERT_EQ(h, pcg::floatToHalf(f)) << std::hex << i;
+        }
+    }
+
+    // Ties round to even, for normals and denormals
+    EXPECT_EQ(0x3c00, pcg::floatToHalf(1.0f + std::ldexp(1.0f, -11)));
+    EXPECT_EQ(0x3c02, pcg::floatToHalf(1.0f + 3*std::ldexp(1.0f, -11)));
+    EXPECT_EQ(0x0000, pcg::floatToHalf(std::ldexp(1.0f, -25)));
+    EXPECT_EQ(0x0002, pcg::floatToHalf(3*std::ldexp(1.0f, -25)));
+    EXPECT_EQ(0x8000, pcg::floatToHalf(-std::ldexp(1.0f, -26)));
+
+    // Overflow
+    EXPECT_EQ(0x7bff, pcg::floatToHalf(65519.0f));
+    EXPECT_EQ(0x7c00, pcg::floatToHalf(65520.0f));
+    EXPECT_EQ(0xfc00, pcg::floatToHalf(-1e10f));
+    EXPECT_EQ(0x7c00,
+        pcg::floatToHalf(std::numeric_limits<float>::infinity()));
+}
+
+TEST_F(Rgba16FTest, Pixel)
+{
+    for (int k = 0; k < 10000; ++k) {
+        const float r = nextFloat();
+        const float g = nextFloat();
+        const float b = nextFloat();
+        const float a = rnd.nextFloat();
+        const pcg::Rgba16F p(r, g, b, a);
+        EXPECT_EQ(pcg::floatToHalf(r), p.rBits);
+        EXPECT_EQ(pcg::floatToHalf(g), p.gBits);
+        EXPECT_EQ(pcg::floatToHalf(b), p.bBits);
+        EXPECT_EQ(pcg::floatToHalf(a), p.aBits);
+
+        const pcg::Rgba32F wide = p.toRgba32F();
+        EXPECT_EQ(p.r(), wide.r());
+        EXPECT_EQ(p.g(), wide.g());
+        EXPECT_EQ(p.b(), wide.b());
+        EXPECT_EQ(p.a(), wide.a());
+        EXPECT_EQ(p, pcg::Rgba16F(wide));
+    }
+}
+
+TEST_F(Rgba16FTest, Iterators)
+{
+    pcg::Image<pcg::Rgba16F> img(37, 5);
+    pcg::RGBA16FImageSoA soa(img.Width(), img.Height());
+    for (int i = 0; i < img.Size(); ++i) {
+        img[i].set(nextFloat(), nextFloat(), nextFloat(), rnd.nextFloat());
+        soa.ElementAt<pcg::RGBA16FImageSoA::R>(i) = img[i].rBits;
+        soa.ElementAt<pcg::RGBA16FImageSoA::G>(i) = img[i].gBits;
+        soa.ElementAt<pcg::RGBA16FImageSoA::B>(i) = img[i].bBits;
+        soa.ElementAt<pcg::RGBA16FImageSoA::A>(i) = img[i].aBits;
+    }
+
+    // The full groups of 4 pixels, widened to float
+    pcg::RGBA16FVec4ImageIterator it = pcg::RGBA16FVec4ImageIterator::begin(img);
+    pcg::RGBA16FVec4ImageSoAIterator itSoA =
+        pcg::RGBA16FVec4ImageSoAIterator::begin(soa);
+    const int numGroups = (img.Size() + 3) / 4;
+    ASSERT_EQ(numGroups, pcg::RGBA16FVec4ImageIterator::end(img) - it);
+    ASSERT_EQ(numGroups, pcg::RGBA16FVec4ImageSoAIterator::end(soa) - itSoA);
+    for (int k = 0; k < img.Size() / 4; ++k, ++it, ++itSoA) {
+        const pcg::RGBA32FVec4 p = *it;
+        const pcg::RGBA32FVec4 pSoA = *itSoA;
+        for (int j = 0; j < 4; ++j) {
+            const pcg::Rgba16F &e = img[4*k + j];
+            ASSERT_EQ(e.r(), reinterpret_cast<const float*>(&p.r())[j]);
+            ASSERT_EQ(e.g(), reinterpret_cast<const float*>(&p.g())[j]);
+            ASSERT_EQ(e.b(), reinterpret_cast<const float*>(&p.b())[j]);
+            ASSERT_EQ(e.a(), reinterpret_cast<const float*>(&p.a())[j]);
+            ASSERT_EQ(e.r(), reinterpret_cast<const float*>(&pSoA.r())[j]);
+            ASSERT_EQ(e.g(), reinterpret_cast<const float*>(&pSoA.g())[j]);
+            ASSERT_EQ(e.b(), reinterpret_cast<const float*>(&pSoA.b())[j]);
+            ASSERT_EQ(e.a(), reinterpret_cast<const float*>(&pSoA.a())[j]);
+            ASSERT_EQ(e.toRgba32F(), soa[4*k + j]);
+        }
+    }
+}
@@ -0,0 +1,353 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "Timer.h"
+#include "TestUtil.h"
+
+#include <StdAfx.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <RgbeIO.h>
+#include <Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <algorithm>
+#include <string>
+
+
+using std::cout;
+using std::endl;
+
+
+
+class RgbeIOTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x5f6c3e0a, 0x1b0d2a77,
+            0x6a8e41f3, 0x3c2b90d5, 0x0e7d6c19, 0x4b5a2f88, 0x2d913e64,
+            0x77a0c5b2, 0x19f4d07e, 0x63be2a41, 0x0a5c8f93, 0x48e1b726,
+            0x3f7a9d0c, 0x5521e6bf, 0x2c08f45a, 0x71d3a9e4
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    virtual void TearDown()
+    {
+
+    }
+
+    // Fills the image with random pixels, repeating the previous pixel now
+    // and then so that the RLE encoder emits both runs and literals. The
+    // exponents avoid the range [1,9] which yields denormal values.
+    template <pcg::ScanLineMode S>
+    void fillRnd (pcg::Image<pcg::Rgbe, S> &img) {
+        pcg::Rgbe prev;
+        for (int i = 0; i < img.Size(); ++i) {
+            if (i == 0 || m_rnd.nextFloat() < 0.75f) {
+                prev.r = static_cast<unsigned char>(m_rnd.nextInt(256));
+                prev.g = static_cast<unsigned char>(m_rnd.nextInt(256));
+                prev.b = static_cast<unsigned char>(m_rnd.nextInt(256));
+                prev.e = m_rnd.nextInt(16) == 0 ? 0 :
+                    static_cast<unsigned char>(10 + m_rnd.nextInt(246));
+            }
+            img[i] = prev;
+        }
+    }
+
+    template <pcg::ScanLineMode S1, pcg::ScanLineMode S2>
+    static void assertEquals(const pcg::Image<pcg::Rgbe, S1> &expected,
+                             const pcg::Image<pcg::Rgbe, S2> &actual)
+    {
+        ASSERT_EQ(expected.Width(),  actual.Width());
+        ASSERT_EQ(expected.Height(), actual.Height());
+        for (int j = 0; j < expected.Height(); ++j) {
+            for (int i = 0; i < expected.Width(); ++i) {
+                const pcg::Rgbe &e = expected.ElementAt(i, j, pcg::TopDown);
+                const pcg::Rgbe &a = actual.ElementAt(i, j, pcg::TopDown);
+                ASSERT_EQ(e.r, a.r);
+                ASSERT_EQ(e.g, a.g);
+                ASSERT_EQ(e.b, a.b);
+                ASSERT_EQ(e.e, a.e);
+            }
+        }
+    }
+
+    template <pcg::ScanLineMode S>
+    void testRoundTrip(int width, int height)
+    {
+        pcg::Image<pcg::Rgbe, pcg::TopDown> img(width, height);
+        fillRnd(img);
+
+        std::stringstream ss(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        pcg::RgbeIO::Save(img, ss);
+        ASSERT_FALSE(ss.fail());
+
+        pcg::Image<pcg::Rgbe, S> result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, ss));
+        assertEquals(img, result);
+    }
+
+    RandomMT m_rnd;
+};
+
+
+
+TEST_F(RgbeIOTest, RoundTrip)
+{
+    testRoundTrip<pcg::TopDown>(640, 480);
+    testRoundTrip<pcg::BottomUp>(640, 480);
+    testRoundTrip<pcg::TopDown>(1, 1);
+    testRoundTrip<pcg::TopDown>(8, 3);
+    testRoundTrip<pcg::BottomUp>(7, 5);
+    testRoundTrip<pcg::TopDown>(0x7fff + 1, 2);
+}
+
+
+
+// The reader works in large blocks, but it must not swallow the data after
+// the image in the stream
+TEST_F(RgbeIOTest, TrailingData)
+{
+    const std::string trailer("Trailing data after the image");
+    const int sizes[][2] = {{320, 200}, {4, 4}};
+    for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k) {
+        pcg::Image<pcg::Rgbe, pcg::TopDown> img(sizes[k][0], sizes[k][1]);
+        fillRnd(img);
+
+        std::stringstream ss(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        pcg::RgbeIO::Save(img, ss);
+        ss << trailer;
+
+        pcg::Image<pcg::Rgbe, pcg::TopDown> result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, ss));
+        assertEquals(img, result);
+
+        ASSERT_FALSE(ss.fail());
+        std::string remaining;
+        std::getline(ss, remaining);
+        ASSERT_EQ(trailer, remaining);
+    }
+}
+
+
+
+// Files whose scanlines switch from RLE to flat pixels halfway
+TEST_F(RgbeIOTest, MixedFlat)
+{
+    const int width = 64, height = 16, rleHeight = 5;
+    pcg::Image<pcg::Rgbe, pcg::TopDown> img(width, height);
+    fillRnd(img);
+    img[rleHeight * width].r = 0;
+
+    pcg::Image<pcg::Rgbe, pcg::TopDown> rleImg(width, rleHeight);
+    std::copy(img.GetDataPointer(), img.GetDataPointer() + rleImg.Size(),
+        rleImg.GetDataPointer());
+    std::stringstream ss(std::ios_base::in | std::ios_base::out |
+        std::ios_base::binary);
+    pcg::RgbeIO::Save(rleImg, ss);
+    std::string data = ss.str();
+
+    // Patch the height and append the flat pixels
+    const size_t pos = data.find("-Y 5 ");
+    ASSERT_NE(std::string::npos, pos);
+    data.replace(pos, 5, "-Y 16 ");
+    data.append(reinterpret_cast<const char*>(img.GetDataPointer() +
+        rleImg.Size()), (img.Size() - rleImg.Size()) * sizeof(pcg::Rgbe));
+
+    {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        pcg::Image<pcg::Rgbe, pcg::TopDown> result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, is));
+        assertEquals(img, result);
+    }
+    {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        pcg::Image<pcg::Rgbe, pcg::BottomUp> result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, is));
+        assertEquals(img, result);
+    }
+    {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        pcg::RGBAImageSoA result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, is));
+        for (int i = 0; i < img.Size(); ++i) {
+            const pcg::Rgba32F expected = static_cast<pcg::Rgba32F>(img[i]);
+            ASSERT_EQ(expected.r(), result[i].r());
+            ASSERT_EQ(expected.g(), result[i].g());
+            ASSERT_EQ(expected.b(), result[i].b());
+        }
+    }
+}
+
+
+
+TEST_F(RgbeIOTest, Truncated)
+{
+    pcg::Image<pcg::Rgbe, pcg::TopDown> img(256, 64);
+    fillRnd(img);
+
+    std::stringstream ss(std::ios_base::in | std::ios_base::out |
+        std::ios_base::binary);
+    pcg::RgbeIO::Save(img, ss);
+    const std::string data = ss.str();
+
+    const size_t lengths[] = {data.size() - 1, data.size() / 2,
+        data.size() - 4*256};
+    for (size_t k = 0; k < sizeof(lengths)/sizeof(lengths[0]); ++k) {
+        std::istringstream is(data.substr(0, lengths[k]),
+            std::ios_base::in | std::ios_base::binary);
+        pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+        ASSERT_THROW(pcg::RgbeIO::Load(result, is), pcg::IOException);
+    }
+}
+
+
+
+TEST_F(RgbeIOTest, Rgba32F)
+{
+    const int sizes[][2] = {{512, 256}, {37, 11}, {5, 3}};
+    for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k) {
+        pcg::Image<pcg::Rgbe, pcg::TopDown> img(sizes[k][0], sizes[k][1]);
+        fillRnd(img);
+
+        std::stringstream ss(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        pcg::RgbeIO::Save(img, ss);
+        const std::string data = ss.str();
+
+        {
+            std::istringstream is(data,std::ios_base::in|std::ios_base::binary);
+            pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+            ASSERT_NO_THROW(pcg::RgbeIO::Load(result, is));
+            for (int i = 0; i < img.Size(); ++i) {
+                ASSERT_RGBA32F_EQ(static_cast<pcg::Rgba32F>(img[i]), result[i]);
+            }
+        }
+        {
+            std::istringstream is(data,std::ios_base::in|std::ios_base::binary);
+            pcg::RGBAImageSoA result;
+            ASSERT_NO_THROW(pcg::RgbeIO::Load(result, is));
+            ASSERT_EQ(img.Width(),  result.Width());
+            ASSERT_EQ(img.Height(), result.Height());
+            // The SoA loader always sets alpha to one
+            for (int i = 0; i < img.Size(); ++i) {
+                const pcg::Rgba32F expected = static_cast<pcg::Rgba32F>(img[i]);
+                const pcg::Rgba32F actual = result[i];
+                ASSERT_EQ(expected.r(), actual.r());
+                ASSERT_EQ(expected.g(), actual.g());
+                ASSERT_EQ(expected.b(), actual.b());
+                ASSERT_EQ(1.0f, actual.a());
+            }
+        }
+    }
+}
+
+
+
+// Opaque SoA images get the same colors without the alpha plane
+TEST_F(RgbeIOTest, RGBImageSoA)
+{
+    const int sizes[][2] = {{512, 256}, {37, 11}, {5, 3}};
+    for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k) {
+        pcg::Image<pcg::Rgbe, pcg::TopDown> img(sizes[k][0], sizes[k][1]);
+        fillRnd(img);
+
+        std::stringstream ss(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        pcg::RgbeIO::Save(img, ss);
+
+        pcg::RGBImageSoA result;
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(result, ss));
+        ASSERT_EQ(img.Width(),  result.Width());
+        ASSERT_EQ(img.Height(), result.Height());
+        for (int i = 0; i < img.Size(); ++i) {
+            const pcg::Rgba32F expected = static_cast<pcg::Rgba32F>(img[i]);
+            const pcg::Rgba32F actual = result[i];
+            ASSERT_EQ(expected.r(), actual.r());
+            ASSERT_EQ(expected.g(), actual.g());
+            ASSERT_EQ(expected.b(), actual.b());
+            ASSERT_EQ(1.0f, actual.a());
+        }
+
+        // Saving produces the same file as an RGBA image without alpha
+        pcg::RGBAImageSoA resultRGBA;
+        ss.clear();
+        ss.seekg(0);
+        ASSERT_NO_THROW(pcg::RgbeIO::Load(resultRGBA, ss));
+        std::stringstream ssRGB(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        std::stringstream ssRGBA(std::ios_base::in | std::ios_base::out |
+            std::ios_base::binary);
+        pcg::RgbeIO::Save(result, ssRGB);
+        pcg::RgbeIO::Save(resultRGBA, ssRGBA);
+        ASSERT_FALSE(ssRGB.fail());
+        ASSERT_EQ(ssRGBA.str(), ssRGB.str());
+    }
+}
+
+
+
+TEST_F(RgbeIOTest, Performance)
+{
+    pcg::Image<pcg::Rgbe, pcg::TopDown> img(4096, 2048);
+    fillRnd(img);
+
+    std::stringstream ss(std::ios_base::in | std::ios_base::out |
+        std::ios_base::binary);
+    pcg::RgbeIO::Save(img, ss);
+    const std::string data = ss.str();
+
+    const int NUM_RUNS = 10;
+    Timer timer;
+    pcg::Image<pcg::Rgba32F, pcg::TopDown> result;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        timer.start();
+        pcg::RgbeIO::Load(result, is);
+        timer.stop();
+    }
+    cout << "> Load (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timer.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerSoA;
+    pcg::RGBAImageSoA resultSoA;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::istringstream is(data, std::ios_base::in|std::ios_base::binary);
+        timerSoA.start();
+        pcg::RgbeIO::Load(resultSoA, is);
+        timerSoA.stop();
+    }
+    cout << "> Load (RGBAImageSoA, " << img.Width() << "x" << img.Height()
+         << "): " << (timerSoA.milliTime() / NUM_RUNS) << " ms" << endl;
+
+    Timer timerSave;
+    for (int k = 0; k < NUM_RUNS; ++k) {
+        std::ostringstream os(std::ios_base::out | std::ios_base::binary);
+        timerSave.start();
+        pcg::RgbeIO::Save(result, os);
+        timerSave.stop();
+    }
+    cout << "> Save (Rgba32F, " << img.Width() << "x" << img.Height()
+         << "): " << (timerSave.milliTime() / NUM_RUNS) << " ms" << endl;
+}
@@ -0,0 +1,412 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "dSFMT/RandomMT.h"
+#include "Timer.h"
+
+#include <TiledImageSoA.h>
+#include <ImageSoA.h>
+
+#include <gtest/gtest.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+typedef pcg::TiledRGBAImageSoA Tiled;
+typedef pcg::RGBAImageSoA Image;
+
+// Stand-in for tbb::split
+struct Split {};
+
+const int TILE = Tiled::TILE_SIZE;
+
+
+
+// Separable gaussian blur with clamp-to-edge boundaries. Both layouts run
+// their passes with TBB, over scanlines or over blocks of tiles.
+class Blur
+{
+public:
+    static const int RADIUS = 4;
+    static const int TAPS   = 2*RADIUS + 1;
+
+    Blur()
+    {
+        const float sigma = 2.0f;
+        float sum = 0.0f;
+        for (int k = -RADIUS; k <= RADIUS; ++k) {
+            m_w[k + RADIUS] = std::exp(-(k*k) / (2.0f*sigma*sigma));
+            sum += m_w[k + RADIUS];
+        }
+        for (int k = 0; k < TAPS; ++k) {
+            m_w[k] /= sum;
+        }
+    }
+
+    // Scanline layout: horizontal pass into a temporary plane, then the
+    // vertical pass which reads TAPS scanlines for each output one
+    template <class ChannelSpec>
+    void apply(const Image &src, Image &tmp, Image &dest) const
+    {
+        const tbb::blocked_range<int> rows(0, src.Height());
+        tbb::parallel_for(rows,
+            HorizontalPass<ChannelSpec>(m_w, src, tmp));
+        tbb::parallel_for(rows,
+            VerticalPass<ChannelSpec>(m_w, tmp, dest));
+    }
+
+    // Tiled layout: each tile copies itself and a halo of RADIUS pixels
+    // from its neighbors, row by row, then runs both passes in that window
+    template <class ChannelSpec>
+    void apply(const Tiled &src, Tiled &dest) const
+    {
+        tbb::parallel_for(src.Tiles(),
+            TilePass<ChannelSpec>(m_w, src, dest));
+    }
+
+private:
+    static inline int clamp(int x, int size) {
+        return std::min(std::max(x, 0), size - 1);
+    }
+
+    template <class ChannelSpec>
+    class HorizontalPass
+    {
+    public:
+        HorizontalPass(const float *w, const Image &src, Image &dest) :
+        m_w(w), m_src(src), m_dest(dest) {}
+
+        void operator() (const tbb::blocked_range<int> &range) const {
+            const int w = m_src.Width();
+            for (int j = range.begin(); j != range.end(); ++j) {
+                const float *in = m_src.GetScanlinePointer<ChannelSpec>(j);
+                float *out = m_dest.GetScanlinePointer<ChannelSpec>(j);
+                for (int i = 0; i < w; ++i) {
+                    float sum = 0.0f;
+                    for (int k = -RADIUS; k <= RADIUS; ++k) {
+                        sum += m_w[k + RADIUS] * in[clamp(i + k, w)];
+                    }
+                    out[i] = sum;
+                }
+            }
+        }
+
+    private:
+        const float *m_w;
+        const Image &m_src;
+        Image &m_dest;
+    };
+
+    template <class ChannelSpec>
+    class VerticalPass
+    {
+    public:
+        VerticalPass(const float *w, const Image &src, Image &dest) :
+        m_w(w), m_src(src), m_dest(dest) {}
+
+        void operator() (const tbb::blocked_range<int> &range) const {
+            const int w = m_src.Width();
+            const int h = m_src.Height();
+            for (int j = range.begin(); j != range.end(); ++j) {
+                const float *rows[TAPS];
+                for (int k = -RADIUS; k <= RADIUS; ++k) {
+                    rows[k + RADIUS] =
+                        m_src.GetScanlinePointer<ChannelSpec>(clamp(j + k, h));
+                }
+                float *out = m_dest.GetScanlinePointer<ChannelSpec>(j);
+                for (int i = 0; i < w; ++i) {
+                    float sum = 0.0f;
+                    for (int k = 0; k < TAPS; ++k) {
+                        sum += m_w[k] * rows[k][i];
+                    }
+                    out[i] = sum;
+                }
+            }
+        }
+
+    private:
+        const float *m_w;
+        const Image &m_src;
+        Image &m_dest;
+    };
+
+    template <class ChannelSpec>
+    class TilePass
+    {
+    public:
+        static const int WIN = TILE + 2*RADIUS;
+
+        TilePass(const float *w, const Tiled &src, Tiled &dest) :
+        m_w(w), m_src(src), m_dest(dest) {}
+
+        void operator() (const Tiled::TileRange &range) const {
+            std::vector<float> window(WIN * WIN);
+            std::vector<float> horiz(WIN * TILE);
+            for (Tiled::TileIterator it = range.begin(); it != range.end();
+                 ++it) {
+                const Tiled::Tile tile = *it;
+                for (int r = 0; r < WIN; ++r) {
+                    copyRow(clamp(tile.y - RADIUS + r, m_src.Height()),
+                        tile.x - RADIUS, &window[r * WIN]);
+                }
+                for (int r = 0; r < WIN; ++r) {
+                    const float *in = &window[r * WIN];
+                    float *out = &horiz[r * TILE];
+                    for (int c = 0; c < tile.width; ++c) {
+                        float sum = 0.0f;
+                        for (int k = 0; k < TAPS; ++k) {
+                            sum += m_w[k] * in[c + k];
+                        }
+                        out[c] = sum;
+                    }
+                }
+                float *out = m_dest.GetTilePlane<ChannelSpec>(tile.tx, tile.ty);
+                for (int r = 0; r < tile.height; ++r) {
+                    for (int c = 0; c < tile.width; ++c) {
+                        float sum = 0.0f;
+                        for (int k = 0; k < TAPS; ++k) {
+                            sum += m_w[k] * horiz[(r + k) * TILE + c];
+                        }
+                        out[r * TILE + c] = sum;
+                    }
+                }
+            }
+        }
+
+    private:
+        // Copies WIN pixels of the row y starting at x0, which may lie
+        // outside of the image, as runs of the rows of the tiles it spans
+        void copyRow(int y, int x0, float *dest) const
+        {
+            const int w = m_src.Width();
+            const int xEnd = x0 + WIN;
+            const int row = (y % TILE) * TILE;
+            int x = x0;
+            for (; x < 0; ++x) {
+                *dest++ = m_src.ElementAt<ChannelSpec>(0, y);
+            }
+            while (x < xEnd && x < w) {
+                const float *plane =
+                    m_src.GetTilePlane<ChannelSpec>(x / TILE, y / TILE);
+                const int n = std::min(TILE - x % TILE,
+                    std::min(xEnd, w) - x);
+                memcpy(dest, plane + row + x % TILE, n * sizeof(float));
+                dest += n;
+                x += n;
+            }
+            for (; x < xEnd; ++x) {
+                *dest++ = m_src.ElementAt<ChannelSpec>(w - 1, y);
+            }
+        }
+
+        const float *m_w;
+        const Tiled &m_src;
+        Tiled &m_dest;
+    };
+
+    float m_w[TAPS];
+};
+
+} // namespace
+
+
+
+class TiledImageSoATest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Python generated:
+        // ['{0:#010x}'.format(random.randint(0,0x7fffffff)) for i in range(16)]
+        static const unsigned int seed[] = {    0x1f5c1ae2, 0x6d0b3e47,
+            0x3a9e8c71, 0x0c4f2b9d, 0x58e17a03, 0x7b2d6f18, 0x24c9e05a,
+            0x4e71b3c6, 0x69a0d24f, 0x137f5e8b, 0x0a6c94d1, 0x5fd23b70,
+            0x2b84f1e9, 0x76195ca4, 0x40e3a867, 0x1cb7d03f
+        };
+        m_rnd.setSeed(seed);
+    }
+
+    void fillRnd(Image &img)
+    {
+        for (int i = 0; i < img.Size(); ++i) {
+            img.ElementAt<Image::R>(i) = 1000.0f * m_rnd.nextFloat();
+            img.ElementAt<Image::G>(i) = 1000.0f * m_rnd.nextFloat();
+            img.ElementAt<Image::B>(i) = 1000.0f * m_rnd.nextFloat();
+            img.ElementAt<Image::A>(i) = m_rnd.nextFloat();
+        }
+    }
+
+    RandomMT m_rnd;
+};
+
+
+
+TEST_F(TiledImageSoATest, RoundTrip)
+{
+    const int sizes[][2] = {
+        {1, 1}, {TILE, TILE}, {TILE + 1, 2*TILE - 1}, {3, 2*TILE + 5}
+    };
+    const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    for (int runIdx = 0; runIdx < numSizes + 10; ++runIdx) {
+        const int width  = runIdx < numSizes ? sizes[runIdx][0] :
+            1 + m_rnd.nextInt(700);
+        const int height = runIdx < numSizes ? sizes[runIdx][1] :
+            1 + m_rnd.nextInt(700);
+        Image img(width, height);
+        fillRnd(img);
+
+        Tiled tiled(img);
+        ASSERT_EQ(width,  tiled.Width());
+        ASSERT_EQ(height, tiled.Height());
+        ASSERT_EQ((width  + TILE - 1) / TILE, tiled.TilesX());
+        ASSERT_EQ((height + TILE - 1) / TILE, tiled.TilesY());
+
+        for (int j = 0; j < height; ++j) {
+            for (int i = 0; i < width; ++i) {
+                ASSERT_EQ(img.ElementAt<Image::R>(i, j),
+                          tiled.ElementAt<Tiled::R>(i, j));
+                ASSERT_EQ(img.ElementAt<Image::G>(i, j),
+                          tiled.ElementAt<Tiled::G>(i, j));
+                ASSERT_EQ(img.ElementAt<Image::B>(i, j),
+                          tiled.ElementAt<Tiled::B>(i, j));
+                ASSERT_EQ(img.ElementAt<Image::A>(i, j),
+                          tiled.ElementAt<Tiled::A>(i, j));
+            }
+        }
+
+        // The padding of the last tile is zero
+        const Tiled::Tile last =
+            tiled.GetTile(tiled.TilesX() - 1, tiled.TilesY() - 1);
+        ASSERT_EQ(width  - last.x, last.width);
+        ASSERT_EQ(height - last.y, last.height);
+        if (last.width < TILE || last.height < TILE) {
+            ASSERT_EQ(0.0f, last.r[Tiled::TILE_PIXELS - 1]);
+            ASSERT_EQ(0.0f, last.a[Tiled::TILE_PIXELS - 1]);
+        }
+
+        Image copy;
+        tiled.CopyTo(copy);
+        ASSERT_EQ(width,  copy.Width());
+        ASSERT_EQ(height, copy.Height());
+        for (int i = 0; i < img.Size(); ++i) {
+            ASSERT_EQ(img.ElementAt<Image::R>(i), copy.ElementAt<Image::R>(i));
+            ASSERT_EQ(img.ElementAt<Image::G>(i), copy.ElementAt<Image::G>(i));
+            ASSERT_EQ(img.ElementAt<Image::B>(i), copy.ElementAt<Image::B>(i));
+            ASSERT_EQ(img.ElementAt<Image::A>(i), copy.ElementAt<Image::A>(i));
+        }
+    }
+}
+
+
+
+TEST_F(TiledImageSoATest, TileRange)
+{
+    Tiled tiled(11*TILE + 3, 7*TILE);
+    ASSERT_EQ(12*7, tiled.NumTiles());
+
+    for (int grain = 1; grain < 5; ++grain) {
+        // Split recursively as TBB does and visit every leaf
+        std::vector<int> visits(tiled.NumTiles(), 0);
+        std::vector<Tiled::TileRange> pending(1, tiled.Tiles(grain));
+        int numLeaves = 0;
+        while (!pending.empty()) {
+            Tiled::TileRange range = pending.back();
+            pending.pop_back();
+            if (range.is_divisible()) {
+                Tiled::TileRange other(range, Split());
+                ASSERT_FALSE(range.empty());
+                ASSERT_FALSE(other.empty());
+                pending.push_back(range);
+                pending.push_back(other);
+                continue;
+            }
+
+            ++numLeaves;
+            ASSERT_LE(range.TileEndX() - range.TileBeginX(), grain);
+            ASSERT_LE(range.TileEndY() - range.TileBeginY(), grain);
+            int count = 0;
+            for (Tiled::TileIterator it = range.begin(); it != range.end();
+                 ++it, ++count) {
+                const Tiled::Tile tile = *it;
+                ASSERT_EQ(tile.tx * TILE, tile.x);
+                ASSERT_EQ(tile.ty * TILE, tile.y);
+                ++visits[tile.ty * tiled.TilesX() + tile.tx];
+            }
+            ASSERT_EQ(range.size(), count);
+        }
+
+        EXPECT_LT(0, numLeaves);
+        for (size_t i = 0; i < visits.size(); ++i) {
+            ASSERT_EQ(1, visits[i]);
+        }
+    }
+}
+
+
+
+TEST_F(TiledImageSoATest, BlurBenchmark)
+{
+    const int width  = 2048;
+    const int height = 1536;
+    Image img(width, height);
+    fillRnd(img);
+    Tiled tiled(img);
+
+    // Both layouts run with the same TBB parallelism
+    const Blur blur;
+    Timer tScanline, tTiled;
+
+    Image tmp(width, height), blurred(width, height);
+    tScanline.start();
+    blur.apply<Image::R>(img, tmp, blurred);
+    blur.apply<Image::G>(img, tmp, blurred);
+    blur.apply<Image::B>(img, tmp, blurred);
+    blur.apply<Image::A>(img, tmp, blurred);
+    tScanline.stop();
+
+    Tiled tiledBlurred(width, height);
+    tTiled.start();
+    blur.apply<Tiled::R>(tiled, tiledBlurred);
+    blur.apply<Tiled::G>(tiled, tiledBlurred);
+    blur.apply<Tiled::B>(tiled, tiledBlurred);
+    blur.apply<Tiled::A>(tiled, tiledBlurred);
+    tTiled.stop();
+
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            const float r = blurred.ElementAt<Image::R>(i, j);
+            const float a = blurred.ElementAt<Image::A>(i, j);
+            ASSERT_NEAR(r, tiledBlurred.ElementAt<Tiled::R>(i, j), 1e-6f * r);
+            ASSERT_NEAR(a, tiledBlurred.ElementAt<Tiled::A>(i, j), 1e-6f * a);
+        }
+    }
+
+    cout << "> Blur " << width << "x" << height << ", scanline: "
+         << tScanline.milliTime()*1e-3 << " s, tiled: "
+         << tTiled.milliTime()*1e-3 << " s" << endl;
+}
@@ -23,13 +23,18 @@
 #include "Timer.h"
 
 #include <ToneMapperSoA.h>
+#include <DisplayLUT.h>
 #include <ImageSoA.h>
+#include <ImageView.h>
 #include <Image.h>
+#include <rgbe.h>
 
 #include <gtest/gtest.h>
 
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <cfloat>
 
 
 using std::cout;
@@ -40,6 +45,11 @@ using std::endl;
 namespace
 {
 
+bool SamePixels(const pcg::Bgra8& p0, const pcg::Bgra8& p1)
+{
+    return p0.r == p1.r && p0.g == p1.g && p0.b == p1.b && p0.a == p1.a;
+}
+
 bool PixelsClose(const pcg::Bgra8& p0, const pcg::Bgra8& p1)
 {
     bool areClose = true;
@@ -497,6 +507,410 @@ TEST_F(ToneMapperSoATest, Benchmark4K)
 
 
 
+TEST_F(ToneMapperSoATest, HalfPrecision)
+{
+    // Widening is exact, so the half sources must produce the same pixels as
+    // their single precision counterparts
+    pcg::Image<pcg::Rgba32F> img(317, 123);
+    fillRnd(img);
+    pcg::Image<pcg::Rgba16F> imgHalf(img.Width(), img.Height());
+    pcg::RGBA16FImageSoA imgHalfSoA(img.Width(), img.Height());
+    for (int i = 0; i < img.Size(); ++i) {
+        imgHalf[i] = pcg::Rgba16F(img[i]);
+        img[i] = imgHalf[i].toRgba32F();
+        imgHalfSoA.ElementAt<pcg::RGBA16FImageSoA::R>(i) = imgHalf[i].rBits;
+        imgHalfSoA.ElementAt<pcg::RGBA16FImageSoA::G>(i) = imgHalf[i].gBits;
+        imgHalfSoA.ElementAt<pcg::RGBA16FImageSoA::B>(i) = imgHalf[i].bBits;
+        imgHalfSoA.ElementAt<pcg::RGBA16FImageSoA::A>(i) = imgHalf[i].aBits;
+    }
+    pcg::RGBAImageSoA imgSoA(img);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(pcg::Reinhard02::EstimateParams(img));
+    const pcg::TmoTechnique techniques[] = {pcg::EXPOSURE, pcg::REINHARD02};
+    for (int k = 0; k < 2; ++k) {
+        pcg::Image<pcg::Bgra8> expected(img.Width(), img.Height());
+        pcg::Image<pcg::Bgra8> expectedSoA(img.Width(), img.Height());
+        pcg::Image<pcg::Bgra8> result(img.Width(), img.Height());
+        pcg::Image<pcg::Bgra8> resultSoA(img.Width(), img.Height());
+        tm.ToneMap(expected, img, techniques[k]);
+        tm.ToneMap(expectedSoA, imgSoA, techniques[k]);
+        tm.ToneMap(result, imgHalf, techniques[k]);
+        tm.ToneMap(resultSoA, imgHalfSoA, techniques[k]);
+
+        for (int i = 0; i < img.Size(); ++i) {
+            ASSERT_TRUE(SamePixels(expected[i], result[i])) << i;
+            ASSERT_TRUE(SamePixels(expectedSoA[i], resultSoA[i])) << i;
+        }
+    }
+}
+
+
+
+TEST_F(ToneMapperSoATest, Opaque)
+{
+    // Without the alpha plane the colors must be the same as with an opaque
+    // RGBA image, and so must be the Reinhard02 parameters
+    pcg::Image<pcg::Rgba32F> img(317, 123);
+    fillRnd(img);
+    pcg::RGBImageSoA imgRGB(img.Width(), img.Height());
+    for (int i = 0; i < img.Size(); ++i) {
+        img[i].setA(1.0f);
+        imgRGB.ElementAt<pcg::RGBImageSoA::R>(i) = img[i].r();
+        imgRGB.ElementAt<pcg::RGBImageSoA::G>(i) = img[i].g();
+        imgRGB.ElementAt<pcg::RGBImageSoA::B>(i) = img[i].b();
+    }
+    pcg::RGBAImageSoA imgSoA(img);
+
+    const pcg::Reinhard02::Params params =
+        pcg::Reinhard02::EstimateParams(imgSoA);
+    const pcg::Reinhard02::Params paramsRGB =
+        pcg::Reinhard02::EstimateParams(imgRGB);
+    ASSERT_EQ(params.key,   paramsRGB.key);
+    ASSERT_EQ(params.l_w,   paramsRGB.l_w);
+    ASSERT_EQ(params.l_max, paramsRGB.l_max);
+    ASSERT_EQ(params.l_min, paramsRGB.l_min);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(params);
+    const pcg::TmoTechnique techniques[] = {pcg::EXPOSURE, pcg::REINHARD02};
+    for (int k = 0; k < 2; ++k) {
+        pcg::Image<pcg::Bgra8> expected(img.Width(), img.Height());
+        pcg::Image<pcg::Bgra8> result(img.Width(), img.Height());
+        tm.ToneMap(expected, imgSoA, techniques[k]);
+        tm.ToneMap(result, imgRGB, techniques[k]);
+
+        for (int i = 0; i < img.Size(); ++i) {
+            ASSERT_TRUE(SamePixels(expected[i], result[i])) << i;
+            ASSERT_EQ(255, result[i].a);
+        }
+    }
+}
+
+
+
+TEST_F(ToneMapperSoATest, OutputFormats)
+{
+    // Every format and scanline order must match the Bgra8 top-down result;
+    // the 16-bit values only have to be within the 8-bit rounding error
+    pcg::Image<pcg::Rgba32F> img(317, 123);
+    fillRnd(img);
+    pcg::RGBAImageSoA imgSoA(img);
+    const int w = img.Width();
+    const int h = img.Height();
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-9.0f);
+    tm.SetParams(pcg::Reinhard02::EstimateParams(imgSoA));
+    const pcg::TmoTechnique techniques[] = {pcg::EXPOSURE, pcg::REINHARD02};
+    for (int k = 0; k < 2; ++k) {
+        for (int useSoA = 0; useSoA != 2; ++useSoA) {
+            pcg::Image<pcg::Bgra8>                 expected(w, h);
+            pcg::Image<pcg::Bgra8, pcg::BottomUp>  bgra8BottomUp(w, h);
+            pcg::Image<pcg::Rgba8>                 rgba8(w, h);
+            pcg::Image<pcg::Rgba8, pcg::BottomUp>  rgba8BottomUp(w, h);
+            pcg::Image<pcg::Rgba16>                rgba16(w, h);
+            pcg::Image<pcg::Rgba16, pcg::BottomUp> rgba16BottomUp(w, h);
+            if (useSoA) {
+                tm.ToneMap(expected,       imgSoA, techniques[k]);
+                tm.ToneMap(bgra8BottomUp,  imgSoA, techniques[k]);
+                tm.ToneMap(rgba8,          imgSoA, techniques[k]);
+                tm.ToneMap(rgba8BottomUp,  imgSoA, techniques[k]);
+                tm.ToneMap(rgba16,         imgSoA, techniques[k]);
+                tm.ToneMap(rgba16BottomUp, imgSoA, techniques[k]);
+            } else {
+                tm.ToneMap(expected,       img, techniques[k]);
+                tm.ToneMap(bgra8BottomUp,  img, techniques[k]);
+                tm.ToneMap(rgba8,          img, techniques[k]);
+                tm.ToneMap(rgba8BottomUp,  img, techniques[k]);
+                tm.ToneMap(rgba16,         img, techniques[k]);
+                tm.ToneMap(rgba16BottomUp, img, techniques[k]);
+            }
+
+            for (int j = 0; j < h; ++j) {
+                for (int i = 0; i < w; ++i) {
+                    const pcg::Bgra8& p = expected.ElementAt(i, j);
+                    ASSERT_TRUE(SamePixels(p,
+                        bgra8BottomUp.ElementAt(i, j, pcg::TopDown)));
+
+                    const pcg::Rgba8* p8[] = { &rgba8.ElementAt(i, j),
+                        &rgba8BottomUp.ElementAt(i, j, pcg::TopDown) };
+                    for (int n = 0; n < 2; ++n) {
+                        ASSERT_EQ(p.r, p8[n]->r) << i << ',' << j;
+                        ASSERT_EQ(p.g, p8[n]->g) << i << ',' << j;
+                        ASSERT_EQ(p.b, p8[n]->b) << i << ',' << j;
+                        ASSERT_EQ(p.a, p8[n]->a) << i << ',' << j;
+                    }
+
+                    const pcg::Rgba16* p16[] = { &rgba16.ElementAt(i, j),
+                        &rgba16BottomUp.ElementAt(i, j, pcg::TopDown) };
+                    for (int n = 0; n < 2; ++n) {
+                        ASSERT_NEAR(257 * p.r, p16[n]->r, 129);
+                        ASSERT_NEAR(257 * p.g, p16[n]->g, 129);
+                        ASSERT_NEAR(257 * p.b, p16[n]->b, 129);
+                        ASSERT_NEAR(257 * p.a, p16[n]->a, 129);
+                    }
+                    ASSERT_EQ(p16[0]->r, p16[1]->r);
+                    ASSERT_EQ(p16[0]->g, p16[1]->g);
+                    ASSERT_EQ(p16[0]->b, p16[1]->b);
+                    ASSERT_EQ(p16[0]->a, p16[1]->a);
+                }
+            }
+        }
+    }
+}
+
+
+
+TEST_F(ToneMapperSoATest, Rgbe)
+{
+    // Decoding within the kernel must give exactly the same results as tone
+    // mapping the decoded image, also through views which are not aligned
+    pcg::RGBAImageSoA imgSoA(317, 123);
+    fillRnd(imgSoA);
+    pcg::Image<pcg::Rgbe> rgbe;
+    imgSoA.CopyTo(rgbe);
+    const pcg::RGBAImageSoA decoded(rgbe);
+    const int w = rgbe.Width();
+    const int h = rgbe.Height();
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-9.0f);
+    tm.SetParams(pcg::Reinhard02::EstimateParams(decoded));
+    const pcg::TmoTechnique techniques[] = {pcg::EXPOSURE, pcg::REINHARD02};
+    for (int k = 0; k < 2; ++k) {
+        pcg::Image<pcg::Bgra8>  expected(w, h),   actual(w, h);
+        pcg::Image<pcg::Rgba16> expected16(w, h), actual16(w, h);
+        tm.ToneMap(expected, decoded, techniques[k]);
+        tm.ToneMap(actual,   rgbe,    techniques[k]);
+        tm.ToneMap(pcg::ImageView<pcg::Rgba16>(expected16),
+            pcg::RGBAImageSoAView(decoded), techniques[k]);
+        tm.ToneMap(pcg::ImageView<pcg::Rgba16>(actual16),
+            pcg::ImageView<pcg::Rgbe>(rgbe), techniques[k]);
+
+        // Odd sized window, starting at an odd pixel
+        const int x0 = 3, y0 = 5, wSub = w - 14, hSub = h - 9;
+        pcg::Image<pcg::Rgba8> sub(wSub, hSub);
+        tm.ToneMap(pcg::ImageView<pcg::Rgba8>(sub), pcg::ImageView<pcg::Rgbe>(
+            &rgbe.ElementAt(x0, y0), wSub, hSub, w), techniques[k]);
+
+        for (int j = 0; j < h; ++j) {
+            for (int i = 0; i < w; ++i) {
+                ASSERT_TRUE(SamePixels(expected.ElementAt(i, j),
+                    actual.ElementAt(i, j))) << i << ',' << j;
+                const pcg::Rgba16& e16 = expected16.ElementAt(i, j);
+                const pcg::Rgba16& a16 = actual16.ElementAt(i, j);
+                ASSERT_EQ(e16.r, a16.r) << i << ',' << j;
+                ASSERT_EQ(e16.g, a16.g) << i << ',' << j;
+                ASSERT_EQ(e16.b, a16.b) << i << ',' << j;
+                ASSERT_EQ(e16.a, a16.a) << i << ',' << j;
+            }
+        }
+        for (int j = 0; j < hSub; ++j) {
+            for (int i = 0; i < wSub; ++i) {
+                const pcg::Bgra8& p = expected.ElementAt(x0 + i, y0 + j);
+                const pcg::Rgba8& p8 = sub.ElementAt(i, j);
+                ASSERT_EQ(p.r, p8.r) << i << ',' << j;
+                ASSERT_EQ(p.g, p8.g) << i << ',' << j;
+                ASSERT_EQ(p.b, p8.b) << i << ',' << j;
+                ASSERT_EQ(p.a, p8.a) << i << ',' << j;
+            }
+        }
+    }
+}
+
+
+
+TEST_F(ToneMapperSoATest, BenchmarkRgbe)
+{
+    // Decoding into a full precision image before tone mapping against
+    // decoding within the kernel
+    pcg::RGBAImageSoA imgSoA(4096, 2160);
+    fillRnd(imgSoA);
+    pcg::Image<pcg::Rgbe> rgbe;
+    imgSoA.CopyTo(rgbe);
+    pcg::Image<pcg::Bgra8> out(rgbe.Width(), rgbe.Height());
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(pcg::Reinhard02::EstimateParams(imgSoA));
+
+    Timer tDecoded;
+    Timer tDirect;
+    const int N = 16;
+    for (int i = 0; i != N; ++i) {
+        tDecoded.start();
+        const pcg::RGBAImageSoA decoded(rgbe);
+        tm.ToneMap(out, decoded, pcg::REINHARD02);
+        tDecoded.stop();
+
+        tDirect.start();
+        tm.ToneMap(out, rgbe, pcg::REINHARD02);
+        tDirect.stop();
+    }
+
+    const double factor = 1e-6 / N;
+    cout << "Time decode + tone map: " << tDecoded.nanoTime()*factor << " ms"
+         << endl;
+    cout << "Time direct RGBE:       " << tDirect.nanoTime()*factor  << " ms"
+         << endl;
+}
+
+
+
+TEST_F(ToneMapperSoATest, DisplayLUT)
+{
+    // The interpolation error decreases with the square of the spacing of
+    // the entries; below 2^-18 the results only need to be small enough
+    const float gammas[] = {0.0f, 1.0f, 2.2f, 0.45f};
+    for (int g = 0; g < 4; ++g) {
+        for (int p = pcg::DisplayLUT::MIN_PRECISION;
+             p <= pcg::DisplayLUT::MAX_PRECISION; ++p) {
+            pcg::DisplayLUT lut;
+            if (gammas[g] == 0.0f) {
+                lut.SetSRGB(p);
+            } else {
+                lut.SetGamma(gammas[g], p);
+            }
+            ASSERT_EQ(p, lut.Precision());
+            const double maxRelError = ldexp(1.0, -2*p) * 
+                (gammas[g] < 1.0f ? 0.5 : 0.05) + 4e-7;
+
+            for (int i = 0; i < 20000; ++i) {
+                const float x = i < 10000 ?
+                    static_cast<float>(ldexp(1.0, -40 * i / 10000) *
+                        (1.0 + m_rnd.nextFloat())) :
+                    m_rnd.nextFloat();
+                const double xd = std::min(static_cast<double>(x), 1.0);
+                const double expected = gammas[g] == 0.0f ?
+                    (xd <= 0.0031308 ? 12.92 * xd :
+                        1.055 * pow(xd, 1.0/2.4) - 0.055) :
+                    pow(xd, 1.0 / gammas[g]);
+                const double actual = lut(x);
+                // The two segments of sRGB do not quite meet at the cutoff
+                const double tolerance = maxRelError * expected +
+                    (gammas[g] == 0.0f ? 1e-6 : 0.0);
+                if (expected < ldexp(1.0, -18)) {
+                    ASSERT_LT(actual, ldexp(1.0, -17)) << x;
+                } else {
+                    ASSERT_NEAR(expected, actual, tolerance) <<
+                        x << " gamma: " << gammas[g] << " precision: " << p;
+                }
+            }
+            ASSERT_FLOAT_EQ(lut(1.0f), 1.0f);
+            ASSERT_EQ(lut(0.0f), lut(-1.0f));
+
+            // The whole range of the floats saturates at the ends
+            const float inf = std::numeric_limits<float>::infinity();
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            const float high[] = {1.0f + FLT_EPSILON, 2.0f, 65504.0f,
+                FLT_MAX, inf, nan};
+            for (size_t k = 0; k < sizeof(high)/sizeof(high[0]); ++k) {
+                ASSERT_EQ(lut(1.0f), lut(high[k])) << high[k];
+            }
+            const float low[] = {-0.0f, -FLT_MIN, -1.0f, -FLT_MAX, -inf,
+                -nan, FLT_MIN, std::numeric_limits<float>::denorm_min()};
+            for (size_t k = 0; k < sizeof(low)/sizeof(low[0]); ++k) {
+                ASSERT_EQ(lut(0.0f), lut(low[k])) << low[k];
+            }
+        }
+    }
+
+    // Copies are independent
+    pcg::DisplayLUT lut;
+    lut.SetGamma(2.2f, 8);
+    pcg::DisplayLUT lutCopy(lut);
+    lut.SetSRGB(4);
+    ASSERT_FALSE(lutCopy.IsSRGB());
+    ASSERT_EQ(2.2f, lutCopy.Gamma());
+    ASSERT_EQ(8, lutCopy.Precision());
+    ASSERT_FLOAT_EQ(powf(0.5f, 1.0f/2.2f), lutCopy(0.5f));
+    lutCopy = lut;
+    ASSERT_TRUE(lutCopy.IsSRGB());
+    ASSERT_EQ(lut(0.25f), lutCopy(0.25f));
+}
+
+
+
+TEST_F(ToneMapperSoATest, BenchmarkDisplayLUT)
+{
+    // Compare the table against the fast sRGB approximation, and the cost of
+    // changing the exposure against the old LUT-based tone mapper
+    pcg::Image<pcg::Rgba32F> img(4096, 2160);
+    fillRnd(img);
+    pcg::RGBAImageSoA imgSoA(img);
+    pcg::Image<pcg::Bgra8> outFast2(img.Width(), img.Height());
+    pcg::Image<pcg::Bgra8> outLUT(img.Width(), img.Height());
+    pcg::Image<pcg::Bgra8> outLUTGamma(img.Width(), img.Height());
+    pcg::Image<pcg::Bgra8> outFastGamma(img.Width(), img.Height());
+
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(pcg::Reinhard02::EstimateParams(imgSoA));
+    tm.SetSRGB(true);
+    pcg::ToneMapper tmOld(0.0f, 4096);
+
+    Timer tFast2;
+    Timer tLUT;
+    Timer tLUTGamma;
+    Timer tFastGamma;
+    Timer tExposure;
+    Timer tExposureOld;
+    const int N = 16;
+    for (int i = 0; i != N; ++i) {
+        tm.SetSRGBMethod(pcg::ToneMapperSoA::SRGB_FAST2);
+        tFast2.start();
+        tm.ToneMap(outFast2, imgSoA, pcg::REINHARD02);
+        tFast2.stop();
+
+        tm.SetSRGBMethod(pcg::ToneMapperSoA::SRGB_LUT);
+        tLUT.start();
+        tm.ToneMap(outLUT, imgSoA, pcg::REINHARD02);
+        tLUT.stop();
+
+        tm.SetSRGB(false);
+        tm.SetGammaMethod(pcg::ToneMapperSoA::GAMMA_LUT);
+        tLUTGamma.start();
+        tm.ToneMap(outLUTGamma, imgSoA, pcg::REINHARD02);
+        tLUTGamma.stop();
+        tm.SetGammaMethod(pcg::ToneMapperSoA::GAMMA_FAST);
+        tFastGamma.start();
+        tm.ToneMap(outFastGamma, imgSoA, pcg::REINHARD02);
+        tFastGamma.stop();
+        tm.SetSRGB(true);
+
+        tExposure.start();
+        tm.SetExposure(-0.125f * i);
+        tExposure.stop();
+
+        tExposureOld.start();
+        tmOld.SetExposure(-0.125f * i);
+        tExposureOld.stop();
+    }
+    tm.SetExposure(0.0f);
+    tm.SetSRGBMethod(pcg::ToneMapperSoA::SRGB_FAST2);
+    tm.ToneMap(outFast2, imgSoA, pcg::REINHARD02);
+    tm.SetSRGBMethod(pcg::ToneMapperSoA::SRGB_LUT);
+    tm.ToneMap(outLUT, imgSoA, pcg::REINHARD02);
+    for (int i = 0; i < img.Size(); ++i) {
+        ASSERT_PRED2(PixelsClose, outFast2[i], outLUT[i]) << i;
+    }
+
+    const double factor = 1e-6 / N;
+    cout << "Time sRGB Fast2:     " << tFast2.nanoTime()*factor    << " ms"
+         << endl;
+    cout << "Time sRGB LUT:       " << tLUT.nanoTime()*factor      << " ms"
+         << endl;
+    cout << "Time Gamma Fast:     " << tFastGamma.nanoTime()*factor << " ms"
+         << endl;
+    cout << "Time Gamma LUT:      " << tLUTGamma.nanoTime()*factor << " ms"
+         << endl;
+    cout << "SetExposure:         " << tExposure.nanoTime()*factor << " ms"
+         << endl;
+    cout << "SetExposure (old):   " << tExposureOld.nanoTime()*factor
+         << " ms" << endl;
+}
+
+
+
 class ToneMapperSoATestSRGB :
     public ::testing::TestWithParam<pcg::ToneMapperSoA::ESRGBMethod>
 {
@@ -636,4 +1050,5 @@ TEST_P(ToneMapperSoATestSRGB, ValidateSoA)
 INSTANTIATE_TEST_CASE_P(SRGB, ToneMapperSoATestSRGB, ::testing::Values(
     pcg::ToneMapperSoA::SRGB_REF,
     pcg::ToneMapperSoA::SRGB_FAST1,
-    pcg::ToneMapperSoA::SRGB_FAST2));
+    pcg::ToneMapperSoA::SRGB_FAST2,
+    pcg::ToneMapperSoA::SRGB_LUT));
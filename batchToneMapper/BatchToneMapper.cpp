@@ -22,8 +22,10 @@
 #include "FileInputFilter.h"
 #include "ZipfileInputFilter.h"
 #include "ToneMappingFilter.h"
+#include "StreamingToneMappingFilter.h"
 
 #include <HDRITools_version.h>
+#include <ImageAllocator.h>
 #include <QString>
 
 #include <cstdio>
@@ -104,6 +106,11 @@ void BatchToneMapper::setFormat(const QString & newFormat)
 
 void BatchToneMapper::execute() {
 
+    // Each token allocates and frees full size images: recycle their buffers
+    // instead of returning them to the system after every file
+    pcg::PooledAllocator pool(pcg::PooledAllocator::DEFAULT_MAX_CACHED, true);
+    pcg::AllocatorScope poolScope(&pool);
+
     if (!zipFiles.isEmpty()) {
         executeZip();
         qcout << "All Zip files have been processed." << endl;
@@ -215,8 +222,24 @@ void BatchToneMapper::executeZip() {
 }
 
 
+bool BatchToneMapper::canStream() const
+{
+    const bool isFixedCurve = technique == pcg::EXPOSURE ||
+        (technique == pcg::REINHARD02 &&
+         key        != ToneMappingFilter::AutoParam() &&
+         whitePoint != ToneMappingFilter::AutoParam() &&
+         logLumAvg  != ToneMappingFilter::AutoParam());
+    return isFixedCurve && (useBpp16 || format == "png");
+}
+
+
 void BatchToneMapper::executeHdr() {
 
+    if (canStream()) {
+        executeHdrStreaming();
+        return;
+    }
+
     // Creates and uses a TBB pipeline
     tbb::pipeline pipeline;
 
@@ -239,6 +262,35 @@ void BatchToneMapper::executeHdr() {
 }
 
 
+void BatchToneMapper::executeHdrStreaming() {
+
+    // The Reinhard02 parameters are fixed, thus they are set only once
+    if (technique == pcg::REINHARD02) {
+        pcg::Reinhard02::Params params;
+        params.key     = key;
+        params.l_white = whitePoint;
+        params.l_w     = logLumAvg;
+        toneMapper.SetParams(params);
+    }
+
+    // Creates and uses a TBB pipeline
+    tbb::pipeline pipeline;
+
+    // Each file is loaded, tone mapped and saved in bands by a single filter
+    FileInputFilter inputFilter(hdrFiles);
+    StreamingToneMappingFilter toneFilter(toneMapper, useBpp16, technique,
+        format, offset);
+
+    pipeline.add_filter(inputFilter);
+    pipeline.add_filter(toneFilter);
+
+    pipeline.run(tokens);
+
+    // Clears the filters after it's done
+    pipeline.clear();
+}
+
+
 ostream& operator<<(ostream& os, const BatchToneMapper& b)
 {
     os << "BatchToneMapper: LUT size " << BatchToneMapper::LUT_SIZE 
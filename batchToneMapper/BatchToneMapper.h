@@ -120,9 +120,15 @@ private:
     // for deletion of the returned object
     ToneMappingFilter* createToneMappingFilter();
 
+    // Whether the standalone files may be tone mapped in bands of scanlines
+    // without loading them whole: the curve must be the same for all the
+    // images and the encoder must accept scanlines, which only png does.
+    bool canStream() const;
+
     // Individual pipelines
     void executeZip();
     void executeHdr();
+    void executeHdrStreaming();
 };
 
 
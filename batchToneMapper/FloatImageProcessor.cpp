@@ -89,6 +89,14 @@ ImageInfo* FloatImageProcessor::load(const QString& filenameStr,
 
 }
 
+QString FloatImageProcessor::targetName(const QString& filenameStr,
+                                        const QString& formatStr, int offset)
+{
+    QString filename(filenameStr);
+    setTargetName(filename, formatStr, offset);
+    return filename;
+}
+
 void FloatImageProcessor::setTargetName(QString & filename,
                                         const QString & formatStr, int offset)
 {
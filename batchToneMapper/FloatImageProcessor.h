@@ -34,6 +34,10 @@ public:
     static ImageInfo* load(const QString& filenameStr, std::istream & is, 
         const QString& formatStr, int offset = 0);
 
+    // Name of the output file for the given input, as used by load
+    static QString targetName(const QString& filenameStr,
+        const QString& formatStr, int offset = 0);
+
 private:
     // To get the output filename it adds the offset (if it makes sense)
     // and changes the extension
@@ -0,0 +1,124 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ ----------------------------------------------------------------------------- 
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "StreamingToneMappingFilter.h"
+#include "FloatImageProcessor.h"
+
+#include <HdrScanlineIO.h>
+#include <PngIO.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <ImageView.h>
+#include <LDRPixels.h>
+#include <rgbe.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include <cstdio>
+#include <QTextStream>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace
+{
+QTextStream cerr(stderr, QIODevice::WriteOnly);
+QTextStream cout(stdout, QIODevice::WriteOnly);
+
+QMutex write_mutex;
+}
+
+const int StreamingToneMappingFilter::BAND_PIXELS;
+
+
+StreamingToneMappingFilter::StreamingToneMappingFilter(
+    const pcg::ToneMapper &toneMapper, bool useBpp16,
+    pcg::TmoTechnique technique, const QString &format, int filenameOffset) :
+tbb::filter(/*is_serial=*/false),
+toneMapper(toneMapper.isSRGB(), toneMapper.Gamma()),
+useBpp16(useBpp16), technique(technique),
+formatStr(format), offset(filenameOffset)
+{
+    this->toneMapper.SetExposure(toneMapper.Exposure());
+    this->toneMapper.SetParams(toneMapper.ParamsReinhard02());
+    this->toneMapper.SetSRGBMethod(pcg::ToneMapperSoA::SRGB_LUT);
+    this->toneMapper.SetGammaMethod(pcg::ToneMapperSoA::GAMMA_LUT);
+}
+
+
+template <class T>
+void StreamingToneMappingFilter::process(const QString &filename,
+                                         const QString &outname) const
+{
+    pcg::HdrScanlineReader reader(filename.toLocal8Bit().constData());
+    const int width  = reader.Width();
+    const int height = reader.Height();
+    const int bandHeight = std::min(height, std::max(1, BAND_PIXELS / width));
+
+    pcg::PngScanlineWriter writer(outname.toLocal8Bit().constData(),
+        width, height, useBpp16, toneMapper.isSRGB(), toneMapper.InvGamma());
+
+    // All the bands are reused, they are reallocated only for the last one
+    pcg::Image<T, pcg::TopDown> ldrBand;
+    if (reader.Format() == pcg::HDR_RGBE) {
+        pcg::Image<pcg::Rgbe, pcg::TopDown> rgbeBand;
+        while (reader.Read(rgbeBand, bandHeight) != 0) {
+            if (ldrBand.Height() != rgbeBand.Height()) {
+                ldrBand.Alloc(width, rgbeBand.Height());
+            }
+            toneMapper.ToneMap(pcg::ImageView<T, pcg::TopDown>(ldrBand),
+                pcg::ImageView<pcg::Rgbe, pcg::TopDown>(rgbeBand), technique);
+            writer.Write(ldrBand);
+        }
+    } else {
+        pcg::RGBAImageSoA floatBand;
+        while (reader.Read(floatBand, bandHeight) != 0) {
+            if (ldrBand.Height() != floatBand.Height()) {
+                ldrBand.Alloc(width, floatBand.Height());
+            }
+            toneMapper.ToneMap(ldrBand, floatBand, technique);
+            writer.Write(ldrBand);
+        }
+    }
+    writer.Close();
+}
+
+
+void* StreamingToneMappingFilter::operator()(void* arg)
+{
+    const QString *filename = static_cast<const QString*>(arg);
+    assert(filename != NULL);
+
+    const QString outname =
+        FloatImageProcessor::targetName(*filename, formatStr, offset);
+
+    try {
+        if (!useBpp16) {
+            process<pcg::Bgra8>(*filename, outname);
+        } else {
+            process<pcg::Rgba16>(*filename, outname);
+        }
+
+        QMutexLocker lock(&write_mutex);
+        cout << *filename << " -> " << outname << endl;
+    }
+    catch (std::exception &e) {
+        cerr << "Ooops! While processing " << *filename << ": "
+             << e.what() << endl;
+    }
+
+    // Always returns null, as it's in the last part of the pipeline
+    return NULL;
+}
@@ -0,0 +1,66 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ ----------------------------------------------------------------------------- 
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#if !defined(STREAMINGTONEMAPPINGFILTER_H)
+#define STREAMINGTONEMAPPINGFILTER_H
+
+#include <ToneMapper.h>
+#include <ToneMapperSoA.h>
+
+#include <QString>
+
+// TBB import for the filter stuff
+#include <tbb/pipeline.h>
+
+
+// Loads, tone maps and saves each file in bands of scanlines, so that the
+// memory used by each token is bounded regardless of the image resolution.
+// This only works when the tone mapping curve is the same for all the pixels
+// of every file (the exposure TMO or Reinhard02 with all the parameters set)
+// and the output format is png.
+//
+// The bands are tone mapped with ToneMapperSoA and its display LUT. RGBE
+// files are read as raw RGBE scanlines and decoded within its kernels, the
+// other formats are read as SoA bands. The png files are written with
+// PngScanlineWriter, thus the 8-bit ones have the same pixels as those saved
+// through QImage but also get the sRGB or gAMA chunks, like the 16-bit ones.
+class StreamingToneMappingFilter : public tbb::filter {
+
+public:
+    // The tone mapper must be already set up: its exposure, display curve
+    // and Reinhard02 parameters are copied into the filter's ToneMapperSoA
+    StreamingToneMappingFilter(const pcg::ToneMapper &toneMapper, bool useBpp16,
+        pcg::TmoTechnique technique, const QString &format,
+        int filenameOffset = 0);
+
+    // The input of this filter are the const QString* from FileInputFilter
+    // with the name of the file to tone map. Always returns null.
+    void* operator()(void* arg);
+
+    // Maximum number of pixels in each band
+    static const int BAND_PIXELS = 1 << 16;
+
+private:
+    template <class T>
+    void process(const QString &filename, const QString &outname) const;
+
+    pcg::ToneMapperSoA toneMapper;
+    const bool useBpp16;
+    const pcg::TmoTechnique technique;
+    const QString formatStr;
+    const int offset;
+};
+
+#endif /* STREAMINGTONEMAPPINGFILTER_H */